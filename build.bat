@@ -4,6 +4,27 @@ echo Building OLED Aegis...
 if not exist build mkdir build
 cd build
 
+if /I "%1"=="test" (
+    rem Unit tests and kernel benchmarks: plain C, no resources or Windows libraries needed
+    echo Compiling tests...
+    for %%T in (test_policy test_config test_motion test_names bench_motion bench_names) do (
+        cl.exe ..\tests\%%T.c /I ..\src /Fe:%%T.exe /O2 /nologo /W3
+        if errorlevel 1 exit /b 1
+        %%T.exe
+        if errorlevel 1 exit /b 1
+    )
+    exit /b 0
+)
+
+if /I "%1"=="bench" (
+    rem Window scan benchmark: creates real windows, so it needs a desktop session
+    echo Compiling window scan benchmark...
+    cl.exe ..\tests\bench_window_scan.c /Fe:bench_window_scan.exe /O2 /nologo /W3 /link user32.lib dwmapi.lib
+    if errorlevel 1 exit /b 1
+    bench_window_scan.exe %2 %3 %4 %5 %6 %7 %8 %9
+    exit /b %ERRORLEVEL%
+)
+
 echo Compiling resources...
 rc.exe /nologo /fo oled_aegis.res ..\src\oled_aegis.rc
 if %ERRORLEVEL% NEQ 0 (
@@ -13,10 +34,18 @@ if %ERRORLEVEL% NEQ 0 (
 )
 
 echo Compiling executable...
-cl.exe ..\src\oled_aegis.c /Fe:oled_aegis.exe /O2 /nologo /MD /D "INITGUID" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib oled_aegis.res
+set OUTPUT_EXE=oled_aegis.exe
+if /I "%1"=="minimal" (
+    rem Minimal-footprint build: media detection, per-monitor input, settings UI and debug logging compiled out
+    set OUTPUT_EXE=oled_aegis_minimal.exe
+    cl.exe ..\src\oled_aegis.c /Fe:oled_aegis_minimal.exe /O1 /nologo /MD /D "INITGUID" /D "OLED_MINIMAL_BUILD" /link user32.lib shell32.lib gdi32.lib advapi32.lib psapi.lib oled_aegis.res
+) else (
+    cl.exe ..\src\oled_aegis.c /Fe:oled_aegis.exe /O2 /nologo /MD /D "INITGUID" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib oled_aegis.res
+)
 if %ERRORLEVEL% EQU 0 (
     echo Build successful!
-    echo Output: build\oled_aegis.exe
+    echo Output: build\%OUTPUT_EXE%
+    for %%A in (%OUTPUT_EXE%) do echo Size: %%~zA bytes
 ) else (
     echo Build failed!
     pause
@@ -45,8 +45,41 @@ if (!(Test-Path $sourceFile)) {
     exit 1
 }
 
-# Determine build type from arguments
+# Determine build type from arguments. Any further arguments are passed to
+# cl.exe as-is, e.g. /D "OLED_FEATURE_SETTINGS_UI=0" to strip a single feature
+# (for "bench" they are the window counts to measure).
 $buildType = if ($args.Count -gt 0) { $args[0] } else { "release" }
+$extraFlags = if ($args.Count -gt 1) { $args[1..($args.Count - 1)] } else { @() }
+
+if ($buildType -eq "test") {
+    # Unit tests and kernel benchmarks: plain C, no resources or Windows libraries needed
+    Write-Host "Building tests..." -ForegroundColor Green
+    $testExit = 0
+    foreach ($test in @("test_policy", "test_config", "test_motion", "test_names", "bench_motion", "bench_names")) {
+        cl.exe /nologo /O2 /W3 /I (Join-Path $PSScriptRoot "src") (Join-Path $PSScriptRoot "tests\$test.c") /Fe:"$test.exe"
+        if ($LASTEXITCODE -eq 0) {
+            & ".\$test.exe"
+        }
+        if ($LASTEXITCODE -ne 0) {
+            $testExit = $LASTEXITCODE
+            break
+        }
+    }
+    Pop-Location
+    exit $testExit
+}
+
+if ($buildType -eq "bench") {
+    # Window scan benchmark: creates real windows, so it needs a desktop session
+    Write-Host "Building window scan benchmark..." -ForegroundColor Green
+    cl.exe /nologo /O2 /W3 (Join-Path $PSScriptRoot "tests\bench_window_scan.c") /Fe:"bench_window_scan.exe" /link user32.lib dwmapi.lib
+    if ($LASTEXITCODE -eq 0) {
+        & ".\bench_window_scan.exe" @extraFlags
+    }
+    $benchExit = $LASTEXITCODE
+    Pop-Location
+    exit $benchExit
+}
 
 Write-Host "Building OLED Aegis ($buildType)..." -ForegroundColor Green
 
@@ -67,16 +100,24 @@ $linkResources = if (Test-Path $resourceObj) { $resourceObj } else { "" }
 if ($buildType -eq "debug") {
     # Debug Compile
     Write-Host "Configuration: Debug" -ForegroundColor Yellow
-    cl.exe -FC -Zi -MDd /D "INITGUID" "$sourceFile" /Fe:"$outputExe" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib $linkResources
+    cl.exe -FC -Zi -MDd /D "INITGUID" @extraFlags "$sourceFile" /Fe:"$outputExe" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib $linkResources
+} elseif ($buildType -eq "minimal") {
+    # Minimal-footprint compile: media detection, per-monitor input, the
+    # settings dialog and debug logging are compiled out (kiosk deployments
+    # that only need "black out monitor X after N seconds").
+    Write-Host "Configuration: Minimal (size optimized, features stripped)" -ForegroundColor Yellow
+    $outputExe = "oled_aegis_minimal.exe"
+    cl.exe -O1 -FC -MD /D "INITGUID" /D "OLED_MINIMAL_BUILD" @extraFlags "$sourceFile" /Fe:"$outputExe" /link user32.lib shell32.lib gdi32.lib advapi32.lib psapi.lib $linkResources
 } else {
     # Optimized Compile (Release)
     Write-Host "Configuration: Release (Optimized)" -ForegroundColor Yellow
-    cl.exe -O2 -FC -MD /D "INITGUID" "$sourceFile" /Fe:"$outputExe" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib $linkResources
+    cl.exe -O2 -FC -MD /D "INITGUID" @extraFlags "$sourceFile" /Fe:"$outputExe" /link user32.lib shell32.lib ole32.lib uuid.lib gdi32.lib advapi32.lib comctl32.lib powrprof.lib psapi.lib dwmapi.lib $linkResources
 }
 
 if ($LASTEXITCODE -eq 0) {
     Write-Host "`nBuild successful!" -ForegroundColor Green
     Write-Host "Output: $outputExe" -ForegroundColor Cyan
+    Write-Host "Size: $((Get-Item $outputExe).Length) bytes" -ForegroundColor Cyan
     Write-Host "Location: $(Get-Location)" -ForegroundColor Cyan
 } else {
     Write-Host "`nBuild failed with exit code: $LASTEXITCODE" -ForegroundColor Red
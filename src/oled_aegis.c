@@ -1,3 +1,82 @@
+// Compile-time feature selection. Every feature defaults to on; build with
+// /D "OLED_FEATURE_<NAME>=0" to strip it from the executable entirely.
+// /D "OLED_MINIMAL_BUILD" flips the default to off for every feature (see the
+// "minimal" configuration in build.ps1 / build.bat).
+#ifdef OLED_MINIMAL_BUILD
+#define OLED_FEATURE_DEFAULT                0
+#else
+#define OLED_FEATURE_DEFAULT                1
+#endif
+#ifndef OLED_FEATURE_MEDIA_DETECTION
+#define OLED_FEATURE_MEDIA_DETECTION        OLED_FEATURE_DEFAULT   // ES_DISPLAY_REQUIRED, WASAPI sessions, DWM window mapping
+#endif
+#ifndef OLED_FEATURE_PER_MONITOR_INPUT
+#define OLED_FEATURE_PER_MONITOR_INPUT      OLED_FEATURE_DEFAULT   // Per-monitor idle timers
+#endif
+#ifndef OLED_FEATURE_SETTINGS_UI
+#define OLED_FEATURE_SETTINGS_UI            OLED_FEATURE_DEFAULT   // Settings dialog (common controls)
+#endif
+#ifndef OLED_FEATURE_DEBUG_LOG
+#define OLED_FEATURE_DEBUG_LOG              OLED_FEATURE_DEFAULT   // debugMode log file
+#endif
+#ifndef OLED_FEATURE_LEASE_API
+#define OLED_FEATURE_LEASE_API              OLED_FEATURE_DEFAULT   // Idle-inhibit lease named pipe
+#endif
+#ifndef OLED_FEATURE_HOTKEYS
+#define OLED_FEATURE_HOTKEYS                OLED_FEATURE_DEFAULT   // RegisterHotKey activation shortcuts
+#endif
+#ifndef OLED_FEATURE_WEAR_STATS
+#define OLED_FEATURE_WEAR_STATS             OLED_FEATURE_DEFAULT   // Per-monitor wear/coverage accounting file
+#endif
+#ifndef OLED_FEATURE_BURNIN_MAP
+#define OLED_FEATURE_BURNIN_MAP             OLED_FEATURE_DEFAULT   // Static-region heatmap and partial overlays
+#endif
+#ifndef OLED_FEATURE_CONTROL_CLI
+#define OLED_FEATURE_CONTROL_CLI            OLED_FEATURE_DEFAULT   // --activate/--query/... forwarded to the running instance
+#endif
+#ifndef OLED_FEATURE_MOTION_DETECTION
+#define OLED_FEATURE_MOTION_DETECTION       OLED_FEATURE_DEFAULT   // On-screen motion as a video signal (frame differencing)
+#endif
+#ifndef OLED_FEATURE_DYNAMIC_TIMEOUT
+#define OLED_FEATURE_DYNAMIC_TIMEOUT        OLED_FEATURE_DEFAULT   // Per-monitor timeout scaled by picture brightness
+#endif
+#ifndef OLED_FEATURE_CONTROLLER_INPUT
+#define OLED_FEATURE_CONTROLLER_INPUT       OLED_FEATURE_DEFAULT   // XInput game controller activity as user input
+#endif
+#ifndef OLED_FEATURE_CPU_ACTIVITY
+#define OLED_FEATURE_CPU_ACTIVITY           OLED_FEATURE_DEFAULT   // Busy window-owning processes as activity
+#endif
+#ifndef OLED_FEATURE_TAB_PROBE
+#define OLED_FEATURE_TAB_PROBE              OLED_FEATURE_MEDIA_DETECTION   // UI Automation probe for background-tab video
+#endif
+#if OLED_FEATURE_TAB_PROBE && !OLED_FEATURE_MEDIA_DETECTION
+#error OLED_FEATURE_TAB_PROBE requires OLED_FEATURE_MEDIA_DETECTION
+#endif
+#ifndef OLED_FEATURE_FULLSCREEN_DETECTION
+#define OLED_FEATURE_FULLSCREEN_DETECTION   OLED_FEATURE_MEDIA_DETECTION   // Full-screen apps / presentation mode as media
+#endif
+#if OLED_FEATURE_FULLSCREEN_DETECTION && !OLED_FEATURE_MEDIA_DETECTION
+#error OLED_FEATURE_FULLSCREEN_DETECTION requires OLED_FEATURE_MEDIA_DETECTION
+#endif
+#ifndef OLED_FEATURE_MEDIA_SESSIONS
+#define OLED_FEATURE_MEDIA_SESSIONS         OLED_FEATURE_MEDIA_DETECTION   // SMTC playback state (WinRT) on a worker thread
+#endif
+#if OLED_FEATURE_MEDIA_SESSIONS && !OLED_FEATURE_MEDIA_DETECTION
+#error OLED_FEATURE_MEDIA_SESSIONS requires OLED_FEATURE_MEDIA_DETECTION
+#endif
+#ifndef OLED_FEATURE_PARALLEL_WINDOW_SCAN
+#define OLED_FEATURE_PARALLEL_WINDOW_SCAN   OLED_FEATURE_MEDIA_DETECTION   // Window interrogation on the thread pool
+#endif
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN && !OLED_FEATURE_MEDIA_DETECTION
+#error OLED_FEATURE_PARALLEL_WINDOW_SCAN requires OLED_FEATURE_MEDIA_DETECTION
+#endif
+#ifndef OLED_FEATURE_SLICED_WINDOW_SCAN
+#define OLED_FEATURE_SLICED_WINDOW_SCAN     OLED_FEATURE_MEDIA_DETECTION   // Window scan split across timer ticks
+#endif
+#if OLED_FEATURE_SLICED_WINDOW_SCAN && !OLED_FEATURE_MEDIA_DETECTION
+#error OLED_FEATURE_SLICED_WINDOW_SCAN requires OLED_FEATURE_MEDIA_DETECTION
+#endif
+
 #include <windows.h>
 #include <shellapi.h>
 #include <shlobj.h>
@@ -5,18 +84,33 @@
 #include <time.h>
 #include <stdarg.h>
 #include <string.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+
+#include "oled_policy.h"
+#include "oled_ini.h"
+#include "oled_names.h"
+
+#if OLED_FEATURE_LEASE_API
+#include <sddl.h>
+#endif
+
+#if OLED_FEATURE_SETTINGS_UI
 #include <commctrl.h>
+#pragma comment(lib, "comctl32.lib")
+#endif
+
+#if OLED_FEATURE_MEDIA_DETECTION
 #include <powerbase.h>
-#include <psapi.h>
 #include <dwmapi.h>
 #include <mmdeviceapi.h>
 #include <audiopolicy.h>
 #include <endpointvolume.h>
-#pragma comment(lib, "comctl32.lib")
+#include <tlhelp32.h>
 #pragma comment(lib, "powrprof.lib")
-#pragma comment(lib, "psapi.lib")
 #pragma comment(lib, "dwmapi.lib")
 #pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "uuid.lib")
 
 // The MMDevice / audio-session GUIDs are only extern-declared in the SDK
 // headers, not DEFINE_GUID'd, so they don't resolve at link time. INITGUID is
@@ -27,15 +121,102 @@ DEFINE_GUID(IID_IMMDeviceEnumerator,      0xA95664D2, 0x9614, 0x4F35, 0xA7, 0x46
 DEFINE_GUID(IID_IAudioSessionManager2,    0x77AA99A0, 0x1BD6, 0x484F, 0x8B, 0xC7, 0x2C, 0x65, 0x4C, 0x9A, 0x9B, 0x6F);
 DEFINE_GUID(IID_IAudioSessionControl2,    0xBFB7FF88, 0x7239, 0x4FC9, 0x8F, 0xA2, 0x07, 0xC9, 0x50, 0xBE, 0x9C, 0x6D);
 DEFINE_GUID(IID_IAudioMeterInformation,   0xC02216F6, 0x8C67, 0x4B5B, 0x9D, 0x00, 0xD0, 0x08, 0xE7, 0x3E, 0x00, 0x64);
+DEFINE_GUID(IID_IMMNotificationClient,    0x7991EEC9, 0x7E89, 0x4D85, 0x83, 0x90, 0x6C, 0x70, 0x3C, 0xEC, 0x60, 0xC0);
+DEFINE_GUID(IID_IAudioSessionNotification, 0x641DD20B, 0x4D41, 0x49CC, 0xAB, 0xA3, 0x17, 0x4B, 0x94, 0x77, 0xBB, 0x08);
+#endif
+
+#if OLED_FEATURE_TAB_PROBE
+#include <uiautomation.h>
+#pragma comment(lib, "oleaut32.lib")
+DEFINE_GUID(CLSID_CUIAutomation,          0xFF48DBA4, 0x60EF, 0x4201, 0xAA, 0x87, 0x54, 0x10, 0x3E, 0xEF, 0x59, 0x4E);
+DEFINE_GUID(IID_IUIAutomation,            0x30CBE57D, 0xD9D0, 0x452A, 0xAB, 0x13, 0x7A, 0xC5, 0xAC, 0x48, 0x25, 0xEE);
+DEFINE_GUID(IID_IUIAutomation2,           0x34723AFF, 0x0C9D, 0x49D0, 0x98, 0x96, 0x7A, 0xB5, 0x2D, 0xF8, 0xCD, 0x8A);
+#endif
+
+#if OLED_FEATURE_MEDIA_SESSIONS
+#include <roapi.h>
+#include <winstring.h>
+#include <propsys.h>
+#include <propkey.h>
+#include <windows.media.control.h>
+#pragma comment(lib, "runtimeobject.lib")
+#pragma comment(lib, "propsys.lib")
+// WinRT IIDs are only extern-declared in the SDK headers as well
+DEFINE_GUID(IID_SmtcManagerStatics,       0x2050C4EE, 0x11A0, 0x57DE, 0xAE, 0xD7, 0xC9, 0x7C, 0x70, 0x33, 0x82, 0x45);
+DEFINE_GUID(IID_SmtcAsyncInfo,            0x00000036, 0x0000, 0x0000, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46);
+DEFINE_GUID(IID_SmtcAgileObject,          0x94EA2B94, 0xE9CC, 0x49E0, 0xC0, 0xFF, 0xEE, 0x64, 0xCA, 0x8F, 0x5B, 0x90);
+// TypedEventHandler<SessionManager, SessionsChangedEventArgs> and
+// TypedEventHandler<Session, PlaybackInfoChangedEventArgs> (parameterized IIDs)
+DEFINE_GUID(IID_SmtcSessionsChangedHandler, 0x2E2A8630, 0xDC8C, 0x530A, 0x97, 0x46, 0xBC, 0x98, 0x4D, 0x4B, 0x02, 0x9E);
+DEFINE_GUID(IID_SmtcPlaybackChangedHandler, 0x2BDF1426, 0xD41F, 0x5896, 0x89, 0x7F, 0xEF, 0xC0, 0xB0, 0xFA, 0x73, 0x92);
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86)
+#if OLED_FEATURE_BURNIN_MAP
+#include <emmintrin.h>
+#endif
+#define BURNIN_USE_SSE2 OLED_FEATURE_BURNIN_MAP
+#else
+#define BURNIN_USE_SSE2 0
+#endif
+
+#if OLED_FEATURE_MOTION_DETECTION
+#include "oled_motion.h"
+#endif
+
+#if OLED_FEATURE_HOTKEYS
+#include <dwmapi.h>
+#pragma comment(lib, "dwmapi.lib")
+#endif
+
+#if OLED_FEATURE_CONTROLLER_INPUT
+#include <xinput.h>     // Types only: XInputGetState is resolved at runtime
+#endif
 
 #define APP_NAME L"OLED Aegis"
 #define WM_TRAYICON (WM_USER + 1)
+#define WM_DEFERRED_INIT (WM_USER + 2)
 #define TIMER_IDLE_CHECK 1
+#define TIMER_MEDIA_SCAN_SLICE 2
 #define DEFAULT_IDLE_TIMEOUT 300
 #define MAX_LOG_SIZE_BYTES (1 * 1024 * 1024)  // 1 MB log file size limit
-#define MANUAL_ACTIVATION_COOLDOWN_MS 2500
 #define MAX_MONITOR_COUNT 16
 
+#if OLED_FEATURE_LEASE_API
+#define WM_LEASE_REQUEST (WM_USER + 3)
+#define WM_LEASE_OWNER_EXITED (WM_USER + 4)
+#define LEASE_PIPE_NAME_FORMAT L"\\\\.\\pipe\\OLEDAegis.Lease.%lu"   // Terminal Services session ID
+#define MAX_IDLE_LEASES 64                      // Slot index must fit in the low byte of a lease id
+#define LEASE_EXPIRY_HEAP_CAPACITY (MAX_IDLE_LEASES * 4)
+#define MAX_LEASE_TTL_SEC 86400
+#define LEASE_CLIENT_TIMEOUT_MS 1000
+#define LEASE_PIPE_BUFFER_SIZE 512
+#endif
+#define LEASE_ALL_MONITORS 0xFFFFFFFFu
+
+#if OLED_FEATURE_HOTKEYS
+#define HOTKEY_ID_ALL_MONITORS   1
+#define HOTKEY_ID_CURSOR_MONITOR 2
+#define HOTKEY_ID_MONITOR_BASE   16             // + monitor index
+#endif
+#define HOTKEY_SPEC_LEN 32
+#define TAB_AUDIO_LABEL_LEN 64
+
+#if OLED_FEATURE_CONTROL_CLI
+#define CONTROL_COPYDATA_COMMAND 0x4F414301     // COPYDATASTRUCT.dwData tags
+#define CONTROL_COPYDATA_REPLY   0x4F414302
+#define CONTROL_MAX_COMMAND_LEN 512
+#define CONTROL_REPLY_BUFFER_SIZE 4096
+#define CONTROL_TIMEOUT_MS 5000
+
+// Control client exit codes
+#define CONTROL_RESULT_OK               0
+#define CONTROL_RESULT_USAGE            1
+#define CONTROL_RESULT_NOT_RUNNING      2
+#define CONTROL_RESULT_UNKNOWN_MONITOR  3
+#define CONTROL_RESULT_TIMEOUT          4
+#endif
+
 // Resource IDs (must match oled_aegis.rc)
 #define IDI_ICON_ACTIVE   101
 #define IDI_ICON_INACTIVE 102
@@ -53,6 +234,7 @@ DEFINE_GUID(IID_IAudioMeterInformation,   0xC02216F6, 0x8C67, 0x4B5B, 0x9D, 0x00
 #define IDC_PERMONITOR_MEDIA_CHECK  1011
 #define IDC_MUTED_MEDIA_CHECK       1012
 #define IDC_PIXELSHIFT_EDIT         1010
+#define IDC_TIMEOUT_LABEL           1013
 #define IDC_MONITOR_BASE            2000  // Monitor checkboxes: IDC_MONITOR_BASE + index
 
 // Tray context menu command IDs
@@ -62,8 +244,6 @@ DEFINE_GUID(IID_IAudioMeterInformation,   0xC02216F6, 0x8C67, 0x4B5B, 0x9D, 0x00
 // Timing constants
 #define INPUT_IGNORE_DELAY_MS           500     // Delay after screen saver window creation to ignore input
 #define IDLE_ACTIVITY_THRESHOLD_MS      1000    // Time threshold to consider user active (1 second)
-#define IDLE_DEACTIVATE_THRESHOLD_MS    2000    // Time threshold to deactivate screen saver after input
-#define IDLE_DEACTIVATE_THRESHOLD_SEC   2       // Time threshold in seconds (for per-monitor mode)
 #define SHELL_CLOSE_DELAY_MS            250     // Delay after sending Escape to close shell windows
 #define SHELL_CLOSE_MAX_ATTEMPTS        2       // Maximum attempts to close shell windows
 #define MIN_MEDIA_WINDOW_AREA           10000   // Ignore tiny windows when mapping media to monitors
@@ -74,7 +254,83 @@ DEFINE_GUID(IID_IAudioMeterInformation,   0xC02216F6, 0x8C67, 0x4B5B, 0x9D, 0x00
 #define CURSOR_COUNTER_MAX_ATTEMPTS     16      // Safety bound when normalizing ShowCursor's counter
 #define TOPMOST_REFRESH_INTERVAL_MS     5000    // Reassert topmost occasionally, not every timer tick
 #define MAX_ACTIVE_AUDIO_PIDS           64      // Upper bound on concurrently active audio sessions we track
+#define MAX_PROCESS_GRAPH_NODES         2048    // Processes kept from a Toolhelp snapshot
+#define PROCESS_TREE_MAX_DEPTH          16      // Safety bound when walking to a session's root process
+#define PID_TARGETED_MAX_PROCESSES      4       // Above this many media processes, scan all windows
+#define MAX_TARGETED_THREADS            512     // Threads of the targeted processes
+#define TARGET_THREAD_REFRESH_MS        10000   // Re-snapshot threads at least this often
+#define MAX_PARALLEL_SCAN_WINDOWS       8192    // Above this, scan sequentially
+#define MAX_PARALLEL_SCAN_WORKERS       7       // Pool workers besides the timer thread
+#define PARALLEL_SCAN_MIN_WINDOWS       32      // Windows per worker, at least
+#define WINDOW_SCAN_BUDGET_MS           50      // Then skip the scan's remaining windows
+#define SLOW_WINDOW_US                  20000   // A window this slow to interrogate earns a strike
+#define SLOW_WINDOW_STRIKES             3       // Consecutive strikes before a window is backed off
+#define WINDOW_BACKOFF_BASE_MS          5000    // First back-off, doubled per strike
+#define WINDOW_BACKOFF_MAX_MS           300000
+#define MAX_WINDOW_BACKOFF              64      // Windows remembered as slow or hung
+#define MAX_SLICED_SCAN_WINDOWS         8192    // Above this, scan in one go
+#define MIN_WINDOW_SCAN_SLICE_US        200
+#define WINDOW_SLICE_INTERVAL_MS        USER_TIMER_MINIMUM   // Pause between slices
+#define MAX_CACHED_AUDIO_SESSIONS       64      // Sessions per endpoint kept with their COM interfaces
+#define MAX_AUDIO_ENDPOINTS             8       // Active render endpoints tracked at once
+#define AUDIO_SESSION_RESYNC_MS         30000   // Re-enumerate sessions even without a notification
 #define MAX_BROWSER_WINDOW_INFO         32      // Max browser windows to collect for diagnostic logging
+#define TAB_PROBE_CACHE_SIZE            16      // Browser windows with a cached tab probe result
+#define TAB_PROBE_BUDGET_MS             250     // UIA call timeout and per-window probe budget
+#define TAB_PROBE_NEGATIVE_TTL_MS       15000   // Re-probe a window that had no playing video tab
+#define TAB_PROBE_MAX_TABS              64      // Tabs inspected per window
+#define SMTC_MAX_SESSIONS               16      // Media transport sessions tracked
+#define SMTC_MAX_SESSION_PIDS           8       // Window-owning processes mapped per session
+#define SMTC_REQUEST_TIMEOUT_MS         5000    // Session manager activation / worker shutdown bound
+#define SMTC_POLL_MS                    2000    // Session re-read interval if change events are unavailable
+#define SMTC_REMATCH_MS                 30000   // Re-map sessions to window processes at most this often
+#define MAX_STARTUP_PHASES              16      // Upper bound on phases recorded by the startup trace
+#define STARTUP_LOG_BUFFER_SIZE         8192    // Log lines buffered in memory until the log file is opened
+#define MEMORY_TRIM_STEADY_MS           600000  // Trim the working set after 10 minutes without a state change
+#define MEMORY_SAMPLE_INTERVAL_MS       60000   // Memory footprint sampling interval (debug log / soak log)
+#define MAX_WEAR_ENTRIES                32      // Distinct monitor device paths tracked by wear accounting
+#define WEAR_FLUSH_INTERVAL_MS          1800000 // Append wear counters to disk every 30 minutes
+#define WEAR_COMPACT_SLACK              256     // Redundant wear records tolerated before compacting the file
+#define BURNIN_GRID_COLS                64      // Burn-in heatmap cells per monitor (multiple of 16 cells total)
+#define BURNIN_GRID_ROWS                36
+#define BURNIN_SUPERSAMPLE              4       // Captured pixels per cell edge (one SSE2 load per cell row)
+#define BURNIN_SAMPLE_INTERVAL_MS       5000    // Initial heatmap sampling interval
+#define BURNIN_MAX_INTERVAL_MS          60000   // Upper bound when backing off to stay under the CPU budget
+#define BURNIN_STILL_THRESHOLD          6       // Max luma change (0-255) for a cell to count as still
+#define BURNIN_MIN_LUMA                 128     // Only bright static cells are worth covering
+#define BURNIN_MAX_OVERLAYS             8       // Overlay windows per monitor
+#define BURNIN_MIN_REGION_CELLS         2       // Ignore single-cell regions (cursor, clock digits)
+#define MOTION_FRAME_WIDTH              128     // Downscaled frame used for motion detection
+#define MOTION_FRAME_HEIGHT             72
+#define MOTION_SAMPLE_INTERVAL_MS       1000    // At most one motion sample per monitor per second
+#define MOTION_LEAD_SEC                 5       // Start sampling this long before a monitor's idle deadline
+#define MOTION_PIXEL_THRESHOLD          12      // Luma change (0-255) for a pixel to count as changed
+#define MOTION_MIN_CHANGED_PERMILLE     15      // Changed pixels (per mille) for a sample to count as motion
+#define MOTION_HISTORY_SAMPLES          4       // Motion is sustained when MOTION_SUSTAINED_SAMPLES of the
+#define MOTION_SUSTAINED_SAMPLES        3       //   last MOTION_HISTORY_SAMPLES samples moved
+#define MOTION_CANDIDATE_TTL_MS         10000   // How long an unclassified audio window's rect narrows sampling
+#define APL_GRID_COLS                   32      // Point samples per monitor for the brightness estimate
+#define APL_GRID_ROWS                   18
+#define APL_SAMPLE_INTERVAL_MS          10000   // Brightness sampling interval
+#define APL_DARK_LEVEL                  32      // Mean luma at or below which the longest timeout applies
+#define APL_BRIGHT_LEVEL                192     // Mean luma at or above which the shortest timeout applies
+#define CONTROLLER_LEAD_SEC             5       // Start polling controllers this long before an idle deadline
+#define CPU_SAMPLE_INTERVAL_MS          1000    // At most one CPU sample per second
+#define CPU_LEAD_SEC                    5       // Start sampling this long before a monitor's idle deadline
+#define CPU_HISTORY_SAMPLES             4       // A process is busy when CPU_SUSTAINED_SAMPLES of the
+#define CPU_SUSTAINED_SAMPLES           3       //   last CPU_HISTORY_SAMPLES samples were over the threshold
+#define CPU_WINDOW_RESCAN_MS            5000    // Re-map windows to processes this often while sampling
+#define MAX_CPU_PROCESSES               128     // Processes sampled at once
+#define DEFAULT_CPU_ACTIVITY_THRESHOLD_PCT 15   // % of one core
+
+// Burn-in heatmap bounds
+#define MIN_BURNIN_STATIC_SEC   60
+#define MAX_BURNIN_STATIC_SEC   36000
+#define DEFAULT_BURNIN_STATIC_SEC 900
+
+// Brightness-aware timeout defaults (clamped to the idle timeout bounds)
+#define DEFAULT_DYNAMIC_TIMEOUT_MIN_SEC 60
+#define DEFAULT_DYNAMIC_TIMEOUT_MAX_SEC 600
 
 // Check interval bounds (milliseconds)
 #define MIN_CHECK_INTERVAL_MS   250
@@ -97,22 +353,65 @@ static FILE* g_logFile = NULL;
 static char g_appDataPath[MAX_PATH];
 static int g_appDataPathInitialized = 0;
 
+// Startup log lines are held in memory until deferred initialization runs, so
+// the log file is never opened on the critical path to the tray icon.
+static int g_logFileDeferred = 1;
+static char g_startupLogBuffer[STARTUP_LOG_BUFFER_SIZE];
+static int g_startupLogBufferLen = 0;
+
+// Startup trace: elapsed time per phase from WinMain entry, reported to the
+// debug log once deferred initialization completes.
+typedef struct {
+    const char* name;
+    LONGLONG elapsedUs;
+} StartupPhase;
+
+static LARGE_INTEGER g_perfFrequency;
+static LONGLONG g_startupBeginUs = 0;
+static LONGLONG g_startupLastMarkUs = 0;
+static StartupPhase g_startupPhases[MAX_STARTUP_PHASES];
+static int g_startupPhaseCount = 0;
+
+// COM is only needed for WASAPI audio session queries, so it is initialized on
+// first use instead of at launch.
+static int g_comInitialized = 0;
+
+#if OLED_FEATURE_SETTINGS_UI
 void ApplySettings(HWND hWnd);
 LRESULT CALLBACK SettingsDialogProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
+void ShowSettingsDialog();
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+void UpdateTimeoutLabel(HWND hDlg);
+#endif
+#endif
 void ShowScreenSaver(int isManual);
 void ShowScreenSaverOnMonitor(int monitorIndex, int isManual);
+void PresentScreenSaverWindow(int monitorIndex);
+void WearRecordActivation(int monitorIndex);
 void HideScreenSaver();
 void HideScreenSaverOnMonitor(int monitorIndex);
 int IsAnyMonitorActive();
 void UpdateTrayIcon(int active);
+#if OLED_FEATURE_DEBUG_LOG
 void LogMessage(const char* format, ...);
+#else
+#define LogMessage(...) ((void)0)
+#endif
 int FindMonitorByDeviceName(const char* deviceName);
 int FindMonitorByDevicePath(const char* devicePath);
 int FindPrimaryMonitorIndex();
 int IsAnyMonitorEnabled();
 int GetProcessNameFromHwnd(HWND hWnd, char* buffer, int bufferSize);
+void GetWindowTitleNoWait(HWND hWnd, char* title, int titleSize);
+int IsCallCaptureActive();
 int UpdateMediaMonitorStates(int mediaOnMonitor[MAX_MONITOR_COUNT]);
 void ResetMediaDetectionCache();
+void TrimWorkingSet(const char* reason);
+void RecordMotionCandidate(const RECT* windowRect);
+DWORD GetMotionMonitorMask();
+DWORD GetCpuActivityMonitorMask();
+int GetEffectiveIdleTimeout(int monitorIndex);
+DWORD GetControllerIdleTime();
 
 typedef struct {
     HMONITOR hMonitor;
@@ -146,6 +445,30 @@ typedef struct {
     int perMonitorMediaDetection;
     int blockOnMutedMedia;
     int pixelShiftCompensation;
+    int memoryTrimEnabled;
+    int memorySoakLog;
+    int leaseApiEnabled;
+    int wearAccountingEnabled;
+    int burnInDetectionEnabled;
+    int burnInOverlayEnabled;
+    int burnInStaticSec;
+    int burnInOverlayAlpha;
+    int motionDetectionEnabled;
+    int dynamicTimeoutEnabled;
+    int dynamicTimeoutMinSec;
+    int dynamicTimeoutMaxSec;
+    int controllerInputEnabled;
+    int cpuActivityEnabled;
+    int cpuActivityThresholdPct;            // % of one core
+    int browserTabProbeEnabled;
+    int mediaSessionDetection;
+    int fullscreenDetectionEnabled;
+    int parallelWindowScan;
+    int windowScanSliceUs;                  // 0 = whole scan per tick
+    char browserTabAudioLabel[TAB_AUDIO_LABEL_LEN];  // UTF-8; empty = English only
+    char hotkeyAllMonitors[HOTKEY_SPEC_LEN];    // e.g. "Ctrl+Alt+B"; empty = unbound
+    char hotkeyCursorMonitor[HOTKEY_SPEC_LEN];
+    char hotkeyMonitor[MAX_MONITOR_COUNT][HOTKEY_SPEC_LEN];
 } Config;
 
 typedef struct {
@@ -159,6 +482,7 @@ typedef struct {
     int trayIconActive;
     DWORD manualActivationTime;
     int isManualActivation;
+    int configMissingAtStartup;
 } AppState;
 
 static AppState g_app;
@@ -176,7 +500,25 @@ static int g_currentMonitorIndex = 0;
 static MonitorInfo g_monitors[MAX_MONITOR_COUNT];
 static MonitorState g_monitorStates[MAX_MONITOR_COUNT];
 static UINT g_uTaskbarRestart = 0;  // Registered "TaskbarCreated" message ID (0 if not registered)
-static int g_mediaCacheInvalidated = 0;  // Set by WM_POWERBROADCAST to force media cache refresh
+static int g_mediaCacheInvalidated = 0;  // Set by WM_POWERBROADCAST / WM_DISPLAYCHANGE to force media cache refresh
+static volatile LONG g_audioCacheInvalidated = 0;  // Drop cached audio endpoints (set from any thread)
+
+typedef struct {
+    SIZE_T privateBytes;
+    SIZE_T workingSet;
+    SIZE_T peakWorkingSet;
+    DWORD gdiHandles;
+    DWORD userHandles;
+} MemoryFootprint;
+
+// Memory management state (see UpdateMemoryManagement)
+static DWORD g_memoryStartTick = 0;
+static DWORD g_lastSteadyStateTick = 0;
+static DWORD g_lastMemorySampleTick = 0;
+static DWORD g_lastActiveMask = 0;
+static int g_trimmedThisSteadyPeriod = 0;
+static int g_workingSetTrimCount = 0;
+static MemoryFootprint g_startupFootprint;
 
 int ClampInt(int value, int minValue, int maxValue) {
     if (value < minValue) return minValue;
@@ -199,6 +541,78 @@ void ClampConfigValues() {
     g_app.config.perMonitorInputDetection = g_app.config.perMonitorInputDetection ? 1 : 0;
     g_app.config.perMonitorMediaDetection = g_app.config.perMonitorMediaDetection ? 1 : 0;
     g_app.config.blockOnMutedMedia = g_app.config.blockOnMutedMedia ? 1 : 0;
+    g_app.config.memoryTrimEnabled = g_app.config.memoryTrimEnabled ? 1 : 0;
+    g_app.config.memorySoakLog = g_app.config.memorySoakLog ? 1 : 0;
+    g_app.config.leaseApiEnabled = g_app.config.leaseApiEnabled ? 1 : 0;
+    g_app.config.wearAccountingEnabled = g_app.config.wearAccountingEnabled ? 1 : 0;
+    g_app.config.burnInDetectionEnabled = g_app.config.burnInDetectionEnabled ? 1 : 0;
+    g_app.config.burnInOverlayEnabled = g_app.config.burnInOverlayEnabled ? 1 : 0;
+    g_app.config.burnInStaticSec = ClampInt(g_app.config.burnInStaticSec, MIN_BURNIN_STATIC_SEC, MAX_BURNIN_STATIC_SEC);
+    g_app.config.burnInOverlayAlpha = ClampInt(g_app.config.burnInOverlayAlpha, 1, 255);
+    g_app.config.motionDetectionEnabled = g_app.config.motionDetectionEnabled ? 1 : 0;
+    g_app.config.dynamicTimeoutEnabled = g_app.config.dynamicTimeoutEnabled ? 1 : 0;
+    g_app.config.controllerInputEnabled = g_app.config.controllerInputEnabled ? 1 : 0;
+    g_app.config.cpuActivityEnabled = g_app.config.cpuActivityEnabled ? 1 : 0;
+    g_app.config.cpuActivityThresholdPct = ClampInt(g_app.config.cpuActivityThresholdPct, 1, 100);
+    g_app.config.browserTabProbeEnabled = g_app.config.browserTabProbeEnabled ? 1 : 0;
+    g_app.config.mediaSessionDetection = g_app.config.mediaSessionDetection ? 1 : 0;
+    g_app.config.fullscreenDetectionEnabled = g_app.config.fullscreenDetectionEnabled ? 1 : 0;
+    g_app.config.parallelWindowScan = g_app.config.parallelWindowScan ? 1 : 0;
+    if (g_app.config.windowScanSliceUs != 0) {
+        g_app.config.windowScanSliceUs = ClampInt(g_app.config.windowScanSliceUs, MIN_WINDOW_SCAN_SLICE_US,
+                                                  WINDOW_SCAN_BUDGET_MS * 1000);
+    }
+    g_app.config.dynamicTimeoutMinSec = ClampInt(g_app.config.dynamicTimeoutMinSec, MIN_IDLE_TIMEOUT_SEC, MAX_IDLE_TIMEOUT_SEC);
+    g_app.config.dynamicTimeoutMaxSec = ClampInt(g_app.config.dynamicTimeoutMaxSec, g_app.config.dynamicTimeoutMinSec,
+                                                 MAX_IDLE_TIMEOUT_SEC);
+
+    // Features compiled out of this build are forced off regardless of config
+#if !OLED_FEATURE_MEDIA_DETECTION
+    g_app.config.mediaDetectionEnabled = 0;
+#endif
+#if !OLED_FEATURE_PER_MONITOR_INPUT
+    g_app.config.perMonitorInputDetection = 0;
+#endif
+#if !OLED_FEATURE_DEBUG_LOG
+    g_app.config.debugMode = 0;
+#endif
+#if !OLED_FEATURE_LEASE_API
+    g_app.config.leaseApiEnabled = 0;
+#endif
+#if !OLED_FEATURE_WEAR_STATS
+    g_app.config.wearAccountingEnabled = 0;
+#endif
+#if !OLED_FEATURE_BURNIN_MAP
+    g_app.config.burnInDetectionEnabled = 0;
+    g_app.config.burnInOverlayEnabled = 0;
+#endif
+#if !OLED_FEATURE_MOTION_DETECTION
+    g_app.config.motionDetectionEnabled = 0;
+#endif
+#if !OLED_FEATURE_DYNAMIC_TIMEOUT
+    g_app.config.dynamicTimeoutEnabled = 0;
+#endif
+#if !OLED_FEATURE_CONTROLLER_INPUT
+    g_app.config.controllerInputEnabled = 0;
+#endif
+#if !OLED_FEATURE_CPU_ACTIVITY
+    g_app.config.cpuActivityEnabled = 0;
+#endif
+#if !OLED_FEATURE_TAB_PROBE
+    g_app.config.browserTabProbeEnabled = 0;
+#endif
+#if !OLED_FEATURE_MEDIA_SESSIONS
+    g_app.config.mediaSessionDetection = 0;
+#endif
+#if !OLED_FEATURE_FULLSCREEN_DETECTION
+    g_app.config.fullscreenDetectionEnabled = 0;
+#endif
+#if !OLED_FEATURE_PARALLEL_WINDOW_SCAN
+    g_app.config.parallelWindowScan = 0;
+#endif
+#if !OLED_FEATURE_SLICED_WINDOW_SCAN
+    g_app.config.windowScanSliceUs = 0;
+#endif
 }
 
 int IsAppUiActive() {
@@ -327,6 +741,7 @@ void LoadTrayIcons() {
     }
 }
 
+#if OLED_FEATURE_DEBUG_LOG
 void RotateLogFileIfNeeded() {
     if (!g_logFile) return;
 
@@ -358,9 +773,42 @@ void RotateLogFileIfNeeded() {
     }
 }
 
+// Append one formatted line to the in-memory startup log buffer. Lines that do
+// not fit are dropped; the buffer only needs to cover the startup window.
+void AppendStartupLog(const char* timeStr, const char* format, va_list args) {
+    int remaining = STARTUP_LOG_BUFFER_SIZE - g_startupLogBufferLen;
+    if (remaining <= 2) return;
+
+    char line[1024];
+    int prefixLen = sprintf_s(line, sizeof(line), "[%s] ", timeStr);
+    if (prefixLen < 0) return;
+    int bodyLen = vsnprintf(line + prefixLen, sizeof(line) - prefixLen, format, args);
+    if (bodyLen < 0) return;
+
+    int lineLen = (int)strlen(line);
+    if (lineLen + 1 >= remaining) return;
+
+    memcpy(g_startupLogBuffer + g_startupLogBufferLen, line, lineLen);
+    g_startupLogBufferLen += lineLen;
+    g_startupLogBuffer[g_startupLogBufferLen++] = '\n';
+}
+
 void LogMessage(const char* format, ...) {
     if (!g_app.config.debugMode) return;
 
+    if (!g_logFile && g_logFileDeferred) {
+        time_t now = time(NULL);
+        char timeStr[64];
+        ctime_s(timeStr, sizeof(timeStr), &now);
+        timeStr[24] = '\0';
+
+        va_list args;
+        va_start(args, format);
+        AppendStartupLog(timeStr, format, args);
+        va_end(args);
+        return;
+    }
+
     if (!g_logFile) {
         char appDataPath[MAX_PATH];
         GetAppDataPath(appDataPath, sizeof(appDataPath));
@@ -373,8 +821,12 @@ void LogMessage(const char* format, ...) {
             ctime_s(timeStr, sizeof(timeStr), &now);
             timeStr[24] = '\0';
             fprintf(g_logFile, "\n=== OLED Aegis Started at %s ===\n", timeStr);
+            if (g_startupLogBufferLen > 0) {
+                fwrite(g_startupLogBuffer, 1, g_startupLogBufferLen, g_logFile);
+            }
             fflush(g_logFile);
         }
+        g_startupLogBufferLen = 0;
     }
 
     if (g_logFile) {
@@ -396,17 +848,93 @@ void LogMessage(const char* format, ...) {
     }
 }
 
-// Get monitor friendly name and device path using DisplayConfig API
-// Returns 1 on success, 0 on failure
-int GetMonitorIdentifiers(const char* gdiDeviceName,
-                          char* friendlyName, int friendlyNameLen,
-                          char* devicePath, int devicePathLen) {
-    UINT32 pathCount = 0, modeCount = 0;
-    int result = 0;
+// Stop buffering log lines in memory. The next LogMessage call opens the log
+// file and writes out anything buffered during startup.
+void EndDeferredLogging() {
+    g_logFileDeferred = 0;
+    if (g_app.config.debugMode && g_startupLogBufferLen > 0) {
+        LogMessage("Deferred logging ended (%d bytes buffered during startup)", g_startupLogBufferLen);
+    } else {
+        g_startupLogBufferLen = 0;
+    }
+}
+#else
+void EndDeferredLogging() {
+    g_logFileDeferred = 0;
+}
+#endif
 
-    if (friendlyName && friendlyNameLen > 0) friendlyName[0] = '\0';
-    if (devicePath && devicePathLen > 0) devicePath[0] = '\0';
+// Monotonic timestamp in microseconds (QueryPerformanceCounter based).
+LONGLONG GetTimestampUs() {
+    LARGE_INTEGER now;
+    if (g_perfFrequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&g_perfFrequency);
+    }
+    QueryPerformanceCounter(&now);
+    // Split the conversion to avoid overflowing the multiplication on long uptimes
+    return (now.QuadPart / g_perfFrequency.QuadPart) * 1000000 +
+           (now.QuadPart % g_perfFrequency.QuadPart) * 1000000 / g_perfFrequency.QuadPart;
+}
+
+void StartupTraceBegin() {
+    g_startupBeginUs = GetTimestampUs();
+    g_startupLastMarkUs = g_startupBeginUs;
+    g_startupPhaseCount = 0;
+}
+
+// Record the time spent since the previous mark under the given phase name.
+void StartupTraceMark(const char* phaseName) {
+    LONGLONG nowUs = GetTimestampUs();
+    if (g_startupPhaseCount < MAX_STARTUP_PHASES) {
+        g_startupPhases[g_startupPhaseCount].name = phaseName;
+        g_startupPhases[g_startupPhaseCount].elapsedUs = nowUs - g_startupLastMarkUs;
+        g_startupPhaseCount++;
+    }
+    g_startupLastMarkUs = nowUs;
+}
+
+void LogStartupTrace() {
+    LONGLONG totalUs = g_startupLastMarkUs - g_startupBeginUs;
+    LogMessage("Startup trace: %d phases, %lld us total", g_startupPhaseCount, totalUs);
+    for (int i = 0; i < g_startupPhaseCount; i++) {
+        LogMessage("Startup trace:   %-24s %8lld us", g_startupPhases[i].name, g_startupPhases[i].elapsedUs);
+    }
+}
+
+#if OLED_FEATURE_MEDIA_DETECTION
+// Initialize COM on the UI thread the first time a COM-based subsystem needs
+// it. Returns 1 if COM is usable on this thread.
+int EnsureComInitialized() {
+    if (g_comInitialized) return 1;
 
+    HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+    // hr may be S_OK or S_FALSE (already initialized); either is fine to proceed.
+    if (FAILED(hr)) {
+        LogMessage("COM: CoInitializeEx failed hr=0x%08X", (unsigned)hr);
+        return 0;
+    }
+
+    g_comInitialized = 1;
+    LogMessage("COM: initialized on first use");
+    return 1;
+}
+#endif
+
+// Active display paths queried once per monitor enumeration and shared by
+// every EnumMonitorCallback, instead of re-querying the whole topology for
+// each monitor.
+typedef struct {
+    DISPLAYCONFIG_PATH_INFO* paths;
+    DISPLAYCONFIG_MODE_INFO* modes;
+    UINT32 pathCount;
+    UINT32 modeCount;
+} DisplayConfigSnapshot;
+
+// Returns 1 on success, 0 on failure (snapshot left empty)
+int QueryDisplayConfigSnapshot(DisplayConfigSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    UINT32 pathCount = 0, modeCount = 0;
     LONG ret = GetDisplayConfigBufferSizes(QDC_ONLY_ACTIVE_PATHS, &pathCount, &modeCount);
     if (ret != ERROR_SUCCESS || pathCount == 0) {
         return 0;
@@ -427,6 +955,37 @@ int GetMonitorIdentifiers(const char* gdiDeviceName,
         return 0;
     }
 
+    snapshot->paths = paths;
+    snapshot->modes = modes;
+    snapshot->pathCount = pathCount;
+    snapshot->modeCount = modeCount;
+    return 1;
+}
+
+void FreeDisplayConfigSnapshot(DisplayConfigSnapshot* snapshot) {
+    free(snapshot->paths);
+    free(snapshot->modes);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// Get monitor friendly name and device path from a DisplayConfig snapshot
+// Returns 1 on success, 0 on failure
+int GetMonitorIdentifiers(const DisplayConfigSnapshot* snapshot, const char* gdiDeviceName,
+                          char* friendlyName, int friendlyNameLen,
+                          char* devicePath, int devicePathLen) {
+    int result = 0;
+    LONG ret;
+
+    if (friendlyName && friendlyNameLen > 0) friendlyName[0] = '\0';
+    if (devicePath && devicePathLen > 0) devicePath[0] = '\0';
+
+    if (!snapshot || snapshot->pathCount == 0) {
+        return 0;
+    }
+
+    const DISPLAYCONFIG_PATH_INFO* paths = snapshot->paths;
+    UINT32 pathCount = snapshot->pathCount;
+
     // Convert GDI device name to wide string for comparison
     WCHAR gdiDeviceNameW[CCHDEVICENAME];
     MultiByteToWideChar(CP_ACP, 0, gdiDeviceName, -1, gdiDeviceNameW, CCHDEVICENAME);
@@ -483,8 +1042,6 @@ int GetMonitorIdentifiers(const char* gdiDeviceName,
         break;
     }
 
-    free(paths);
-    free(modes);
     return result;
 }
 
@@ -514,6 +1071,7 @@ BOOL CALLBACK EnumMonitorCallback(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprc
 
         // Get friendly name and device path using DisplayConfig API
         int gotIdentifiers = GetMonitorIdentifiers(
+            (const DisplayConfigSnapshot*)dwData,
             mi.szDevice,
             g_monitors[g_monitorCount].friendlyName,
             sizeof(g_monitors[g_monitorCount].friendlyName),
@@ -606,21 +1164,8 @@ LRESULT CALLBACK MonitorWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARA
     return 0;
 }
 
-int ConfigFileExists() {
-    char appDataPath[MAX_PATH];
-    char configPath[MAX_PATH];
-    GetAppDataPath(appDataPath, sizeof(appDataPath));
-    sprintf_s(configPath, sizeof(configPath), "%s\\oled_aegis.ini", appDataPath);
-
-    FILE* f = fopen(configPath, "r");
-    if (f) {
-        fclose(f);
-        return 1;
-    }
-    return 0;
-}
-
-void LoadConfig() {
+// Returns 1 if the config file existed and was read, 0 if defaults were kept.
+int LoadConfig() {
     char appDataPath[MAX_PATH];
     char configPath[MAX_PATH];
     GetAppDataPath(appDataPath, sizeof(appDataPath));
@@ -628,25 +1173,22 @@ void LoadConfig() {
 
     g_app.config.monitorCount = g_monitorCount;
 
+    // Per-monitor hotkeys are keyed by device path and re-matched on every
+    // load, so drop bindings that belonged to the previous monitor indices
+    memset(g_app.config.hotkeyMonitor, 0, sizeof(g_app.config.hotkeyMonitor));
+
     int hadMonitorConfig = 0;  // Track if we found any monitor config entries
     int anyMonitorMatched = 0; // Track if any monitor config matched current monitors
 
     FILE* f = fopen(configPath, "r");
+    int configFound = f != NULL;
     if (f) {
         char line[512];  // Increased buffer size for longer device paths
         while (fgets(line, sizeof(line), f)) {
-            // Strip inline comments (everything after ';')
-            char* comment = strchr(line, ';');
-            if (comment) *comment = '\0';
-
-            // Trim trailing whitespace
-            size_t len = strlen(line);
-            while (len > 0 && (line[len-1] == ' ' || line[len-1] == '\t' || line[len-1] == '\n' || line[len-1] == '\r')) {
-                line[--len] = '\0';
-            }
-
-            char key[300], value[64];  // Increased key size for device paths
-            if (sscanf(line, "%299[^=]=%63s", key, value) == 2) {
+            // Inline ';' comments are stripped, except from string values
+            char* key;
+            char* value;
+            if (SplitIniLine(line, &key, &value)) {
                 if (strcmp(key, "idleTimeout") == 0) {
                     g_app.config.idleTimeout = atoi(value);
                 } else if (strcmp(key, "checkInterval") == 0) {
@@ -667,6 +1209,63 @@ void LoadConfig() {
                     g_app.config.blockOnMutedMedia = atoi(value);
                 } else if (strcmp(key, "pixelShiftCompensation") == 0) {
                     g_app.config.pixelShiftCompensation = atoi(value);
+                } else if (strcmp(key, "memoryTrimEnabled") == 0) {
+                    g_app.config.memoryTrimEnabled = atoi(value);
+                } else if (strcmp(key, "memorySoakLog") == 0) {
+                    g_app.config.memorySoakLog = atoi(value);
+                } else if (strcmp(key, "leaseApiEnabled") == 0) {
+                    g_app.config.leaseApiEnabled = atoi(value);
+                } else if (strcmp(key, "wearAccountingEnabled") == 0) {
+                    g_app.config.wearAccountingEnabled = atoi(value);
+                } else if (strcmp(key, "burnInDetectionEnabled") == 0) {
+                    g_app.config.burnInDetectionEnabled = atoi(value);
+                } else if (strcmp(key, "burnInOverlayEnabled") == 0) {
+                    g_app.config.burnInOverlayEnabled = atoi(value);
+                } else if (strcmp(key, "burnInStaticSec") == 0) {
+                    g_app.config.burnInStaticSec = atoi(value);
+                } else if (strcmp(key, "burnInOverlayAlpha") == 0) {
+                    g_app.config.burnInOverlayAlpha = atoi(value);
+                } else if (strcmp(key, "motionDetectionEnabled") == 0) {
+                    g_app.config.motionDetectionEnabled = atoi(value);
+                } else if (strcmp(key, "dynamicTimeoutEnabled") == 0) {
+                    g_app.config.dynamicTimeoutEnabled = atoi(value);
+                } else if (strcmp(key, "dynamicTimeoutMinSec") == 0) {
+                    g_app.config.dynamicTimeoutMinSec = atoi(value);
+                } else if (strcmp(key, "dynamicTimeoutMaxSec") == 0) {
+                    g_app.config.dynamicTimeoutMaxSec = atoi(value);
+                } else if (strcmp(key, "controllerInputEnabled") == 0) {
+                    g_app.config.controllerInputEnabled = atoi(value);
+                } else if (strcmp(key, "cpuActivityEnabled") == 0) {
+                    g_app.config.cpuActivityEnabled = atoi(value);
+                } else if (strcmp(key, "cpuActivityThresholdPct") == 0) {
+                    g_app.config.cpuActivityThresholdPct = atoi(value);
+                } else if (strcmp(key, "browserTabProbeEnabled") == 0) {
+                    g_app.config.browserTabProbeEnabled = atoi(value);
+                } else if (strcmp(key, "mediaSessionDetection") == 0) {
+                    g_app.config.mediaSessionDetection = atoi(value);
+                } else if (strcmp(key, "fullscreenDetectionEnabled") == 0) {
+                    g_app.config.fullscreenDetectionEnabled = atoi(value);
+                } else if (strcmp(key, "parallelWindowScan") == 0) {
+                    g_app.config.parallelWindowScan = atoi(value);
+                } else if (strcmp(key, "windowScanSliceUs") == 0) {
+                    g_app.config.windowScanSliceUs = atoi(value);
+                } else if (strcmp(key, "browserTabAudioLabel") == 0) {
+                    strncpy_s(g_app.config.browserTabAudioLabel, TAB_AUDIO_LABEL_LEN, value, _TRUNCATE);
+                } else if (strcmp(key, "hotkeyAllMonitors") == 0) {
+                    strncpy_s(g_app.config.hotkeyAllMonitors, HOTKEY_SPEC_LEN, value, _TRUNCATE);
+                } else if (strcmp(key, "hotkeyCursorMonitor") == 0) {
+                    strncpy_s(g_app.config.hotkeyCursorMonitor, HOTKEY_SPEC_LEN, value, _TRUNCATE);
+                } else if (strncmp(key, "hotkeyMonitor_", 14) == 0) {
+                    const char* identifier = key + 14;
+                    int idx = FindMonitorByDevicePath(identifier);
+                    if (idx < 0) {
+                        idx = FindMonitorByDeviceName(identifier);
+                    }
+                    if (idx >= 0 && idx < MAX_MONITOR_COUNT) {
+                        strncpy_s(g_app.config.hotkeyMonitor[idx], HOTKEY_SPEC_LEN, value, _TRUNCATE);
+                    } else {
+                        LogMessage("Config: no match for hotkey monitor identifier: %s", identifier);
+                    }
                 } else if (strncmp(key, "monitorEnabled_", 15) == 0) {
                     const char* identifier = key + 15;
                     hadMonitorConfig = 1;
@@ -716,6 +1315,7 @@ void LoadConfig() {
     }
 
     ClampConfigValues();
+    return configFound;
 }
 
 void SaveConfig() {
@@ -735,6 +1335,29 @@ void SaveConfig() {
         fprintf(f, "perMonitorMediaDetection=%d\n", g_app.config.perMonitorMediaDetection);
         fprintf(f, "blockOnMutedMedia=%d\n", g_app.config.blockOnMutedMedia);
         fprintf(f, "pixelShiftCompensation=%d\n", g_app.config.pixelShiftCompensation);
+        fprintf(f, "memoryTrimEnabled=%d\n", g_app.config.memoryTrimEnabled);
+        fprintf(f, "memorySoakLog=%d\n", g_app.config.memorySoakLog);
+        fprintf(f, "leaseApiEnabled=%d\n", g_app.config.leaseApiEnabled);
+        fprintf(f, "wearAccountingEnabled=%d\n", g_app.config.wearAccountingEnabled);
+        fprintf(f, "burnInDetectionEnabled=%d\n", g_app.config.burnInDetectionEnabled);
+        fprintf(f, "burnInOverlayEnabled=%d\n", g_app.config.burnInOverlayEnabled);
+        fprintf(f, "burnInStaticSec=%d\n", g_app.config.burnInStaticSec);
+        fprintf(f, "burnInOverlayAlpha=%d\n", g_app.config.burnInOverlayAlpha);
+        fprintf(f, "motionDetectionEnabled=%d\n", g_app.config.motionDetectionEnabled);
+        fprintf(f, "dynamicTimeoutEnabled=%d\n", g_app.config.dynamicTimeoutEnabled);
+        fprintf(f, "dynamicTimeoutMinSec=%d\n", g_app.config.dynamicTimeoutMinSec);
+        fprintf(f, "dynamicTimeoutMaxSec=%d\n", g_app.config.dynamicTimeoutMaxSec);
+        fprintf(f, "controllerInputEnabled=%d\n", g_app.config.controllerInputEnabled);
+        fprintf(f, "cpuActivityEnabled=%d\n", g_app.config.cpuActivityEnabled);
+        fprintf(f, "cpuActivityThresholdPct=%d\n", g_app.config.cpuActivityThresholdPct);
+        fprintf(f, "browserTabProbeEnabled=%d\n", g_app.config.browserTabProbeEnabled);
+        fprintf(f, "mediaSessionDetection=%d\n", g_app.config.mediaSessionDetection);
+        fprintf(f, "fullscreenDetectionEnabled=%d\n", g_app.config.fullscreenDetectionEnabled);
+        fprintf(f, "parallelWindowScan=%d\n", g_app.config.parallelWindowScan);
+        fprintf(f, "windowScanSliceUs=%d\n", g_app.config.windowScanSliceUs);
+        fprintf(f, "browserTabAudioLabel=%s\n", g_app.config.browserTabAudioLabel);
+        fprintf(f, "hotkeyAllMonitors=%s\n", g_app.config.hotkeyAllMonitors);
+        fprintf(f, "hotkeyCursorMonitor=%s\n", g_app.config.hotkeyCursorMonitor);
         // Save monitor settings using persistent device path as key, with comment showing friendly name
         for (int i = 0; i < g_monitorCount; i++) {
             fprintf(f, "monitorEnabled_%s=%d ; %s\n",
@@ -742,24 +1365,45 @@ void SaveConfig() {
                     g_app.config.monitorsEnabled[i],
                     g_monitors[i].displayName);
         }
+        for (int i = 0; i < g_monitorCount; i++) {
+            if (g_app.config.hotkeyMonitor[i][0] != '\0') {
+                fprintf(f, "hotkeyMonitor_%s=%s ; %s\n",
+                        g_monitors[i].monitorDevicePath,
+                        g_app.config.hotkeyMonitor[i],
+                        g_monitors[i].displayName);
+            }
+        }
         fclose(f);
     }
 }
 
+// Sync the HKCU Run entry with startupEnabled. The current value is read
+// first so the common case (already in sync) costs no registry write or flush.
 void UpdateStartupRegistry() {
     HKEY hKey;
     WCHAR exePath[MAX_PATH];
     GetModuleFileNameW(NULL, exePath, MAX_PATH);
 
-    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Run", 0, KEY_SET_VALUE, &hKey) == ERROR_SUCCESS) {
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Run", 0, KEY_QUERY_VALUE | KEY_SET_VALUE, &hKey) == ERROR_SUCCESS) {
+        WCHAR currentPath[MAX_PATH] = {0};
+        DWORD currentType = 0;
+        DWORD currentSize = sizeof(currentPath);
+        LONG queryResult = RegQueryValueExW(hKey, APP_NAME, NULL, &currentType, (BYTE*)currentPath, &currentSize);
+
         if (g_app.config.startupEnabled) {
             DWORD valueSize = (DWORD)((wcslen(exePath) + 1) * sizeof(WCHAR));
-            LONG result = RegSetValueExW(hKey, APP_NAME, 0, REG_SZ, (BYTE*)exePath, valueSize);
-            if (result == ERROR_SUCCESS) {
-                RegFlushKey(hKey);
+            int alreadySet = queryResult == ERROR_SUCCESS && currentType == REG_SZ &&
+                             currentSize == valueSize && memcmp(currentPath, exePath, valueSize) == 0;
+            if (!alreadySet) {
+                LONG result = RegSetValueExW(hKey, APP_NAME, 0, REG_SZ, (BYTE*)exePath, valueSize);
+                if (result == ERROR_SUCCESS) {
+                    RegFlushKey(hKey);
+                }
+                LogMessage("Startup registry: Run entry written (result=%ld)", result);
             }
-        } else {
+        } else if (queryResult != ERROR_FILE_NOT_FOUND) {
             RegDeleteValueW(hKey, APP_NAME);
+            LogMessage("Startup registry: Run entry removed");
         }
         RegCloseKey(hKey);
     }
@@ -769,7 +1413,22 @@ DWORD GetIdleTime() {
     LASTINPUTINFO lii;
     lii.cbSize = sizeof(LASTINPUTINFO);
     GetLastInputInfo(&lii);
-    return GetTickCount() - lii.dwTime;
+    DWORD idleTime = GetTickCount() - lii.dwTime;
+
+    // GetLastInputInfo ignores game controllers; merge their activity in
+    DWORD controllerIdleTime = GetControllerIdleTime();
+    return controllerIdleTime < idleTime ? controllerIdleTime : idleTime;
+}
+
+// Seconds since the input that counts for this monitor's idle deadline.
+int GetMonitorIdleSeconds(int monitorIndex) {
+#if OLED_FEATURE_PER_MONITOR_INPUT
+    if (g_app.config.perMonitorInputDetection) {
+        return (int)(time(NULL) - g_monitorStates[monitorIndex].lastInputTime);
+    }
+#endif
+    (void)monitorIndex;
+    return (int)(GetIdleTime() / 1000);
 }
 
 int GetMonitorIndexFromPoint(POINT pt) {
@@ -847,11 +1506,41 @@ void HideScreenSaverOnMonitor(int monitorIndex) {
 }
 
 void EnumerateMonitors() {
+    DisplayConfigSnapshot snapshot;
+    QueryDisplayConfigSnapshot(&snapshot);
+
     g_monitorCount = 0;
-    EnumDisplayMonitors(NULL, NULL, EnumMonitorCallback, 0);
+    EnumDisplayMonitors(NULL, NULL, EnumMonitorCallback, (LPARAM)&snapshot);
+    FreeDisplayConfigSnapshot(&snapshot);
     LogMessage("Enumerated %d monitors", g_monitorCount);
 }
 
+// Reset media detection cache. Called after system sleep/wake to force a fresh
+// scan, since WASAPI sessions and ES_DISPLAY_REQUIRED state may be stale.
+void ResetMediaDetectionCache() {
+    g_mediaCacheInvalidated = 1;
+    InterlockedExchange(&g_audioCacheInvalidated, 1);
+}
+
+#if OLED_FEATURE_MEDIA_DETECTION
+// 1 while an app requests the display (ES_DISPLAY_REQUIRED), as video
+// players do; -1 if the execution state can't be read.
+int QueryDisplayRequired(ULONG* executionState) {
+    NTSTATUS status = CallNtPowerInformation(
+        SystemExecutionState,
+        NULL, 0,
+        executionState, sizeof(*executionState)
+    );
+
+    if (status != 0) {
+        LogMessage("Media detection: CallNtPowerInformation failed with status=%d", status);
+        return -1;
+    }
+    return (*executionState & ES_DISPLAY_REQUIRED) != 0;
+}
+
+// Global media check, for the paths without per-monitor media detection
+// (UpdateMediaMonitorStates finds calls in its own capture pass).
 int IsMediaPlaying() {
     static int lastMediaState = -1;
 
@@ -860,26 +1549,27 @@ int IsMediaPlaying() {
     }
 
     ULONG executionState = 0;
-    NTSTATUS status = CallNtPowerInformation(
-        SystemExecutionState,
-        NULL, 0,
-        &executionState, sizeof(executionState)
-    );
-
-    if (status == 0) {
-        int isPlaying = (executionState & ES_DISPLAY_REQUIRED) != 0;
-        // Only log when state changes to reduce noise
-        if (isPlaying != lastMediaState) {
-            LogMessage("Media detection: state changed to %s (executionState=0x%08X)",
-                     isPlaying ? "PLAYING" : "NOT_PLAYING", executionState);
-            lastMediaState = isPlaying;
-        }
-        return isPlaying;
+    int isPlaying = QueryDisplayRequired(&executionState);
+    if (isPlaying < 0) {
+        return 0;
     }
 
-    LogMessage("Media detection: CallNtPowerInformation failed with status=%d", status);
+    // Call apps don't always request the display: a call counts as well
+    int inCall = !isPlaying && IsCallCaptureActive();
+    int state = isPlaying ? 1 : inCall ? 2 : 0;
+    // Only log when state changes to reduce noise
+    if (state != lastMediaState) {
+        LogMessage("Media detection: state changed to %s (executionState=0x%08X)",
+                 isPlaying ? "PLAYING" : inCall ? "IN_CALL" : "NOT_PLAYING", executionState);
+        lastMediaState = state;
+    }
+    return isPlaying || inCall;
+}
+#else
+int IsMediaPlaying() {
     return 0;
 }
+#endif
 
 // Get the process name (e.g., "explorer.exe") from a window handle
 // Returns 1 on success, 0 on failure
@@ -903,6 +1593,31 @@ int GetProcessNameFromHwnd(HWND hWnd, char* buffer, int bufferSize) {
     return result > 0 ? 1 : 0;
 }
 
+LONGLONG RectArea(const RECT* rect) {
+    LONG width = rect->right - rect->left;
+    LONG height = rect->bottom - rect->top;
+
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+
+    return (LONGLONG)width * (LONGLONG)height;
+}
+
+LONGLONG RectIntersectionArea(const RECT* a, const RECT* b) {
+    LONG left = a->left > b->left ? a->left : b->left;
+    LONG top = a->top > b->top ? a->top : b->top;
+    LONG right = a->right < b->right ? a->right : b->right;
+    LONG bottom = a->bottom < b->bottom ? a->bottom : b->bottom;
+
+    if (right <= left || bottom <= top) {
+        return 0;
+    }
+
+    return (LONGLONG)(right - left) * (LONGLONG)(bottom - top);
+}
+
+#if OLED_FEATURE_MEDIA_DETECTION
 // Case-insensitive substring search (MSVC _strnicmp-based)
 int ContainsIgnoreCase(const char* haystack, const char* needle) {
     if (!haystack || !needle) return 0;
@@ -1022,6 +1737,30 @@ int WindowTitleHasMediaHint(const char* title) {
     return 0;
 }
 
+// Title hints for call and meeting windows, for apps holding a silent
+// (muted) microphone session.
+int WindowTitleHasCallHint(const char* title) {
+    static const char* const callTitleHints[] = {
+        "Meeting",
+        "Webinar",
+        "Call with",
+        "| Call",
+        "Meet -",       // Google Meet: "Meet - abc-defg-hij"
+        "Webex",
+        "Huddle"
+    };
+
+    if (!title || title[0] == '\0') return 0;
+
+    for (int i = 0; i < (int)(sizeof(callTitleHints) / sizeof(callTitleHints[0])); i++) {
+        if (ContainsIgnoreCase(title, callTitleHints[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 // Returns 1 if the (processName, title) pair looks like a media-playing window,
 // 0 otherwise. Known media players always count; browsers count only with a
 // video-site title hint; any other process counts only with a title hint.
@@ -1076,720 +1815,5635 @@ int GetProcessNameFromPid(DWORD pid, char* buffer, int bufferSize) {
     return buffer[0] != '\0' ? 1 : 0;
 }
 
-// Context passed to EnumMediaWindowCallback. Carries the per-monitor media
-// flags being built plus the set of process names currently emitting audio.
-// We match by name (not PID) because Chromium browsers (Chrome/Brave/Edge/etc.)
-// run multi-process: the audio session's PID is the renderer process, while the
-// browser window is owned by the main process. Both share the same exe name, so
-// name matching bridges the gap. Single-process players (VLC, mpv) match too.
-typedef struct {
-    int mediaOnMonitor[MAX_MONITOR_COUNT];
-    char audioActiveProcessNames[MAX_ACTIVE_AUDIO_PIDS][MAX_PATH];
-    int audioActiveProcessNameCount;
-    // Diagnostic info: all browser windows with active audio, collected during
-    // enumeration and logged once in UpdateMediaMonitorStates when the mask changes.
-    // This avoids per-tick log spam and shows both matching and non-matching windows.
-    char browserTitles[MAX_BROWSER_WINDOW_INFO][256];
-    int browserMatched[MAX_BROWSER_WINDOW_INFO];  // 1 = matched a hint, 0 = no hint
-    int browserWindowCount;
-} MediaEnumContext;
+// Process names seen in audio sessions are interned (oled_names.h). Only
+// session owners are inserted; window processes are looked up, never added.
+// A session whose name couldn't be interned still counts as audio, so the
+// scan falls back instead of ruling its audio out.
+static ProcessNameTable g_processNames;
 
-int IsAudioActiveProcessName(const MediaEnumContext* ctx, const char* processName) {
-    if (!processName || !ctx) return 0;
-    for (int i = 0; i < ctx->audioActiveProcessNameCount; i++) {
-        if (_stricmp(ctx->audioActiveProcessNames[i], processName) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+int FindProcessNameId(const char* name) {
+    return FindProcessName(&g_processNames, name);
 }
 
-// Returns 1 if every audio-active process is a known browser. Used to decide
-// whether to skip the block-all fallback: when a browser has active audio but
-// no window title matches a video hint (e.g. video in a background tab), we
-// can't determine which monitor is playing. For browsers, not blocking is
-// preferable to blocking everything, since the user's use case is to let the
-// OLED sleep when video plays elsewhere. For non-browser apps (unknown apps,
-// media players with minimized windows), we keep the safe block-all fallback.
-int AllAudioActiveAreBrowsers(const MediaEnumContext* ctx) {
-    if (ctx->audioActiveProcessNameCount == 0) return 0;
-    for (int i = 0; i < ctx->audioActiveProcessNameCount; i++) {
-        if (!IsKnownBrowserProcess(ctx->audioActiveProcessNames[i])) {
-            return 0;
+int InternProcessName(const char* name) {
+    int wasOverflowed = g_processNames.overflowed;
+    int inserted;
+    int slot = InsertProcessName(&g_processNames, name, &inserted);
+    if (slot < 0) {
+        if (!wasOverflowed) {
+            LogMessage("Process names: table full (%d names), '%s' not interned until the next scan",
+                       g_processNames.count, name);
         }
+        return -1;
     }
-    return 1;
+    if (inserted) {
+        g_processNames.entries[slot].isBrowser = IsKnownBrowserProcess(name);
+    }
+    return slot;
 }
 
-// Collect exe names of processes with an ACTIVE audio session on the default
-// render endpoint. Returns the count filled into names[] (0 on any failure,
-// which causes the caller's safe fallback to block all enabled monitors).
-int CollectActiveAudioProcessNames(char names[][MAX_PATH], int maxNames) {
-    if (!names || maxNames <= 0) return 0;
+void ResetProcessNamesIfFull() {
+    ClearProcessNamesIfFull(&g_processNames);
+}
 
-    IMMDeviceEnumerator* pEnum = NULL;
-    IMMDevice* pDevice = NULL;
-    IAudioSessionManager2* pSessionManager = NULL;
-    IAudioSessionEnumerator* pSessionEnum = NULL;
-    int count = 0;
+int TestProcessId(const DWORD* bitmap, int id) {
+    return id >= 0 && (bitmap[id >> 5] & (1u << (id & 31))) != 0;
+}
 
-    HRESULT hr = CoCreateInstance(&CLSID_MMDeviceEnumerator, NULL, CLSCTX_ALL,
-                                  &IID_IMMDeviceEnumerator, (void**)&pEnum);
-    if (FAILED(hr) || !pEnum) {
-        LogMessage("Audio: CoCreateInstance failed hr=0x%08X", (unsigned)hr);
-        goto done;
-    }
+// ---------------------------------------------------------------------------
+// Process graph
+//
+// Audio sessions belong to helper processes (Chromium renderers and audio
+// service, Firefox content processes) while the windows belong to the main
+// process. Instead of matching by exe name, which lumps together every
+// instance of the same exe, a session PID is resolved to its root process:
+// the topmost ancestor with the same exe. Only that process's windows then
+// count. The graph is a pid-sorted Toolhelp snapshot, rebuilt only when the
+// set of session PIDs changes (a new session, or a PID reused by another
+// process), so a scan normally does no snapshot at all.
+// ---------------------------------------------------------------------------
 
-    hr = pEnum->lpVtbl->GetDefaultAudioEndpoint(pEnum, eRender, eConsole, &pDevice);
-    if (FAILED(hr) || !pDevice) {
-        LogMessage("Audio: GetDefaultAudioEndpoint(eRender,eConsole) failed hr=0x%08X", (unsigned)hr);
-        goto done;
-    }
+typedef struct {
+    DWORD pid;
+    DWORD parentPid;
+    char exe[PROCESS_NAME_KEY_LEN];     // Lower-cased like interned names
+} ProcessNode;
+
+static ProcessNode g_processGraph[MAX_PROCESS_GRAPH_NODES];
+static int g_processGraphCount = 0;
+static int g_processGraphValid = 0;
+static int g_processGraphRefreshes = 0;
+static DWORD g_graphSessionPids[MAX_ACTIVE_AUDIO_PIDS * 2];    // Session PIDs the graph was checked against
+static int g_graphSessionPidCount = 0;
+
+int CompareProcessNodes(const void* a, const void* b) {
+    DWORD pa = ((const ProcessNode*)a)->pid;
+    DWORD pb = ((const ProcessNode*)b)->pid;
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
 
-    hr = pDevice->lpVtbl->Activate(pDevice, &IID_IAudioSessionManager2,
-                                   CLSCTX_ALL, NULL, (void**)&pSessionManager);
-    if (FAILED(hr) || !pSessionManager) {
-        LogMessage("Audio: Activate(IAudioSessionManager2) failed hr=0x%08X", (unsigned)hr);
-        goto done;
-    }
+int RefreshProcessGraph() {
+    g_processGraphValid = 0;
+    g_processGraphCount = 0;
 
-    hr = pSessionManager->lpVtbl->GetSessionEnumerator(pSessionManager, &pSessionEnum);
-    if (FAILED(hr) || !pSessionEnum) {
-        LogMessage("Audio: GetSessionEnumerator failed hr=0x%08X", (unsigned)hr);
-        goto done;
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) {
+        LogMessage("Process graph: CreateToolhelp32Snapshot failed (error %lu)", GetLastError());
+        return 0;
     }
 
-    int sessionCount = 0;
-    pSessionEnum->lpVtbl->GetCount(pSessionEnum, &sessionCount);
-
-    for (int i = 0; i < sessionCount && count < maxNames; i++) {
-        IAudioSessionControl* pControl = NULL;
-        if (FAILED(pSessionEnum->lpVtbl->GetSession(pSessionEnum, i, &pControl)) || !pControl) {
-            continue;
+    PROCESSENTRY32W entry;
+    entry.dwSize = sizeof(entry);
+    int truncated = 0;
+    for (BOOL ok = Process32FirstW(hSnapshot, &entry); ok; ok = Process32NextW(hSnapshot, &entry)) {
+        if (g_processGraphCount >= MAX_PROCESS_GRAPH_NODES) {
+            truncated = 1;
+            break;
         }
-
-        AudioSessionState state = AudioSessionStateInactive;
-        pControl->lpVtbl->GetState(pControl, &state);
-
-        if (state == AudioSessionStateActive) {
-            // AudioSessionStateActive can be true even when a video is paused
-            // (the session stays "active" but produces no sound). Use the peak
-            // meter to filter out silent sessions so paused video doesn't block
-            // the screen saver.
-            IAudioMeterInformation* pMeter = NULL;
-            if (SUCCEEDED(pControl->lpVtbl->QueryInterface(pControl, &IID_IAudioMeterInformation, (void**)&pMeter)) && pMeter) {
-                float peak = 0.0f;
-                if (SUCCEEDED(pMeter->lpVtbl->GetPeakValue(pMeter, &peak)) && peak > AUDIO_ACTIVE_PEAK_THRESHOLD) {
-                    IAudioSessionControl2* pControl2 = NULL;
-                    if (SUCCEEDED(pControl->lpVtbl->QueryInterface(pControl, &IID_IAudioSessionControl2, (void**)&pControl2)) && pControl2) {
-                        DWORD pid = 0;
-                        if (SUCCEEDED(pControl2->lpVtbl->GetProcessId(pControl2, &pid)) && pid != 0) {
-                            char procName[MAX_PATH] = {0};
-                            if (GetProcessNameFromPid(pid, procName, sizeof(procName))) {
-                                int found = 0;
-                                for (int j = 0; j < count; j++) {
-                                    if (_stricmp(names[j], procName) == 0) { found = 1; break; }
-                                }
-                                if (!found) {
-                                    strncpy(names[count], procName, MAX_PATH - 1);
-                                    names[count][MAX_PATH - 1] = '\0';
-                                    count++;
-                                }
-                            }
-                        }
-                        pControl2->lpVtbl->Release(pControl2);
-                    }
-                }
-                pMeter->lpVtbl->Release(pMeter);
-            }
+        ProcessNode* node = &g_processGraph[g_processGraphCount++];
+        node->pid = entry.th32ProcessID;
+        node->parentPid = entry.th32ParentProcessID;
+
+        // Exe names are ASCII
+        char exe[PROCESS_NAME_KEY_LEN];
+        int i = 0;
+        for (; entry.szExeFile[i] && i < PROCESS_NAME_KEY_LEN - 1; i++) {
+            exe[i] = (char)entry.szExeFile[i];
         }
-        pControl->lpVtbl->Release(pControl);
+        exe[i] = '\0';
+        MakeProcessNameKey(exe, node->exe);
     }
+    CloseHandle(hSnapshot);
 
-done:
-    if (pSessionEnum) pSessionEnum->lpVtbl->Release(pSessionEnum);
-    if (pSessionManager) pSessionManager->lpVtbl->Release(pSessionManager);
-    if (pDevice) pDevice->lpVtbl->Release(pDevice);
-    if (pEnum) pEnum->lpVtbl->Release(pEnum);
-    return count;
+    qsort(g_processGraph, g_processGraphCount, sizeof(g_processGraph[0]), CompareProcessNodes);
+    g_processGraphRefreshes++;
+    // A truncated graph can't vouch for missing PIDs: fall back to name matching
+    g_processGraphValid = !truncated;
+    return g_processGraphValid;
 }
 
-LONGLONG RectArea(const RECT* rect) {
-    LONG width = rect->right - rect->left;
-    LONG height = rect->bottom - rect->top;
-
-    if (width <= 0 || height <= 0) {
-        return 0;
+const ProcessNode* FindProcessNode(DWORD pid) {
+    int lo = 0;
+    int hi = g_processGraphCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (g_processGraph[mid].pid == pid) return &g_processGraph[mid];
+        if (g_processGraph[mid].pid < pid) lo = mid + 1;
+        else hi = mid - 1;
     }
-
-    return (LONGLONG)width * (LONGLONG)height;
+    return NULL;
 }
 
-LONGLONG RectIntersectionArea(const RECT* a, const RECT* b) {
-    LONG left = a->left > b->left ? a->left : b->left;
-    LONG top = a->top > b->top ? a->top : b->top;
-    LONG right = a->right < b->right ? a->right : b->right;
-    LONG bottom = a->bottom < b->bottom ? a->bottom : b->bottom;
-
-    if (right <= left || bottom <= top) {
-        return 0;
+// Topmost ancestor of node running the same exe. A parent PID may have been
+// reused by an unrelated process; the exe check stops the walk there.
+const ProcessNode* FindRootProcess(const ProcessNode* node) {
+    for (int depth = 0; depth < PROCESS_TREE_MAX_DEPTH; depth++) {
+        if (node->parentPid == node->pid) break;
+        const ProcessNode* parent = FindProcessNode(node->parentPid);
+        if (!parent || strcmp(parent->exe, node->exe) != 0) break;
+        node = parent;
     }
+    return node;
+}
 
-    return (LONGLONG)(right - left) * (LONGLONG)(bottom - top);
+int ContainsPid(const DWORD* pids, int count, DWORD pid) {
+    for (int i = 0; i < count; i++) {
+        if (pids[i] == pid) return 1;
+    }
+    return 0;
 }
 
-// Prefer DWM's extended frame bounds (accounts for invisible drop-shadow borders);
-// fall back to GetWindowRect if DWM query fails.
-int GetVisibleWindowRect(HWND hWnd, RECT* rect) {
-    RECT frameRect;
-    HRESULT hr = DwmGetWindowAttribute(hWnd, DWMWA_EXTENDED_FRAME_BOUNDS, &frameRect, sizeof(frameRect));
-    if (SUCCEEDED(hr) && RectArea(&frameRect) > 0) {
-        *rect = frameRect;
-        return 1;
+void AddUniquePid(DWORD* pids, int* count, int capacity, DWORD pid) {
+    if (pid != 0 && *count < capacity && !ContainsPid(pids, *count, pid)) {
+        pids[(*count)++] = pid;
     }
-
-    return GetWindowRect(hWnd, rect) != 0;
 }
 
-void MarkMediaWindowMonitors(MediaEnumContext* ctx, const RECT* windowRect) {
-    LONGLONG windowArea = RectArea(windowRect);
-
-    if (windowArea < MIN_MEDIA_WINDOW_AREA) {
-        return;
+// Rebuild the graph if a session PID wasn't there at the last check.
+int EnsureProcessGraph(const DWORD* pids, int count) {
+    int changed = !g_processGraphValid;
+    for (int i = 0; i < count && !changed; i++) {
+        changed = !ContainsPid(g_graphSessionPids, g_graphSessionPidCount, pids[i]);
     }
-
-    int marked = 0;
-    for (int i = 0; i < g_monitorCount; i++) {
-        LONGLONG intersectionArea = RectIntersectionArea(windowRect, &g_monitors[i].rect);
-        double overlapRatio = (double)intersectionArea / (double)windowArea;
-        if (intersectionArea >= MIN_MEDIA_WINDOW_AREA && overlapRatio >= MIN_MEDIA_WINDOW_OVERLAP_RATIO) {
-            ctx->mediaOnMonitor[i] = 1;
-            marked = 1;
-        }
+    g_graphSessionPidCount = 0;
+    for (int i = 0; i < count; i++) {
+        AddUniquePid(g_graphSessionPids, &g_graphSessionPidCount, MAX_ACTIVE_AUDIO_PIDS * 2, pids[i]);
     }
+    return changed ? RefreshProcessGraph() : 1;
+}
 
-    if (!marked) {
-        int monitorIndex = GetMonitorIndexFromRect(*windowRect);
-        if (monitorIndex >= 0 && monitorIndex < g_monitorCount) {
-            ctx->mediaOnMonitor[monitorIndex] = 1;
+// Map session PIDs to the root processes whose windows may show them.
+// Returns 0 if a PID can't be resolved.
+int ResolveRootPids(const DWORD* pids, int count, DWORD roots[MAX_ACTIVE_AUDIO_PIDS], int* rootCount) {
+    for (int i = 0; i < count; i++) {
+        const ProcessNode* node = FindProcessNode(pids[i]);
+        if (!node) return 0;
+        const ProcessNode* root = FindRootProcess(node);
+        AddUniquePid(roots, rootCount, MAX_ACTIVE_AUDIO_PIDS, root->pid);
+        // WebView2 runs under the app that embeds it (new Teams, widgets),
+        // which owns the windows
+        if (strcmp(root->exe, "msedgewebview2.exe") == 0) {
+            AddUniquePid(roots, rootCount, MAX_ACTIVE_AUDIO_PIDS, root->parentPid);
         }
     }
+    return 1;
 }
 
-BOOL CALLBACK EnumMediaWindowCallback(HWND hWnd, LPARAM lParam) {
-    MediaEnumContext* ctx = (MediaEnumContext*)lParam;
-
-    if (!IsWindowVisible(hWnd) || IsIconic(hWnd) || IsWindowCloakedCompat(hWnd)) {
-        return TRUE;
-    }
+// Context passed to EnumMediaWindowCallback. Carries the per-monitor media
+// flags being built plus the processes currently emitting audio. Windows are
+// matched by the root process of each session (see the process graph above);
+// if the graph is unavailable, by exe name, which also bridges Chromium's
+// renderer/main process split but can't tell instances of one exe apart.
+typedef struct {
+    int mediaOnMonitor[MAX_MONITOR_COUNT];
+    DWORD audioActiveIds[PROCESS_ID_WORDS];     // Bitmaps over interned process name IDs
+    int audioActiveProcessNameCount;
+    // Processes in a call (microphone picking up sound, or muted with a call
+    // window open): a call keeps its windows uncovered even when the far end
+    // is quiet
+    DWORD captureActiveIds[PROCESS_ID_WORDS];
+    int captureActiveProcessNameCount;
+    DWORD audioPids[MAX_ACTIVE_AUDIO_PIDS];     // Session PIDs behind the bitmaps
+    int audioPidCount;
+    DWORD capturePids[MAX_ACTIVE_AUDIO_PIDS];
+    int capturePidCount;
+    int useProcessTree;                         // Root PIDs below are valid
+    DWORD audioRootPids[MAX_ACTIVE_AUDIO_PIDS];
+    int audioRootCount;
+    DWORD captureRootPids[MAX_ACTIVE_AUDIO_PIDS];
+    int captureRootCount;
+    int collectDiagnostics;                     // Fill g_mediaDiagnostics (debug log only)
+    int windowsVisited;
+    LONGLONG deadlineUs;                        // Window scan budget (GetTimestampUs)
+    int truncated;                              // Windows skipped for the budget
+    int windowsUnknown;                         // Windows skipped as backed off or hung
+} MediaEnumContext;
 
-    LONG_PTR exStyle = GetWindowLongPtr(hWnd, GWL_EXSTYLE);
-    if ((exStyle & WS_EX_TOOLWINDOW) != 0) {
-        return TRUE;
+// Resolve the scan's session PIDs to root processes; on failure the window
+// scan falls back to exe name matching.
+void ResolveMediaProcessRoots(MediaEnumContext* ctx) {
+    DWORD pids[MAX_ACTIVE_AUDIO_PIDS * 2];
+    int count = 0;
+    for (int i = 0; i < ctx->audioPidCount; i++) pids[count++] = ctx->audioPids[i];
+    for (int i = 0; i < ctx->capturePidCount; i++) pids[count++] = ctx->capturePids[i];
+    if (count == 0) {
+        ctx->useProcessTree = 1;
+        return;
     }
 
-    RECT rect;
-    if (!GetVisibleWindowRect(hWnd, &rect)) {
-        return TRUE;
-    }
+    ctx->useProcessTree = EnsureProcessGraph(pids, count) &&
+        ResolveRootPids(ctx->audioPids, ctx->audioPidCount, ctx->audioRootPids, &ctx->audioRootCount) &&
+        ResolveRootPids(ctx->capturePids, ctx->capturePidCount, ctx->captureRootPids, &ctx->captureRootCount);
+}
 
-    if (RectArea(&rect) <= 0) {
-        return TRUE;
-    }
+// Diagnostic info: all browser windows with active audio, collected during
+// enumeration and logged once in UpdateMediaMonitorStates when the mask changes.
+// This avoids per-tick log spam and shows both matching and non-matching windows.
+// Only gathered while the debug log is on.
+typedef struct {
+    char browserTitles[MAX_BROWSER_WINDOW_INFO][256];
+    int browserMatched[MAX_BROWSER_WINDOW_INFO];  // 1 = matched a hint, 0 = no hint
+    int browserWindowCount;
+} MediaDiagnostics;
 
-    char processName[MAX_PATH] = {0};
-    if (!GetProcessNameFromHwnd(hWnd, processName, sizeof(processName))) {
-        return TRUE;
-    }
+static MediaDiagnostics g_mediaDiagnostics;
 
-    // A window only counts as media if its process is actually emitting audio.
-    // We match by exe name (not PID) because Chromium browsers run multi-process:
-    // the audio session belongs to the renderer process, while the window belongs
-    // to the main process both share the same exe name. This also handles
-    // single-process players (VLC, mpv) where name match == PID match.
-    if (!IsAudioActiveProcessName(ctx, processName)) {
-        return TRUE;
+// Returns 1 if every audio-active process is a known browser. Used to decide
+// whether to skip the block-all fallback: when a browser has active audio but
+// no window title matches a video hint (e.g. video in a background tab), we
+// can't determine which monitor is playing. For browsers, not blocking is
+// preferable to blocking everything, since the user's use case is to let the
+// OLED sleep when video plays elsewhere. For non-browser apps (unknown apps,
+// media players with minimized windows), we keep the safe block-all fallback.
+int AllAudioActiveAreBrowsers(const MediaEnumContext* ctx) {
+    if (ctx->audioActiveProcessNameCount == 0) return 0;
+    for (int id = 0; id < MAX_INTERNED_PROCESS_NAMES; id++) {
+        if (TestProcessId(ctx->audioActiveIds, id) && !g_processNames.entries[id].isBrowser) {
+            return 0;
+        }
     }
+    return 1;
+}
 
-    char title[512] = {0};
-    GetWindowTextA(hWnd, title, sizeof(title));
+// ---------------------------------------------------------------------------
+// Persistent audio session cache
+//
+// COM activation dominated the per-scan cost, so the device enumerator, each
+// endpoint's IMMDevice and IAudioSessionManager2, and per-session
+// IAudioSessionControl / IAudioMeterInformation (plus the owning process's
+// interned name) are kept for the app's lifetime.
+//
+// Every active render endpoint is tracked (speakers, headphones, USB DACs,
+// monitor HDMI audio), plus the default communications capture endpoint.
+// The render set is re-enumerated only when IMMNotificationClient reports a
+// device being added, removed or changing state; existing endpoints keep
+// their caches. Each endpoint registers an IAudioSessionNotification, and
+// its session list is re-enumerated only after it reports a new session, so
+// a scan normally just reads state and peak of the cached sessions: the cost
+// follows the number of sessions, not endpoints. Expired sessions are
+// evicted. Notification callbacks run on audio service threads and only set
+// flags for the UI thread. Session notifications are not guaranteed to reach
+// the UI thread's STA at all, so an endpoint is re-enumerated on every scan
+// until its first notification has actually arrived, and after that still
+// every AUDIO_SESSION_RESYNC_MS.
+//
+// The capture endpoint is also dropped when the default device changes, and
+// everything but the enumerator on resume (ResetMediaDetectionCache) or on
+// any failure; the next scan rebuilds it.
+// ---------------------------------------------------------------------------
 
-    int matched = IsMediaCandidateWindow(processName, title);
+typedef struct {
+    IAudioSessionControl* pControl;     // Identity key (referenced)
+    IAudioMeterInformation* pMeter;
+    DWORD pid;
+    int nameId;                         // Interned process name, -1 = unresolved
+    DWORD nameGeneration;
+    int quiet;                          // Active but at or below the peak in the last collection
+} CachedAudioSession;
 
-    // Collect diagnostic info for all browser windows with active audio,
-    // regardless of whether they matched a hint. This is logged once in
-    // UpdateMediaMonitorStates when the mask changes, so the user can see
-    // ALL browser windows (including the one playing video) without per-tick spam.
-    if (IsKnownBrowserProcess(processName) && title[0] && ctx->browserWindowCount < MAX_BROWSER_WINDOW_INFO) {
-        int idx = ctx->browserWindowCount++;
-        strncpy(ctx->browserTitles[idx], title, 255);
-        ctx->browserTitles[idx][255] = '\0';
-        ctx->browserMatched[idx] = matched;
+typedef struct {
+    IAudioSessionNotification notify;   // Must stay first: callbacks cast back to the endpoint
+    int inUse;
+    const char* name;
+    WCHAR* deviceId;                    // CoTaskMem; NULL for the default capture endpoint
+    IMMDevice* pDevice;
+    IAudioSessionManager2* pManager;
+    int notifyRegistered;
+    volatile LONG sessionsDirty;        // New session reported: re-enumerate
+    volatile LONG notifyReceived;       // Notifications proven to arrive; until then enumerate every scan
+    DWORD lastEnumTick;
+    int missing;                        // No such endpoint; retried after invalidation
+    CachedAudioSession sessions[MAX_CACHED_AUDIO_SESSIONS];
+    int sessionCount;
+} AudioEndpointCache;
+
+static IMMDeviceEnumerator* g_pAudioEnum = NULL;
+static AudioEndpointCache g_renderEndpoints[MAX_AUDIO_ENDPOINTS];
+static AudioEndpointCache g_captureEndpoint;
+static int g_audioNotifyRegistered = 0;
+static volatile LONG g_audioEndpointsChanged = 1;  // Re-enumerate render endpoints
+static LONGLONG g_audioScanLastUs = 0;
+static LONGLONG g_audioScanTotalUs = 0;
+static int g_audioScanCount = 0;
+static int g_audioComObjectsLast = 0;   // COM objects obtained by the last scan
+static LONG g_audioComObjectsTotal = 0;
+
+static HRESULT STDMETHODCALLTYPE AudioNotifyQueryInterface(IMMNotificationClient* This, REFIID riid, void** ppv) {
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_IMMNotificationClient)) {
+        *ppv = This;
+        return S_OK;
     }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
 
-    if (!matched) {
-        return TRUE;
-    }
+// The notification clients are static objects: reference counting is a no-op
+static ULONG STDMETHODCALLTYPE AudioNotifyAddRef(IMMNotificationClient* This) {
+    (void)This;
+    return 1;
+}
 
-    MarkMediaWindowMonitors(ctx, &rect);
-    return TRUE;
+static ULONG STDMETHODCALLTYPE AudioNotifyRelease(IMMNotificationClient* This) {
+    (void)This;
+    return 1;
 }
 
-// Reset media detection cache. Called after system sleep/wake to force a fresh
-// scan, since WASAPI sessions and ES_DISPLAY_REQUIRED state may be stale.
-void ResetMediaDetectionCache() {
-    g_mediaCacheInvalidated = 1;
+static HRESULT STDMETHODCALLTYPE AudioNotifyDeviceStateChanged(IMMNotificationClient* This, LPCWSTR deviceId, DWORD newState) {
+    (void)This; (void)deviceId; (void)newState;
+    InterlockedExchange(&g_audioEndpointsChanged, 1);
+    return S_OK;
 }
 
-// Fills mediaOnMonitor[] with 1 for each monitor hosting a visible media window.
-// Uses the cheap ES_DISPLAY_REQUIRED gate to skip enumeration when nothing is
-// playing, and caches the scan for MEDIA_DETECTION_CACHE_MS to keep the timer
-// light. Returns 1 if any monitor has media. If media is playing globally but
-// no candidate window maps to a monitor, falls back to blocking all enabled
-// monitors (safe default so unknown apps are never covered).
-int UpdateMediaMonitorStates(int mediaOnMonitor[MAX_MONITOR_COUNT]) {
-    static DWORD lastLoggedMask = (DWORD)-1;
-    static DWORD lastScanTick = 0;
-    static int hasCachedState = 0;
-    static int cachedAnyMedia = 0;
-    static int cachedMediaOnMonitor[MAX_MONITOR_COUNT] = {0};
-    static DWORD lastAudioDetectedTick = 0;
+static HRESULT STDMETHODCALLTYPE AudioNotifyDeviceAdded(IMMNotificationClient* This, LPCWSTR deviceId) {
+    (void)This; (void)deviceId;
+    InterlockedExchange(&g_audioEndpointsChanged, 1);
+    return S_OK;
+}
 
-    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
-        mediaOnMonitor[i] = 0;
-    }
+static HRESULT STDMETHODCALLTYPE AudioNotifyDeviceRemoved(IMMNotificationClient* This, LPCWSTR deviceId) {
+    (void)This; (void)deviceId;
+    InterlockedExchange(&g_audioEndpointsChanged, 1);
+    return S_OK;
+}
 
-    if (g_mediaCacheInvalidated) {
-        hasCachedState = 0;
-        lastLoggedMask = (DWORD)-1;
-        g_mediaCacheInvalidated = 0;
-        LogMessage("Media detection cache invalidated (sleep/wake)");
+// Render endpoints are all tracked already; only the capture endpoint
+// follows the default device
+static HRESULT STDMETHODCALLTYPE AudioNotifyDefaultDeviceChanged(IMMNotificationClient* This, EDataFlow flow, ERole role, LPCWSTR deviceId) {
+    (void)This; (void)role; (void)deviceId;
+    if (flow == eCapture) {
+        InterlockedExchange(&g_audioCacheInvalidated, 1);
     }
+    return S_OK;
+}
 
-    if (!g_app.config.mediaDetectionEnabled) {
-        hasCachedState = 0;
-        if (lastLoggedMask != 0) {
-            LogMessage("Media monitor detection: disabled");
-            lastLoggedMask = 0;
-        }
-        return 0;
+static HRESULT STDMETHODCALLTYPE AudioNotifyPropertyValueChanged(IMMNotificationClient* This, LPCWSTR deviceId, const PROPERTYKEY key) {
+    (void)This; (void)deviceId; (void)key;
+    return S_OK;
+}
+
+static IMMNotificationClientVtbl g_audioNotifyVtbl = {
+    AudioNotifyQueryInterface,
+    AudioNotifyAddRef,
+    AudioNotifyRelease,
+    AudioNotifyDeviceStateChanged,
+    AudioNotifyDeviceAdded,
+    AudioNotifyDeviceRemoved,
+    AudioNotifyDefaultDeviceChanged,
+    AudioNotifyPropertyValueChanged
+};
+static IMMNotificationClient g_audioNotifyClient = { &g_audioNotifyVtbl };
+
+static HRESULT STDMETHODCALLTYPE SessionNotifyQueryInterface(IAudioSessionNotification* This, REFIID riid, void** ppv) {
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_IAudioSessionNotification)) {
+        *ppv = This;
+        return S_OK;
     }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
 
-    DWORD nowTick = GetTickCount();
-    if (hasCachedState && (DWORD)(nowTick - lastScanTick) < MEDIA_DETECTION_CACHE_MS) {
-        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
-            mediaOnMonitor[i] = cachedMediaOnMonitor[i];
+static ULONG STDMETHODCALLTYPE SessionNotifyAddRef(IAudioSessionNotification* This) {
+    (void)This;
+    return 1;
+}
+
+static ULONG STDMETHODCALLTYPE SessionNotifyRelease(IAudioSessionNotification* This) {
+    (void)This;
+    return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE SessionNotifySessionCreated(IAudioSessionNotification* This, IAudioSessionControl* newSession) {
+    (void)newSession;
+    InterlockedExchange(&((AudioEndpointCache*)This)->sessionsDirty, 1);
+    InterlockedExchange(&((AudioEndpointCache*)This)->notifyReceived, 1);
+    return S_OK;
+}
+
+static IAudioSessionNotificationVtbl g_sessionNotifyVtbl = {
+    SessionNotifyQueryInterface,
+    SessionNotifyAddRef,
+    SessionNotifyRelease,
+    SessionNotifySessionCreated
+};
+
+void ReleaseCachedAudioSession(CachedAudioSession* session) {
+    if (session->pMeter) session->pMeter->lpVtbl->Release(session->pMeter);
+    if (session->pControl) session->pControl->lpVtbl->Release(session->pControl);
+    memset(session, 0, sizeof(*session));
+}
+
+void ReleaseAudioEndpoint(AudioEndpointCache* endpoint) {
+    for (int i = 0; i < endpoint->sessionCount; i++) {
+        ReleaseCachedAudioSession(&endpoint->sessions[i]);
+    }
+    endpoint->sessionCount = 0;
+    if (endpoint->pManager) {
+        if (endpoint->notifyRegistered) {
+            endpoint->pManager->lpVtbl->UnregisterSessionNotification(endpoint->pManager, &endpoint->notify);
+            endpoint->notifyRegistered = 0;
         }
-        return cachedAnyMedia;
+        InterlockedExchange(&endpoint->notifyReceived, 0);
+        endpoint->pManager->lpVtbl->Release(endpoint->pManager);
+        endpoint->pManager = NULL;
     }
+    if (endpoint->pDevice) endpoint->pDevice->lpVtbl->Release(endpoint->pDevice);
+    endpoint->pDevice = NULL;
+    endpoint->missing = 0;
+}
 
-    lastScanTick = nowTick;
+// Release a render endpoint and free its slot.
+void RemoveRenderEndpoint(AudioEndpointCache* endpoint) {
+    ReleaseAudioEndpoint(endpoint);
+    if (endpoint->deviceId) CoTaskMemFree(endpoint->deviceId);
+    endpoint->deviceId = NULL;
+    endpoint->inUse = 0;
+}
 
-    int globalMediaPlaying = IsMediaPlaying();
+int GetRenderEndpointCount() {
+    int count = 0;
+    for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+        count += g_renderEndpoints[i].inUse;
+    }
+    return count;
+}
 
-    if (!globalMediaPlaying) {
-        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
-            cachedMediaOnMonitor[i] = 0;
+// Release everything, including the enumerator (before CoUninitialize).
+void ReleaseAudioCache() {
+    for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+        if (g_renderEndpoints[i].inUse) RemoveRenderEndpoint(&g_renderEndpoints[i]);
+    }
+    ReleaseAudioEndpoint(&g_captureEndpoint);
+    if (g_pAudioEnum) {
+        if (g_audioNotifyRegistered) {
+            g_pAudioEnum->lpVtbl->UnregisterEndpointNotificationCallback(g_pAudioEnum, &g_audioNotifyClient);
+            g_audioNotifyRegistered = 0;
         }
-        hasCachedState = 1;
-        cachedAnyMedia = 0;
+        g_pAudioEnum->lpVtbl->Release(g_pAudioEnum);
+        g_pAudioEnum = NULL;
+    }
+    InterlockedExchange(&g_audioEndpointsChanged, 1);
+}
 
-        if (lastLoggedMask != 0) {
-            LogMessage("Media monitor detection: no active media monitors");
-            lastLoggedMask = 0;
-        }
+int EnsureAudioEnumerator() {
+    if (g_pAudioEnum) return 1;
+    if (!EnsureComInitialized()) return 0;
+
+    HRESULT hr = CoCreateInstance(&CLSID_MMDeviceEnumerator, NULL, CLSCTX_ALL,
+                                  &IID_IMMDeviceEnumerator, (void**)&g_pAudioEnum);
+    if (FAILED(hr) || !g_pAudioEnum) {
+        LogMessage("Audio: CoCreateInstance failed hr=0x%08X", (unsigned)hr);
+        g_pAudioEnum = NULL;
         return 0;
     }
+    g_audioComObjectsLast++;
 
-    int localMediaOnMonitor[MAX_MONITOR_COUNT] = {0};
-    MediaEnumContext ctx = {0};
-    ctx.audioActiveProcessNameCount = CollectActiveAudioProcessNames(
-        ctx.audioActiveProcessNames, MAX_ACTIVE_AUDIO_PIDS);
-
-    if (ctx.audioActiveProcessNameCount > 0) {
-        lastAudioDetectedTick = nowTick;
-    } else if (hasCachedState && cachedAnyMedia &&
-               (DWORD)(nowTick - lastAudioDetectedTick) < AUDIO_GRACE_PERIOD_MS) {
-        // Audio was detected recently but this scan found no audible audio.
-        // This happens during quiet passages in video audio where the peak
-        // meter momentarily drops below threshold. Keep the previous media
-        // state to avoid flickering the screen saver on and off.
-        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
-            mediaOnMonitor[i] = cachedMediaOnMonitor[i];
+    hr = g_pAudioEnum->lpVtbl->RegisterEndpointNotificationCallback(g_pAudioEnum, &g_audioNotifyClient);
+    g_audioNotifyRegistered = SUCCEEDED(hr);
+    if (!g_audioNotifyRegistered) {
+        LogMessage("Audio: RegisterEndpointNotificationCallback failed hr=0x%08X", (unsigned)hr);
+    }
+    return 1;
+}
+
+// Match the render endpoint slots to the currently active render devices:
+// endpoints that are still active keep their session caches, new ones get a
+// free slot, the rest are released.
+void RefreshRenderEndpoints() {
+    IMMDeviceCollection* pCollection = NULL;
+    HRESULT hr = g_pAudioEnum->lpVtbl->EnumAudioEndpoints(g_pAudioEnum, eRender, DEVICE_STATE_ACTIVE, &pCollection);
+    if (FAILED(hr) || !pCollection) {
+        LogMessage("Audio: EnumAudioEndpoints(eRender) failed hr=0x%08X", (unsigned)hr);
+        InterlockedExchange(&g_audioEndpointsChanged, 1);
+        return;
+    }
+    g_audioComObjectsLast++;
+
+    int seen[MAX_AUDIO_ENDPOINTS] = {0};
+    UINT deviceCount = 0;
+    pCollection->lpVtbl->GetCount(pCollection, &deviceCount);
+    for (UINT d = 0; d < deviceCount; d++) {
+        IMMDevice* pDevice = NULL;
+        WCHAR* deviceId = NULL;
+        if (FAILED(pCollection->lpVtbl->Item(pCollection, d, &pDevice)) || !pDevice) continue;
+        if (FAILED(pDevice->lpVtbl->GetId(pDevice, &deviceId)) || !deviceId) {
+            pDevice->lpVtbl->Release(pDevice);
+            continue;
         }
-        hasCachedState = 1;
-        cachedAnyMedia = 1;
-        lastScanTick = nowTick;
 
-        DWORD mask = 0;
-        for (int i = 0; i < g_monitorCount && i < 32; i++) {
-            if (mediaOnMonitor[i]) {
-                mask |= (1u << i);
+        int slot = -1;
+        int freeSlot = -1;
+        for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+            if (g_renderEndpoints[i].inUse && wcscmp(g_renderEndpoints[i].deviceId, deviceId) == 0) {
+                slot = i;
+                break;
             }
+            if (!g_renderEndpoints[i].inUse && freeSlot < 0) freeSlot = i;
         }
-        if (mask != lastLoggedMask) {
-            LogMessage("Media monitor detection: mask=0x%08X (grace period, %lums since last audio)",
-                       mask, (unsigned long)(nowTick - lastAudioDetectedTick));
-            lastLoggedMask = mask;
+
+        if (slot >= 0) {
+            seen[slot] = 1;
+            CoTaskMemFree(deviceId);
+            pDevice->lpVtbl->Release(pDevice);
+        } else if (freeSlot >= 0) {
+            AudioEndpointCache* endpoint = &g_renderEndpoints[freeSlot];
+            memset(endpoint, 0, sizeof(*endpoint));
+            endpoint->notify.lpVtbl = &g_sessionNotifyVtbl;
+            endpoint->inUse = 1;
+            endpoint->name = "eRender";
+            endpoint->deviceId = deviceId;
+            endpoint->pDevice = pDevice;
+            g_audioComObjectsLast++;
+            seen[freeSlot] = 1;
+        } else {
+            CoTaskMemFree(deviceId);
+            pDevice->lpVtbl->Release(pDevice);
         }
-        return 1;
     }
+    pCollection->lpVtbl->Release(pCollection);
 
-    EnumWindows(EnumMediaWindowCallback, (LPARAM)&ctx);
-
-    int mappedMonitorCount = 0;
-    for (int i = 0; i < g_monitorCount; i++) {
-        if (ctx.mediaOnMonitor[i]) {
-            localMediaOnMonitor[i] = 1;
-            mediaOnMonitor[i] = 1;
-            mappedMonitorCount++;
+    for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+        if (g_renderEndpoints[i].inUse && !seen[i]) {
+            RemoveRenderEndpoint(&g_renderEndpoints[i]);
         }
     }
+    LogMessage("Audio: tracking %d render endpoint(s)", GetRenderEndpointCount());
+}
 
-    int usedGlobalFallback = 0;
-    int skippedFallbackForBrowser = 0;
-    int skippedFallbackForNoAudio = 0;
-    if (mappedMonitorCount == 0) {
-        if (ctx.audioActiveProcessNameCount == 0) {
-            // ES_DISPLAY_REQUIRED is set but no audible audio is detected on the
-            // default render endpoint. This happens with muted video, OBS replay
-            // buffer, or other apps that call SetThreadExecutionState without
-            // producing audio.
-            if (g_app.config.blockOnMutedMedia) {
-                // User opted in to blocking on muted/silent media. Conservatively
-                // block all enabled monitors.
-                for (int i = 0; i < g_monitorCount; i++) {
-                    if (g_monitorStates[i].enabled) {
-                        mediaOnMonitor[i] = 1;
-                    }
-                }
-                usedGlobalFallback = 1;
-            } else {
-                // No audible media is playing, let the screen saver activate.
-                skippedFallbackForNoAudio = 1;
-                LogMessage("Media detection: ES_DISPLAY_REQUIRED set but no audible audio detected: skipping fallback");
-            }
-        } else if (AllAudioActiveAreBrowsers(&ctx)) {
-            // All audio-active processes are known browsers, but no window title
-            // matched a video hint. This typically means video is playing in a
-            // background tab - the window title shows the active tab, not the
-            // playing one. We can't determine which monitor is playing, so
-            // rather than blocking all monitors (which would defeat per-monitor
-            // detection), we skip the fallback and let the screen saver activate.
-            // The user can always move the mouse to dismiss it if needed.
-            skippedFallbackForBrowser = 1;
-            LogMessage("Media detection: no title hint match, all audio-active processes are browsers: skipping fallback");
-        } else {
-            // Non-browser audio (unknown app, media player with minimized window,
-            // audio on non-default device). Conservatively block all enabled
-            // monitors to avoid covering playback.
-            for (int i = 0; i < g_monitorCount; i++) {
-                if (g_monitorStates[i].enabled) {
-                    mediaOnMonitor[i] = 1;
-                }
+// Returns 1 if the endpoint's session manager is available.
+int EnsureAudioEndpoint(AudioEndpointCache* endpoint, EDataFlow flow, ERole role) {
+    if (endpoint->pManager) return 1;
+    if (endpoint->missing) return 0;
+
+    HRESULT hr;
+    if (!endpoint->pDevice) {
+        // Render endpoints are reopened by ID, the capture endpoint follows the default
+        hr = endpoint->deviceId ?
+             g_pAudioEnum->lpVtbl->GetDevice(g_pAudioEnum, endpoint->deviceId, &endpoint->pDevice) :
+             g_pAudioEnum->lpVtbl->GetDefaultAudioEndpoint(g_pAudioEnum, flow, role, &endpoint->pDevice);
+        if (FAILED(hr) || !endpoint->pDevice) {
+            // A missing endpoint (e.g. no microphone) is not an error
+            if (hr != HRESULT_FROM_WIN32(ERROR_NOT_FOUND)) {
+                LogMessage("Audio: opening endpoint (%s) failed hr=0x%08X", endpoint->name, (unsigned)hr);
             }
-            usedGlobalFallback = 1;
+            endpoint->pDevice = NULL;
+            endpoint->missing = 1;
+            return 0;
         }
+        g_audioComObjectsLast++;
     }
 
-    DWORD mask = 0;
-    for (int i = 0; i < g_monitorCount && i < 32; i++) {
-        if (mediaOnMonitor[i]) {
-            mask |= (1u << i);
-        }
+    hr = endpoint->pDevice->lpVtbl->Activate(endpoint->pDevice, &IID_IAudioSessionManager2,
+                                             CLSCTX_ALL, NULL, (void**)&endpoint->pManager);
+    if (FAILED(hr) || !endpoint->pManager) {
+        LogMessage("Audio: Activate(IAudioSessionManager2, %s) failed hr=0x%08X", endpoint->name, (unsigned)hr);
+        endpoint->pManager = NULL;
+        endpoint->missing = 1;
+        return 0;
     }
-
-    hasCachedState = 1;
-    cachedAnyMedia = mask != 0;
-    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
-        cachedMediaOnMonitor[i] = mediaOnMonitor[i];
+    g_audioComObjectsLast++;
+
+    endpoint->notify.lpVtbl = &g_sessionNotifyVtbl;
+    hr = endpoint->pManager->lpVtbl->RegisterSessionNotification(endpoint->pManager, &endpoint->notify);
+    endpoint->notifyRegistered = SUCCEEDED(hr);
+    if (!endpoint->notifyRegistered) {
+        LogMessage("Audio: RegisterSessionNotification(%s) failed hr=0x%08X, enumerating every scan",
+                   endpoint->name, (unsigned)hr);
     }
+    // Notifications only start after the first GetSessionEnumerator
+    InterlockedExchange(&endpoint->sessionsDirty, 1);
+    return 1;
+}
 
-    if (mask != lastLoggedMask) {
-        for (int i = 0; i < ctx.browserWindowCount; i++) {
-            LogMessage("Media detection: browser window %s: '%.120s'",
-                       ctx.browserMatched[i] ? "MATCHED  " : "no hint  ",
-                       ctx.browserTitles[i]);
+// Add a session returned by the session enumerator to the cache unless it
+// is already there. Consumes the caller's reference to pControl.
+void AddCachedAudioSession(AudioEndpointCache* endpoint, IAudioSessionControl* pControl) {
+    for (int i = 0; i < endpoint->sessionCount; i++) {
+        if (endpoint->sessions[i].pControl == pControl) {
+            pControl->lpVtbl->Release(pControl);
+            return;
         }
-        LogMessage("Media monitor detection: mask=0x%08X (activeAudioNames=%d, fallback=%d, browserSkip=%d, noAudioSkip=%d, browserWindows=%d)",
-                   mask, ctx.audioActiveProcessNameCount, usedGlobalFallback, skippedFallbackForBrowser, skippedFallbackForNoAudio, ctx.browserWindowCount);
-        lastLoggedMask = mask;
+    }
+    if (endpoint->sessionCount >= MAX_CACHED_AUDIO_SESSIONS) {
+        pControl->lpVtbl->Release(pControl);
+        return;
     }
 
-    return cachedAnyMedia;
-}
+    CachedAudioSession* session = &endpoint->sessions[endpoint->sessionCount++];
+    memset(session, 0, sizeof(*session));
+    session->pControl = pControl;
+    session->nameId = -1;
 
-// Check if a Windows shell overlay window (Start Menu, Task View, Action Center) is open
-// Returns the number of shell windows detected (0, 1, or 2 if both Start Menu and Action Center)
-int IsShellWindowOpen() {
-    HWND hFg = GetForegroundWindow();
-    if (!hFg) {
-        LogMessage("Shell detection: No foreground window");
-        return 0;
+    IAudioSessionControl2* pControl2 = NULL;
+    if (SUCCEEDED(pControl->lpVtbl->QueryInterface(pControl, &IID_IAudioSessionControl2, (void**)&pControl2)) && pControl2) {
+        pControl2->lpVtbl->GetProcessId(pControl2, &session->pid);
+        pControl2->lpVtbl->Release(pControl2);
+        g_audioComObjectsLast++;
+    }
+    if (SUCCEEDED(pControl->lpVtbl->QueryInterface(pControl, &IID_IAudioMeterInformation, (void**)&session->pMeter)) && session->pMeter) {
+        g_audioComObjectsLast++;
+    } else {
+        session->pMeter = NULL;
     }
+}
+
+// Re-read the endpoint's session list into the cache. Returns 0 if the
+// endpoint has become unusable.
+int RefreshEndpointSessions(AudioEndpointCache* endpoint) {
+    IAudioSessionEnumerator* pSessionEnum = NULL;
+    HRESULT hr = endpoint->pManager->lpVtbl->GetSessionEnumerator(endpoint->pManager, &pSessionEnum);
+    if (FAILED(hr) || !pSessionEnum) {
+        // Usually AUDCLNT_E_DEVICE_INVALIDATED
+        LogMessage("Audio: GetSessionEnumerator(%s) failed hr=0x%08X", endpoint->name, (unsigned)hr);
+        return 0;
+    }
+    g_audioComObjectsLast++;
+
+    int sessionCount = 0;
+    pSessionEnum->lpVtbl->GetCount(pSessionEnum, &sessionCount);
+    for (int i = 0; i < sessionCount; i++) {
+        IAudioSessionControl* pControl = NULL;
+        if (SUCCEEDED(pSessionEnum->lpVtbl->GetSession(pSessionEnum, i, &pControl)) && pControl) {
+            AddCachedAudioSession(endpoint, pControl);
+        }
+    }
+    pSessionEnum->lpVtbl->Release(pSessionEnum);
+    return 1;
+}
+
+int GetCachedSessionNameId(CachedAudioSession* session) {
+    if (session->nameId < 0 || session->nameGeneration != g_processNames.generation) {
+        char procName[MAX_PATH] = {0};
+        session->nameId = GetProcessNameFromPid(session->pid, procName, sizeof(procName)) ?
+                          InternProcessName(procName) : -1;
+        session->nameGeneration = g_processNames.generation;
+    }
+    return session->nameId;
+}
+
+void AddSessionProcess(CachedAudioSession* session, DWORD ids[PROCESS_ID_WORDS], DWORD pids[MAX_ACTIVE_AUDIO_PIDS],
+                       int* pidCount, int* count) {
+    AddUniquePid(pids, pidCount, MAX_ACTIVE_AUDIO_PIDS, session->pid);
+    int id = GetCachedSessionNameId(session);
+    if (id >= 0 && !TestProcessId(ids, id)) {
+        ids[id >> 5] |= 1u << (id & 31);
+        (*count)++;
+    } else if (id < 0 && g_processNames.overflowed) {
+        (*count)++;                     // Unnamed, but still audio
+    }
+}
+
+// Add the processes with an ACTIVE session on the endpoint whose peak meter
+// is above minPeak to the ids bitmap and their PIDs to pids, returning the
+// number of process names added. Active sessions at or below it are marked
+// quiet.
+int CollectEndpointSessionNames(AudioEndpointCache* endpoint, float minPeak, DWORD ids[PROCESS_ID_WORDS],
+                                DWORD pids[MAX_ACTIVE_AUDIO_PIDS], int* pidCount) {
+    int count = 0;
+
+    DWORD nowTick = GetTickCount();
+    if (InterlockedExchange(&endpoint->sessionsDirty, 0) || !endpoint->notifyRegistered || !endpoint->notifyReceived ||
+        (DWORD)(nowTick - endpoint->lastEnumTick) >= AUDIO_SESSION_RESYNC_MS) {
+        endpoint->lastEnumTick = nowTick;
+        if (!RefreshEndpointSessions(endpoint)) {
+            ReleaseAudioEndpoint(endpoint);
+            return 0;
+        }
+    }
+
+    for (int i = endpoint->sessionCount - 1; i >= 0; i--) {
+        CachedAudioSession* session = &endpoint->sessions[i];
+
+        AudioSessionState state = AudioSessionStateExpired;
+        session->pControl->lpVtbl->GetState(session->pControl, &state);
+        if (state == AudioSessionStateExpired) {
+            ReleaseCachedAudioSession(session);
+            endpoint->sessions[i] = endpoint->sessions[--endpoint->sessionCount];
+            continue;
+        }
+        session->quiet = 0;
+        if (state != AudioSessionStateActive || session->pid == 0) continue;
+
+        // AudioSessionStateActive can be true even when a video is paused
+        // (the session stays "active" but produces no sound). Use the peak
+        // meter to filter out silent sessions so paused video doesn't block
+        // the screen saver.
+        float peak = 0.0f;
+        if (!session->pMeter || FAILED(session->pMeter->lpVtbl->GetPeakValue(session->pMeter, &peak)) ||
+            peak <= minPeak) {
+            session->quiet = 1;
+            continue;
+        }
+
+        AddSessionProcess(session, ids, pids, pidCount, &count);
+    }
+    return count;
+}
+
+// Sets the name IDs of processes showing a visible window titled like a call.
+BOOL CALLBACK CollectCallWindowCallback(HWND hWnd, LPARAM lParam) {
+    DWORD* callIds = (DWORD*)lParam;
+    if (!IsWindowVisible(hWnd) || IsIconic(hWnd) || IsWindowCloakedCompat(hWnd)) return TRUE;
+
+    char title[512];
+    GetWindowTitleNoWait(hWnd, title, sizeof(title));
+    if (!WindowTitleHasCallHint(title)) return TRUE;
 
     char processName[MAX_PATH] = {0};
-    if (!GetProcessNameFromHwnd(hFg, processName, sizeof(processName))) {
-        LogMessage("Shell detection: Could not get process name for foreground window");
+    if (GetProcessNameFromHwnd(hWnd, processName, sizeof(processName))) {
+        int id = FindProcessNameId(processName);
+        if (id >= 0) callIds[id >> 5] |= 1u << (id & 31);
+    }
+    return TRUE;
+}
+
+// Collect the processes in a call from the default communications capture
+// endpoint (call apps capture from it). A session counts while the
+// microphone picks up sound; a muted one (zero peak) only while its process
+// shows a window titled like a call, so an app that merely keeps the
+// microphone open (voice chat, a browser tab) doesn't count. Returns the
+// number of process names added.
+int CollectCallCaptureNames(DWORD ids[PROCESS_ID_WORDS], DWORD pids[MAX_ACTIVE_AUDIO_PIDS], int* pidCount) {
+    g_captureEndpoint.name = "eCapture";
+    if (!EnsureAudioEndpoint(&g_captureEndpoint, eCapture, eCommunications)) return 0;
+
+    int count = CollectEndpointSessionNames(&g_captureEndpoint, 0.0f, ids, pids, pidCount);
+
+    // Quiet sessions' names are interned first, so the window pass only
+    // opens processes behind call-titled windows
+    int quietCount = 0;
+    for (int i = 0; i < g_captureEndpoint.sessionCount; i++) {
+        if (g_captureEndpoint.sessions[i].quiet && GetCachedSessionNameId(&g_captureEndpoint.sessions[i]) >= 0) {
+            quietCount++;
+        }
+    }
+    if (quietCount == 0) return count;
+
+    DWORD callIds[PROCESS_ID_WORDS] = {0};
+    EnumWindows(CollectCallWindowCallback, (LPARAM)callIds);
+    for (int i = 0; i < g_captureEndpoint.sessionCount; i++) {
+        CachedAudioSession* session = &g_captureEndpoint.sessions[i];
+        if (session->quiet && TestProcessId(callIds, session->nameId)) {
+            AddSessionProcess(session, ids, pids, pidCount, &count);
+        }
+    }
+    return count;
+}
+
+// Timer thread, for media detection without per-monitor detection: is a
+// call using the microphone?
+int IsCallCaptureActive() {
+    if (!EnsureAudioEnumerator()) return 0;
+    ResetProcessNamesIfFull();
+
+    DWORD ids[PROCESS_ID_WORDS] = {0};
+    DWORD pids[MAX_ACTIVE_AUDIO_PIDS];
+    int pidCount = 0;
+    CollectCallCaptureNames(ids, pids, &pidCount);
+    return pidCount > 0;
+}
+
+// Collect the processes with an ACTIVE, audible audio session on any active
+// render endpoint into ctx->audioActiveIds, and the processes in a call
+// (CollectCallCaptureNames) into ctx->captureActiveIds. Returns the render count (0 on any failure,
+// which causes the caller's safe fallback to block all enabled monitors).
+int CollectActiveAudioProcessNames(MediaEnumContext* ctx) {
+    LONGLONG startUs = GetTimestampUs();
+    g_audioComObjectsLast = 0;
+
+    ResetProcessNamesIfFull();
+
+    if (InterlockedExchange(&g_audioCacheInvalidated, 0)) {
+        LogMessage("Audio: default capture device changed or system resumed, dropping cached endpoints");
+        for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+            if (g_renderEndpoints[i].inUse) ReleaseAudioEndpoint(&g_renderEndpoints[i]);
+        }
+        ReleaseAudioEndpoint(&g_captureEndpoint);
+        InterlockedExchange(&g_audioEndpointsChanged, 1);
+    }
+
+    if (EnsureAudioEnumerator()) {
+        if (InterlockedExchange(&g_audioEndpointsChanged, 0)) {
+            RefreshRenderEndpoints();
+        }
+
+        for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+            AudioEndpointCache* endpoint = &g_renderEndpoints[i];
+            if (endpoint->inUse && EnsureAudioEndpoint(endpoint, eRender, eConsole)) {
+                ctx->audioActiveProcessNameCount += CollectEndpointSessionNames(endpoint, AUDIO_ACTIVE_PEAK_THRESHOLD,
+                                                                               ctx->audioActiveIds,
+                                                                               ctx->audioPids, &ctx->audioPidCount);
+            }
+        }
+
+        ctx->captureActiveProcessNameCount = CollectCallCaptureNames(ctx->captureActiveIds, ctx->capturePids,
+                                                                     &ctx->capturePidCount);
+    }
+
+    g_audioScanLastUs = GetTimestampUs() - startUs;
+    g_audioScanTotalUs += g_audioScanLastUs;
+    g_audioScanCount++;
+    g_audioComObjectsTotal += g_audioComObjectsLast;
+    return ctx->audioActiveProcessNameCount;
+}
+
+// Prefer DWM's extended frame bounds (accounts for invisible drop-shadow borders);
+// fall back to GetWindowRect if DWM query fails.
+int GetVisibleWindowRect(HWND hWnd, RECT* rect) {
+    RECT frameRect;
+    HRESULT hr = DwmGetWindowAttribute(hWnd, DWMWA_EXTENDED_FRAME_BOUNDS, &frameRect, sizeof(frameRect));
+    if (SUCCEEDED(hr) && RectArea(&frameRect) > 0) {
+        *rect = frameRect;
+        return 1;
+    }
+
+    return GetWindowRect(hWnd, rect) != 0;
+}
+
+void MarkMediaWindowMonitors(MediaEnumContext* ctx, const RECT* windowRect) {
+    LONGLONG windowArea = RectArea(windowRect);
+
+    if (windowArea < MIN_MEDIA_WINDOW_AREA) {
+        return;
+    }
+
+    int marked = 0;
+    for (int i = 0; i < g_monitorCount; i++) {
+        LONGLONG intersectionArea = RectIntersectionArea(windowRect, &g_monitors[i].rect);
+        double overlapRatio = (double)intersectionArea / (double)windowArea;
+        if (intersectionArea >= MIN_MEDIA_WINDOW_AREA && overlapRatio >= MIN_MEDIA_WINDOW_OVERLAP_RATIO) {
+            ctx->mediaOnMonitor[i] = 1;
+            marked = 1;
+        }
+    }
+
+    if (!marked) {
+        int monitorIndex = GetMonitorIndexFromRect(*windowRect);
+        if (monitorIndex >= 0 && monitorIndex < g_monitorCount) {
+            ctx->mediaOnMonitor[monitorIndex] = 1;
+        }
+    }
+}
+
+#if OLED_FEATURE_TAB_PROBE
+// ---------------------------------------------------------------------------
+// Browser tab probe
+//
+// When a browser is audible but none of its window titles has a video hint,
+// the video is usually in a background tab. With browserTabProbeEnabled, a
+// worker thread asks UI Automation for the window's tab strip, then for the
+// strip's tab items only (never the page content, which can be huge), and
+// looks for one whose accessible name carries Chromium's "Audio playing"
+// suffix and a video hint. The suffix is in the browser's UI language:
+// English is built in, browserTabAudioLabel supplies any other.
+// UIA walks another process's accessibility tree and can take hundreds of
+// milliseconds, so the timer thread never calls it: it only reads the
+// cached result for the HWND (or queues a probe and moves on).
+// A result stays valid until the window's title or position changes;
+// negative results also expire after TAB_PROBE_NEGATIVE_TTL_MS, since audio
+// can start in a background tab without changing either.
+// ---------------------------------------------------------------------------
+
+#define TAB_PROBE_FREE      0
+#define TAB_PROBE_PENDING   1
+#define TAB_PROBE_DONE      2
+
+typedef struct {
+    HWND hWnd;
+    RECT rect;
+    DWORD titleHash;
+    int state;
+    DWORD serial;                       // Bumped on every queueing; stale results are dropped
+    int mediaTab;                       // A playing tab with a video hint was found
+    DWORD doneTick;
+    DWORD lastUsedTick;
+} TabProbeEntry;
+
+static TabProbeEntry g_tabProbeCache[TAB_PROBE_CACHE_SIZE];
+static CRITICAL_SECTION g_tabProbeLock;
+static int g_tabProbeLockReady = 0;
+// One per worker thread. A worker that doesn't stop in time keeps running
+// on its own context, so StopTabProbe never closes events it still waits on.
+typedef struct {
+    volatile LONG refs;                 // Held by the worker and by g_tabProbe
+    HANDLE hStopEvent;
+    HANDLE hWakeEvent;
+    DWORD epoch;                        // Results from an older epoch are dropped
+    char audioLabel[TAB_AUDIO_LABEL_LEN];   // Copy of browserTabAudioLabel
+} TabProbeContext;
+
+static TabProbeContext* g_tabProbe = NULL;  // Current worker, UI thread only
+static HANDLE g_hTabProbeThread = NULL;
+static DWORD g_tabProbeEpoch = 0;           // Bumped on stop, under g_tabProbeLock
+static volatile LONG g_tabProbeFailed = 0;  // UIA unavailable: stop queueing
+static LONG g_tabProbeCount = 0;
+static LONG g_tabProbeHits = 0;
+static LONG g_tabProbeLastMs = 0;
+static LONG g_tabProbeMaxMs = 0;
+
+DWORD HashWindowTitle(const char* title) {
+    DWORD hash = 2166136261u;
+    for (; *title; title++) {
+        hash = (hash ^ (BYTE)*title) * 16777619u;
+    }
+    return hash;
+}
+
+// Returns 1 if a tab's accessible name says it is playing audio and looks
+// like video. Chromium browsers append " - Audio playing" (localized) to the
+// name.
+int TabNameIsPlayingMedia(BSTR name, const char* audioLabel) {
+    char narrow[512];
+    if (!WideCharToMultiByte(CP_UTF8, 0, name, -1, narrow, sizeof(narrow), NULL, NULL)) {
+        return 0;
+    }
+    int playing = ContainsIgnoreCase(narrow, "Audio playing") || ContainsIgnoreCase(narrow, "Playing audio") ||
+                  (audioLabel[0] && ContainsIgnoreCase(narrow, audioLabel));
+    return playing && WindowTitleHasMediaHint(narrow);
+}
+
+// pStripCondition matches the tab strip (a Tab control), pTabCondition its
+// tab items. The strip is found with FindFirst, which stops at the browser
+// frame's tab strip before reaching the page content.
+int ProbeBrowserWindowTabs(IUIAutomation* pAutomation, IUIAutomationCondition* pStripCondition,
+                           IUIAutomationCondition* pTabCondition, const char* audioLabel, HWND hWnd) {
+    IUIAutomationElement* pWindow = NULL;
+    if (FAILED(pAutomation->lpVtbl->ElementFromHandle(pAutomation, hWnd, &pWindow)) || !pWindow) {
+        return 0;
+    }
+
+    IUIAutomationElement* pStrip = NULL;
+    HRESULT hr = pWindow->lpVtbl->FindFirst(pWindow, TreeScope_Descendants, pStripCondition, &pStrip);
+    pWindow->lpVtbl->Release(pWindow);
+    if (FAILED(hr) || !pStrip) {
+        return 0;
+    }
+
+    int found = 0;
+    DWORD startTick = GetTickCount();
+    IUIAutomationElementArray* pTabs = NULL;
+    if (SUCCEEDED(pStrip->lpVtbl->FindAll(pStrip, TreeScope_Children, pTabCondition, &pTabs)) && pTabs) {
+        int count = 0;
+        pTabs->lpVtbl->get_Length(pTabs, &count);
+        for (int i = 0; i < count && i < TAB_PROBE_MAX_TABS && !found; i++) {
+            if ((DWORD)(GetTickCount() - startTick) >= TAB_PROBE_BUDGET_MS) break;
+            IUIAutomationElement* pTab = NULL;
+            if (FAILED(pTabs->lpVtbl->GetElement(pTabs, i, &pTab)) || !pTab) continue;
+            BSTR name = NULL;
+            if (SUCCEEDED(pTab->lpVtbl->get_CurrentName(pTab, &name)) && name) {
+                found = TabNameIsPlayingMedia(name, audioLabel);
+                SysFreeString(name);
+            }
+            pTab->lpVtbl->Release(pTab);
+        }
+        pTabs->lpVtbl->Release(pTabs);
+    }
+    pStrip->lpVtbl->Release(pStrip);
+    return found;
+}
+
+IUIAutomationCondition* CreateControlTypeCondition(IUIAutomation* pAutomation, int controlTypeId) {
+    IUIAutomationCondition* pCondition = NULL;
+    VARIANT controlType;
+    VariantInit(&controlType);
+    controlType.vt = VT_I4;
+    controlType.lVal = controlTypeId;
+    if (FAILED(pAutomation->lpVtbl->CreatePropertyCondition(pAutomation, UIA_ControlTypePropertyId,
+                                                            controlType, &pCondition))) {
+        return NULL;
+    }
+    return pCondition;
+}
+
+// Take the oldest pending entry; returns 0 if there is none.
+int TakePendingTabProbe(HWND* hWnd, int* slot, DWORD* serial) {
+    int best = -1;
+    EnterCriticalSection(&g_tabProbeLock);
+    for (int i = 0; i < TAB_PROBE_CACHE_SIZE; i++) {
+        if (g_tabProbeCache[i].state == TAB_PROBE_PENDING &&
+            (best < 0 || (LONG)(g_tabProbeCache[i].lastUsedTick - g_tabProbeCache[best].lastUsedTick) < 0)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        *hWnd = g_tabProbeCache[best].hWnd;
+        *slot = best;
+        *serial = g_tabProbeCache[best].serial;
+    }
+    LeaveCriticalSection(&g_tabProbeLock);
+    return best >= 0;
+}
+
+void ReleaseTabProbeContext(TabProbeContext* ctx) {
+    if (InterlockedDecrement(&ctx->refs) == 0) {
+        CloseHandle(ctx->hStopEvent);
+        CloseHandle(ctx->hWakeEvent);
+        free(ctx);
+    }
+}
+
+DWORD RunTabProbe(TabProbeContext* ctx) {
+    if (FAILED(CoInitializeEx(NULL, COINIT_MULTITHREADED))) {
+        InterlockedExchange(&g_tabProbeFailed, 1);
+        return 1;
+    }
+
+    IUIAutomation* pAutomation = NULL;
+    IUIAutomationCondition* pStripCondition = NULL;
+    IUIAutomationCondition* pTabCondition = NULL;
+    HRESULT hr = CoCreateInstance(&CLSID_CUIAutomation, NULL, CLSCTX_INPROC_SERVER,
+                                  &IID_IUIAutomation, (void**)&pAutomation);
+    if (SUCCEEDED(hr) && pAutomation) {
+        pStripCondition = CreateControlTypeCondition(pAutomation, UIA_TabControlTypeId);
+        pTabCondition = CreateControlTypeCondition(pAutomation, UIA_TabItemControlTypeId);
+    }
+    if (!pStripCondition || !pTabCondition) {
+        LogMessage("Tab probe: UI Automation unavailable hr=0x%08X", (unsigned)hr);
+        InterlockedExchange(&g_tabProbeFailed, 1);
+        if (pStripCondition) pStripCondition->lpVtbl->Release(pStripCondition);
+        if (pTabCondition) pTabCondition->lpVtbl->Release(pTabCondition);
+        if (pAutomation) pAutomation->lpVtbl->Release(pAutomation);
+        CoUninitialize();
+        return 1;
+    }
+
+    // Bound each cross-process call (Windows 8+); a hung browser then costs
+    // the budget instead of the default 20 s
+    IUIAutomation2* pAutomation2 = NULL;
+    if (SUCCEEDED(pAutomation->lpVtbl->QueryInterface(pAutomation, &IID_IUIAutomation2, (void**)&pAutomation2)) &&
+        pAutomation2) {
+        pAutomation2->lpVtbl->put_ConnectionTimeout(pAutomation2, TAB_PROBE_BUDGET_MS);
+        pAutomation2->lpVtbl->put_TransactionTimeout(pAutomation2, TAB_PROBE_BUDGET_MS);
+        pAutomation2->lpVtbl->Release(pAutomation2);
+    }
+
+    HANDLE handles[2] = { ctx->hStopEvent, ctx->hWakeEvent };
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        HWND hWnd;
+        int slot;
+        DWORD serial;
+        while (WaitForSingleObject(ctx->hStopEvent, 0) != WAIT_OBJECT_0 &&
+               TakePendingTabProbe(&hWnd, &slot, &serial)) {
+            DWORD startTick = GetTickCount();
+            int mediaTab = IsWindow(hWnd) ?
+                           ProbeBrowserWindowTabs(pAutomation, pStripCondition, pTabCondition, ctx->audioLabel, hWnd) : 0;
+            LONG elapsedMs = (LONG)(GetTickCount() - startTick);
+
+            EnterCriticalSection(&g_tabProbeLock);
+            TabProbeEntry* entry = &g_tabProbeCache[slot];
+            if (ctx->epoch == g_tabProbeEpoch && entry->serial == serial && entry->state == TAB_PROBE_PENDING) {
+                entry->mediaTab = mediaTab;
+                entry->doneTick = GetTickCount();
+                entry->state = TAB_PROBE_DONE;
+            }
+            LeaveCriticalSection(&g_tabProbeLock);
+
+            InterlockedIncrement(&g_tabProbeCount);
+            if (mediaTab) InterlockedIncrement(&g_tabProbeHits);
+            InterlockedExchange(&g_tabProbeLastMs, elapsedMs);
+            if (elapsedMs > g_tabProbeMaxMs) InterlockedExchange(&g_tabProbeMaxMs, elapsedMs);
+        }
+    }
+
+    pStripCondition->lpVtbl->Release(pStripCondition);
+    pTabCondition->lpVtbl->Release(pTabCondition);
+    pAutomation->lpVtbl->Release(pAutomation);
+    CoUninitialize();
+    return 0;
+}
+
+DWORD WINAPI TabProbeThread(LPVOID param) {
+    TabProbeContext* ctx = (TabProbeContext*)param;
+    DWORD result = RunTabProbe(ctx);
+    ReleaseTabProbeContext(ctx);
+    return result;
+}
+
+int StartTabProbe() {
+    if (g_hTabProbeThread) return 1;
+    if (g_tabProbeFailed) return 0;
+
+    if (!g_tabProbeLockReady) {
+        InitializeCriticalSection(&g_tabProbeLock);
+        g_tabProbeLockReady = 1;
+    }
+
+    TabProbeContext* ctx = calloc(1, sizeof(TabProbeContext));
+    if (ctx) {
+        ctx->refs = 2;
+        ctx->epoch = g_tabProbeEpoch;
+        strcpy_s(ctx->audioLabel, sizeof(ctx->audioLabel), g_app.config.browserTabAudioLabel);
+        ctx->hStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        ctx->hWakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (ctx->hStopEvent && ctx->hWakeEvent) {
+            g_hTabProbeThread = CreateThread(NULL, 0, TabProbeThread, ctx, 0, NULL);
+        }
+    }
+    if (!g_hTabProbeThread) {
+        if (ctx) {
+            if (ctx->hStopEvent) CloseHandle(ctx->hStopEvent);
+            if (ctx->hWakeEvent) CloseHandle(ctx->hWakeEvent);
+            free(ctx);
+        }
+        InterlockedExchange(&g_tabProbeFailed, 1);
         return 0;
     }
+    g_tabProbe = ctx;
+    LogMessage("Tab probe: worker started");
+    return 1;
+}
+
+void StopTabProbe() {
+    if (g_tabProbeLockReady) {
+        EnterCriticalSection(&g_tabProbeLock);
+        g_tabProbeEpoch++;
+        memset(g_tabProbeCache, 0, sizeof(g_tabProbeCache));
+        LeaveCriticalSection(&g_tabProbeLock);
+    }
+    if (g_hTabProbeThread) {
+        SetEvent(g_tabProbe->hStopEvent);
+        // A probe in flight is bounded by the UIA timeouts. A worker stuck
+        // anyway is left to finish on its own context, which it frees.
+        if (WaitForSingleObject(g_hTabProbeThread, TAB_PROBE_BUDGET_MS * 4) != WAIT_OBJECT_0) {
+            LogMessage("Tab probe: worker did not stop in time");
+        }
+        ReleaseTabProbeContext(g_tabProbe);
+        g_tabProbe = NULL;
+        CloseHandle(g_hTabProbeThread);
+        g_hTabProbeThread = NULL;
+    }
+    InterlockedExchange(&g_tabProbeFailed, 0);
+}
+
+// Timer thread: returns the cached probe result for an audible browser
+// window whose title has no video hint, queueing a probe if there is none.
+// Never blocks on UIA.
+int BrowserWindowHasMediaTab(HWND hWnd, const RECT* rect, const char* title) {
+    if (!g_app.config.browserTabProbeEnabled || !StartTabProbe()) return 0;
+
+    DWORD nowTick = GetTickCount();
+    DWORD titleHash = HashWindowTitle(title);
+    int result = 0;
+    int queue = 0;
+
+    EnterCriticalSection(&g_tabProbeLock);
+    TabProbeEntry* entry = NULL;
+    for (int i = 0; i < TAB_PROBE_CACHE_SIZE; i++) {
+        if (g_tabProbeCache[i].state != TAB_PROBE_FREE && g_tabProbeCache[i].hWnd == hWnd) {
+            entry = &g_tabProbeCache[i];
+            break;
+        }
+    }
+
+    if (entry && entry->titleHash == titleHash && EqualRect(&entry->rect, rect)) {
+        if (entry->state == TAB_PROBE_DONE) {
+            result = entry->mediaTab;
+            queue = !entry->mediaTab && (DWORD)(nowTick - entry->doneTick) >= TAB_PROBE_NEGATIVE_TTL_MS;
+        }
+    } else {
+        if (!entry) {
+            // Free slot, else the least recently used one
+            entry = &g_tabProbeCache[0];
+            for (int i = 0; i < TAB_PROBE_CACHE_SIZE; i++) {
+                if (g_tabProbeCache[i].state == TAB_PROBE_FREE) {
+                    entry = &g_tabProbeCache[i];
+                    break;
+                }
+                if ((LONG)(g_tabProbeCache[i].lastUsedTick - entry->lastUsedTick) < 0) {
+                    entry = &g_tabProbeCache[i];
+                }
+            }
+        }
+        entry->hWnd = hWnd;
+        entry->rect = *rect;
+        entry->titleHash = titleHash;
+        queue = 1;
+    }
+
+    if (queue) {
+        entry->state = TAB_PROBE_PENDING;
+        entry->serial++;
+    }
+    entry->lastUsedTick = nowTick;
+    LeaveCriticalSection(&g_tabProbeLock);
+
+    if (queue) SetEvent(g_tabProbe->hWakeEvent);
+    return result;
+}
+#endif
+
+#if OLED_FEATURE_MEDIA_SESSIONS
+// ---------------------------------------------------------------------------
+// System media transport control sessions
+//
+// Apps that show up in the Windows media flyout publish whether they are
+// playing, and whether it is video or music, through the global SMTC session
+// manager. With mediaSessionDetection, a worker thread subscribes to session
+// and playback changes, maps each session's source app to the processes
+// owning its windows and publishes a small snapshot. The window scan then
+// takes that state as exact for those processes instead of combining audio
+// peaks, grace periods and title hints; apps without a session keep the
+// existing path.
+//
+// Chromium reports every session as music and shares one session between
+// all tabs, so for browsers only "playing video" is taken from the session,
+// and only as "some window of this browser plays video": the title hints or
+// the tab probe still pick the window. Anything else falls back to the
+// heuristics.
+//
+// Sessions stay subscribed, and their window processes cached, across
+// refreshes: a playback change only re-reads the playback state. The session
+// list is diffed when it changes, and the processes are re-mapped every
+// SMTC_REMATCH_MS (an app may open more windows).
+//
+// Event handler objects are static. If the runtime rejects them, for the
+// manager or for any single session, the worker re-reads the sessions every
+// SMTC_POLL_MS instead.
+// ---------------------------------------------------------------------------
+
+typedef __x_ABI_CWindows_CMedia_CControl_CIGlobalSystemMediaTransportControlsSessionManagerStatics SmtcManagerStatics;
+typedef __x_ABI_CWindows_CMedia_CControl_CIGlobalSystemMediaTransportControlsSessionManager SmtcManager;
+typedef __x_ABI_CWindows_CMedia_CControl_CIGlobalSystemMediaTransportControlsSession SmtcSession;
+typedef __x_ABI_CWindows_CMedia_CControl_CIGlobalSystemMediaTransportControlsSessionPlaybackInfo SmtcPlaybackInfo;
+typedef __FIAsyncOperation_1_Windows__CMedia__CControl__CGlobalSystemMediaTransportControlsSessionManager SmtcManagerOperation;
+typedef __FIVectorView_1_Windows__CMedia__CControl__CGlobalSystemMediaTransportControlsSession SmtcSessionList;
+typedef __FITypedEventHandler_2_Windows__CMedia__CControl__CGlobalSystemMediaTransportControlsSessionManager_Windows__CMedia__CControl__CSessionsChangedEventArgs SmtcSessionsChangedHandler;
+typedef __FITypedEventHandler_2_Windows__CMedia__CControl__CGlobalSystemMediaTransportControlsSession_Windows__CMedia__CControl__CPlaybackInfoChangedEventArgs SmtcPlaybackChangedHandler;
+
+#define SMTC_STATE_UNKNOWN  -1          // No session, or not exact: use the heuristics
+#define SMTC_STATE_IDLE     0           // Paused, stopped or music
+#define SMTC_STATE_VIDEO    1           // Playing video
+#define SMTC_STATE_BROWSER_VIDEO 2      // A browser plays video in one of its windows
+
+typedef struct {
+    int state;
+    DWORD pids[SMTC_MAX_SESSION_PIDS];  // Processes owning the app's top-level windows
+    int pidCount;
+} SmtcSessionState;
+
+typedef struct {
+    SmtcSessionState sessions[SMTC_MAX_SESSIONS];
+    int sessionCount;
+} SmtcSnapshot;
+
+// Written by the worker under g_smtcLock, copied by the timer thread per scan
+static SmtcSnapshot g_smtcPublished;
+static volatile LONG g_smtcGeneration = 0;
+static SmtcSnapshot g_smtcScan;         // Timer thread's copy for the current scan
+static CRITICAL_SECTION g_smtcLock;
+static int g_smtcLockReady = 0;
+static HANDLE g_hSmtcThread = NULL;
+static HANDLE g_hSmtcStopEvent = NULL;
+static HANDLE g_hSmtcWakeEvent = NULL;
+static volatile LONG g_smtcFailed = 0;
+static LONG g_smtcRefreshCount = 0;
+static LONG g_smtcEventDriven = 0;
+
+static volatile LONG g_smtcSessionsChanged = 0;
+
+// Worker-only subscription state
+typedef struct {
+    SmtcSession* session;
+    IUnknown* identity;                 // Compared to find the session in a new list
+    EventRegistrationToken token;       // 0 = playback changes not subscribed
+    SmtcSessionState windows;           // Window processes; state is read per refresh
+    int isBrowser;
+} SmtcSubscription;
+
+static SmtcSubscription g_smtcSubscriptions[SMTC_MAX_SESSIONS];
+static int g_smtcSubscriptionCount = 0;
+
+typedef struct SmtcHandlerVtbl SmtcHandlerVtbl;
+
+typedef struct {
+    const SmtcHandlerVtbl* lpVtbl;
+    volatile LONG* changed;             // Set on each event, if not NULL
+} SmtcHandler;
+
+static HRESULT STDMETHODCALLTYPE SmtcHandlerQueryInterface(IUnknown* This, REFIID riid, void** ppv) {
+    // Agile: invoked directly on the runtime's thread, which only sets an event
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_SmtcAgileObject) ||
+        IsEqualIID(riid, &IID_SmtcSessionsChangedHandler) || IsEqualIID(riid, &IID_SmtcPlaybackChangedHandler)) {
+        *ppv = This;
+        return S_OK;
+    }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE SmtcHandlerAddRef(IUnknown* This) {
+    (void)This;
+    return 1;
+}
+
+static ULONG STDMETHODCALLTYPE SmtcHandlerRelease(IUnknown* This) {
+    (void)This;
+    return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE SmtcHandlerInvoke(IUnknown* This, IInspectable* sender, IInspectable* args) {
+    (void)sender; (void)args;
+    SmtcHandler* handler = (SmtcHandler*)This;
+    if (handler->changed) InterlockedExchange(handler->changed, 1);
+    if (g_hSmtcWakeEvent) SetEvent(g_hSmtcWakeEvent);
+    return S_OK;
+}
+
+// Both TypedEventHandler delegates share this layout: IUnknown plus Invoke
+struct SmtcHandlerVtbl {
+    HRESULT (STDMETHODCALLTYPE* QueryInterface)(IUnknown*, REFIID, void**);
+    ULONG (STDMETHODCALLTYPE* AddRef)(IUnknown*);
+    ULONG (STDMETHODCALLTYPE* Release)(IUnknown*);
+    HRESULT (STDMETHODCALLTYPE* Invoke)(IUnknown*, IInspectable*, IInspectable*);
+};
+
+static const SmtcHandlerVtbl g_smtcHandlerVtbl = {
+    SmtcHandlerQueryInterface,
+    SmtcHandlerAddRef,
+    SmtcHandlerRelease,
+    SmtcHandlerInvoke
+};
+static SmtcHandler g_smtcSessionsHandler = { &g_smtcHandlerVtbl, &g_smtcSessionsChanged };
+static SmtcHandler g_smtcPlaybackHandler = { &g_smtcHandlerVtbl, NULL };
+
+// Wait for the manager request without a completion handler; the worker
+// has nothing else to do meanwhile.
+SmtcManager* RequestSmtcManager() {
+    HSTRING className = NULL;
+    static const WCHAR name[] = L"Windows.Media.Control.GlobalSystemMediaTransportControlsSessionManager";
+    if (FAILED(WindowsCreateString(name, (UINT32)(sizeof(name) / sizeof(name[0]) - 1), &className))) {
+        return NULL;
+    }
+
+    SmtcManagerStatics* pStatics = NULL;
+    HRESULT hr = RoGetActivationFactory(className, &IID_SmtcManagerStatics, (void**)&pStatics);
+    WindowsDeleteString(className);
+    if (FAILED(hr) || !pStatics) {
+        LogMessage("Media sessions: RoGetActivationFactory failed hr=0x%08X", (unsigned)hr);
+        return NULL;
+    }
+
+    SmtcManagerOperation* pOperation = NULL;
+    SmtcManager* pManager = NULL;
+    hr = pStatics->lpVtbl->RequestAsync(pStatics, &pOperation);
+    pStatics->lpVtbl->Release(pStatics);
+    if (FAILED(hr) || !pOperation) {
+        LogMessage("Media sessions: RequestAsync failed hr=0x%08X", (unsigned)hr);
+        return NULL;
+    }
+
+    __x_ABI_CWindows_CFoundation_CIAsyncInfo* pInfo = NULL;
+    if (SUCCEEDED(pOperation->lpVtbl->QueryInterface(pOperation, &IID_SmtcAsyncInfo, (void**)&pInfo)) && pInfo) {
+        AsyncStatus status = Started;
+        DWORD startTick = GetTickCount();
+        while (SUCCEEDED(pInfo->lpVtbl->get_Status(pInfo, &status)) && status == Started &&
+               (DWORD)(GetTickCount() - startTick) < SMTC_REQUEST_TIMEOUT_MS) {
+            if (WaitForSingleObject(g_hSmtcStopEvent, 10) == WAIT_OBJECT_0) break;
+        }
+        if (status == Completed) {
+            pOperation->lpVtbl->GetResults(pOperation, &pManager);
+        } else {
+            pInfo->lpVtbl->Cancel(pInfo);
+            LogMessage("Media sessions: manager request did not complete (status=%d)", (int)status);
+        }
+        pInfo->lpVtbl->Release(pInfo);
+    }
+    pOperation->lpVtbl->Release(pOperation);
+    return pManager;
+}
+
+void ReleaseSmtcSubscription(SmtcSubscription* subscription) {
+    SmtcSession* pSession = subscription->session;
+    if (subscription->token.value) {
+        pSession->lpVtbl->remove_PlaybackInfoChanged(pSession, subscription->token);
+    }
+    if (subscription->identity) subscription->identity->lpVtbl->Release(subscription->identity);
+    pSession->lpVtbl->Release(pSession);
+}
+
+void UnsubscribeSmtcSessions() {
+    for (int i = 0; i < g_smtcSubscriptionCount; i++) {
+        ReleaseSmtcSubscription(&g_smtcSubscriptions[i]);
+    }
+    g_smtcSubscriptionCount = 0;
+}
+
+// Exact state of one session, given whether its app is a browser.
+int ReadSmtcSessionState(SmtcSession* pSession, int isBrowser) {
+    SmtcPlaybackInfo* pInfo = NULL;
+    if (FAILED(pSession->lpVtbl->GetPlaybackInfo(pSession, &pInfo)) || !pInfo) {
+        return SMTC_STATE_UNKNOWN;
+    }
+
+    __x_ABI_CWindows_CMedia_CControl_CGlobalSystemMediaTransportControlsSessionPlaybackStatus status =
+        GlobalSystemMediaTransportControlsSessionPlaybackStatus_Closed;
+    __x_ABI_CWindows_CMedia_CMediaPlaybackType type = MediaPlaybackType_Unknown;
+    pInfo->lpVtbl->get_PlaybackStatus(pInfo, &status);
+    __FIReference_1_Windows__CMedia__CMediaPlaybackType* pType = NULL;
+    if (SUCCEEDED(pInfo->lpVtbl->get_PlaybackType(pInfo, &pType)) && pType) {
+        pType->lpVtbl->get_Value(pType, &type);
+        pType->lpVtbl->Release(pType);
+    }
+    pInfo->lpVtbl->Release(pInfo);
+
+    int playing = status == GlobalSystemMediaTransportControlsSessionPlaybackStatus_Playing;
+    if (playing && type == MediaPlaybackType_Video) return isBrowser ? SMTC_STATE_BROWSER_VIDEO : SMTC_STATE_VIDEO;
+    if (isBrowser) return SMTC_STATE_UNKNOWN;
+    if (!playing || type == MediaPlaybackType_Music) return SMTC_STATE_IDLE;
+    return SMTC_STATE_UNKNOWN;
+}
+
+typedef struct {
+    const WCHAR* sourceId;              // Session's source AppUserModelID
+    SmtcSessionState* session;
+    int isBrowser;
+} SmtcWindowMatch;
+
+// Does the window belong to the session's source app? Win32 apps report an
+// explicit window AppUserModelID (Firefox, Chromium) or their exe name.
+BOOL CALLBACK SmtcMatchWindowCallback(HWND hWnd, LPARAM lParam) {
+    SmtcWindowMatch* match = (SmtcWindowMatch*)lParam;
+    if (!IsWindowVisible(hWnd) || GetWindow(hWnd, GW_OWNER) != NULL) return TRUE;
+
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hWnd, &pid);
+    if (pid == 0 || ContainsPid(match->session->pids, match->session->pidCount, pid)) return TRUE;
+
+    char exe[MAX_PATH] = {0};
+    GetProcessNameFromPid(pid, exe, sizeof(exe));
+
+    int matched = 0;
+    IPropertyStore* pStore = NULL;
+    if (SUCCEEDED(SHGetPropertyStoreForWindow(hWnd, &IID_IPropertyStore, (void**)&pStore)) && pStore) {
+        PROPVARIANT value;
+        PropVariantInit(&value);
+        if (SUCCEEDED(pStore->lpVtbl->GetValue(pStore, &PKEY_AppUserModel_ID, &value)) &&
+            value.vt == VT_LPWSTR && value.pwszVal) {
+            matched = _wcsicmp(value.pwszVal, match->sourceId) == 0;
+        }
+        PropVariantClear(&value);
+        pStore->lpVtbl->Release(pStore);
+    }
+
+    if (!matched && exe[0]) {
+        // "vlc.exe" or "vlc"
+        WCHAR wexe[MAX_PATH];
+        int length = 0;
+        for (; exe[length]; length++) wexe[length] = (WCHAR)(BYTE)exe[length];
+        wexe[length] = L'\0';
+        int stem = length > 4 ? length - 4 : length;
+        matched = _wcsicmp(wexe, match->sourceId) == 0 ||
+                  ((int)wcslen(match->sourceId) == stem && _wcsnicmp(wexe, match->sourceId, stem) == 0);
+    }
+
+    if (matched) {
+        AddUniquePid(match->session->pids, &match->session->pidCount, SMTC_MAX_SESSION_PIDS, pid);
+        match->isBrowser |= IsKnownBrowserProcess(exe);
+    }
+    return TRUE;
+}
+
+// Map the session's source app to the processes owning its windows.
+void MatchSmtcSessionWindows(SmtcSubscription* subscription) {
+    SmtcSession* pSession = subscription->session;
+    memset(&subscription->windows, 0, sizeof(subscription->windows));
+    subscription->isBrowser = 0;
+
+    HSTRING sourceId = NULL;
+    if (FAILED(pSession->lpVtbl->get_SourceAppUserModelId(pSession, &sourceId)) || !sourceId) return;
+
+    SmtcWindowMatch match = { WindowsGetStringRawBuffer(sourceId, NULL), &subscription->windows, 0 };
+    EnumWindows(SmtcMatchWindowCallback, (LPARAM)&match);
+    WindowsDeleteString(sourceId);
+    subscription->isBrowser = match.isBrowser;
+}
+
+// Diff the manager's session list against the subscriptions: sessions still
+// listed keep their subscription and window processes, new ones are
+// subscribed and matched, and gone ones are released. Returns 1 if every
+// session's playback changes are subscribed.
+int UpdateSmtcSessionList(SmtcManager* pManager) {
+    SmtcSubscription updated[SMTC_MAX_SESSIONS];
+    int updatedCount = 0;
+    int kept[SMTC_MAX_SESSIONS] = {0};
+
+    SmtcSessionList* pList = NULL;
+    if (FAILED(pManager->lpVtbl->GetSessions(pManager, &pList)) || !pList) {
+        return g_smtcSubscriptionCount == 0;
+    }
+
+    unsigned int count = 0;
+    pList->lpVtbl->get_Size(pList, &count);
+    for (unsigned int i = 0; i < count && updatedCount < SMTC_MAX_SESSIONS; i++) {
+        SmtcSession* pSession = NULL;
+        if (FAILED(pList->lpVtbl->GetAt(pList, i, &pSession)) || !pSession) continue;
+
+        IUnknown* identity = NULL;
+        pSession->lpVtbl->QueryInterface(pSession, &IID_IUnknown, (void**)&identity);
+
+        int existing = -1;
+        for (int j = 0; identity && j < g_smtcSubscriptionCount; j++) {
+            if (!kept[j] && g_smtcSubscriptions[j].identity == identity) {
+                existing = j;
+                break;
+            }
+        }
+        if (existing >= 0) {
+            kept[existing] = 1;
+            updated[updatedCount++] = g_smtcSubscriptions[existing];
+            identity->lpVtbl->Release(identity);
+            pSession->lpVtbl->Release(pSession);
+            continue;
+        }
+
+        SmtcSubscription* subscription = &updated[updatedCount++];
+        memset(subscription, 0, sizeof(*subscription));
+        subscription->session = pSession;
+        subscription->identity = identity;
+        if (FAILED(pSession->lpVtbl->add_PlaybackInfoChanged(pSession, (SmtcPlaybackChangedHandler*)&g_smtcPlaybackHandler,
+                                                             &subscription->token))) {
+            subscription->token.value = 0;
+        }
+        MatchSmtcSessionWindows(subscription);
+    }
+    pList->lpVtbl->Release(pList);
+
+    for (int j = 0; j < g_smtcSubscriptionCount; j++) {
+        if (!kept[j]) ReleaseSmtcSubscription(&g_smtcSubscriptions[j]);
+    }
+    memcpy(g_smtcSubscriptions, updated, updatedCount * sizeof(updated[0]));
+    g_smtcSubscriptionCount = updatedCount;
+
+    int allSubscribed = 1;
+    for (int i = 0; i < g_smtcSubscriptionCount; i++) {
+        if (!g_smtcSubscriptions[i].token.value) allSubscribed = 0;
+    }
+    return allSubscribed;
+}
+
+// Re-read the playback state of the subscribed sessions and publish.
+void PublishSmtcSessions() {
+    SmtcSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    for (int i = 0; i < g_smtcSubscriptionCount; i++) {
+        SmtcSubscription* subscription = &g_smtcSubscriptions[i];
+        if (subscription->windows.pidCount == 0) continue;
+
+        SmtcSessionState* state = &snapshot.sessions[snapshot.sessionCount++];
+        *state = subscription->windows;
+        state->state = ReadSmtcSessionState(subscription->session, subscription->isBrowser);
+    }
+
+    EnterCriticalSection(&g_smtcLock);
+    g_smtcPublished = snapshot;
+    LeaveCriticalSection(&g_smtcLock);
+    InterlockedIncrement(&g_smtcGeneration);
+    InterlockedIncrement(&g_smtcRefreshCount);
+}
+
+DWORD WINAPI SmtcThread(LPVOID param) {
+    (void)param;
+    if (FAILED(RoInitialize(RO_INIT_MULTITHREADED))) {
+        InterlockedExchange(&g_smtcFailed, 1);
+        return 1;
+    }
+
+    SmtcManager* pManager = RequestSmtcManager();
+    if (!pManager) {
+        InterlockedExchange(&g_smtcFailed, 1);
+        RoUninitialize();
+        return 1;
+    }
+
+    EventRegistrationToken sessionsToken = {0};
+    HRESULT hr = pManager->lpVtbl->add_SessionsChanged(pManager, (SmtcSessionsChangedHandler*)&g_smtcSessionsHandler,
+                                                       &sessionsToken);
+    int sessionsSubscribed = SUCCEEDED(hr);
+    if (!sessionsSubscribed) {
+        LogMessage("Media sessions: event subscription failed hr=0x%08X, polling every %d ms",
+                   (unsigned)hr, SMTC_POLL_MS);
+    }
+
+    // A session whose playback changes can't be subscribed would go stale
+    // until the session list changes, so any failure means polling
+    HANDLE handles[2] = { g_hSmtcStopEvent, g_hSmtcWakeEvent };
+    int lastEventDriven = 1;
+    int allSubscribed = 0;
+    DWORD matchTick = GetTickCount();
+    InterlockedExchange(&g_smtcSessionsChanged, 1);
+    do {
+        // Polling can't tell what changed: re-read the list (still diffed)
+        if (InterlockedExchange(&g_smtcSessionsChanged, 0) || !g_smtcEventDriven) {
+            allSubscribed = UpdateSmtcSessionList(pManager);
+        }
+        if ((DWORD)(GetTickCount() - matchTick) >= SMTC_REMATCH_MS) {
+            for (int i = 0; i < g_smtcSubscriptionCount; i++) {
+                MatchSmtcSessionWindows(&g_smtcSubscriptions[i]);
+            }
+            matchTick = GetTickCount();
+        }
+        PublishSmtcSessions();
+
+        int eventDriven = allSubscribed && sessionsSubscribed;
+        if (sessionsSubscribed && !eventDriven && lastEventDriven) {
+            LogMessage("Media sessions: playback subscription failed, polling every %d ms", SMTC_POLL_MS);
+        }
+        lastEventDriven = eventDriven;
+        InterlockedExchange(&g_smtcEventDriven, eventDriven);
+    } while (WaitForMultipleObjects(2, handles, FALSE, g_smtcEventDriven ? INFINITE : SMTC_POLL_MS) != WAIT_OBJECT_0);
+
+    UnsubscribeSmtcSessions();
+    if (sessionsSubscribed) {
+        pManager->lpVtbl->remove_SessionsChanged(pManager, sessionsToken);
+    }
+    pManager->lpVtbl->Release(pManager);
+    RoUninitialize();
+    return 0;
+}
+
+int StartSmtcWatcher() {
+    if (g_hSmtcThread) return 1;
+    if (g_smtcFailed) return 0;
+
+    if (!g_smtcLockReady) {
+        InitializeCriticalSection(&g_smtcLock);
+        g_smtcLockReady = 1;
+    }
+    g_hSmtcStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    g_hSmtcWakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (g_hSmtcStopEvent && g_hSmtcWakeEvent) {
+        g_hSmtcThread = CreateThread(NULL, 0, SmtcThread, NULL, 0, NULL);
+    }
+    if (!g_hSmtcThread) {
+        if (g_hSmtcStopEvent) CloseHandle(g_hSmtcStopEvent);
+        if (g_hSmtcWakeEvent) CloseHandle(g_hSmtcWakeEvent);
+        g_hSmtcStopEvent = NULL;
+        g_hSmtcWakeEvent = NULL;
+        InterlockedExchange(&g_smtcFailed, 1);
+        return 0;
+    }
+    LogMessage("Media sessions: watcher started");
+    return 1;
+}
+
+void StopSmtcWatcher() {
+    if (g_hSmtcThread) {
+        SetEvent(g_hSmtcStopEvent);
+        // Unsubscribing can wait for a handler in flight; if the thread is
+        // stuck, leave its events open rather than close what it waits on
+        if (WaitForSingleObject(g_hSmtcThread, SMTC_REQUEST_TIMEOUT_MS) == WAIT_OBJECT_0) {
+            CloseHandle(g_hSmtcStopEvent);
+            CloseHandle(g_hSmtcWakeEvent);
+        } else {
+            LogMessage("Media sessions: watcher did not stop in time");
+        }
+        CloseHandle(g_hSmtcThread);
+        g_hSmtcThread = NULL;
+        g_hSmtcStopEvent = NULL;
+        g_hSmtcWakeEvent = NULL;
+    }
+    if (g_smtcLockReady) {
+        EnterCriticalSection(&g_smtcLock);
+        memset(&g_smtcPublished, 0, sizeof(g_smtcPublished));
+        LeaveCriticalSection(&g_smtcLock);
+    }
+    memset(&g_smtcScan, 0, sizeof(g_smtcScan));
+    InterlockedIncrement(&g_smtcGeneration);
+    InterlockedExchange(&g_smtcFailed, 0);
+}
+
+// Timer thread, once per scan: copy the worker's latest snapshot. Returns 1
+// if it changed since the last call.
+int TakeSmtcSnapshot() {
+    static LONG lastGeneration = 0;
+    if (!g_app.config.mediaSessionDetection || !StartSmtcWatcher()) {
+        g_smtcScan.sessionCount = 0;
+        return 0;
+    }
+
+    LONG generation = g_smtcGeneration;
+    if (generation == lastGeneration) return 0;
+    EnterCriticalSection(&g_smtcLock);
+    g_smtcScan = g_smtcPublished;
+    LeaveCriticalSection(&g_smtcLock);
+    lastGeneration = generation;
+    return 1;
+}
+
+int GetSmtcProcessState(DWORD pid) {
+    for (int i = 0; i < g_smtcScan.sessionCount; i++) {
+        if (ContainsPid(g_smtcScan.sessions[i].pids, g_smtcScan.sessions[i].pidCount, pid)) {
+            return g_smtcScan.sessions[i].state;
+        }
+    }
+    return SMTC_STATE_UNKNOWN;
+}
+
+int AnySmtcVideoPlaying() {
+    for (int i = 0; i < g_smtcScan.sessionCount; i++) {
+        if (g_smtcScan.sessions[i].state >= SMTC_STATE_VIDEO) return 1;
+    }
+    return 0;
+}
+
+// Returns 1 if every audible process is one whose session state is exact:
+// their windows have been classified already, so the audio alone must not
+// trigger the block-all fallback (e.g. a music app playing).
+int AllAudioActiveHaveSmtcState(const MediaEnumContext* ctx) {
+    if (!ctx->useProcessTree || ctx->audioRootCount == 0) return 0;
+    for (int i = 0; i < ctx->audioRootCount; i++) {
+        // A browser's session doesn't say which window plays
+        int state = GetSmtcProcessState(ctx->audioRootPids[i]);
+        if (state == SMTC_STATE_UNKNOWN || state == SMTC_STATE_BROWSER_VIDEO) return 0;
+    }
+    return 1;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Window back-off
+//
+// Interrogating a window never sends it a message: titles are read with
+// InternalGetWindowText, and the other calls only read state that win32k
+// and DWM keep themselves. A call can still be slow, e.g. opening a process
+// that is being torn down. An interrogation that took longer than
+// SLOW_WINDOW_US, or found the window's thread hung (IsHungAppWindow, which
+// doesn't wait), is a strike. The wall time of one call also includes being
+// preempted, so only SLOW_WINDOW_STRIKES strikes in a row back the window
+// off: it is skipped for WINDOW_BACKOFF_BASE_MS, doubled with each further
+// strike up to WINDOW_BACKOFF_MAX_MS. Each scan also stops after
+// WINDOW_SCAN_BUDGET_MS. A skipped or hung window isn't known not to show
+// media, so the scan keeps the monitors that had media last time.
+// The table is written on the timer thread only, and pool workers read it,
+// possibly while the timer thread reduces an earlier slot: both sides hold
+// g_windowBackoffLock (shared for reads) for the lookup only.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    HWND hWnd;                          // NULL = free
+    int strikes;                        // Slow interrogations in a row
+    DWORD untilTick;
+} WindowBackoff;
+
+static WindowBackoff g_windowBackoff[MAX_WINDOW_BACKOFF];
+static SRWLOCK g_windowBackoffLock = SRWLOCK_INIT;
+static int g_slowWindowCount = 0;       // Interrogations that earned a strike
+static int g_skippedWindowCount = 0;    // Windows skipped: backed off, hung or over budget
+static int g_windowBudgetStops = 0;     // Scans cut short by the budget
+
+WindowBackoff* FindWindowBackoff(HWND hWnd) {
+    for (int i = 0; i < MAX_WINDOW_BACKOFF; i++) {
+        if (g_windowBackoff[i].hWnd == hWnd) return &g_windowBackoff[i];
+    }
+    return NULL;
+}
+
+int IsWindowBackedOff(HWND hWnd) {
+    AcquireSRWLockShared(&g_windowBackoffLock);
+    const WindowBackoff* entry = FindWindowBackoff(hWnd);
+    int backedOff = entry && (LONG)(entry->untilTick - GetTickCount()) > 0;
+    ReleaseSRWLockShared(&g_windowBackoffLock);
+    return backedOff;
+}
+
+void RecordWindowCost(HWND hWnd, LONGLONG costUs, int hung) {
+    int slow = hung || costUs >= SLOW_WINDOW_US;
+    // Fast path: most windows are fast and were never slow
+    AcquireSRWLockShared(&g_windowBackoffLock);
+    int known = FindWindowBackoff(hWnd) != NULL;
+    ReleaseSRWLockShared(&g_windowBackoffLock);
+    if (!slow && !known) return;
+
+    AcquireSRWLockExclusive(&g_windowBackoffLock);
+    WindowBackoff* entry = FindWindowBackoff(hWnd);
+    if (!slow) {
+        if (entry) entry->hWnd = NULL;  // Recovered
+        ReleaseSRWLockExclusive(&g_windowBackoffLock);
+        return;
+    }
+
+    if (!entry) {
+        // Take a free slot, else the one whose back-off ends first
+        entry = &g_windowBackoff[0];
+        for (int i = 0; i < MAX_WINDOW_BACKOFF && entry->hWnd; i++) {
+            if (!g_windowBackoff[i].hWnd ||
+                (LONG)(g_windowBackoff[i].untilTick - entry->untilTick) < 0) {
+                entry = &g_windowBackoff[i];
+            }
+        }
+        entry->hWnd = hWnd;
+        entry->strikes = 0;
+        entry->untilTick = GetTickCount();
+    }
+
+    int strikes = ++entry->strikes;
+    g_slowWindowCount++;
+    if (strikes < SLOW_WINDOW_STRIKES) {
+        ReleaseSRWLockExclusive(&g_windowBackoffLock);
+        return;
+    }
+
+    int doublings = strikes - SLOW_WINDOW_STRIKES;
+    DWORD backoffMs = WINDOW_BACKOFF_MAX_MS;
+    if (doublings < 16 && ((DWORD)WINDOW_BACKOFF_BASE_MS << doublings) < WINDOW_BACKOFF_MAX_MS) {
+        backoffMs = (DWORD)WINDOW_BACKOFF_BASE_MS << doublings;
+    }
+    entry->untilTick = GetTickCount() + backoffMs;
+    ReleaseSRWLockExclusive(&g_windowBackoffLock);
+    LogMessage("Window scan: %s window %p (%lldus, strike %d): skipping for %lums",
+               hung ? "hung" : "slow", (void*)hWnd, costUs, strikes, (unsigned long)backoffMs);
+}
+
+// GetWindowTextA sends WM_GETTEXT to windows of this process, and callers
+// can't tell which windows those are; InternalGetWindowText never sends.
+void GetWindowTitleNoWait(HWND hWnd, char* title, int titleSize) {
+    WCHAR wideTitle[512];
+    title[0] = '\0';
+    if (InternalGetWindowText(hWnd, wideTitle, ARRAYSIZE(wideTitle)) > 0) {
+        WideCharToMultiByte(CP_ACP, 0, wideTitle, -1, title, titleSize, NULL, NULL);
+        title[titleSize - 1] = '\0';
+    }
+}
+
+// What a scan needs to know about one top-level window
+typedef struct {
+    HWND hWnd;
+    DWORD pid;
+    RECT rect;
+    LONGLONG costUs;
+    int hung;
+    int backedOff;
+} MediaWindowFacts;
+
+// The window's own state: no scan state is touched, so this can run on any
+// thread. Returns 0 if the window can't show media.
+int InterrogateWindowState(MediaWindowFacts* window) {
+    HWND hWnd = window->hWnd;
+    if (!IsWindowVisible(hWnd) || IsIconic(hWnd) || IsWindowCloakedCompat(hWnd)) {
+        return 0;
+    }
+
+    // A hung window's state can't be read safely: the caller keeps what the
+    // previous scan found
+    if (IsHungAppWindow(hWnd)) {
+        window->hung = 1;
+        return 0;
+    }
+
+    LONG_PTR exStyle = GetWindowLongPtr(hWnd, GWL_EXSTYLE);
+    if ((exStyle & WS_EX_TOOLWINDOW) != 0) {
+        return 0;
+    }
+
+    if (!GetVisibleWindowRect(hWnd, &window->rect)) {
+        return 0;
+    }
+
+    if (RectArea(&window->rect) <= 0) {
+        return 0;
+    }
+
+    window->pid = 0;
+    GetWindowThreadProcessId(hWnd, &window->pid);
+    return 1;
+}
+
+// Interrogates the window unless it is backed off, timing the calls. Safe on
+// any thread.
+int InterrogateMediaWindow(MediaWindowFacts* window) {
+    window->costUs = 0;
+    window->hung = 0;
+    window->backedOff = IsWindowBackedOff(window->hWnd);
+    if (window->backedOff) {
+        return 0;
+    }
+
+    LONGLONG startUs = GetTimestampUs();
+    int usable = InterrogateWindowState(window);
+    window->costUs = GetTimestampUs() - startUs;
+    return usable;
+}
+
+// Timer thread: back off the window if it was slow, and count skips.
+void FinishWindowInterrogation(MediaEnumContext* ctx, const MediaWindowFacts* window) {
+    if (window->backedOff || window->hung) {
+        g_skippedWindowCount++;
+        ctx->windowsUnknown++;
+    }
+    if (!window->backedOff) {
+        RecordWindowCost(window->hWnd, window->costUs, window->hung);
+    }
+}
+
+// Timer thread only: marks the window's monitors in ctx if it shows media.
+void ClassifyMediaWindow(MediaEnumContext* ctx, const MediaWindowFacts* window) {
+    HWND hWnd = window->hWnd;
+    DWORD pid = window->pid;
+    RECT rect = window->rect;
+
+    int browserSessionVideo = 0;
+#if OLED_FEATURE_MEDIA_SESSIONS
+    // Apps with a media transport session report their state exactly
+    int sessionState = GetSmtcProcessState(pid);
+    if (sessionState == SMTC_STATE_VIDEO) {
+        MarkMediaWindowMonitors(ctx, &rect);
+        return;
+    }
+    // A browser's video counts as audible, even muted, but its windows still
+    // need a title hint or the tab probe
+    browserSessionVideo = sessionState == SMTC_STATE_BROWSER_VIDEO;
+#endif
+
+    char processName[MAX_PATH] = {0};
+    int captureActive;
+    int audioActive;
+    if (ctx->useProcessTree) {
+        // Only windows of a session's root process count. The PID test is
+        // cheap, and the name comes from the graph without opening the process.
+        captureActive = ContainsPid(ctx->captureRootPids, ctx->captureRootCount, pid);
+        audioActive = ContainsPid(ctx->audioRootPids, ctx->audioRootCount, pid) || browserSessionVideo;
+        if (!captureActive && !audioActive) {
+            return;
+        }
+        const ProcessNode* node = FindProcessNode(pid);
+        if (!node) {
+            return;
+        }
+        strncpy_s(processName, sizeof(processName), node->exe, _TRUNCATE);
+    } else {
+        // Without the process graph, only windows that passed the state
+        // checks cost a process open
+        if (!GetProcessNameFromHwnd(hWnd, processName, sizeof(processName))) {
+            return;
+        }
+
+        // Window processes that own no audio session were never interned
+        int nameId = FindProcessNameId(processName);
+        if (nameId < 0 && !browserSessionVideo) {
+            return;
+        }
+        captureActive = nameId >= 0 && TestProcessId(ctx->captureActiveIds, nameId);
+        audioActive = (nameId >= 0 && TestProcessId(ctx->audioActiveIds, nameId)) || browserSessionVideo;
+    }
+
+    // A process using the microphone is in a call (Teams, Zoom, WebRTC): its
+    // windows count as media whatever their title, even with quiet playback.
+    if (captureActive) {
+        MarkMediaWindowMonitors(ctx, &rect);
+        return;
+    }
+
+#if OLED_FEATURE_MEDIA_SESSIONS
+    // Paused, stopped or music: audio and title hints don't matter
+    if (sessionState == SMTC_STATE_IDLE) {
+        return;
+    }
+#endif
+
+    // A window only counts as media if its process is actually emitting audio.
+    if (!audioActive) {
+        return;
+    }
+
+    char title[512];
+    GetWindowTitleNoWait(hWnd, title, sizeof(title));
+
+    int matched = IsMediaCandidateWindow(processName, title);
+
+    // Collect diagnostic info for all browser windows with active audio,
+    // regardless of whether they matched a hint. This is logged once in
+    // UpdateMediaMonitorStates when the mask changes, so the user can see
+    // ALL browser windows (including the one playing video) without per-tick spam.
+    MediaDiagnostics* diag = &g_mediaDiagnostics;
+    if (ctx->collectDiagnostics && title[0] && IsKnownBrowserProcess(processName) &&
+        diag->browserWindowCount < MAX_BROWSER_WINDOW_INFO) {
+        int idx = diag->browserWindowCount++;
+        strncpy(diag->browserTitles[idx], title, 255);
+        diag->browserTitles[idx][255] = '\0';
+        diag->browserMatched[idx] = matched;
+    }
+
+#if OLED_FEATURE_TAB_PROBE
+    if (!matched && IsKnownBrowserProcess(processName) && BrowserWindowHasMediaTab(hWnd, &rect, title)) {
+        matched = 1;
+    }
+#endif
+
+    if (!matched) {
+        // Audible but unclassified (background tab, unknown player): motion
+        // detection samples just this window instead of the whole monitor.
+        RecordMotionCandidate(&rect);
+        return;
+    }
+
+    MarkMediaWindowMonitors(ctx, &rect);
+}
+
+BOOL CALLBACK EnumMediaWindowCallback(HWND hWnd, LPARAM lParam) {
+    MediaEnumContext* ctx = (MediaEnumContext*)lParam;
+    if (GetTimestampUs() >= ctx->deadlineUs) {
+        ctx->truncated = 1;
+        return FALSE;
+    }
+    ctx->windowsVisited++;
+
+    MediaWindowFacts window;
+    window.hWnd = hWnd;
+    int usable = InterrogateMediaWindow(&window);
+    FinishWindowInterrogation(ctx, &window);
+    if (usable) {
+        ClassifyMediaWindow(ctx, &window);
+    }
+    return TRUE;
+}
+
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN
+// ---------------------------------------------------------------------------
+// Parallel window interrogation
+//
+// With parallelWindowScan, a full scan first collects the top-level HWNDs
+// (EnumWindows only copies handles), then the per-window system calls in
+// InterrogateMediaWindow run on the process thread pool. Workers claim
+// windows with an interlocked counter and each fills only its own slot, so
+// no lock is taken. The timer thread works alongside them, then reduces the
+// slots in z-order with ClassifyMediaWindow, which touches the shared scan
+// state. Scans of fewer than PARALLEL_SCAN_MIN_WINDOWS windows stay on the
+// timer thread, where the dispatch would cost more than it saves.
+//
+// Windows not claimed before the scan budget runs out are skipped. Slots
+// still being filled when it does (a worker stuck in a call) are skipped and
+// backed off, and scans stay sequential until the worker returns. The
+// workers only read g_parallelScan and the back-off table (under its lock),
+// never the caller's context. A slot holds just what classification needs
+// (handle, PID, rectangle, cost); process names are looked up on the timer
+// thread.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    MediaWindowFacts windows[MAX_PARALLEL_SCAN_WINDOWS];
+    volatile LONG done[MAX_PARALLEL_SCAN_WINDOWS];
+    int usable[MAX_PARALLEL_SCAN_WINDOWS];     // -1 = skipped for the budget
+    int windowCount;
+    LONGLONG deadlineUs;
+    volatile LONG next;                 // Next unclaimed window
+    volatile LONG remaining;            // Windows not yet interrogated
+} ParallelWindowScan;
+
+static ParallelWindowScan g_parallelScan;
+static PTP_WORK g_parallelScanWork = NULL;
+static HANDLE g_parallelScanDone = NULL;
+static volatile LONG g_parallelScanBusy = 0;    // Workers inside the callback
+static int g_parallelScanWorkers = 0;
+static int g_parallelScanTimeouts = 0;
+
+BOOL CALLBACK CollectWindowHandleCallback(HWND hWnd, LPARAM lParam) {
+    ParallelWindowScan* scan = (ParallelWindowScan*)lParam;
+    if (scan->windowCount >= MAX_PARALLEL_SCAN_WINDOWS) {
+        scan->windowCount = -1;         // Overflow: scan sequentially
+        return FALSE;
+    }
+    scan->windows[scan->windowCount++].hWnd = hWnd;
+    return TRUE;
+}
+
+void InterrogateClaimedWindows(ParallelWindowScan* scan) {
+    for (;;) {
+        LONG i = InterlockedIncrement(&scan->next) - 1;
+        if (i >= scan->windowCount) break;
+        if (GetTimestampUs() >= scan->deadlineUs) {
+            scan->usable[i] = -1;
+        } else {
+            scan->usable[i] = InterrogateMediaWindow(&scan->windows[i]);
+        }
+        InterlockedExchange(&scan->done[i], 1);
+        if (InterlockedDecrement(&scan->remaining) == 0) {
+            SetEvent(g_parallelScanDone);
+        }
+    }
+}
+
+VOID CALLBACK ParallelScanWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) {
+    InterlockedIncrement(&g_parallelScanBusy);
+    InterrogateClaimedWindows(&g_parallelScan);
+    InterlockedDecrement(&g_parallelScanBusy);
+}
+
+int StartParallelWindowScan() {
+    if (g_parallelScanWork) return 1;
+
+    g_parallelScanDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!g_parallelScanDone) return 0;
+    g_parallelScanWork = CreateThreadpoolWork(ParallelScanWorkCallback, NULL, NULL);
+    if (!g_parallelScanWork) {
+        CloseHandle(g_parallelScanDone);
+        g_parallelScanDone = NULL;
+        return 0;
+    }
+
+    // The timer thread is one of the workers
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    g_parallelScanWorkers = ClampInt((int)info.dwNumberOfProcessors - 1, 0, MAX_PARALLEL_SCAN_WORKERS);
+    LogMessage("Parallel window scan: %d pool workers", g_parallelScanWorkers);
+    return 1;
+}
+
+void StopParallelWindowScan() {
+    if (!g_parallelScanWork) return;
+
+    // A worker stuck in a window call would block the wait: leak instead
+    if (g_parallelScanBusy == 0) {
+        WaitForThreadpoolWorkCallbacks(g_parallelScanWork, TRUE);
+        CloseThreadpoolWork(g_parallelScanWork);
+        CloseHandle(g_parallelScanDone);
+    }
+    g_parallelScanWork = NULL;
+    g_parallelScanDone = NULL;
+}
+
+// Returns 0 if the scan must fall back to EnumWindows.
+int ScanWindowsInParallel(MediaEnumContext* ctx) {
+    if (!g_app.config.parallelWindowScan || g_parallelScanBusy > 0 || !StartParallelWindowScan()) return 0;
+
+    // A worker queued by the previous scan may start late: keep it from
+    // claiming slots while they are being refilled
+    ParallelWindowScan* scan = &g_parallelScan;
+    InterlockedExchange(&scan->next, MAX_PARALLEL_SCAN_WINDOWS);
+    scan->windowCount = 0;
+    EnumWindows(CollectWindowHandleCallback, (LPARAM)scan);
+    if (scan->windowCount < 0) return 0;
+
+    ctx->windowsVisited = scan->windowCount;
+    if (scan->windowCount < PARALLEL_SCAN_MIN_WINDOWS || g_parallelScanWorkers == 0) {
+        for (int i = 0; i < scan->windowCount; i++) {
+            if (GetTimestampUs() >= ctx->deadlineUs) {
+                g_skippedWindowCount += scan->windowCount - i;
+                ctx->truncated = 1;
+                break;
+            }
+            MediaWindowFacts* window = &scan->windows[i];
+            int usable = InterrogateMediaWindow(window);
+            FinishWindowInterrogation(ctx, window);
+            if (usable) {
+                ClassifyMediaWindow(ctx, window);
+            }
+        }
+        return 1;
+    }
+
+    scan->deadlineUs = ctx->deadlineUs;
+    memset((void*)scan->done, 0, scan->windowCount * sizeof(scan->done[0]));
+    scan->remaining = scan->windowCount;
+    ResetEvent(g_parallelScanDone);
+    InterlockedExchange(&scan->next, 0);
+
+    int workers = g_parallelScanWorkers;
+    if (workers > scan->windowCount / PARALLEL_SCAN_MIN_WINDOWS) {
+        workers = scan->windowCount / PARALLEL_SCAN_MIN_WINDOWS;
+    }
+    for (int i = 0; i < workers; i++) {
+        SubmitThreadpoolWork(g_parallelScanWork);
+    }
+    InterrogateClaimedWindows(scan);
+    LONGLONG waitUs = ctx->deadlineUs - GetTimestampUs();
+    DWORD waitMs = waitUs > 0 ? (DWORD)(waitUs / 1000) + 1 : 0;
+    if (WaitForSingleObject(g_parallelScanDone, waitMs) != WAIT_OBJECT_0) {
+        g_parallelScanTimeouts++;
+        LogMessage("Parallel window scan: %ld windows still being interrogated after %dms",
+                   scan->remaining, WINDOW_SCAN_BUDGET_MS);
+    }
+
+    LONGLONG elapsedUs = GetTimestampUs() - (ctx->deadlineUs - WINDOW_SCAN_BUDGET_MS * 1000LL);
+    for (int i = 0; i < scan->windowCount; i++) {
+        MediaWindowFacts* window = &scan->windows[i];
+        if (!scan->done[i]) {
+            RecordWindowCost(window->hWnd, elapsedUs, 1);
+            g_skippedWindowCount++;
+            ctx->windowsUnknown++;
+        } else if (scan->usable[i] < 0) {
+            g_skippedWindowCount++;
+            ctx->truncated = 1;
+        } else {
+            FinishWindowInterrogation(ctx, window);
+            if (scan->usable[i]) {
+                ClassifyMediaWindow(ctx, window);
+            }
+        }
+    }
+    return 1;
+}
+#endif
+
+
+// ---------------------------------------------------------------------------
+// Window lookup strategy
+//
+// Only windows of a few processes can be media: session root processes,
+// plus apps whose media session reports video. EnumWindows visits every
+// top-level window to find them. When the process graph resolved the
+// sessions and there are at most PID_TARGETED_MAX_PROCESSES such processes,
+// their threads' windows are enumerated directly (EnumThreadWindows) instead.
+// The thread IDs come from a Toolhelp thread snapshot, which lists every
+// thread on the system and is the expensive part, so it is kept until the
+// target set changes or it is TARGET_THREAD_REFRESH_MS old. With more
+// processes, or when the snapshot overflows, the full scan is used. Both
+// strategies are timed for --stats.
+// ---------------------------------------------------------------------------
+
+#define WINDOW_SCAN_FULL        0
+#define WINDOW_SCAN_TARGETED    1
+#define WINDOW_SCAN_PARALLEL    2
+#define WINDOW_SCAN_SLICED      3
+#define WINDOW_SCAN_STRATEGIES  4
+
+static DWORD g_targetPids[PID_TARGETED_MAX_PROCESSES];
+static int g_targetPidCount = 0;
+static DWORD g_targetThreads[MAX_TARGETED_THREADS];
+static int g_targetThreadCount = -1;    // -1 = no snapshot
+static DWORD g_targetThreadTick = 0;
+static int g_threadSnapshotCount = 0;
+static int g_windowScanCount[WINDOW_SCAN_STRATEGIES] = {0};
+static LONGLONG g_windowScanTotalUs[WINDOW_SCAN_STRATEGIES] = {0};
+static LONGLONG g_windowScanLastUs[WINDOW_SCAN_STRATEGIES] = {0};
+static int g_windowScanLastWindows[WINDOW_SCAN_STRATEGIES] = {0};
+
+// Collect the processes whose windows the scan needs. Returns 0 if only a
+// full scan can find them.
+int CollectTargetPids(const MediaEnumContext* ctx, DWORD pids[PID_TARGETED_MAX_PROCESSES], int* count) {
+    *count = 0;
+    if (!ctx->useProcessTree) return 0;
+
+    int total = ctx->audioRootCount + ctx->captureRootCount;
+#if OLED_FEATURE_MEDIA_SESSIONS
+    for (int i = 0; i < g_smtcScan.sessionCount; i++) {
+        if (g_smtcScan.sessions[i].state >= SMTC_STATE_VIDEO) total += g_smtcScan.sessions[i].pidCount;
+    }
+#endif
+    if (total > PID_TARGETED_MAX_PROCESSES) return 0;
+
+    for (int i = 0; i < ctx->audioRootCount; i++) {
+        AddUniquePid(pids, count, PID_TARGETED_MAX_PROCESSES, ctx->audioRootPids[i]);
+    }
+    for (int i = 0; i < ctx->captureRootCount; i++) {
+        AddUniquePid(pids, count, PID_TARGETED_MAX_PROCESSES, ctx->captureRootPids[i]);
+    }
+#if OLED_FEATURE_MEDIA_SESSIONS
+    for (int i = 0; i < g_smtcScan.sessionCount; i++) {
+        if (g_smtcScan.sessions[i].state < SMTC_STATE_VIDEO) continue;
+        for (int p = 0; p < g_smtcScan.sessions[i].pidCount; p++) {
+            AddUniquePid(pids, count, PID_TARGETED_MAX_PROCESSES, g_smtcScan.sessions[i].pids[p]);
+        }
+    }
+#endif
+    return 1;
+}
+
+// Returns 1 if g_targetThreads holds the threads of pids.
+int EnsureTargetThreads(const DWORD* pids, int count) {
+    int changed = count != g_targetPidCount || g_targetThreadCount < 0 ||
+                  (DWORD)(GetTickCount() - g_targetThreadTick) >= TARGET_THREAD_REFRESH_MS;
+    for (int i = 0; i < count && !changed; i++) {
+        changed = !ContainsPid(g_targetPids, g_targetPidCount, pids[i]);
+    }
+    if (!changed) return 1;
+
+    memcpy(g_targetPids, pids, count * sizeof(DWORD));
+    g_targetPidCount = count;
+    g_targetThreadCount = -1;
+    g_targetThreadTick = GetTickCount();
+    if (count == 0) {
+        g_targetThreadCount = 0;        // Nothing playing: no windows to visit
+        return 1;
+    }
+
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) return 0;
+    g_threadSnapshotCount++;
+
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    int threadCount = 0;
+    for (BOOL ok = Thread32First(hSnapshot, &entry); ok; ok = Thread32Next(hSnapshot, &entry)) {
+        if (!ContainsPid(pids, count, entry.th32OwnerProcessID)) continue;
+        if (threadCount >= MAX_TARGETED_THREADS) {
+            threadCount = -1;
+            break;
+        }
+        g_targetThreads[threadCount++] = entry.th32ThreadID;
+    }
+    CloseHandle(hSnapshot);
+
+    g_targetThreadCount = threadCount;
+    return threadCount >= 0;
+}
+
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+// ---------------------------------------------------------------------------
+// Sliced window scan
+//
+// A full scan runs on the UI thread, inside a WM_TIMER dispatch. With
+// windowScanSliceUs, it is split into slices of at most that many
+// microseconds instead. The first slice snapshots the HWND list. Each slice
+// continues from a cursor and adds to the scan context's per-monitor
+// results. Between slices a short timer (TIMER_MEDIA_SCAN_SLICE) waits, and
+// WM_TIMER is only dispatched once input and posted messages are handled.
+// ScanMediaMonitorStates keeps returning the previous complete result until
+// the last slice. A scan that is still running after MEDIA_DETECTION_CACHE_MS
+// is stale: its remaining windows get one more slice with the full scan
+// budget.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    HWND windows[MAX_SLICED_SCAN_WINDOWS];
+    int windowCount;                    // -1 = overflow
+    int cursor;                         // Next window to interrogate
+    int active;
+    int stale;
+    DWORD startTick;
+    int slices;
+    LONGLONG busyUs;                    // Total slice time of this scan
+} WindowSliceScan;
+
+static WindowSliceScan g_windowSlices;
+static int g_windowSlicesLast = 0;
+static LONGLONG g_windowSliceMaxUs = 0;
+static int g_staleWindowScans = 0;
+
+BOOL CALLBACK CollectSliceWindowCallback(HWND hWnd, LPARAM lParam) {
+    WindowSliceScan* scan = (WindowSliceScan*)lParam;
+    if (scan->windowCount >= MAX_SLICED_SCAN_WINDOWS) {
+        scan->windowCount = -1;         // Overflow: scan in one go
+        return FALSE;
+    }
+    scan->windows[scan->windowCount++] = hWnd;
+    return TRUE;
+}
+
+void AbortWindowSlices() {
+    if (!g_windowSlices.active) return;
+    g_windowSlices.active = 0;
+    KillTimer(g_app.hWnd, TIMER_MEDIA_SCAN_SLICE);
+}
+
+// Returns 0 if the scan must run in one go.
+int StartWindowSlices(MediaEnumContext* ctx) {
+    if (!g_app.config.windowScanSliceUs) return 0;
+
+    WindowSliceScan* scan = &g_windowSlices;
+    scan->windowCount = 0;
+    EnumWindows(CollectSliceWindowCallback, (LPARAM)scan);
+    if (scan->windowCount < 0) return 0;
+
+    scan->cursor = 0;
+    scan->active = 1;
+    scan->stale = 0;
+    scan->startTick = GetTickCount();
+    scan->slices = 0;
+    scan->busyUs = 0;
+    ctx->windowsVisited = 0;
+    return 1;
+}
+
+// Runs one slice. Returns 1 when the scan is complete.
+int ContinueWindowSlices(MediaEnumContext* ctx) {
+    WindowSliceScan* scan = &g_windowSlices;
+    LONGLONG startUs = GetTimestampUs();
+
+    if (!scan->stale && (DWORD)(GetTickCount() - scan->startTick) >= MEDIA_DETECTION_CACHE_MS) {
+        scan->stale = 1;
+        g_staleWindowScans++;
+        LogMessage("Window scan: stale after %d slices (%d of %d windows): finishing it",
+                   scan->slices, scan->cursor, scan->windowCount);
+    }
+    LONGLONG budgetUs = g_app.config.windowScanSliceUs;
+    if (scan->stale || budgetUs == 0) {
+        budgetUs = WINDOW_SCAN_BUDGET_MS * 1000LL;
+    }
+    ctx->deadlineUs = startUs + budgetUs;
+
+    // At least one window per slice, so a scan always makes progress
+    int first = scan->cursor;
+    while (scan->cursor < scan->windowCount) {
+        if (scan->cursor > first && GetTimestampUs() >= ctx->deadlineUs) break;
+
+        MediaWindowFacts window;
+        window.hWnd = scan->windows[scan->cursor++];
+        ctx->windowsVisited++;
+        int usable = InterrogateMediaWindow(&window);
+        FinishWindowInterrogation(ctx, &window);
+        if (usable) {
+            ClassifyMediaWindow(ctx, &window);
+        }
+    }
+
+    LONGLONG sliceUs = GetTimestampUs() - startUs;
+    scan->slices++;
+    scan->busyUs += sliceUs;
+    if (sliceUs > g_windowSliceMaxUs) {
+        g_windowSliceMaxUs = sliceUs;
+    }
+
+    if (scan->cursor < scan->windowCount && !scan->stale) {
+        if (scan->slices == 1) {
+            SetTimer(g_app.hWnd, TIMER_MEDIA_SCAN_SLICE, WINDOW_SLICE_INTERVAL_MS, NULL);
+        }
+        return 0;
+    }
+
+    // Even the stale slice ran out of budget
+    if (scan->cursor < scan->windowCount) {
+        g_skippedWindowCount += scan->windowCount - scan->cursor;
+        ctx->truncated = 1;
+        g_windowBudgetStops++;
+    }
+    AbortWindowSlices();
+
+    g_windowSlicesLast = scan->slices;
+    g_windowScanLastUs[WINDOW_SCAN_SLICED] = scan->busyUs;
+    g_windowScanTotalUs[WINDOW_SCAN_SLICED] += scan->busyUs;
+    g_windowScanLastWindows[WINDOW_SCAN_SLICED] = ctx->windowsVisited;
+    g_windowScanCount[WINDOW_SCAN_SLICED]++;
+    return 1;
+}
+#else
+void AbortWindowSlices() {
+}
+#endif
+
+// Returns 0 while a sliced scan is still in progress.
+int EnumerateMediaWindows(MediaEnumContext* ctx) {
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+    if (g_windowSlices.active) {
+        return ContinueWindowSlices(ctx);
+    }
+#endif
+
+    DWORD pids[PID_TARGETED_MAX_PROCESSES];
+    int pidCount = 0;
+    LONGLONG startUs = GetTimestampUs();
+    ctx->windowsVisited = 0;
+    ctx->deadlineUs = startUs + WINDOW_SCAN_BUDGET_MS * 1000LL;
+    ctx->truncated = 0;
+    ctx->windowsUnknown = 0;
+
+    int strategy = WINDOW_SCAN_FULL;
+    if (CollectTargetPids(ctx, pids, &pidCount) && EnsureTargetThreads(pids, pidCount)) {
+        strategy = WINDOW_SCAN_TARGETED;
+        for (int i = 0; i < g_targetThreadCount && !ctx->truncated; i++) {
+            EnumThreadWindows(g_targetThreads[i], EnumMediaWindowCallback, (LPARAM)ctx);
+        }
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN
+    } else if (ScanWindowsInParallel(ctx)) {
+        strategy = WINDOW_SCAN_PARALLEL;
+#endif
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+    } else if (StartWindowSlices(ctx)) {
+        return ContinueWindowSlices(ctx);
+#endif
+    } else {
+        EnumWindows(EnumMediaWindowCallback, (LPARAM)ctx);
+    }
+
+    g_windowScanLastUs[strategy] = GetTimestampUs() - startUs;
+    g_windowScanTotalUs[strategy] += g_windowScanLastUs[strategy];
+    g_windowScanLastWindows[strategy] = ctx->windowsVisited;
+    g_windowScanCount[strategy]++;
+    if (ctx->truncated) {
+        g_windowBudgetStops++;
+    }
+    return 1;
+}
+
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+// ---------------------------------------------------------------------------
+// Full-screen detection
+//
+// A full-screen app or presentation keeps the monitor it fills uncovered,
+// like media, even when it is silent. The answer is kept as a monitor bit
+// mask and only recomputed after something that can change it:
+// the foreground window changing (EVENT_SYSTEM_FOREGROUND), the foreground
+// process's windows moving or resizing (EVENT_OBJECT_LOCATIONCHANGE, hooked
+// for that process only, so other windows' events never reach us) or a
+// display change. Events just mark the mask stale; the next media scan
+// recomputes it once, and otherwise only reads it. Presentation mode and
+// exclusive full-screen raise no event, so SHQueryUserNotificationState is
+// also polled, at most every MEDIA_DETECTION_CACHE_MS.
+//
+// A foreground window without a caption that covers a whole monitor counts
+// on that monitor, unless it is maximized (browsers and other apps that draw
+// their own caption, with an auto-hidden taskbar). SHQueryUserNotificationState
+// adds exclusive Direct3D full-screen (the foreground window's monitor) and
+// presentation mode (every monitor).
+// ---------------------------------------------------------------------------
+
+static HWINEVENTHOOK g_hForegroundHook = NULL;
+static HWINEVENTHOOK g_hLocationHook = NULL;
+static DWORD g_locationHookPid = 0;
+static HWND g_fullscreenForeground = NULL;
+static int g_fullscreenStale = 1;
+static DWORD g_fullscreenMask = 0;
+static int g_fullscreenRecomputes = 0;
+static QUERY_USER_NOTIFICATION_STATE g_fullscreenNotifyState = QUNS_ACCEPTS_NOTIFICATIONS;
+static DWORD g_fullscreenNotifyTick = 0;
+
+void InvalidateFullscreenState() {
+    g_fullscreenStale = 1;
+}
+
+void CALLBACK FullscreenWinEventProc(HWINEVENTHOOK hHook, DWORD event, HWND hWnd, LONG idObject,
+                                     LONG idChild, DWORD eventThread, DWORD eventTime) {
+    (void)hHook; (void)idChild; (void)eventThread; (void)eventTime;
+    if (event == EVENT_SYSTEM_FOREGROUND ||
+        (idObject == OBJID_WINDOW && hWnd == g_fullscreenForeground)) {
+        g_fullscreenStale = 1;
+    }
+}
+
+void StopFullscreenTracking() {
+    if (g_hLocationHook) UnhookWinEvent(g_hLocationHook);
+    if (g_hForegroundHook) UnhookWinEvent(g_hForegroundHook);
+    g_hLocationHook = NULL;
+    g_hForegroundHook = NULL;
+    g_locationHookPid = 0;
+    g_fullscreenForeground = NULL;
+    g_fullscreenStale = 1;
+    g_fullscreenMask = 0;
+    g_fullscreenNotifyState = QUNS_ACCEPTS_NOTIFICATIONS;
+}
+
+QUERY_USER_NOTIFICATION_STATE QueryFullscreenNotifyState() {
+    QUERY_USER_NOTIFICATION_STATE notifyState = QUNS_ACCEPTS_NOTIFICATIONS;
+    SHQueryUserNotificationState(&notifyState);
+    g_fullscreenNotifyTick = GetTickCount();
+    return notifyState;
+}
+
+// Desktop and shell windows span whole monitors without being full-screen apps
+int IsShellDesktopWindow(HWND hWnd) {
+    char className[32];
+    if (hWnd == GetShellWindow() || hWnd == GetDesktopWindow()) return 1;
+    if (!GetClassNameA(hWnd, className, sizeof(className))) return 0;
+    return strcmp(className, "Progman") == 0 || strcmp(className, "WorkerW") == 0;
+}
+
+DWORD ComputeFullscreenMask() {
+    HWND hWnd = GetForegroundWindow();
+    DWORD pid = 0;
+    if (hWnd) GetWindowThreadProcessId(hWnd, &pid);
+
+    // Follow the foreground process's window moves only
+    if (pid != g_locationHookPid) {
+        if (g_hLocationHook) UnhookWinEvent(g_hLocationHook);
+        g_hLocationHook = pid ? SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE, NULL,
+                                                FullscreenWinEventProc, pid, 0,
+                                                WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS) : NULL;
+        g_locationHookPid = pid;
+    }
+    g_fullscreenForeground = hWnd;
+
+    QUERY_USER_NOTIFICATION_STATE notifyState = QueryFullscreenNotifyState();
+    g_fullscreenNotifyState = notifyState;
+    if (notifyState == QUNS_PRESENTATION_MODE) {
+        return g_monitorCount >= 32 ? 0xFFFFFFFFu : (1u << g_monitorCount) - 1;
+    }
+
+    // Our own screen saver windows are full-screen by design
+    if (!hWnd || pid == GetCurrentProcessId() || IsShellDesktopWindow(hWnd) || IsIconic(hWnd)) {
+        return 0;
+    }
+
+    DWORD mask = 0;
+    RECT rect;
+    LONG_PTR style = GetWindowLongPtr(hWnd, GWL_STYLE);
+    if ((style & WS_CAPTION) != WS_CAPTION && !IsZoomed(hWnd) && GetWindowRect(hWnd, &rect)) {
+        for (int i = 0; i < g_monitorCount && i < 32; i++) {
+            const RECT* monitor = &g_monitors[i].rect;
+            if (rect.left <= monitor->left && rect.top <= monitor->top &&
+                rect.right >= monitor->right && rect.bottom >= monitor->bottom) {
+                mask |= 1u << i;
+            }
+        }
+    }
+    if (!mask && notifyState == QUNS_RUNNING_D3D_FULL_SCREEN && GetWindowRect(hWnd, &rect)) {
+        int monitorIndex = GetMonitorIndexFromRect(rect);
+        if (monitorIndex >= 0 && monitorIndex < 32) mask = 1u << monitorIndex;
+    }
+    return mask;
+}
+
+DWORD GetFullscreenMonitorMask() {
+    if (!g_hForegroundHook) {
+        g_hForegroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL,
+                                            FullscreenWinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+        g_fullscreenStale = 1;
+    }
+    if (!g_fullscreenStale && (DWORD)(GetTickCount() - g_fullscreenNotifyTick) >= MEDIA_DETECTION_CACHE_MS &&
+        QueryFullscreenNotifyState() != g_fullscreenNotifyState) {
+        g_fullscreenStale = 1;
+    }
+    if (g_fullscreenStale || !g_hForegroundHook) {
+        g_fullscreenStale = 0;
+        g_fullscreenRecomputes++;
+        DWORD mask = ComputeFullscreenMask();
+        if (mask != g_fullscreenMask) {
+            LogMessage("Full-screen detection: mask=0x%08X", mask);
+            g_fullscreenMask = mask;
+        }
+    }
+    return g_fullscreenMask;
+}
+#endif
+
+// Fills mediaOnMonitor[] with 1 for each monitor hosting a visible media window.
+// Uses the cheap ES_DISPLAY_REQUIRED gate to skip enumeration when nothing is
+// playing, and caches the scan for MEDIA_DETECTION_CACHE_MS to keep the timer
+// light. Returns 1 if any monitor has media. If media is playing globally but
+// no candidate window maps to a monitor, falls back to blocking all enabled
+// monitors (safe default so unknown apps are never covered).
+int ScanMediaMonitorStates(int mediaOnMonitor[MAX_MONITOR_COUNT]) {
+    static DWORD lastLoggedMask = (DWORD)-1;
+    static DWORD lastScanTick = 0;
+    static int hasCachedState = 0;
+    static int cachedAnyMedia = 0;
+    static int cachedMediaOnMonitor[MAX_MONITOR_COUNT] = {0};
+    static DWORD lastAudioDetectedTick = 0;
+    static MediaEnumContext ctx;        // Kept across the slices of a scan
+    static int scanInProgress = 0;
+
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        mediaOnMonitor[i] = 0;
+    }
+
+    if (g_mediaCacheInvalidated) {
+        hasCachedState = 0;
+        lastLoggedMask = (DWORD)-1;
+        g_mediaCacheInvalidated = 0;
+        scanInProgress = 0;
+        AbortWindowSlices();
+        LogMessage("Media detection cache invalidated (sleep/wake or display change)");
+    }
+
+    if (!g_app.config.mediaDetectionEnabled) {
+        hasCachedState = 0;
+        scanInProgress = 0;
+        AbortWindowSlices();
+        if (lastLoggedMask != 0) {
+            LogMessage("Media monitor detection: disabled");
+            lastLoggedMask = 0;
+        }
+        return 0;
+    }
+
+    DWORD nowTick = GetTickCount();
+#if OLED_FEATURE_MEDIA_SESSIONS
+    // A session state change is exact news: don't sit on a cached result
+    int sessionsChanged = TakeSmtcSnapshot();
+#else
+    int sessionsChanged = 0;
+#endif
+    if (!scanInProgress && hasCachedState && !sessionsChanged &&
+        (DWORD)(nowTick - lastScanTick) < MEDIA_DETECTION_CACHE_MS) {
+        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+            mediaOnMonitor[i] = cachedMediaOnMonitor[i];
+        }
+        return cachedAnyMedia;
+    }
+
+    if (!scanInProgress) {
+        lastScanTick = nowTick;
+
+        ULONG executionState = 0;
+        int globalMediaPlaying = QueryDisplayRequired(&executionState) > 0;
+#if OLED_FEATURE_MEDIA_SESSIONS
+        if (!globalMediaPlaying && AnySmtcVideoPlaying()) {
+            globalMediaPlaying = 1;
+        }
+#endif
+
+        memset(&ctx, 0, sizeof(ctx));
+#if OLED_FEATURE_DEBUG_LOG
+        ctx.collectDiagnostics = g_app.config.debugMode;
+#endif
+        g_mediaDiagnostics.browserWindowCount = 0;
+        g_processNames.compares = 0;
+        CollectActiveAudioProcessNames(&ctx);
+
+        // Call apps don't always request the display: the capture pass above
+        // is this scan's one call check
+        if (!globalMediaPlaying && ctx.captureActiveProcessNameCount == 0) {
+            for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+                cachedMediaOnMonitor[i] = 0;
+            }
+            hasCachedState = 1;
+            cachedAnyMedia = 0;
+
+            if (lastLoggedMask != 0) {
+                LogMessage("Media monitor detection: no active media monitors");
+                lastLoggedMask = 0;
+            }
+            return 0;
+        }
+
+        if (ctx.audioActiveProcessNameCount > 0 || ctx.captureActiveProcessNameCount > 0) {
+            lastAudioDetectedTick = nowTick;
+        } else if (!sessionsChanged && hasCachedState && cachedAnyMedia &&
+                   (DWORD)(nowTick - lastAudioDetectedTick) < AUDIO_GRACE_PERIOD_MS) {
+            // Audio was detected recently but this scan found no audible audio.
+            // This happens during quiet passages in video audio where the peak
+            // meter momentarily drops below threshold. Keep the previous media
+            // state to avoid flickering the screen saver on and off.
+            for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+                mediaOnMonitor[i] = cachedMediaOnMonitor[i];
+            }
+            hasCachedState = 1;
+            cachedAnyMedia = 1;
+            lastScanTick = nowTick;
+
+            DWORD mask = 0;
+            for (int i = 0; i < g_monitorCount && i < 32; i++) {
+                if (mediaOnMonitor[i]) {
+                    mask |= (1u << i);
+                }
+            }
+            if (mask != lastLoggedMask) {
+                LogMessage("Media monitor detection: mask=0x%08X (grace period, %lums since last audio)",
+                           mask, (unsigned long)(nowTick - lastAudioDetectedTick));
+                lastLoggedMask = mask;
+            }
+            return 1;
+        }
+
+        ResolveMediaProcessRoots(&ctx);
+    }
+
+    // Only complete scans are published: until then the previous one stands
+    scanInProgress = !EnumerateMediaWindows(&ctx);
+    if (scanInProgress) {
+        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+            mediaOnMonitor[i] = cachedMediaOnMonitor[i];
+        }
+        return cachedAnyMedia;
+    }
+
+    // Windows skipped for the scan budget, backed off or hung may be the ones
+    // playing: keep the monitors that had media last time
+    if ((ctx.truncated || ctx.windowsUnknown) && hasCachedState) {
+        for (int i = 0; i < g_monitorCount; i++) {
+            ctx.mediaOnMonitor[i] |= cachedMediaOnMonitor[i];
+        }
+    }
+
+    int localMediaOnMonitor[MAX_MONITOR_COUNT] = {0};
+    int mappedMonitorCount = 0;
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (ctx.mediaOnMonitor[i]) {
+            localMediaOnMonitor[i] = 1;
+            mediaOnMonitor[i] = 1;
+            mappedMonitorCount++;
+        }
+    }
+
+    int usedGlobalFallback = 0;
+    int skippedFallbackForBrowser = 0;
+    int skippedFallbackForNoAudio = 0;
+    int skippedFallbackForSessions = 0;
+    if (mappedMonitorCount == 0) {
+        if (ctx.audioActiveProcessNameCount == 0) {
+            // ES_DISPLAY_REQUIRED is set but no audible audio is detected on the
+            // default render endpoint. This happens with muted video, OBS replay
+            // buffer, or other apps that call SetThreadExecutionState without
+            // producing audio.
+            if (g_app.config.blockOnMutedMedia) {
+                // User opted in to blocking on muted/silent media. Conservatively
+                // block all enabled monitors.
+                for (int i = 0; i < g_monitorCount; i++) {
+                    if (g_monitorStates[i].enabled) {
+                        mediaOnMonitor[i] = 1;
+                    }
+                }
+                usedGlobalFallback = 1;
+            } else {
+                // No audible media is playing, let the screen saver activate.
+                skippedFallbackForNoAudio = 1;
+                LogMessage("Media detection: ES_DISPLAY_REQUIRED set but no audible audio detected: skipping fallback");
+            }
+#if OLED_FEATURE_MEDIA_SESSIONS
+        } else if (AllAudioActiveHaveSmtcState(&ctx)) {
+            // Every audible app reported its playback state and none is
+            // playing video on a monitor (e.g. music): nothing to protect
+            skippedFallbackForSessions = 1;
+            LogMessage("Media detection: all audio-active processes have media sessions: skipping fallback");
+#endif
+        } else if (AllAudioActiveAreBrowsers(&ctx)) {
+            // All audio-active processes are known browsers, but no window title
+            // matched a video hint. This typically means video is playing in a
+            // background tab - the window title shows the active tab, not the
+            // playing one. We can't determine which monitor is playing, so
+            // rather than blocking all monitors (which would defeat per-monitor
+            // detection), we skip the fallback and let the screen saver activate.
+            // The user can always move the mouse to dismiss it if needed.
+            skippedFallbackForBrowser = 1;
+            LogMessage("Media detection: no title hint match, all audio-active processes are browsers: skipping fallback");
+        } else {
+            // Non-browser audio (unknown app, media player with minimized window,
+            // audio on non-default device). Conservatively block all enabled
+            // monitors to avoid covering playback.
+            for (int i = 0; i < g_monitorCount; i++) {
+                if (g_monitorStates[i].enabled) {
+                    mediaOnMonitor[i] = 1;
+                }
+            }
+            usedGlobalFallback = 1;
+        }
+    }
+
+    DWORD mask = 0;
+    for (int i = 0; i < g_monitorCount && i < 32; i++) {
+        if (mediaOnMonitor[i]) {
+            mask |= (1u << i);
+        }
+    }
+
+    hasCachedState = 1;
+    cachedAnyMedia = mask != 0;
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        cachedMediaOnMonitor[i] = mediaOnMonitor[i];
+    }
+
+    if (mask != lastLoggedMask) {
+        for (int i = 0; i < g_mediaDiagnostics.browserWindowCount; i++) {
+            LogMessage("Media detection: browser window %s: '%.120s'",
+                       g_mediaDiagnostics.browserMatched[i] ? "MATCHED  " : "no hint  ",
+                       g_mediaDiagnostics.browserTitles[i]);
+        }
+        LogMessage("Media monitor detection: mask=0x%08X (activeAudioNames=%d, captureNames=%d, fallback=%d, browserSkip=%d, noAudioSkip=%d, sessionSkip=%d, browserWindows=%d, nameCompares=%d, processTree=%d, graphRefreshes=%d)",
+                   mask, ctx.audioActiveProcessNameCount, ctx.captureActiveProcessNameCount, usedGlobalFallback,
+                   skippedFallbackForBrowser, skippedFallbackForNoAudio, skippedFallbackForSessions,
+                   g_mediaDiagnostics.browserWindowCount,
+                   g_processNames.compares, ctx.useProcessTree, g_processGraphRefreshes);
+        lastLoggedMask = mask;
+    }
+
+    return cachedAnyMedia;
+}
+
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+// Slice timer: advances the scan in progress, which publishes its result
+// when complete.
+void ContinueMediaScan() {
+    if (!g_windowSlices.active) {
+        KillTimer(g_app.hWnd, TIMER_MEDIA_SCAN_SLICE);
+        return;
+    }
+    int mediaOnMonitor[MAX_MONITOR_COUNT];
+    ScanMediaMonitorStates(mediaOnMonitor);
+}
+#endif
+
+// Media windows plus, with fullscreenDetectionEnabled, monitors filled by a
+// full-screen app (a cached mask: one bit test per monitor).
+int UpdateMediaMonitorStates(int mediaOnMonitor[MAX_MONITOR_COUNT]) {
+    int anyMedia = ScanMediaMonitorStates(mediaOnMonitor);
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+    if (g_app.config.mediaDetectionEnabled && g_app.config.fullscreenDetectionEnabled) {
+        DWORD fullscreenMask = GetFullscreenMonitorMask();
+        for (int i = 0; i < g_monitorCount && i < 32; i++) {
+            if (fullscreenMask & (1u << i)) {
+                mediaOnMonitor[i] = 1;
+                anyMedia = 1;
+            }
+        }
+    }
+#endif
+    return anyMedia;
+}
+#else
+int UpdateMediaMonitorStates(int mediaOnMonitor[MAX_MONITOR_COUNT]) {
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        mediaOnMonitor[i] = 0;
+    }
+    return 0;
+}
+#endif
+
+// Resolve a list of monitors ("DISPLAY2,\\.\DISPLAY3,<device path>", comma or
+// space separated) to a bit mask of monitor indices. Returns 0 if any entry
+// does not match a current monitor.
+DWORD ParseMonitorList(const char* list) {
+    DWORD mask = 0;
+    char buffer[512];
+    strncpy_s(buffer, sizeof(buffer), list, _TRUNCATE);
+
+    char* context = NULL;
+    for (char* token = strtok_s(buffer, ", ", &context); token; token = strtok_s(NULL, ", ", &context)) {
+        int idx = FindMonitorByDevicePath(token);
+        if (idx < 0) {
+            char deviceName[CCHDEVICENAME + DEVICE_NAME_PREFIX_LEN];
+            if (strncmp(token, DEVICE_NAME_PREFIX, DEVICE_NAME_PREFIX_LEN) == 0) {
+                strncpy_s(deviceName, sizeof(deviceName), token, _TRUNCATE);
+            } else {
+                sprintf_s(deviceName, sizeof(deviceName), "%s%s", DEVICE_NAME_PREFIX, token);
+            }
+            idx = FindMonitorByDeviceName(deviceName);
+        }
+        if (idx < 0 || idx >= MAX_MONITOR_COUNT) {
+            return 0;
+        }
+        mask |= (1u << idx);
+    }
+
+    return mask;
+}
+
+#if OLED_FEATURE_LEASE_API
+// ---------------------------------------------------------------------------
+// Idle-inhibit leases
+//
+// Local applications can ask for monitors to stay uncovered for a bounded time
+// over the named pipe LEASE_PIPE_NAME_FORMAT, one request per message:
+//
+//   LEASE ttl=<seconds> [pid=<owner>] [monitors=DISPLAY1,DISPLAY2] [reason=<text>]
+//       -> "OK <leaseId>" or "ERR <message>"
+//   RENEW <leaseId> ttl=<seconds>   -> "OK" or "ERR <message>"
+//   RELEASE <leaseId>               -> "OK" or "ERR <message>"
+//
+// The pipe is served by a worker thread that only does I/O; every request is
+// posted to the UI thread, so the lease table itself is single-threaded. The
+// request is heap-allocated and reference-counted, since the worker gives up
+// waiting for the answer after LEASE_CLIENT_TIMEOUT_MS while the message may
+// still be queued. A lease without monitors= covers all monitors, and is
+// released early if its owner process (the pipe client unless pid= is given)
+// exits. reason= must come last and takes the rest of the line.
+//
+// Every logged-on session has its own pipe, only the current user can open
+// it, and it is created with FILE_FLAG_FIRST_PIPE_INSTANCE, so another
+// process can't squat on the name and impersonate the server.
+//
+// Per tick, GetIdleLeaseMonitorMask looks only at the earliest expiry in a
+// min-heap and returns a precomputed mask, so the common case is O(1).
+// Releases and renewals leave stale heap entries behind (lazy deletion); they
+// are recognized by their generation when they reach the top.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    DWORD id;                   // 0 = free slot; low byte is the slot index
+    DWORD generation;           // Bumped on release/renew to invalidate heap entries
+    DWORD ownerPid;
+    DWORD monitorMask;          // Bit per monitor index, or LEASE_ALL_MONITORS
+    DWORD expiresTick;
+    HANDLE hOwnerProcess;
+    HANDLE hOwnerWait;
+    char reason[64];
+} IdleLease;
+
+typedef struct {
+    DWORD expiresTick;
+    int slot;
+    DWORD generation;
+} LeaseExpiry;
+
+typedef struct {
+    volatile LONG refs;         // Held by the pipe worker and the posted message
+    volatile LONG abandoned;    // Worker stopped waiting; don't act on the request
+    HANDLE hDone;               // Set by the UI thread once response is filled in
+    DWORD clientPid;
+    char request[LEASE_PIPE_BUFFER_SIZE];
+    char response[LEASE_PIPE_BUFFER_SIZE];
+} LeaseRequest;
+
+static IdleLease g_leases[MAX_IDLE_LEASES];
+static LeaseExpiry g_leaseHeap[LEASE_EXPIRY_HEAP_CAPACITY];
+static int g_leaseHeapCount = 0;
+static int g_leaseCount = 0;
+static DWORD g_leaseSequence = 0;
+static int g_leaseMonitorRefs[MAX_MONITOR_COUNT];
+static int g_leaseAllMonitorRefs = 0;
+static DWORD g_leaseMonitorMask = 0;
+static HANDLE g_hLeaseServerThread = NULL;
+static HANDLE g_hLeaseStopEvent = NULL;
+
+int LeaseExpiresBefore(const LeaseExpiry* a, const LeaseExpiry* b) {
+    // Tick-count wraparound safe as long as TTLs stay far below 24 days
+    return (LONG)(a->expiresTick - b->expiresTick) < 0;
+}
+
+void LeaseHeapSiftDown(int index) {
+    for (;;) {
+        int smallest = index;
+        int left = index * 2 + 1;
+        int right = left + 1;
+        if (left < g_leaseHeapCount && LeaseExpiresBefore(&g_leaseHeap[left], &g_leaseHeap[smallest])) {
+            smallest = left;
+        }
+        if (right < g_leaseHeapCount && LeaseExpiresBefore(&g_leaseHeap[right], &g_leaseHeap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) break;
+
+        LeaseExpiry tmp = g_leaseHeap[index];
+        g_leaseHeap[index] = g_leaseHeap[smallest];
+        g_leaseHeap[smallest] = tmp;
+        index = smallest;
+    }
+}
+
+void LeaseHeapPop() {
+    if (g_leaseHeapCount == 0) return;
+    g_leaseHeap[0] = g_leaseHeap[--g_leaseHeapCount];
+    LeaseHeapSiftDown(0);
+}
+
+// Rebuild the heap from live leases only. Needed only when stale entries from
+// renewals/releases have filled it up.
+void LeaseHeapCompact() {
+    g_leaseHeapCount = 0;
+    for (int i = 0; i < MAX_IDLE_LEASES; i++) {
+        if (g_leases[i].id != 0) {
+            g_leaseHeap[g_leaseHeapCount].expiresTick = g_leases[i].expiresTick;
+            g_leaseHeap[g_leaseHeapCount].slot = i;
+            g_leaseHeap[g_leaseHeapCount].generation = g_leases[i].generation;
+            g_leaseHeapCount++;
+        }
+    }
+    for (int i = g_leaseHeapCount / 2 - 1; i >= 0; i--) {
+        LeaseHeapSiftDown(i);
+    }
+}
+
+void LeaseHeapPush(int slot) {
+    if (g_leaseHeapCount >= LEASE_EXPIRY_HEAP_CAPACITY) {
+        // The live lease is already in the rebuilt heap
+        LeaseHeapCompact();
+        return;
+    }
+
+    int index = g_leaseHeapCount++;
+    g_leaseHeap[index].expiresTick = g_leases[slot].expiresTick;
+    g_leaseHeap[index].slot = slot;
+    g_leaseHeap[index].generation = g_leases[slot].generation;
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!LeaseExpiresBefore(&g_leaseHeap[index], &g_leaseHeap[parent])) break;
+        LeaseExpiry tmp = g_leaseHeap[index];
+        g_leaseHeap[index] = g_leaseHeap[parent];
+        g_leaseHeap[parent] = tmp;
+        index = parent;
+    }
+}
+
+// Adjust per-monitor reference counts and recompute the cached mask. Runs only
+// when a lease is taken or dropped, never on the per-tick path.
+void AddLeaseMonitorRefs(DWORD monitorMask, int delta) {
+    if (monitorMask == LEASE_ALL_MONITORS) {
+        g_leaseAllMonitorRefs += delta;
+    } else {
+        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+            if (monitorMask & (1u << i)) {
+                g_leaseMonitorRefs[i] += delta;
+            }
+        }
+    }
+
+    DWORD mask = 0;
+    if (g_leaseAllMonitorRefs > 0) {
+        mask = LEASE_ALL_MONITORS;
+    } else {
+        for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+            if (g_leaseMonitorRefs[i] > 0) {
+                mask |= (1u << i);
+            }
+        }
+    }
+    g_leaseMonitorMask = mask;
+}
+
+IdleLease* FindIdleLease(DWORD leaseId) {
+    if (leaseId == 0) return NULL;
+    IdleLease* lease = &g_leases[leaseId & 0xFF];
+    return lease->id == leaseId ? lease : NULL;
+}
+
+void ReleaseIdleLease(IdleLease* lease, const char* reason) {
+    LogMessage("Lease: %lu released (%s): pid=%lu, monitors=0x%08X, reason='%s'",
+               (unsigned long)lease->id, reason, (unsigned long)lease->ownerPid,
+               lease->monitorMask, lease->reason);
+
+    AddLeaseMonitorRefs(lease->monitorMask, -1);
+
+    if (lease->hOwnerWait) {
+        // Non-blocking: the callback only posts a message and may still run
+        UnregisterWaitEx(lease->hOwnerWait, NULL);
+    }
+    if (lease->hOwnerProcess) {
+        CloseHandle(lease->hOwnerProcess);
+    }
+
+    DWORD generation = lease->generation + 1;
+    memset(lease, 0, sizeof(*lease));
+    lease->generation = generation;
+    g_leaseCount--;
+}
+
+VOID CALLBACK LeaseOwnerExitedCallback(PVOID context, BOOLEAN timedOut) {
+    if (!timedOut) {
+        PostMessage(g_app.hWnd, WM_LEASE_OWNER_EXITED, (WPARAM)(ULONG_PTR)context, 0);
+    }
+}
+
+// Per-tick lease check: reap leases whose TTL has elapsed (only ever looking
+// at the heap top) and return the mask of monitors that must stay uncovered.
+// LEASE_ALL_MONITORS means every monitor; 0 means no active lease.
+DWORD GetIdleLeaseMonitorMask() {
+    if (g_leaseHeapCount == 0) {
+        return g_leaseMonitorMask;
+    }
+
+    DWORD nowTick = GetTickCount();
+    while (g_leaseHeapCount > 0 && (LONG)(nowTick - g_leaseHeap[0].expiresTick) >= 0) {
+        LeaseExpiry top = g_leaseHeap[0];
+        LeaseHeapPop();
+
+        IdleLease* lease = &g_leases[top.slot];
+        if (lease->id != 0 && lease->generation == top.generation) {
+            ReleaseIdleLease(lease, "expired");
+        }
+    }
+
+    return g_leaseMonitorMask;
+}
+
+// Parse "ttl=<seconds>" from a request. Returns the TTL in seconds, or 0.
+int ParseLeaseTtl(const char* request) {
+    const char* ttl = strstr(request, "ttl=");
+    if (!ttl) return 0;
+    return ClampInt(atoi(ttl + 4), 0, MAX_LEASE_TTL_SEC);
+}
+
+void HandleLeaseAcquire(LeaseRequest* req) {
+    // Options are parsed from the text before reason=, which is free-form
+    char options[LEASE_PIPE_BUFFER_SIZE];
+    strcpy_s(options, sizeof(options), req->request);
+    char* reason = strstr(options, "reason=");
+    if (reason) {
+        *reason = '\0';
+        reason = req->request + (reason - options) + 7;
+    }
+
+    int ttlSec = ParseLeaseTtl(options);
+    if (ttlSec <= 0) {
+        strcpy_s(req->response, sizeof(req->response), "ERR ttl=<seconds> required");
+        return;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < MAX_IDLE_LEASES; i++) {
+        if (g_leases[i].id == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        strcpy_s(req->response, sizeof(req->response), "ERR too many leases");
+        return;
+    }
+
+    DWORD ownerPid = req->clientPid;
+    const char* pid = strstr(options, "pid=");
+    if (pid) {
+        ownerPid = (DWORD)strtoul(pid + 4, NULL, 10);
+    }
+
+    DWORD monitorMask = LEASE_ALL_MONITORS;
+    const char* monitors = strstr(options, "monitors=");
+    if (monitors) {
+        char list[LEASE_PIPE_BUFFER_SIZE];
+        sscanf_s(monitors + 9, "%511s", list, (unsigned)sizeof(list));
+        monitorMask = ParseMonitorList(list);
+        if (monitorMask == 0) {
+            strcpy_s(req->response, sizeof(req->response), "ERR unknown monitor");
+            return;
+        }
+    }
+
+    IdleLease* lease = &g_leases[slot];
+    g_leaseSequence = (g_leaseSequence + 1) & 0x00FFFFFF;
+    if (g_leaseSequence == 0) g_leaseSequence = 1;
+    lease->id = (g_leaseSequence << 8) | (DWORD)slot;
+    lease->ownerPid = ownerPid;
+    lease->monitorMask = monitorMask;
+    lease->expiresTick = GetTickCount() + (DWORD)ttlSec * 1000;
+
+    if (reason) {
+        strncpy_s(lease->reason, sizeof(lease->reason), reason, _TRUNCATE);
+    }
+
+    if (ownerPid != 0) {
+        lease->hOwnerProcess = OpenProcess(SYNCHRONIZE, FALSE, ownerPid);
+        if (lease->hOwnerProcess &&
+            !RegisterWaitForSingleObject(&lease->hOwnerWait, lease->hOwnerProcess,
+                                         LeaseOwnerExitedCallback, (PVOID)(ULONG_PTR)lease->id,
+                                         INFINITE, WT_EXECUTEONLYONCE)) {
+            lease->hOwnerWait = NULL;
+        }
+    }
+
+    g_leaseCount++;
+    AddLeaseMonitorRefs(monitorMask, 1);
+    LeaseHeapPush(slot);
+
+    sprintf_s(req->response, sizeof(req->response), "OK %lu", (unsigned long)lease->id);
+    LogMessage("Lease: %lu taken: pid=%lu, ttl=%ds, monitors=0x%08X, reason='%s' (%d active)",
+               (unsigned long)lease->id, (unsigned long)ownerPid, ttlSec, monitorMask,
+               lease->reason, g_leaseCount);
+}
+
+void HandleLeaseRenew(LeaseRequest* req, DWORD leaseId) {
+    IdleLease* lease = FindIdleLease(leaseId);
+    int ttlSec = ParseLeaseTtl(req->request);
+    if (!lease) {
+        strcpy_s(req->response, sizeof(req->response), "ERR unknown lease");
+        return;
+    }
+    if (ttlSec <= 0) {
+        strcpy_s(req->response, sizeof(req->response), "ERR ttl=<seconds> required");
+        return;
+    }
+
+    lease->generation++;
+    lease->expiresTick = GetTickCount() + (DWORD)ttlSec * 1000;
+    LeaseHeapPush((int)(leaseId & 0xFF));
+    strcpy_s(req->response, sizeof(req->response), "OK");
+}
+
+LeaseRequest* CreateLeaseRequest() {
+    LeaseRequest* req = calloc(1, sizeof(LeaseRequest));
+    if (!req) return NULL;
+    req->hDone = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!req->hDone) {
+        free(req);
+        return NULL;
+    }
+    req->refs = 1;
+    return req;
+}
+
+void ReleaseLeaseRequest(LeaseRequest* req) {
+    if (InterlockedDecrement(&req->refs) == 0) {
+        CloseHandle(req->hDone);
+        free(req);
+    }
+}
+
+// Runs on the UI thread (WM_LEASE_REQUEST), so the lease table needs no locking.
+void HandleLeaseRequest(LeaseRequest* req) {
+    if (req->abandoned) {
+        return;
+    }
+
+    char verb[16] = {0};
+    unsigned long leaseId = 0;
+    sscanf_s(req->request, "%15s %lu", verb, (unsigned)sizeof(verb), &leaseId);
+
+    if (_stricmp(verb, "LEASE") == 0) {
+        HandleLeaseAcquire(req);
+    } else if (_stricmp(verb, "RENEW") == 0) {
+        HandleLeaseRenew(req, (DWORD)leaseId);
+    } else if (_stricmp(verb, "RELEASE") == 0) {
+        IdleLease* lease = FindIdleLease((DWORD)leaseId);
+        if (lease) {
+            ReleaseIdleLease(lease, "client release");
+            strcpy_s(req->response, sizeof(req->response), "OK");
+        } else {
+            strcpy_s(req->response, sizeof(req->response), "ERR unknown lease");
+        }
+    } else {
+        strcpy_s(req->response, sizeof(req->response), "ERR unknown command");
+    }
+}
+
+// Wait for an overlapped pipe operation, giving up on stop or timeout.
+// Returns 1 if the operation completed successfully.
+int WaitForLeasePipeIo(HANDLE hPipe, OVERLAPPED* ov, BOOL started, DWORD timeoutMs, DWORD* transferred) {
+    if (!started && GetLastError() != ERROR_IO_PENDING) {
+        return GetLastError() == ERROR_PIPE_CONNECTED;
+    }
+
+    HANDLE handles[2] = { g_hLeaseStopEvent, ov->hEvent };
+    DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeoutMs);
+    if (wait != WAIT_OBJECT_0 + 1) {
+        CancelIo(hPipe);
+        GetOverlappedResult(hPipe, ov, transferred, TRUE);
+        return 0;
+    }
+
+    return GetOverlappedResult(hPipe, ov, transferred, FALSE) ? 1 : 0;
+}
+
+// Create the session's lease pipe with a DACL that only admits the current
+// user. Returns INVALID_HANDLE_VALUE and logs the reason on failure.
+HANDLE CreateLeasePipe() {
+    DWORD sessionId = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+    WCHAR pipeName[64];
+    swprintf_s(pipeName, 64, LEASE_PIPE_NAME_FORMAT, (unsigned long)sessionId);
+
+    HANDLE hToken = NULL;
+    BYTE tokenUser[SECURITY_MAX_SID_SIZE + sizeof(TOKEN_USER)];
+    DWORD size = 0;
+    LPWSTR userSid = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken) ||
+        !GetTokenInformation(hToken, TokenUser, tokenUser, sizeof(tokenUser), &size) ||
+        !ConvertSidToStringSidW(((TOKEN_USER*)tokenUser)->User.Sid, &userSid)) {
+        LogMessage("Lease: could not look up the current user (error %lu); server not started", GetLastError());
+        if (hToken) CloseHandle(hToken);
+        return INVALID_HANDLE_VALUE;
+    }
+    CloseHandle(hToken);
+
+    // Protected DACL with a single entry: full access for this user
+    WCHAR sddl[256];
+    swprintf_s(sddl, 256, L"D:P(A;;GA;;;%s)", userSid);
+    LocalFree(userSid);
+
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, FALSE };
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl, SDDL_REVISION_1,
+                                                              &sa.lpSecurityDescriptor, NULL)) {
+        LogMessage("Lease: could not build the pipe security descriptor (error %lu); server not started", GetLastError());
+        return INVALID_HANDLE_VALUE;
+    }
+
+    HANDLE hPipe = CreateNamedPipeW(pipeName,
+                                    PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                    PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                    1, LEASE_PIPE_BUFFER_SIZE, LEASE_PIPE_BUFFER_SIZE, 0, &sa);
+    DWORD error = GetLastError();
+    LocalFree(sa.lpSecurityDescriptor);
+
+    if (hPipe == INVALID_HANDLE_VALUE) {
+        // ERROR_ACCESS_DENIED here means another process already owns the name
+        LogMessage("Lease: could not create pipe %ls (error %lu); server not started", pipeName, error);
+    } else {
+        LogMessage("Lease: server listening on pipe %ls", pipeName);
+    }
+    return hPipe;
+}
+
+// Pipe server: accepts one client at a time on the single pipe instance (param),
+// reads one request, forwards it to the UI thread and writes back the
+// response. Only does I/O; owns and closes the pipe handle.
+DWORD WINAPI LeaseServerThread(LPVOID param) {
+    HANDLE hPipe = (HANDLE)param;
+    OVERLAPPED ov = {0};
+    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!ov.hEvent) {
+        CloseHandle(hPipe);
+        return 1;
+    }
+
+    while (WaitForSingleObject(g_hLeaseStopEvent, 0) != WAIT_OBJECT_0) {
+        DWORD transferred = 0;
+        ResetEvent(ov.hEvent);
+        BOOL started = ConnectNamedPipe(hPipe, &ov);
+        LeaseRequest* req = NULL;
+        if (WaitForLeasePipeIo(hPipe, &ov, started, INFINITE, &transferred) &&
+            (req = CreateLeaseRequest()) != NULL) {
+            GetNamedPipeClientProcessId(hPipe, &req->clientPid);
+
+            ResetEvent(ov.hEvent);
+            started = ReadFile(hPipe, req->request, sizeof(req->request) - 1, &transferred, &ov);
+            if (WaitForLeasePipeIo(hPipe, &ov, started, LEASE_CLIENT_TIMEOUT_MS, &transferred)) {
+                req->request[transferred] = '\0';
+                // Strip trailing newline from line-oriented clients
+                while (transferred > 0 && (req->request[transferred - 1] == '\n' || req->request[transferred - 1] == '\r')) {
+                    req->request[--transferred] = '\0';
+                }
+
+                // The posted message holds its own reference, released by the
+                // UI thread once handled
+                InterlockedIncrement(&req->refs);
+                const char* response = "ERR busy";
+                if (PostMessage(g_app.hWnd, WM_LEASE_REQUEST, 0, (LPARAM)req)) {
+                    HANDLE handles[2] = { g_hLeaseStopEvent, req->hDone };
+                    if (WaitForMultipleObjects(2, handles, FALSE, LEASE_CLIENT_TIMEOUT_MS) != WAIT_OBJECT_0 + 1) {
+                        InterlockedExchange(&req->abandoned, 1);
+                    }
+                    // The response is only complete once hDone is set; the UI
+                    // thread may still be writing it otherwise
+                    if (WaitForSingleObject(req->hDone, 0) == WAIT_OBJECT_0) {
+                        response = req->response;
+                    }
+                } else {
+                    ReleaseLeaseRequest(req);
+                }
+
+                ResetEvent(ov.hEvent);
+                started = WriteFile(hPipe, response, (DWORD)strlen(response), &transferred, &ov);
+                WaitForLeasePipeIo(hPipe, &ov, started, LEASE_CLIENT_TIMEOUT_MS, &transferred);
+            }
+            ReleaseLeaseRequest(req);
+        }
+
+        // Keep the instance (and the name) for the next client
+        DisconnectNamedPipe(hPipe);
+    }
+
+    CloseHandle(hPipe);
+    CloseHandle(ov.hEvent);
+    return 0;
+}
+
+void StartLeaseServer() {
+    if (g_hLeaseServerThread) return;
+
+    HANDLE hPipe = CreateLeasePipe();
+    if (hPipe == INVALID_HANDLE_VALUE) return;
+
+    g_hLeaseStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!g_hLeaseStopEvent) {
+        CloseHandle(hPipe);
+        return;
+    }
+
+    g_hLeaseServerThread = CreateThread(NULL, 0, LeaseServerThread, hPipe, 0, NULL);
+    if (!g_hLeaseServerThread) {
+        CloseHandle(hPipe);
+        CloseHandle(g_hLeaseStopEvent);
+        g_hLeaseStopEvent = NULL;
+    }
+}
+
+void StopLeaseServer() {
+    if (g_hLeaseServerThread) {
+        SetEvent(g_hLeaseStopEvent);
+        // The thread may be waiting for this (now busy) thread to answer a
+        // request; it also wakes on the stop event.
+        WaitForSingleObject(g_hLeaseServerThread, LEASE_CLIENT_TIMEOUT_MS * 2);
+        CloseHandle(g_hLeaseServerThread);
+        g_hLeaseServerThread = NULL;
+    }
+    if (g_hLeaseStopEvent) {
+        CloseHandle(g_hLeaseStopEvent);
+        g_hLeaseStopEvent = NULL;
+    }
+
+    for (int i = 0; i < MAX_IDLE_LEASES; i++) {
+        if (g_leases[i].id != 0) {
+            ReleaseIdleLease(&g_leases[i], "shutdown");
+        }
+    }
+    g_leaseHeapCount = 0;
+}
+#else
+DWORD GetIdleLeaseMonitorMask() {
+    return 0;
+}
+#endif
+
+// Merge idle-inhibit leases and sustained on-screen motion into a per-monitor
+// media array: those monitors are treated exactly like monitors with media.
+void ApplyInhibitMask(int mediaOnMonitor[MAX_MONITOR_COUNT], DWORD inhibitMask) {
+    if (inhibitMask == 0) return;
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (inhibitMask & (1u << i)) {
+            mediaOnMonitor[i] = 1;
+        }
+    }
+}
+
+// Check if a Windows shell overlay window (Start Menu, Task View, Action Center) is open
+// Returns the number of shell windows detected (0, 1, or 2 if both Start Menu and Action Center)
+int IsShellWindowOpen() {
+    HWND hFg = GetForegroundWindow();
+    if (!hFg) {
+        LogMessage("Shell detection: No foreground window");
+        return 0;
+    }
+
+    char processName[MAX_PATH] = {0};
+    if (!GetProcessNameFromHwnd(hFg, processName, sizeof(processName))) {
+        LogMessage("Shell detection: Could not get process name for foreground window");
+        return 0;
+    }
+
+    char className[256] = {0};
+    GetClassNameA(hFg, className, sizeof(className));
+
+    LogMessage("Shell detection: Foreground window - process='%s', class='%s'", processName, className);
+
+    int shellWindowCount = 0;
+
+    // Check for known shell host processes
+    // ShellExperienceHost.exe - Start Menu, Action Center on Windows 11
+    // SearchHost.exe - Windows Search/Start Menu
+    // StartMenuExperienceHost.exe - Start Menu on Windows 10
+    // ShellHost.exe - Action Center / Control Center on Windows 11
+    if (_stricmp(processName, "ShellExperienceHost.exe") == 0 ||
+        _stricmp(processName, "SearchHost.exe") == 0 ||
+        _stricmp(processName, "StartMenuExperienceHost.exe") == 0 ||
+        _stricmp(processName, "ShellHost.exe") == 0) {
+
+        LogMessage("Shell detection: Shell host process detected: %s", processName);
+        shellWindowCount = 1;
+    }
+
+    // Additional check: Task View is hosted by explorer.exe with specific window classes
+    if (_stricmp(processName, "explorer.exe") == 0) {
+        // Task View uses Windows.UI.Core.CoreWindow or XamlExplorerHostIslandWindow
+        if (strstr(className, "Windows.UI.Core.CoreWindow") != NULL ||
+            strstr(className, "XamlExplorerHostIslandWindow") != NULL) {
+
+            LogMessage("Shell detection: Explorer shell window detected: class=%s", className);
+            shellWindowCount = 1;
+        }
+    }
+
+    if (shellWindowCount == 0) {
+        LogMessage("Shell detection: No shell windows detected");
+    }
+
+    return shellWindowCount;
+}
+
+// Send Escape key(s) to close shell windows (Start Menu, Task View, Action Center)
+void CloseShellWindows(int escapeCount) {
+    LogMessage("Sending %d Escape key(s) to close shell windows", escapeCount);
+
+    for (int i = 0; i < escapeCount; i++) {
+        INPUT input[2] = {0};
+
+        // Key down
+        input[0].type = INPUT_KEYBOARD;
+        input[0].ki.wVk = VK_ESCAPE;
+        input[0].ki.dwFlags = 0;
+
+        // Key up
+        input[1].type = INPUT_KEYBOARD;
+        input[1].ki.wVk = VK_ESCAPE;
+        input[1].ki.dwFlags = KEYEVENTF_KEYUP;
+
+        UINT sent = SendInput(2, input, sizeof(INPUT));
+        LogMessage("SendInput returned %u (expected 2)", sent);
+
+        // Small delay between escape presses if sending multiple
+        if (i < escapeCount - 1) {
+            Sleep(50);
+        }
+    }
+}
+
+void ShowScreenSaverOnMonitor(int monitorIndex, int isManual) {
+    if (monitorIndex < 0 || monitorIndex >= g_monitorCount) return;
+    if (!g_monitorStates[monitorIndex].enabled) return;
+    if (g_monitorStates[monitorIndex].screenSaverActive) return;
+
+    if (g_app.config.perMonitorInputDetection) {
+        int wasInactiveCount = 0;
+        for (int i = 0; i < g_monitorCount; i++) {
+            if (g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
+                wasInactiveCount++;
+            }
+        }
+
+        if (wasInactiveCount == 1) {
+            int sentEscapeKeys = 0;
+            for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
+                int shellWindowCount = IsShellWindowOpen();
+                if (shellWindowCount > 0) {
+                    LogMessage("Shell window(s) detected before last monitor activation (attempt %d), closing them", attempt + 1);
+                    CloseShellWindows(1);
+                    Sleep(SHELL_CLOSE_DELAY_MS);
+                    sentEscapeKeys = 1;
+                } else {
+                    break;
+                }
+            }
+
+            if (sentEscapeKeys) {
+                // The Escape keys sent via SendInput update GetLastInputInfo,
+                // which would make the next timer tick think the user is active
+                // and deactivate the screen saver. Use the manual-activation
+                // cooldown to suppress deactivation for a short period, instead
+                // of resetting lastInputTime (which would also deactivate the
+                // monitor we just activated).
+                g_app.isManualActivation = 1;
+                g_app.manualActivationTime = GetTickCount();
+            }
+        }
+    } else {
+        int sentEscapeKeys = 0;
+        for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
+            int shellWindowCount = IsShellWindowOpen();
+            if (shellWindowCount > 0) {
+                LogMessage("Shell window(s) detected before screen saver activation (attempt %d), closing them", attempt + 1);
+                CloseShellWindows(1);
+                Sleep(SHELL_CLOSE_DELAY_MS);
+                sentEscapeKeys = 1;
+            } else {
+                break;
+            }
+        }
+
+        if (sentEscapeKeys) {
+            g_app.isManualActivation = 1;
+            g_app.manualActivationTime = GetTickCount();
+        }
+    }
+
+    PresentScreenSaverWindow(monitorIndex);
+}
+
+// Create (or reuse) and show the black window on one monitor. This is the
+// part of ShowScreenSaverOnMonitor that does not probe for shell windows, for
+// callers that must not wait (global hotkeys).
+void PresentScreenSaverWindow(int monitorIndex) {
+    int wasActive = g_monitorStates[monitorIndex].screenSaverActive;
+
+    if (g_monitorStates[monitorIndex].hScreenSaverWnd) {
+        // Reposition and resize in case the pixel shift compensation setting changed since the
+        // window was last created.
+        LONG_PTR exStyle = GetWindowLongPtrW(g_monitorStates[monitorIndex].hScreenSaverWnd, GWL_EXSTYLE);
+        if ((exStyle & WS_EX_NOACTIVATE) == 0) {
+            SetWindowLongPtrW(g_monitorStates[monitorIndex].hScreenSaverWnd, GWL_EXSTYLE, exStyle | WS_EX_NOACTIVATE);
+        }
+        int pad = g_app.config.pixelShiftCompensation;
+        SetWindowPos(g_monitorStates[monitorIndex].hScreenSaverWnd, HWND_TOPMOST,
+                     g_monitors[monitorIndex].rect.left   - pad,
+                     g_monitors[monitorIndex].rect.top    - pad,
+                     g_monitors[monitorIndex].rect.right  - g_monitors[monitorIndex].rect.left + pad * 2,
+                     g_monitors[monitorIndex].rect.bottom - g_monitors[monitorIndex].rect.top  + pad * 2,
+                     SWP_NOACTIVATE);
+        ShowWindow(g_monitorStates[monitorIndex].hScreenSaverWnd, SW_SHOWNOACTIVATE);
+        UpdateWindow(g_monitorStates[monitorIndex].hScreenSaverWnd);
+        g_monitorStates[monitorIndex].screenSaverActive = 1;
+        LogMessage("Screen saver window shown on monitor %d (reused)", monitorIndex);
+    } else {
+        // Expand the window beyond the monitor's reported bounds by the pixel shift compensation
+        // amount on all four sides. This ensures hardware pixel shift (used by some OLED panels
+        // to reduce burn-in) cannot expose the desktop behind the screen saver window.
+        int pad = g_app.config.pixelShiftCompensation;
+        HWND hWnd = CreateWindowExW(WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
+                                    L"OLEDAegisScreen", L"",
+                                   WS_POPUP,
+                                   g_monitors[monitorIndex].rect.left   - pad,
+                                   g_monitors[monitorIndex].rect.top    - pad,
+                                   g_monitors[monitorIndex].rect.right  - g_monitors[monitorIndex].rect.left + pad * 2,
+                                   g_monitors[monitorIndex].rect.bottom - g_monitors[monitorIndex].rect.top  + pad * 2,
+                                   NULL, NULL, GetModuleHandle(NULL), NULL);
+
+        if (hWnd) {
+            ShowWindow(hWnd, SW_SHOWNOACTIVATE);
+            UpdateWindow(hWnd);
+            g_monitorStates[monitorIndex].hScreenSaverWnd = hWnd;
+            g_monitorStates[monitorIndex].screenSaverActive = 1;
+            LogMessage("Screen saver window created on monitor %d", monitorIndex);
+        }
+    }
+
+    if (!wasActive && g_monitorStates[monitorIndex].screenSaverActive) {
+        WearRecordActivation(monitorIndex);
+    }
+
+    if (!g_app.config.perMonitorInputDetection) {
+        HideCursorForScreenSaver("screen saver activation");
+    }
+}
+
+void ShowScreenSaver(int isManual) {
+    if (g_app.screenSaverActive && !g_app.config.perMonitorInputDetection) return;
+
+    if (g_app.config.perMonitorInputDetection && !isManual) {
+        return;
+    }
+
+    if (isManual) {
+        g_app.isManualActivation = 1;
+        g_app.manualActivationTime = GetTickCount();
+        LogMessage("Showing screen saver (manual activation)");
+    }
+
+    if (!g_app.config.perMonitorInputDetection) {
+        int sentEscapeKeys = 0;
+        for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
+            int shellWindowCount = IsShellWindowOpen();
+            if (shellWindowCount > 0) {
+                LogMessage("Shell window(s) detected before screen saver activation (attempt %d), closing them", attempt + 1);
+                CloseShellWindows(1);
+                Sleep(SHELL_CLOSE_DELAY_MS);
+                sentEscapeKeys = 1;
+            } else {
+                break;
+            }
+        }
+
+        if (sentEscapeKeys && !isManual) {
+            g_app.isManualActivation = 1;
+            g_app.manualActivationTime = GetTickCount();
+            LogMessage("Showing screen saver (automatic activation, with input cooldown due to shell window closure)");
+        } else if (!isManual) {
+            g_app.isManualActivation = 0;
+            g_app.manualActivationTime = 0;
+            LogMessage("Showing screen saver (automatic activation)");
+        }
+    }
+
+    LogMessage("%d monitors detected", g_monitorCount);
+
+    int windowsCreated = 0;
+    time_t now = time(NULL);
+
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
+            if (g_app.config.perMonitorInputDetection) {
+                g_monitorStates[i].lastInputTime = now;
+            }
+            ShowScreenSaverOnMonitor(i, isManual);
+            windowsCreated++;
+        }
+    }
+
+    LogMessage("Activated screen saver on %d monitors", windowsCreated);
+
+    g_app.screenSaverActive = 1;
+}
+
+void HideScreenSaver() {
+    if (!g_app.screenSaverActive && !IsAnyMonitorActive()) return;
+
+    LogMessage("Hiding screen saver");
+
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (g_monitorStates[i].screenSaverActive) {
+            HideScreenSaverOnMonitor(i);
+        }
+    }
+
+    g_app.screenSaverActive = 0;
+    g_app.manualActivationTime = 0;
+    g_app.isManualActivation = 0;
+
+    EnsureCursorVisible("screen saver hidden");
+}
+
+void EnsureScreenSaverTopmost() {
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (g_monitorStates[i].screenSaverActive && g_monitorStates[i].hScreenSaverWnd) {
+            SetWindowPos(g_monitorStates[i].hScreenSaverWnd, HWND_TOPMOST,
+                        0, 0, 0, 0,
+                        SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+        }
+    }
+}
+
+void GetMemoryFootprint(MemoryFootprint* footprint) {
+    memset(footprint, 0, sizeof(*footprint));
+
+    PROCESS_MEMORY_COUNTERS_EX pmc = {0};
+    pmc.cb = sizeof(pmc);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
+        footprint->privateBytes = pmc.PrivateUsage;
+        footprint->workingSet = pmc.WorkingSetSize;
+        footprint->peakWorkingSet = pmc.PeakWorkingSetSize;
+    }
+
+    footprint->gdiHandles = GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS);
+    footprint->userHandles = GetGuiResources(GetCurrentProcess(), GR_USEROBJECTS);
+}
+
+// Return unused heap and working-set pages to the OS. Pages touched again
+// (e.g. on the next media scan) are soft-faulted back in.
+void TrimWorkingSet(const char* reason) {
+    MemoryFootprint before;
+    GetMemoryFootprint(&before);
+
+    HeapCompact(GetProcessHeap(), 0);
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+    g_workingSetTrimCount++;
+
+    MemoryFootprint after;
+    GetMemoryFootprint(&after);
+    LogMessage("Memory: working set trimmed (%s): %lu KB -> %lu KB",
+               reason ? reason : "unknown",
+               (unsigned long)(before.workingSet / 1024), (unsigned long)(after.workingSet / 1024));
+}
+
+// Append one footprint sample to the soak log (CSV, one row per sample) so
+// memory and handle growth can be tracked over long runs.
+void WriteMemorySoakSample(const MemoryFootprint* footprint) {
+    char appDataPath[MAX_PATH];
+    char soakPath[MAX_PATH];
+    GetAppDataPath(appDataPath, sizeof(appDataPath));
+    sprintf_s(soakPath, sizeof(soakPath), "%s\\oled_aegis_memory.csv", appDataPath);
+
+    FILE* f = fopen(soakPath, "a");
+    if (!f) return;
+
+    if (ftell(f) == 0) {
+        fprintf(f, "unixTime,uptimeSec,privateKB,workingSetKB,peakWorkingSetKB,gdiHandles,userHandles,trimCount\n");
+    }
+    fprintf(f, "%lld,%lu,%lu,%lu,%lu,%lu,%lu,%d\n",
+            (long long)time(NULL),
+            (unsigned long)((GetTickCount() - g_memoryStartTick) / 1000),
+            (unsigned long)(footprint->privateBytes / 1024),
+            (unsigned long)(footprint->workingSet / 1024),
+            (unsigned long)(footprint->peakWorkingSet / 1024),
+            (unsigned long)footprint->gdiHandles,
+            (unsigned long)footprint->userHandles,
+            g_workingSetTrimCount);
+    fclose(f);
+}
+
+// Called once per timer tick. Samples the memory footprint at a low rate and,
+// when memoryTrimEnabled is set, trims the working set once after a long
+// period without any screen saver state change.
+void UpdateMemoryManagement() {
+    DWORD nowTick = GetTickCount();
+
+    DWORD activeMask = 0;
+    for (int i = 0; i < g_monitorCount && i < 32; i++) {
+        if (g_monitorStates[i].screenSaverActive) {
+            activeMask |= (1u << i);
+        }
+    }
+
+    if (g_memoryStartTick == 0) {
+        g_memoryStartTick = nowTick;
+        g_lastSteadyStateTick = nowTick;
+        g_lastMemorySampleTick = nowTick;
+    }
+
+    if (activeMask != g_lastActiveMask || g_hSettingsDialog) {
+        g_lastActiveMask = activeMask;
+        g_lastSteadyStateTick = nowTick;
+        g_trimmedThisSteadyPeriod = 0;
+    }
+
+    if (g_app.config.memoryTrimEnabled && !g_trimmedThisSteadyPeriod &&
+        (DWORD)(nowTick - g_lastSteadyStateTick) >= MEMORY_TRIM_STEADY_MS) {
+        TrimWorkingSet("steady state");
+        g_trimmedThisSteadyPeriod = 1;
+    }
+
+    if ((g_app.config.debugMode || g_app.config.memorySoakLog) &&
+        (DWORD)(nowTick - g_lastMemorySampleTick) >= MEMORY_SAMPLE_INTERVAL_MS) {
+        g_lastMemorySampleTick = nowTick;
+
+        MemoryFootprint footprint;
+        GetMemoryFootprint(&footprint);
+        LogMessage("Memory: private=%lu KB, workingSet=%lu KB (peak %lu KB), gdi=%lu, user=%lu, trims=%d",
+                   (unsigned long)(footprint.privateBytes / 1024),
+                   (unsigned long)(footprint.workingSet / 1024),
+                   (unsigned long)(footprint.peakWorkingSet / 1024),
+                   (unsigned long)footprint.gdiHandles,
+                   (unsigned long)footprint.userHandles,
+                   g_workingSetTrimCount);
+        if (g_app.config.memorySoakLog) {
+            WriteMemorySoakSample(&footprint);
+        }
+    }
+}
+
+#if OLED_FEATURE_WEAR_STATS
+// ---------------------------------------------------------------------------
+// Panel wear accounting
+//
+// Per monitor device path, accumulates time the panel was on and uncovered,
+// time it was covered, time it stayed uncovered past the idle timeout because
+// something blocked the screen saver (media, a lease, a manual deactivation),
+// and the number of activations. Counters are kept in memory and appended to
+// oled_aegis_wear.bin every WEAR_FLUSH_INTERVAL_MS, on suspend, at midnight
+// and at exit. The file is a sequence of records:
+//
+//   WearRecordHeader { magic 'OAWR', type, size, day (YYYYMMDD), pathHash }
+//   type WEAR_RECORD_COUNTERS: + WearRecordCounters (seconds/activations
+//                              accumulated since the previous flush)
+//   type WEAR_RECORD_NAME:     + the device path (size - header bytes)
+//
+// Summing the counter records with the same day and pathHash gives the daily
+// rollup; a name record is written once per path per session so tools can
+// map hashes back to monitors. Time spent with the display powered off or the
+// system asleep is not counted.
+//
+// Flushes add up to 48 counter records per monitor per day. Once the file
+// holds WEAR_COMPACT_SLACK more records than its rollup needs (checked at
+// load and at midnight), it is rewritten with one counter record per day and
+// path and one name record per path, through a temporary file.
+// ---------------------------------------------------------------------------
+
+#define WEAR_RECORD_MAGIC       0x5257414F      // "OAWR"
+#define WEAR_RECORD_COUNTERS    1
+#define WEAR_RECORD_NAME        2
+
+#pragma pack(push, 1)
+typedef struct {
+    DWORD magic;
+    WORD type;
+    WORD size;              // Total record size including this header
+    DWORD day;              // Local date as YYYYMMDD
+    DWORD pathHash;         // FNV-1a of the lower-cased monitor device path
+} WearRecordHeader;
+
+typedef struct {
+    DWORD uncoveredSec;
+    DWORD coveredSec;
+    DWORD blockedSec;
+    DWORD activations;
+} WearRecordCounters;
+#pragma pack(pop)
+
+typedef struct {
+    ULONGLONG uncoveredMs;
+    ULONGLONG coveredMs;
+    ULONGLONG blockedMs;
+    DWORD activations;
+} WearCounters;
+
+typedef struct {
+    DWORD pathHash;
+    int nameWritten;
+    WearCounters total;     // Lifetime, including earlier sessions
+    WearCounters today;
+    WearCounters pending;   // Not yet written to the file
+} WearEntry;
+
+static WearEntry g_wearEntries[MAX_WEAR_ENTRIES];
+static int g_wearEntryCount = 0;
+static int g_wearEntryForMonitor[MAX_MONITOR_COUNT];
+static int g_wearLoaded = 0;
+static DWORD g_wearDay = 0;
+static DWORD g_wearLastTick = 0;
+static DWORD g_wearLastFlushTick = 0;
+static int g_displayPoweredOn = 1;
+static HPOWERNOTIFY g_hDisplayStateNotify = NULL;
+
+DWORD HashDevicePath(const char* path) {
+    DWORD hash = 2166136261u;
+    for (const char* p = path; *p; p++) {
+        char c = *p;
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+DWORD GetLocalDay() {
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    return (DWORD)st.wYear * 10000 + st.wMonth * 100 + st.wDay;
+}
+
+void GetWearFilePath(char* buffer, size_t bufferSize) {
+    char appDataPath[MAX_PATH];
+    GetAppDataPath(appDataPath, sizeof(appDataPath));
+    sprintf_s(buffer, bufferSize, "%s\\oled_aegis_wear.bin", appDataPath);
+}
+
+int FindOrAddWearEntry(DWORD pathHash) {
+    for (int i = 0; i < g_wearEntryCount; i++) {
+        if (g_wearEntries[i].pathHash == pathHash) return i;
+    }
+    if (g_wearEntryCount >= MAX_WEAR_ENTRIES) return -1;
+
+    memset(&g_wearEntries[g_wearEntryCount], 0, sizeof(WearEntry));
+    g_wearEntries[g_wearEntryCount].pathHash = pathHash;
+    return g_wearEntryCount++;
+}
+
+// Map current monitor indices to wear entries. Called after every monitor
+// enumeration once the history has been loaded.
+void RefreshWearMapping() {
+    if (!g_wearLoaded) return;
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        g_wearEntryForMonitor[i] = i < g_monitorCount
+            ? FindOrAddWearEntry(HashDevicePath(g_monitors[i].monitorDevicePath))
+            : -1;
+    }
+}
+
+typedef void (*WearRecordFn)(const WearRecordHeader* header, void* context);
+
+// Call fn for each complete record of the wear file. Returns the number of
+// records; *goodBytes is the offset just past the last one, and *damaged is
+// set if a corrupt or torn tail follows it.
+int ReadWearRecords(const char* path, WearRecordFn fn, void* context, LONGLONG* goodBytes, int* damaged) {
+    *goodBytes = 0;
+    *damaged = 0;
+
+    HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+    BYTE buffer[4096];
+    DWORD filled = 0, bytesRead = 0;
+    int records = 0;
+    int corrupt = 0;
+    while (!corrupt && ReadFile(hFile, buffer + filled, sizeof(buffer) - filled, &bytesRead, NULL) && bytesRead > 0) {
+        filled += bytesRead;
+
+        DWORD offset = 0;
+        while (filled - offset >= sizeof(WearRecordHeader)) {
+            const WearRecordHeader* header = (const WearRecordHeader*)(buffer + offset);
+            if (header->magic != WEAR_RECORD_MAGIC || header->size < sizeof(WearRecordHeader) ||
+                header->size > sizeof(buffer) / 2) {
+                // Torn or foreign data: keep what was read so far
+                LogMessage("Wear: corrupt record after %d records, ignoring the rest of the file", records);
+                corrupt = 1;
+                break;
+            }
+            if (filled - offset < header->size) break;
+
+            fn(header, context);
+            records++;
+            offset += header->size;
+            *goodBytes += header->size;
+        }
+
+        memmove(buffer, buffer + offset, filled - offset);
+        filled -= offset;
+    }
+    CloseHandle(hFile);
+
+    *damaged = corrupt || filled != 0;
+    return records;
+}
+
+// How many records the file would keep compacted. Flushes append in time
+// order, so a day's counter records form one run (a clock change just starts
+// another run, which compaction keeps apart).
+typedef struct {
+    int records;
+    int compacted;
+    DWORD runDay;
+    DWORD runHashes[MAX_WEAR_ENTRIES];  // Paths with counters in the current day run
+    int runCount;
+    DWORD namedHashes[MAX_WEAR_ENTRIES];
+    int namedCount;
+} WearFileStats;
+
+// Returns 1 if hash is new to the set (and adds it while there is room).
+int AddWearHash(DWORD* hashes, int* count, DWORD hash) {
+    for (int i = 0; i < *count; i++) {
+        if (hashes[i] == hash) return 0;
+    }
+    if (*count < MAX_WEAR_ENTRIES) hashes[(*count)++] = hash;
+    return 1;
+}
+
+void CountWearRecord(const WearRecordHeader* header, void* context) {
+    WearFileStats* stats = (WearFileStats*)context;
+    stats->records++;
+    if (header->type == WEAR_RECORD_COUNTERS) {
+        if (header->day != stats->runDay) {
+            stats->runDay = header->day;
+            stats->runCount = 0;
+        }
+        stats->compacted += AddWearHash(stats->runHashes, &stats->runCount, header->pathHash);
+    } else if (header->type == WEAR_RECORD_NAME) {
+        stats->compacted += AddWearHash(stats->namedHashes, &stats->namedCount, header->pathHash);
+    } else {
+        stats->compacted++;
+    }
+}
+
+typedef struct {
+    WearFileStats stats;                // Run and name tracking, as in the count
+    WearRecordCounters sums[MAX_WEAR_ENTRIES];
+    BYTE buffer[4096];
+    DWORD used;
+    HANDLE hFile;
+    int failed;
+} WearCompaction;
+
+void FlushCompactedBytes(WearCompaction* compaction) {
+    DWORD written = 0;
+    if (compaction->used &&
+        (!WriteFile(compaction->hFile, compaction->buffer, compaction->used, &written, NULL) ||
+         written != compaction->used)) {
+        compaction->failed = 1;
+    }
+    compaction->used = 0;
+}
+
+void WriteCompactedBytes(WearCompaction* compaction, const void* data, DWORD size) {
+    if (compaction->used + size > sizeof(compaction->buffer)) {
+        FlushCompactedBytes(compaction);
+    }
+    memcpy(compaction->buffer + compaction->used, data, size);
+    compaction->used += size;
+}
+
+// Write the current day run's sums, one counter record per path.
+void WriteCompactedRun(WearCompaction* compaction) {
+    WearFileStats* run = &compaction->stats;
+    for (int i = 0; i < run->runCount; i++) {
+        BYTE record[sizeof(WearRecordHeader) + sizeof(WearRecordCounters)];
+        WearRecordHeader* header = (WearRecordHeader*)record;
+        header->magic = WEAR_RECORD_MAGIC;
+        header->type = WEAR_RECORD_COUNTERS;
+        header->size = (WORD)sizeof(record);
+        header->day = run->runDay;
+        header->pathHash = run->runHashes[i];
+        memcpy(header + 1, &compaction->sums[i], sizeof(WearRecordCounters));
+        WriteCompactedBytes(compaction, record, sizeof(record));
+    }
+    run->runCount = 0;
+}
+
+void CompactWearRecord(const WearRecordHeader* header, void* context) {
+    WearCompaction* compaction = (WearCompaction*)context;
+    WearFileStats* run = &compaction->stats;
+
+    if (header->type == WEAR_RECORD_COUNTERS &&
+        header->size >= sizeof(WearRecordHeader) + sizeof(WearRecordCounters)) {
+        if (header->day != run->runDay) {
+            WriteCompactedRun(compaction);
+            run->runDay = header->day;
+        }
+        int slot = 0;
+        while (slot < run->runCount && run->runHashes[slot] != header->pathHash) slot++;
+        if (slot == run->runCount) {
+            if (slot >= MAX_WEAR_ENTRIES) {
+                WriteCompactedBytes(compaction, header, header->size);    // No room: keep as is
+                return;
+            }
+            run->runHashes[run->runCount++] = header->pathHash;
+            memset(&compaction->sums[slot], 0, sizeof(WearRecordCounters));
+        }
+        const WearRecordCounters* c = (const WearRecordCounters*)(header + 1);
+        compaction->sums[slot].uncoveredSec += c->uncoveredSec;
+        compaction->sums[slot].coveredSec += c->coveredSec;
+        compaction->sums[slot].blockedSec += c->blockedSec;
+        compaction->sums[slot].activations += c->activations;
+    } else if (header->type == WEAR_RECORD_NAME) {
+        if (AddWearHash(run->namedHashes, &run->namedCount, header->pathHash)) {
+            WriteCompactedBytes(compaction, header, header->size);
+        }
+    } else {
+        WriteCompactedBytes(compaction, header, header->size);
+    }
+}
+
+// Rewrite the wear file with one counter record per day and path. The new
+// file replaces the old one only once completely written.
+// Returns 1 if the file was replaced (which also drops a damaged tail).
+int CompactWearFile(const char* path, const WearFileStats* stats) {
+    char tempPath[MAX_PATH];
+    sprintf_s(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+    WearCompaction compaction;
+    memset(&compaction, 0, sizeof(compaction));
+    compaction.hFile = CreateFileA(tempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (compaction.hFile == INVALID_HANDLE_VALUE) {
+        LogMessage("Wear: cannot create %s (error %lu)", tempPath, GetLastError());
+        return 0;
+    }
+
+    LONGLONG goodBytes;
+    int damaged;
+    ReadWearRecords(path, CompactWearRecord, &compaction, &goodBytes, &damaged);
+    WriteCompactedRun(&compaction);
+    FlushCompactedBytes(&compaction);
+    CloseHandle(compaction.hFile);
+
+    if (!compaction.failed && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        LogMessage("Wear: compacted %d records to %d", stats->records, stats->compacted);
+        return 1;
+    }
+    LogMessage("Wear: compaction failed (error %lu), keeping the file", GetLastError());
+    DeleteFileA(tempPath);
+    return 0;
+}
+
+// Compact the wear file if it holds WEAR_COMPACT_SLACK redundant records.
+int CompactWearFileIfNeeded(const char* path, const WearFileStats* stats) {
+    if (stats->records - stats->compacted < WEAR_COMPACT_SLACK) return 0;
+    return CompactWearFile(path, stats);
+}
+
+void LoadWearRecord(const WearRecordHeader* header, void* context) {
+    CountWearRecord(header, (WearFileStats*)context);
+
+    if (header->type == WEAR_RECORD_COUNTERS &&
+        header->size >= sizeof(WearRecordHeader) + sizeof(WearRecordCounters)) {
+        const WearRecordCounters* c = (const WearRecordCounters*)(header + 1);
+        int idx = FindOrAddWearEntry(header->pathHash);
+        if (idx >= 0) {
+            WearCounters* targets[2] = { &g_wearEntries[idx].total,
+                                         header->day == g_wearDay ? &g_wearEntries[idx].today : NULL };
+            for (int t = 0; t < 2; t++) {
+                if (!targets[t]) continue;
+                targets[t]->uncoveredMs += (ULONGLONG)c->uncoveredSec * 1000;
+                targets[t]->coveredMs += (ULONGLONG)c->coveredSec * 1000;
+                targets[t]->blockedMs += (ULONGLONG)c->blockedSec * 1000;
+                targets[t]->activations += c->activations;
+            }
+        }
+    }
+}
+
+// Read the wear file once at startup to seed lifetime and today's totals.
+void LoadWearHistory() {
+    char path[MAX_PATH];
+    GetWearFilePath(path, sizeof(path));
+
+    g_wearDay = GetLocalDay();
+    g_wearEntryCount = 0;
+
+    WearFileStats stats;
+    memset(&stats, 0, sizeof(stats));
+    LONGLONG goodBytes;
+    int damaged;
+    int records = ReadWearRecords(path, LoadWearRecord, &stats, &goodBytes, &damaged);
+
+    // Drop a torn or corrupt tail so later appends stay readable
+    if (!CompactWearFileIfNeeded(path, &stats) && damaged) {
+        HANDLE hFile = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+        if (hFile != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER end;
+            end.QuadPart = goodBytes;
+            if (SetFilePointerEx(hFile, end, NULL, FILE_BEGIN)) {
+                SetEndOfFile(hFile);
+            }
+            CloseHandle(hFile);
+            LogMessage("Wear: truncated damaged tail at %lld bytes", goodBytes);
+        }
+    }
+
+    g_wearLoaded = 1;
+    RefreshWearMapping();
+    LogMessage("Wear: loaded %d records for %d monitors", records, g_wearEntryCount);
+}
+
+// Midnight: compact the file if the days since the last check left it
+// redundant enough.
+void MaintainWearFile() {
+    char path[MAX_PATH];
+    GetWearFilePath(path, sizeof(path));
+
+    WearFileStats stats;
+    memset(&stats, 0, sizeof(stats));
+    LONGLONG goodBytes;
+    int damaged;
+    ReadWearRecords(path, CountWearRecord, &stats, &goodBytes, &damaged);
+    CompactWearFileIfNeeded(path, &stats);
+}
+
+// Append all pending counters (and name records for paths not yet named this
+// session) to the wear file in a single write.
+void FlushWearCounters() {
+    if (!g_wearLoaded) return;
+    g_wearLastFlushTick = GetTickCount();
+
+    BYTE buffer[MAX_WEAR_ENTRIES * (sizeof(WearRecordHeader) + sizeof(WearRecordCounters)) +
+                MAX_MONITOR_COUNT * (sizeof(WearRecordHeader) + 256)];
+    DWORD used = 0;
+
+    for (int m = 0; m < g_monitorCount; m++) {
+        int idx = g_wearEntryForMonitor[m];
+        if (idx < 0 || g_wearEntries[idx].nameWritten) continue;
+
+        DWORD pathLen = (DWORD)strlen(g_monitors[m].monitorDevicePath);
+        if (pathLen > 256) pathLen = 256;
+        WearRecordHeader* header = (WearRecordHeader*)(buffer + used);
+        header->magic = WEAR_RECORD_MAGIC;
+        header->type = WEAR_RECORD_NAME;
+        header->size = (WORD)(sizeof(WearRecordHeader) + pathLen);
+        header->day = g_wearDay;
+        header->pathHash = g_wearEntries[idx].pathHash;
+        memcpy(header + 1, g_monitors[m].monitorDevicePath, pathLen);
+        used += header->size;
+        g_wearEntries[idx].nameWritten = 1;
+    }
+
+    for (int i = 0; i < g_wearEntryCount; i++) {
+        WearCounters* pending = &g_wearEntries[i].pending;
+        DWORD uncoveredSec = (DWORD)(pending->uncoveredMs / 1000);
+        DWORD coveredSec = (DWORD)(pending->coveredMs / 1000);
+        DWORD blockedSec = (DWORD)(pending->blockedMs / 1000);
+        if (uncoveredSec == 0 && coveredSec == 0 && blockedSec == 0 && pending->activations == 0) {
+            continue;
+        }
+
+        WearRecordHeader* header = (WearRecordHeader*)(buffer + used);
+        header->magic = WEAR_RECORD_MAGIC;
+        header->type = WEAR_RECORD_COUNTERS;
+        header->size = (WORD)(sizeof(WearRecordHeader) + sizeof(WearRecordCounters));
+        header->day = g_wearDay;
+        header->pathHash = g_wearEntries[i].pathHash;
+        WearRecordCounters* c = (WearRecordCounters*)(header + 1);
+        c->uncoveredSec = uncoveredSec;
+        c->coveredSec = coveredSec;
+        c->blockedSec = blockedSec;
+        c->activations = pending->activations;
+        used += header->size;
+
+        // Keep sub-second remainders for the next flush
+        pending->uncoveredMs -= (ULONGLONG)uncoveredSec * 1000;
+        pending->coveredMs -= (ULONGLONG)coveredSec * 1000;
+        pending->blockedMs -= (ULONGLONG)blockedSec * 1000;
+        pending->activations = 0;
+    }
+
+    if (used == 0) return;
+
+    char path[MAX_PATH];
+    GetWearFilePath(path, sizeof(path));
+    HANDLE hFile = CreateFileA(path, FILE_APPEND_DATA, FILE_SHARE_READ, NULL,
+                               OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        LogMessage("Wear: cannot open %s (error %lu)", path, GetLastError());
+        return;
+    }
+    DWORD written = 0;
+    WriteFile(hFile, buffer, used, &written, NULL);
+    CloseHandle(hFile);
+}
+
+void WearRecordActivation(int monitorIndex) {
+    if (!g_wearLoaded || monitorIndex < 0 || monitorIndex >= MAX_MONITOR_COUNT) return;
+    int idx = g_wearEntryForMonitor[monitorIndex];
+    if (idx < 0) return;
+    g_wearEntries[idx].total.activations++;
+    g_wearEntries[idx].today.activations++;
+    g_wearEntries[idx].pending.activations++;
+}
+
+// Per-tick accounting. Cost is a few additions per monitor; the file is only
+// touched on flush.
+void UpdateWearAccounting() {
+    if (!g_wearLoaded) return;
+
+    DWORD nowTick = GetTickCount();
+    DWORD elapsedMs = nowTick - g_wearLastTick;
+    g_wearLastTick = nowTick;
+
+    DWORD day = GetLocalDay();
+    if (day != g_wearDay) {
+        FlushWearCounters();
+        MaintainWearFile();
+        for (int i = 0; i < g_wearEntryCount; i++) {
+            memset(&g_wearEntries[i].today, 0, sizeof(WearCounters));
+        }
+        g_wearDay = day;
+    }
+
+    // A long gap means the timer did not run (sleep, hibernate, hang):
+    // don't attribute it to any state
+    DWORD maxGapMs = (DWORD)g_app.config.checkInterval * 5;
+    if (maxGapMs < 10000) maxGapMs = 10000;
+    if (g_displayPoweredOn && elapsedMs <= maxGapMs) {
+        DWORD idleMs = GetIdleTime();
+        time_t now = time(NULL);
+
+        for (int i = 0; i < g_monitorCount; i++) {
+            int idx = g_wearEntryForMonitor[i];
+            if (idx < 0) continue;
+
+            int pastTimeout;
+            if (g_app.config.perMonitorInputDetection) {
+                pastTimeout = (now - g_monitorStates[i].lastInputTime) >= GetEffectiveIdleTimeout(i);
+            } else {
+                pastTimeout = idleMs > (DWORD)g_app.config.idleTimeout * 1000;
+            }
+
+            WearCounters* counters[3] = { &g_wearEntries[idx].total, &g_wearEntries[idx].today,
+                                          &g_wearEntries[idx].pending };
+            for (int c = 0; c < 3; c++) {
+                if (g_monitorStates[i].screenSaverActive) {
+                    counters[c]->coveredMs += elapsedMs;
+                } else {
+                    counters[c]->uncoveredMs += elapsedMs;
+                    if (g_monitorStates[i].enabled && pastTimeout) {
+                        counters[c]->blockedMs += elapsedMs;
+                    }
+                }
+            }
+        }
+    }
+
+    if ((DWORD)(nowTick - g_wearLastFlushTick) >= WEAR_FLUSH_INTERVAL_MS) {
+        FlushWearCounters();
+    }
+}
+
+void StartWearAccounting() {
+    LoadWearHistory();
+    g_wearLastTick = GetTickCount();
+    g_wearLastFlushTick = g_wearLastTick;
+
+    // Console display on/off/dimmed notifications, so time with the panel
+    // powered down is not counted as uncovered
+    g_hDisplayStateNotify = RegisterPowerSettingNotification(g_app.hWnd, &GUID_CONSOLE_DISPLAY_STATE,
+                                                             DEVICE_NOTIFY_WINDOW_HANDLE);
+}
+
+void StopWearAccounting() {
+    FlushWearCounters();
+    g_wearLoaded = 0;
+    if (g_hDisplayStateNotify) {
+        UnregisterPowerSettingNotification(g_hDisplayStateNotify);
+        g_hDisplayStateNotify = NULL;
+    }
+}
+
+// WM_POWERBROADCAST handling for wear accounting
+void HandleWearPowerEvent(WPARAM wParam, LPARAM lParam) {
+    if (!g_wearLoaded) return;
+
+    if (wParam == PBT_APMSUSPEND) {
+        FlushWearCounters();
+    } else if (wParam == PBT_POWERSETTINGCHANGE && lParam) {
+        const POWERBROADCAST_SETTING* setting = (const POWERBROADCAST_SETTING*)lParam;
+        if (IsEqualGUID(&setting->PowerSetting, &GUID_CONSOLE_DISPLAY_STATE) &&
+            setting->DataLength >= sizeof(DWORD)) {
+            // 0 = off, 1 = on, 2 = dimmed (still lit)
+            g_displayPoweredOn = (*(const DWORD*)setting->Data) != 0;
+            LogMessage("Wear: display %s", g_displayPoweredOn ? "on" : "off");
+        }
+    }
+}
+
+// Summary of a monitor's wear counters for --stats (one line) and the
+// settings dialog (multiline: activations and today's totals on a second
+// line, so the label's width fits both).
+void FormatWearSummary(int monitorIndex, int multiline, char* buffer, size_t bufferSize) {
+    int idx = (g_wearLoaded && monitorIndex >= 0 && monitorIndex < MAX_MONITOR_COUNT)
+              ? g_wearEntryForMonitor[monitorIndex] : -1;
+    if (idx < 0) {
+        buffer[0] = '\0';
+        return;
+    }
+
+    const WearCounters* total = &g_wearEntries[idx].total;
+    const WearCounters* today = &g_wearEntries[idx].today;
+    sprintf_s(buffer, bufferSize,
+              "Uncovered %.1fh (blocked %.1fh), covered %.1fh%s%lu activations; today %.1fh/%.1fh",
+              total->uncoveredMs / 3600000.0, total->blockedMs / 3600000.0,
+              total->coveredMs / 3600000.0, multiline ? "\n" : ", ", (unsigned long)total->activations,
+              today->uncoveredMs / 3600000.0, today->coveredMs / 3600000.0);
+}
+#else
+void WearRecordActivation(int monitorIndex) {
+    (void)monitorIndex;
+}
+#endif
+
+#if OLED_FEATURE_BURNIN_MAP
+// ---------------------------------------------------------------------------
+// Static-region burn-in heatmap
+//
+// While a monitor is uncovered, a heavily downscaled frame of it is captured
+// every g_burnInIntervalMs into one reused DIB section (BURNIN_GRID_COLS x
+// BURNIN_GRID_ROWS cells, BURNIN_SUPERSAMPLE^2 point samples per cell). Per
+// cell we keep the mean luminance and for how many seconds it has stayed
+// within BURNIN_STILL_THRESHOLD of the previous sample. Cells that have been
+// still for burnInStaticSec and are at least BURNIN_MIN_LUMA bright are
+// merged into rectangles and, with burnInOverlayEnabled, covered by click-
+// through black layered windows of the screen saver window class.
+//
+// Overlays are excluded from screen capture where supported
+// (WDA_EXCLUDEFROMCAPTURE), so sampling keeps seeing the content underneath
+// and lifts an overlay as soon as that content changes. Otherwise cells under
+// an overlay are frozen. Moving the cursor into an overlay lifts it and
+// restarts the stillness count for those cells.
+//
+// Sampling time is measured; if one sample exceeds 1% of the interval, the
+// interval is doubled (up to BURNIN_MAX_INTERVAL_MS).
+// ---------------------------------------------------------------------------
+
+#define BURNIN_CELLS (BURNIN_GRID_COLS * BURNIN_GRID_ROWS)
+
+#ifndef WDA_EXCLUDEFROMCAPTURE
+#define WDA_EXCLUDEFROMCAPTURE 0x00000011
+#endif
+
+typedef struct {
+    BYTE lum[BURNIN_CELLS];
+    BYTE prevLum[BURNIN_CELLS];
+    BYTE frozen[BURNIN_CELLS];                  // 0xFF = don't update (under a captured overlay)
+    WORD stillSec[BURNIN_CELLS];
+    int sampled;                                // prevLum is valid
+    int overlayCount;
+    HWND overlays[BURNIN_MAX_OVERLAYS];
+    RECT overlayCells[BURNIN_MAX_OVERLAYS];     // In cell units, right/bottom exclusive
+    int overlayExcluded[BURNIN_MAX_OVERLAYS];   // Hidden from screen capture
+    int hotCells;
+} BurnInHeatmap;
+
+static BurnInHeatmap g_burnIn[MAX_MONITOR_COUNT];
+static HDC g_hBurnInDC = NULL;
+static HBITMAP g_hBurnInBitmap = NULL;
+static HGDIOBJ g_hBurnInOldBitmap = NULL;
+static BYTE* g_burnInPixels = NULL;
+static DWORD g_burnInIntervalMs = BURNIN_SAMPLE_INTERVAL_MS;
+static DWORD g_burnInLastSampleTick = 0;
+static LONGLONG g_burnInStartUs = 0;
+static LONGLONG g_burnInTotalSampleUs = 0;
+static LONGLONG g_burnInLastSampleUs = 0;
+static int g_burnInSampleCount = 0;
+
+// Mean BT.601 luma of each cell from a BGRA frame where every cell is
+// BURNIN_SUPERSAMPLE (4) pixels wide and tall: one 16-byte load per cell row.
+void ComputeCellLuminance(const BYTE* pixels, int stride, BYTE* lum) {
+    for (int row = 0; row < BURNIN_GRID_ROWS; row++) {
+        const BYTE* cellRow = pixels + (size_t)row * BURNIN_SUPERSAMPLE * stride;
+        for (int col = 0; col < BURNIN_GRID_COLS; col++) {
+            const BYTE* cell = cellRow + col * BURNIN_SUPERSAMPLE * 4;
+            unsigned int sum;
+#if BURNIN_USE_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);  // B, G, R, A (x256)
+            __m128i acc = _mm_setzero_si128();
+            for (int y = 0; y < BURNIN_SUPERSAMPLE; y++) {
+                __m128i px = _mm_loadu_si128((const __m128i*)(cell + (size_t)y * stride));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights));
+            }
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = (unsigned int)_mm_cvtsi128_si32(acc);
+#else
+            sum = 0;
+            for (int y = 0; y < BURNIN_SUPERSAMPLE; y++) {
+                const BYTE* p = cell + (size_t)y * stride;
+                for (int x = 0; x < BURNIN_SUPERSAMPLE; x++, p += 4) {
+                    sum += p[0] * 29u + p[1] * 150u + p[2] * 77u;
+                }
+            }
+#endif
+            lum[row * BURNIN_GRID_COLS + col] =
+                (BYTE)(sum / (BURNIN_SUPERSAMPLE * BURNIN_SUPERSAMPLE * 256));
+        }
+    }
+}
+
+// Advance the per-cell stillness counters: cells whose luma moved by more than
+// threshold restart at 0, the rest gain addSec (saturating). Frozen cells keep
+// their previous luma and counter. count must be a multiple of 16.
+void UpdateCellStillness(BurnInHeatmap* map, int count, BYTE threshold, WORD addSec) {
+#if BURNIN_USE_SSE2
+    const __m128i thr = _mm_set1_epi8((char)threshold);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i add = _mm_set1_epi16((short)addSec);
+    for (int i = 0; i < count; i += 16) {
+        __m128i cur = _mm_loadu_si128((const __m128i*)(map->lum + i));
+        __m128i prev = _mm_loadu_si128((const __m128i*)(map->prevLum + i));
+        __m128i fz = _mm_loadu_si128((const __m128i*)(map->frozen + i));
+
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(cur, prev), _mm_subs_epu8(prev, cur));
+        __m128i still = _mm_cmpeq_epi8(_mm_subs_epu8(diff, thr), zero);  // 0xFF where |diff| <= thr
+
+        _mm_storeu_si128((__m128i*)(map->prevLum + i),
+                        _mm_or_si128(_mm_and_si128(fz, prev), _mm_andnot_si128(fz, cur)));
+
+        for (int half = 0; half < 2; half++) {
+            __m128i* counters = (__m128i*)(map->stillSec + i + half * 8);
+            __m128i old = _mm_loadu_si128(counters);
+            __m128i still16 = half ? _mm_unpackhi_epi8(still, still) : _mm_unpacklo_epi8(still, still);
+            __m128i fz16 = half ? _mm_unpackhi_epi8(fz, fz) : _mm_unpacklo_epi8(fz, fz);
+            __m128i updated = _mm_and_si128(_mm_adds_epu16(old, add), still16);
+            _mm_storeu_si128(counters, _mm_or_si128(_mm_and_si128(fz16, old), _mm_andnot_si128(fz16, updated)));
+        }
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        if (map->frozen[i]) continue;
+        int diff = (int)map->lum[i] - (int)map->prevLum[i];
+        if (diff < 0) diff = -diff;
+        if (diff <= threshold) {
+            unsigned int still = (unsigned int)map->stillSec[i] + addSec;
+            map->stillSec[i] = (WORD)(still > 0xFFFF ? 0xFFFF : still);
+        } else {
+            map->stillSec[i] = 0;
+        }
+        map->prevLum[i] = map->lum[i];
+    }
+#endif
+}
+
+int EnsureBurnInSurface() {
+    if (g_hBurnInDC) return 1;
+
+    BITMAPINFO bmi = {0};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = BURNIN_GRID_COLS * BURNIN_SUPERSAMPLE;
+    bmi.bmiHeader.biHeight = -(BURNIN_GRID_ROWS * BURNIN_SUPERSAMPLE);  // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    g_hBurnInDC = CreateCompatibleDC(NULL);
+    if (!g_hBurnInDC) return 0;
+    g_hBurnInBitmap = CreateDIBSection(g_hBurnInDC, &bmi, DIB_RGB_COLORS, (void**)&g_burnInPixels, NULL, 0);
+    if (!g_hBurnInBitmap) {
+        DeleteDC(g_hBurnInDC);
+        g_hBurnInDC = NULL;
+        return 0;
+    }
+    g_hBurnInOldBitmap = SelectObject(g_hBurnInDC, g_hBurnInBitmap);
+    SetStretchBltMode(g_hBurnInDC, COLORONCOLOR);
+    return 1;
+}
+
+void RemoveBurnInOverlays(int monitorIndex) {
+    BurnInHeatmap* map = &g_burnIn[monitorIndex];
+    for (int k = 0; k < map->overlayCount; k++) {
+        if (map->overlays[k]) {
+            DestroyWindow(map->overlays[k]);
+            map->overlays[k] = NULL;
+        }
+    }
+    map->overlayCount = 0;
+    memset(map->frozen, 0, sizeof(map->frozen));
+}
+
+void ReleaseBurnInResources() {
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        RemoveBurnInOverlays(i);
+        g_burnIn[i].sampled = 0;
+    }
+    if (g_hBurnInDC) {
+        SelectObject(g_hBurnInDC, g_hBurnInOldBitmap);
+        DeleteObject(g_hBurnInBitmap);
+        DeleteDC(g_hBurnInDC);
+        g_hBurnInDC = NULL;
+        g_hBurnInBitmap = NULL;
+        g_burnInPixels = NULL;
+    }
+}
+
+// Merge hot cells into rectangles: horizontal runs per row, extended downward
+// while the run below has exactly the same span. Returns the rectangle count
+// (largest BURNIN_MAX_OVERLAYS kept).
+int FindHotRegions(const BYTE* hot, RECT* regions) {
+    RECT candidates[BURNIN_CELLS / 2];
+    int count = 0;
+
+    for (int row = 0; row < BURNIN_GRID_ROWS; row++) {
+        int col = 0;
+        while (col < BURNIN_GRID_COLS) {
+            if (!hot[row * BURNIN_GRID_COLS + col]) {
+                col++;
+                continue;
+            }
+            int start = col;
+            while (col < BURNIN_GRID_COLS && hot[row * BURNIN_GRID_COLS + col]) col++;
+
+            int merged = 0;
+            for (int k = 0; k < count; k++) {
+                if (candidates[k].bottom == row && candidates[k].left == start && candidates[k].right == col) {
+                    candidates[k].bottom = row + 1;
+                    merged = 1;
+                    break;
+                }
+            }
+            if (!merged && count < (int)(sizeof(candidates) / sizeof(candidates[0]))) {
+                SetRect(&candidates[count++], start, row, col, row + 1);
+            }
+        }
+    }
+
+    // Keep the largest regions (selection sort; count is small in practice)
+    int kept = 0;
+    while (kept < BURNIN_MAX_OVERLAYS && kept < count) {
+        int best = kept;
+        for (int k = kept + 1; k < count; k++) {
+            if (RectArea(&candidates[k]) > RectArea(&candidates[best])) best = k;
+        }
+        if (RectArea(&candidates[best]) < BURNIN_MIN_REGION_CELLS) break;
+        RECT tmp = candidates[kept];
+        candidates[kept] = candidates[best];
+        candidates[best] = tmp;
+        regions[kept] = candidates[kept];
+        kept++;
+    }
+    return kept;
+}
+
+void CellRectToScreen(int monitorIndex, const RECT* cells, RECT* screen) {
+    const RECT* m = &g_monitors[monitorIndex].rect;
+    int width = m->right - m->left;
+    int height = m->bottom - m->top;
+    screen->left = m->left + MulDiv(cells->left, width, BURNIN_GRID_COLS);
+    screen->right = m->left + MulDiv(cells->right, width, BURNIN_GRID_COLS);
+    screen->top = m->top + MulDiv(cells->top, height, BURNIN_GRID_ROWS);
+    screen->bottom = m->top + MulDiv(cells->bottom, height, BURNIN_GRID_ROWS);
+}
+
+// Bring the monitor's overlay windows in line with the given regions, reusing
+// existing windows where possible.
+void UpdateBurnInOverlays(int monitorIndex, const RECT* regions, int regionCount) {
+    BurnInHeatmap* map = &g_burnIn[monitorIndex];
+
+    int same = (regionCount == map->overlayCount);
+    for (int k = 0; same && k < regionCount; k++) {
+        same = EqualRect(&regions[k], &map->overlayCells[k]);
+    }
+    if (same) return;
+
+    memset(map->frozen, 0, sizeof(map->frozen));
+    for (int k = regionCount; k < map->overlayCount; k++) {
+        DestroyWindow(map->overlays[k]);
+        map->overlays[k] = NULL;
+    }
+
+    for (int k = 0; k < regionCount; k++) {
+        RECT screen;
+        CellRectToScreen(monitorIndex, &regions[k], &screen);
+
+        if (k >= map->overlayCount || !map->overlays[k]) {
+            map->overlays[k] = CreateWindowExW(WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST |
+                                               WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
+                                               L"OLEDAegisScreen", L"", WS_POPUP,
+                                               screen.left, screen.top,
+                                               screen.right - screen.left, screen.bottom - screen.top,
+                                               NULL, NULL, GetModuleHandle(NULL), NULL);
+            if (!map->overlays[k]) continue;
+            SetLayeredWindowAttributes(map->overlays[k], 0, (BYTE)g_app.config.burnInOverlayAlpha, LWA_ALPHA);
+            // Not available before Windows 10 2004; then the overlay shows up
+            // in our own capture and the cells under it are frozen instead
+            map->overlayExcluded[k] = SetWindowDisplayAffinity(map->overlays[k], WDA_EXCLUDEFROMCAPTURE) ? 1 : 0;
+        } else {
+            SetWindowPos(map->overlays[k], HWND_TOPMOST, screen.left, screen.top,
+                         screen.right - screen.left, screen.bottom - screen.top, SWP_NOACTIVATE);
+        }
+
+        if (!map->overlayExcluded[k]) {
+            for (int row = regions[k].top; row < regions[k].bottom; row++) {
+                memset(map->frozen + row * BURNIN_GRID_COLS + regions[k].left, 0xFF,
+                       regions[k].right - regions[k].left);
+            }
+        }
+        ShowWindow(map->overlays[k], SW_SHOWNOACTIVATE);
+        map->overlayCells[k] = regions[k];
+    }
+    map->overlayCount = regionCount;
+
+    LogMessage("Burn-in: monitor %d now has %d overlay(s), %d hot cells", monitorIndex, regionCount, map->hotCells);
+}
+
+// Lift overlays the cursor has moved into, and restart stillness under them.
+// Cheap enough to run every timer tick.
+void CheckBurnInOverlayCursor() {
+    POINT pt;
+    GetCursorPos(&pt);
+    int monitorIndex = GetMonitorIndexFromPoint(pt);
+    if (monitorIndex < 0 || monitorIndex >= g_monitorCount) return;
+
+    BurnInHeatmap* map = &g_burnIn[monitorIndex];
+    for (int k = 0; k < map->overlayCount; k++) {
+        RECT screen;
+        CellRectToScreen(monitorIndex, &map->overlayCells[k], &screen);
+        if (PtInRect(&screen, pt)) {
+            for (int row = map->overlayCells[k].top; row < map->overlayCells[k].bottom; row++) {
+                for (int col = map->overlayCells[k].left; col < map->overlayCells[k].right; col++) {
+                    map->stillSec[row * BURNIN_GRID_COLS + col] = 0;
+                }
+            }
+            LogMessage("Burn-in: cursor entered overlay on monitor %d, lifting overlays", monitorIndex);
+            RemoveBurnInOverlays(monitorIndex);
+            return;
+        }
+    }
+}
+
+void SampleBurnInMonitor(HDC hScreenDC, int monitorIndex, WORD elapsedSec) {
+    BurnInHeatmap* map = &g_burnIn[monitorIndex];
+    const RECT* m = &g_monitors[monitorIndex].rect;
+
+    if (!StretchBlt(g_hBurnInDC, 0, 0, BURNIN_GRID_COLS * BURNIN_SUPERSAMPLE, BURNIN_GRID_ROWS * BURNIN_SUPERSAMPLE,
+                    hScreenDC, m->left, m->top, m->right - m->left, m->bottom - m->top, SRCCOPY)) {
+        return;
+    }
+    GdiFlush();
+
+    ComputeCellLuminance(g_burnInPixels, BURNIN_GRID_COLS * BURNIN_SUPERSAMPLE * 4, map->lum);
+    if (!map->sampled) {
+        memcpy(map->prevLum, map->lum, sizeof(map->lum));
+        map->sampled = 1;
+        return;
+    }
+    UpdateCellStillness(map, BURNIN_CELLS, BURNIN_STILL_THRESHOLD, elapsedSec);
+
+    BYTE hot[BURNIN_CELLS];
+    int hotCells = 0;
+    for (int i = 0; i < BURNIN_CELLS; i++) {
+        hot[i] = (map->stillSec[i] >= g_app.config.burnInStaticSec && map->prevLum[i] >= BURNIN_MIN_LUMA);
+        hotCells += hot[i];
+    }
+    map->hotCells = hotCells;
+
+    if (g_app.config.burnInOverlayEnabled) {
+        RECT regions[BURNIN_MAX_OVERLAYS];
+        int regionCount = FindHotRegions(hot, regions);
+        UpdateBurnInOverlays(monitorIndex, regions, regionCount);
+    }
+}
+
+// Called every timer tick when burnInDetectionEnabled is on.
+void UpdateBurnInHeatmap() {
+    if (g_burnInStartUs == 0) {
+        g_burnInStartUs = GetTimestampUs();
+    }
+
+    CheckBurnInOverlayCursor();
+
+    DWORD nowTick = GetTickCount();
+    DWORD elapsedMs = nowTick - g_burnInLastSampleTick;
+    if (g_burnInLastSampleTick != 0 && elapsedMs < g_burnInIntervalMs) return;
+    g_burnInLastSampleTick = nowTick;
+    // After sleep or a long hang, treat the gap as one interval
+    if (elapsedMs > BURNIN_MAX_INTERVAL_MS * 2) elapsedMs = g_burnInIntervalMs;
+
+    if (!EnsureBurnInSurface()) return;
+
+    LONGLONG startUs = GetTimestampUs();
+    HDC hScreenDC = GetDC(NULL);
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (!g_monitorStates[i].enabled || g_monitorStates[i].screenSaverActive) {
+            // Full cover takes over; start over when the monitor is uncovered
+            if (g_burnIn[i].overlayCount > 0) RemoveBurnInOverlays(i);
+            g_burnIn[i].sampled = 0;
+            continue;
+        }
+        SampleBurnInMonitor(hScreenDC, i, (WORD)((elapsedMs + 500) / 1000));
+    }
+    ReleaseDC(NULL, hScreenDC);
+
+    g_burnInLastSampleUs = GetTimestampUs() - startUs;
+    g_burnInTotalSampleUs += g_burnInLastSampleUs;
+    g_burnInSampleCount++;
+
+    // Stay under 1% of one core: a sample may take at most interval/100
+    if (g_burnInLastSampleUs * 100 > (LONGLONG)g_burnInIntervalMs * 1000 &&
+        g_burnInIntervalMs < BURNIN_MAX_INTERVAL_MS) {
+        g_burnInIntervalMs *= 2;
+        LogMessage("Burn-in: sample took %lld us, interval raised to %lu ms",
+                   g_burnInLastSampleUs, (unsigned long)g_burnInIntervalMs);
+    }
+}
+
+// Fraction of one core spent sampling since detection started, in percent.
+double GetBurnInCpuPercent() {
+    LONGLONG wallUs = GetTimestampUs() - g_burnInStartUs;
+    return (g_burnInStartUs != 0 && wallUs > 0) ? g_burnInTotalSampleUs * 100.0 / wallUs : 0.0;
+}
+#endif
+
+#if OLED_FEATURE_MOTION_DETECTION
+// ---------------------------------------------------------------------------
+// Motion-based video detection
+//
+// Audio sessions and window titles miss muted video, video in a background
+// browser tab (the window title shows the active tab), and players without a
+// title hint. As a last signal, each monitor that is about to be covered
+// (enabled, uncovered and close to its idle deadline) is captured at
+// MOTION_FRAME_WIDTH x MOTION_FRAME_HEIGHT into one reused DIB section,
+// reduced to luma and compared with its previous sample. When an audible
+// window could not be classified, only that window's rect is sampled, so a
+// ticking clock or a spinner elsewhere on the monitor does not count.
+//
+// A sample moved when at least MOTION_MIN_CHANGED_PERMILLE of its pixels
+// changed by more than MOTION_PIXEL_THRESHOLD. Motion is sustained when
+// MOTION_SUSTAINED_SAMPLES of the last MOTION_HISTORY_SAMPLES samples moved;
+// such monitors are treated exactly like monitors with media playing.
+//
+// Nothing is captured while the user is active, so the cost only applies in
+// the seconds before a monitor would be covered (and while motion keeps it
+// uncovered). The luma and diff kernels live in oled_motion.h.
+// ---------------------------------------------------------------------------
+
+#define MOTION_PIXELS (MOTION_FRAME_WIDTH * MOTION_FRAME_HEIGHT)
+
+typedef struct {
+    BYTE prevLum[MOTION_PIXELS];
+    int sampled;                        // prevLum is valid
+    RECT source;                        // Screen rect prevLum was captured from
+    DWORD history;                      // One bit per sample, newest in bit 0 (1 = moved)
+    int changedPermille;                // Last sample
+    DWORD lastSampleTick;
+} MotionMonitorState;
+
+typedef struct {
+    RECT rect;                          // Clipped to the monitor
+    DWORD tick;                         // 0 = none
+} MotionCandidate;
+
+static MotionMonitorState g_motion[MAX_MONITOR_COUNT];
+static MotionCandidate g_motionCandidates[MAX_MONITOR_COUNT];
+static DWORD g_motionMask = 0;
+static HDC g_hMotionDC = NULL;
+static HBITMAP g_hMotionBitmap = NULL;
+static HGDIOBJ g_hMotionOldBitmap = NULL;
+static BYTE* g_motionPixels = NULL;
+static LONGLONG g_motionTotalSampleUs = 0;
+static LONGLONG g_motionLastSampleUs = 0;
+static int g_motionSampleCount = 0;
+
+int CountMotionSamples(DWORD history) {
+    int count = 0;
+    for (; history; history &= history - 1) count++;
+    return count;
+}
+
+// Called from the media window scan for audible windows that matched no
+// media hint. Several such windows in one scan: the largest per monitor wins.
+void RecordMotionCandidate(const RECT* windowRect) {
+    int monitorIndex = GetMonitorIndexFromRect(*windowRect);
+    if (monitorIndex < 0 || monitorIndex >= g_monitorCount) return;
+
+    RECT clipped;
+    if (!IntersectRect(&clipped, windowRect, &g_monitors[monitorIndex].rect) ||
+        RectArea(&clipped) < MIN_MEDIA_WINDOW_AREA) {
+        return;
+    }
+
+    MotionCandidate* candidate = &g_motionCandidates[monitorIndex];
+    DWORD nowTick = GetTickCount();
+    if (candidate->tick != 0 && (DWORD)(nowTick - candidate->tick) < MEDIA_DETECTION_CACHE_MS &&
+        RectArea(&candidate->rect) >= RectArea(&clipped)) {
+        return;
+    }
+    candidate->rect = clipped;
+    candidate->tick = nowTick ? nowTick : 1;
+}
+
+int EnsureMotionSurface() {
+    if (g_hMotionDC) return 1;
+
+    BITMAPINFO bmi = {0};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = MOTION_FRAME_WIDTH;
+    bmi.bmiHeader.biHeight = -MOTION_FRAME_HEIGHT;  // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    g_hMotionDC = CreateCompatibleDC(NULL);
+    if (!g_hMotionDC) return 0;
+    g_hMotionBitmap = CreateDIBSection(g_hMotionDC, &bmi, DIB_RGB_COLORS, (void**)&g_motionPixels, NULL, 0);
+    if (!g_hMotionBitmap) {
+        DeleteDC(g_hMotionDC);
+        g_hMotionDC = NULL;
+        return 0;
+    }
+    g_hMotionOldBitmap = SelectObject(g_hMotionDC, g_hMotionBitmap);
+    SetStretchBltMode(g_hMotionDC, COLORONCOLOR);
+    return 1;
+}
+
+void ResetMotionMonitor(int monitorIndex) {
+    g_motion[monitorIndex].sampled = 0;
+    g_motion[monitorIndex].history = 0;
+    g_motion[monitorIndex].changedPermille = 0;
+}
+
+void ReleaseMotionResources() {
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        ResetMotionMonitor(i);
+        g_motionCandidates[i].tick = 0;
+    }
+    g_motionMask = 0;
+    if (g_hMotionDC) {
+        SelectObject(g_hMotionDC, g_hMotionOldBitmap);
+        DeleteObject(g_hMotionBitmap);
+        DeleteDC(g_hMotionDC);
+        g_hMotionDC = NULL;
+        g_hMotionBitmap = NULL;
+        g_motionPixels = NULL;
+    }
+}
+
+void SampleMotionMonitor(HDC hScreenDC, int monitorIndex, const RECT* source) {
+    MotionMonitorState* state = &g_motion[monitorIndex];
+
+    // A different source (candidate window appeared, moved or expired) can't
+    // be compared with the previous frame
+    if (state->sampled && !EqualRect(&state->source, source)) {
+        ResetMotionMonitor(monitorIndex);
+    }
+
+    if (!StretchBlt(g_hMotionDC, 0, 0, MOTION_FRAME_WIDTH, MOTION_FRAME_HEIGHT,
+                    hScreenDC, source->left, source->top, source->right - source->left,
+                    source->bottom - source->top, SRCCOPY)) {
+        return;
+    }
+    GdiFlush();
+
+    BYTE lum[MOTION_PIXELS];
+    MotionLumaFromBgra(g_motionPixels, MOTION_PIXELS, lum);
+    if (state->sampled) {
+        int changed = CountChangedPixels(lum, state->prevLum, MOTION_PIXELS, MOTION_PIXEL_THRESHOLD);
+        state->changedPermille = changed * 1000 / MOTION_PIXELS;
+        state->history = ((state->history << 1) | (state->changedPermille >= MOTION_MIN_CHANGED_PERMILLE)) &
+                         ((1u << MOTION_HISTORY_SAMPLES) - 1);
+    }
+    memcpy(state->prevLum, lum, sizeof(lum));
+    state->source = *source;
+    state->sampled = 1;
+}
+
+// Called every timer tick when motionDetectionEnabled is on, before the
+// activation decision. Updates g_motionMask.
+void UpdateMotionDetection() {
+    DWORD nowTick = GetTickCount();
+    HDC hScreenDC = NULL;
+    LONGLONG startUs = 0;
+
+    // Start early enough to collect a full history before the deadline
+    int sampleMs = g_app.config.checkInterval > MOTION_SAMPLE_INTERVAL_MS ?
+                   g_app.config.checkInterval : MOTION_SAMPLE_INTERVAL_MS;
+    int leadSec = MOTION_LEAD_SEC + (MOTION_HISTORY_SAMPLES * sampleMs + 999) / 1000;
+
+    for (int i = 0; i < g_monitorCount; i++) {
+        MotionMonitorState* state = &g_motion[i];
+        if (!g_monitorStates[i].enabled || g_monitorStates[i].screenSaverActive ||
+            GetMonitorIdleSeconds(i) < GetEffectiveIdleTimeout(i) - leadSec) {
+            // In use or covered (a covered monitor only shows our black window)
+            if (state->sampled) ResetMotionMonitor(i);
+            continue;
+        }
+        if (state->sampled && (DWORD)(nowTick - state->lastSampleTick) < MOTION_SAMPLE_INTERVAL_MS) {
+            continue;
+        }
+
+        RECT source = g_monitors[i].rect;
+        const MotionCandidate* candidate = &g_motionCandidates[i];
+        if (candidate->tick != 0 && (DWORD)(nowTick - candidate->tick) < MOTION_CANDIDATE_TTL_MS) {
+            source = candidate->rect;
+        }
+
+        if (!hScreenDC) {
+            if (!EnsureMotionSurface()) break;
+            startUs = GetTimestampUs();
+            hScreenDC = GetDC(NULL);
+        }
+        SampleMotionMonitor(hScreenDC, i, &source);
+        state->lastSampleTick = nowTick;
+    }
+
+    if (hScreenDC) {
+        ReleaseDC(NULL, hScreenDC);
+        g_motionLastSampleUs = GetTimestampUs() - startUs;
+        g_motionTotalSampleUs += g_motionLastSampleUs;
+        g_motionSampleCount++;
+    }
+
+    DWORD mask = 0;
+    for (int i = 0; i < g_monitorCount && i < 32; i++) {
+        if (CountMotionSamples(g_motion[i].history) >= MOTION_SUSTAINED_SAMPLES) {
+            mask |= (1u << i);
+        }
+    }
+    if (mask != g_motionMask) {
+        LogMessage("Motion detection: mask=0x%08X", mask);
+        g_motionMask = mask;
+    }
+}
 
-    char className[256] = {0};
-    GetClassNameA(hFg, className, sizeof(className));
+DWORD GetMotionMonitorMask() {
+    return g_app.config.motionDetectionEnabled ? g_motionMask : 0;
+}
+#else
+void RecordMotionCandidate(const RECT* windowRect) {
+    (void)windowRect;
+}
 
-    LogMessage("Shell detection: Foreground window - process='%s', class='%s'", processName, className);
+DWORD GetMotionMonitorMask() {
+    return 0;
+}
+#endif
+
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+// ---------------------------------------------------------------------------
+// Brightness-aware per-monitor timeout
+//
+// A white document wears an OLED panel far faster than a dark IDE theme, so
+// with dynamicTimeoutEnabled (per-monitor input mode only) each monitor gets
+// its own timeout between dynamicTimeoutMinSec and dynamicTimeoutMaxSec. The
+// average picture level (APL) is estimated every APL_SAMPLE_INTERVAL_MS from
+// APL_GRID_COLS x APL_GRID_ROWS point samples per monitor (a COLORONCOLOR
+// StretchBlt into one reused DIB section), smoothed over a few samples so a
+// briefly opened bright window doesn't flip the timeout. At or below
+// APL_DARK_LEVEL the maximum applies, at or above APL_BRIGHT_LEVEL the
+// minimum, linear in between. Covered monitors keep their last estimate;
+// until a monitor has been sampled, idleTimeout applies.
+// ---------------------------------------------------------------------------
 
-    int shellWindowCount = 0;
+typedef struct {
+    int apl;                            // Smoothed mean luma 0-255, -1 = not sampled yet
+    int timeoutSec;
+} MonitorApl;
+
+static MonitorApl g_apl[MAX_MONITOR_COUNT];
+static int g_aplInitialized = 0;
+static HDC g_hAplDC = NULL;
+static HBITMAP g_hAplBitmap = NULL;
+static HGDIOBJ g_hAplOldBitmap = NULL;
+static BYTE* g_aplPixels = NULL;
+static DWORD g_aplLastSampleTick = 0;
+static LONGLONG g_aplTotalSampleUs = 0;
+static LONGLONG g_aplLastSampleUs = 0;
+static int g_aplSampleCount = 0;
+
+int AplToTimeoutSec(int apl) {
+    int minSec = g_app.config.dynamicTimeoutMinSec;
+    int maxSec = g_app.config.dynamicTimeoutMaxSec;
+    if (apl <= APL_DARK_LEVEL) return maxSec;
+    if (apl >= APL_BRIGHT_LEVEL) return minSec;
+    return maxSec - (maxSec - minSec) * (apl - APL_DARK_LEVEL) / (APL_BRIGHT_LEVEL - APL_DARK_LEVEL);
+}
 
-    // Check for known shell host processes
-    // ShellExperienceHost.exe - Start Menu, Action Center on Windows 11
-    // SearchHost.exe - Windows Search/Start Menu
-    // StartMenuExperienceHost.exe - Start Menu on Windows 10
-    // ShellHost.exe - Action Center / Control Center on Windows 11
-    if (_stricmp(processName, "ShellExperienceHost.exe") == 0 ||
-        _stricmp(processName, "SearchHost.exe") == 0 ||
-        _stricmp(processName, "StartMenuExperienceHost.exe") == 0 ||
-        _stricmp(processName, "ShellHost.exe") == 0) {
+int IsDynamicTimeoutActive() {
+    return g_app.config.dynamicTimeoutEnabled && g_app.config.perMonitorInputDetection;
+}
 
-        LogMessage("Shell detection: Shell host process detected: %s", processName);
-        shellWindowCount = 1;
+int GetEffectiveIdleTimeout(int monitorIndex) {
+    if (!IsDynamicTimeoutActive() || !g_aplInitialized || g_apl[monitorIndex].apl < 0) {
+        return g_app.config.idleTimeout;
     }
+    return g_apl[monitorIndex].timeoutSec;
+}
 
-    // Additional check: Task View is hosted by explorer.exe with specific window classes
-    if (_stricmp(processName, "explorer.exe") == 0) {
-        // Task View uses Windows.UI.Core.CoreWindow or XamlExplorerHostIslandWindow
-        if (strstr(className, "Windows.UI.Core.CoreWindow") != NULL ||
-            strstr(className, "XamlExplorerHostIslandWindow") != NULL) {
+int EnsureAplSurface() {
+    if (g_hAplDC) return 1;
+
+    BITMAPINFO bmi = {0};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = APL_GRID_COLS;
+    bmi.bmiHeader.biHeight = -APL_GRID_ROWS;  // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    g_hAplDC = CreateCompatibleDC(NULL);
+    if (!g_hAplDC) return 0;
+    g_hAplBitmap = CreateDIBSection(g_hAplDC, &bmi, DIB_RGB_COLORS, (void**)&g_aplPixels, NULL, 0);
+    if (!g_hAplBitmap) {
+        DeleteDC(g_hAplDC);
+        g_hAplDC = NULL;
+        return 0;
+    }
+    g_hAplOldBitmap = SelectObject(g_hAplDC, g_hAplBitmap);
+    SetStretchBltMode(g_hAplDC, COLORONCOLOR);
+    return 1;
+}
 
-            LogMessage("Shell detection: Explorer shell window detected: class=%s", className);
-            shellWindowCount = 1;
-        }
+void ReleaseAplResources() {
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        g_apl[i].apl = -1;
+        g_apl[i].timeoutSec = 0;
     }
+    g_aplInitialized = 1;
+    g_aplLastSampleTick = 0;
+    if (g_hAplDC) {
+        SelectObject(g_hAplDC, g_hAplOldBitmap);
+        DeleteObject(g_hAplBitmap);
+        DeleteDC(g_hAplDC);
+        g_hAplDC = NULL;
+        g_hAplBitmap = NULL;
+        g_aplPixels = NULL;
+    }
+}
 
-    if (shellWindowCount == 0) {
-        LogMessage("Shell detection: No shell windows detected");
+// Mean BT.601 luma of one monitor's point samples, or -1 on failure.
+int SampleMonitorApl(HDC hScreenDC, int monitorIndex) {
+    const RECT* m = &g_monitors[monitorIndex].rect;
+    if (!StretchBlt(g_hAplDC, 0, 0, APL_GRID_COLS, APL_GRID_ROWS,
+                    hScreenDC, m->left, m->top, m->right - m->left, m->bottom - m->top, SRCCOPY)) {
+        return -1;
     }
+    GdiFlush();
 
-    return shellWindowCount;
+    unsigned int sum = 0;
+    const BYTE* p = g_aplPixels;
+    for (int i = 0; i < APL_GRID_COLS * APL_GRID_ROWS; i++, p += 4) {
+        sum += p[0] * 29u + p[1] * 150u + p[2] * 77u;
+    }
+    return (int)(sum / (APL_GRID_COLS * APL_GRID_ROWS * 256u));
 }
 
-// Send Escape key(s) to close shell windows (Start Menu, Task View, Action Center)
-void CloseShellWindows(int escapeCount) {
-    LogMessage("Sending %d Escape key(s) to close shell windows", escapeCount);
+// Called every timer tick while the dynamic timeout is active.
+void UpdateDynamicTimeouts() {
+    if (!g_aplInitialized) {
+        ReleaseAplResources();
+    }
 
-    for (int i = 0; i < escapeCount; i++) {
-        INPUT input[2] = {0};
+    DWORD nowTick = GetTickCount();
+    if (g_aplLastSampleTick != 0 && (DWORD)(nowTick - g_aplLastSampleTick) < APL_SAMPLE_INTERVAL_MS) return;
+    g_aplLastSampleTick = nowTick ? nowTick : 1;
 
-        // Key down
-        input[0].type = INPUT_KEYBOARD;
-        input[0].ki.wVk = VK_ESCAPE;
-        input[0].ki.dwFlags = 0;
+    if (!EnsureAplSurface()) return;
 
-        // Key up
-        input[1].type = INPUT_KEYBOARD;
-        input[1].ki.wVk = VK_ESCAPE;
-        input[1].ki.dwFlags = KEYEVENTF_KEYUP;
+    LONGLONG startUs = GetTimestampUs();
+    HDC hScreenDC = GetDC(NULL);
+    for (int i = 0; i < g_monitorCount; i++) {
+        // A covered monitor only shows our black window
+        if (!g_monitorStates[i].enabled || g_monitorStates[i].screenSaverActive) continue;
+
+        int sample = SampleMonitorApl(hScreenDC, i);
+        if (sample < 0) continue;
+
+        MonitorApl* apl = &g_apl[i];
+        apl->apl = apl->apl < 0 ? sample : (apl->apl * 3 + sample) / 4;
+        int timeoutSec = AplToTimeoutSec(apl->apl);
+        if (timeoutSec != apl->timeoutSec) {
+            LogMessage("Dynamic timeout: monitor %d APL %d -> timeout %ds", i, apl->apl, timeoutSec);
+            apl->timeoutSec = timeoutSec;
+        }
+    }
+    ReleaseDC(NULL, hScreenDC);
 
-        UINT sent = SendInput(2, input, sizeof(INPUT));
-        LogMessage("SendInput returned %u (expected 2)", sent);
+    g_aplLastSampleUs = GetTimestampUs() - startUs;
+    g_aplTotalSampleUs += g_aplLastSampleUs;
+    g_aplSampleCount++;
+}
+#else
+int GetEffectiveIdleTimeout(int monitorIndex) {
+    (void)monitorIndex;
+    return g_app.config.idleTimeout;
+}
+#endif
+
+#if OLED_FEATURE_CONTROLLER_INPUT
+// ---------------------------------------------------------------------------
+// Game controller activity
+//
+// GetLastInputInfo only sees keyboard and mouse, so a controller-driven game
+// or media-center session would be covered unless the game sets
+// ES_DISPLAY_REQUIRED. With controllerInputEnabled, the XInput packet number
+// of each slot is compared with the previous poll; a change (or a newly
+// connected controller) counts as input and is merged into GetIdleTime, so it
+// reaches both the global timer and the per-monitor lastInputTime updates.
+//
+// Controllers are only polled while an idle deadline is approaching or a
+// monitor is covered; during keyboard/mouse use nothing is polled at all, and
+// the first poll after such a gap only takes a new baseline. XInputGetState
+// on an empty slot is slow, so empty slots are re-probed at most every
+// CONTROLLER_RESCAN_MS. The slot tracking lives in oled_policy.h and reads
+// the device through a ControllerReadPacketFn, which tests/test_policy.c
+// replaces with a scripted controller.
+// ---------------------------------------------------------------------------
+
+typedef DWORD (WINAPI *PFN_XInputGetState)(DWORD, XINPUT_STATE*);
+static PFN_XInputGetState g_pfnXInputGetState = NULL;
+
+int OpenXInput() {
+    if (g_pfnXInputGetState) return 1;
+
+    // xinput1_4 ships with Windows 8+; xinput9_1_0 covers Windows 7. Only
+    // look in System32, never the current directory or PATH.
+    HMODULE hXInput = LoadLibraryExW(L"xinput1_4.dll", NULL, LOAD_LIBRARY_SEARCH_SYSTEM32);
+    if (!hXInput) hXInput = LoadLibraryExW(L"xinput9_1_0.dll", NULL, LOAD_LIBRARY_SEARCH_SYSTEM32);
+    if (!hXInput) return 0;
+    g_pfnXInputGetState = (PFN_XInputGetState)GetProcAddress(hXInput, "XInputGetState");
+    return g_pfnXInputGetState != NULL;
+}
 
-        // Small delay between escape presses if sending multiple
-        if (i < escapeCount - 1) {
-            Sleep(50);
+int XInputReadPacket(unsigned int slot, unsigned int* packetNumber) {
+    XINPUT_STATE state;
+    if (g_pfnXInputGetState(slot, &state) != ERROR_SUCCESS) return 0;
+    *packetNumber = state.dwPacketNumber;
+    return 1;
+}
+
+static ControllerTracker g_controllers;
+static int g_xinputState = 0;  // 0 = not opened yet, 1 = open, -1 = unavailable
+static DWORD g_controllerLastActivityTick = 0;
+static int g_controllerHasActivity = 0;
+static int g_controllerPollCount = 0;
+static int g_controllerActivityCount = 0;
+
+// Milliseconds since the last controller activity, or MAXDWORD if none.
+DWORD GetControllerIdleTime() {
+    if (!g_app.config.controllerInputEnabled || !g_controllerHasActivity) return MAXDWORD;
+    return GetTickCount() - g_controllerLastActivityTick;
+}
+
+// Poll only when it can change a decision: a monitor is covered (input
+// should uncover it) or an enabled monitor is close to its deadline.
+int IsControllerPollNeeded() {
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (!g_monitorStates[i].enabled) continue;
+        if (g_monitorStates[i].screenSaverActive ||
+            GetMonitorIdleSeconds(i) >= GetEffectiveIdleTimeout(i) - CONTROLLER_LEAD_SEC) {
+            return 1;
         }
     }
+    return 0;
 }
 
-void ShowScreenSaverOnMonitor(int monitorIndex, int isManual) {
-    if (monitorIndex < 0 || monitorIndex >= g_monitorCount) return;
-    if (!g_monitorStates[monitorIndex].enabled) return;
-    if (g_monitorStates[monitorIndex].screenSaverActive) return;
+void PollControllers() {
+    if (g_xinputState == 0) {
+        g_xinputState = OpenXInput() ? 1 : -1;
+        LogMessage("Controller input: XInput %s", g_xinputState > 0 ? "loaded" : "unavailable");
+    }
+    if (g_xinputState < 0) return;
 
-    if (g_app.config.perMonitorInputDetection) {
-        int wasInactiveCount = 0;
-        for (int i = 0; i < g_monitorCount; i++) {
-            if (g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
-                wasInactiveCount++;
-            }
-        }
+    int wasConnected[CONTROLLER_MAX_SLOTS];
+    for (int slot = 0; slot < CONTROLLER_MAX_SLOTS; slot++) {
+        wasConnected[slot] = g_controllers.slots[slot].connected;
+    }
 
-        if (wasInactiveCount == 1) {
-            int sentEscapeKeys = 0;
-            for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
-                int shellWindowCount = IsShellWindowOpen();
-                if (shellWindowCount > 0) {
-                    LogMessage("Shell window(s) detected before last monitor activation (attempt %d), closing them", attempt + 1);
-                    CloseShellWindows(1);
-                    Sleep(SHELL_CLOSE_DELAY_MS);
-                    sentEscapeKeys = 1;
-                } else {
-                    break;
-                }
-            }
+    // Anything longer than two timer ticks is a gap, e.g. a delayed timer
+    DWORD nowTick = GetTickCount();
+    g_controllerPollCount++;
+    if (PollControllerTracker(&g_controllers, XInputReadPacket, nowTick, (unsigned int)g_app.config.checkInterval * 2)) {
+        g_controllerLastActivityTick = nowTick;
+        g_controllerHasActivity = 1;
+        g_controllerActivityCount++;
+    }
 
-            if (sentEscapeKeys) {
-                // The Escape keys sent via SendInput update GetLastInputInfo,
-                // which would make the next timer tick think the user is active
-                // and deactivate the screen saver. Use the manual-activation
-                // cooldown to suppress deactivation for a short period, instead
-                // of resetting lastInputTime (which would also deactivate the
-                // monitor we just activated).
-                g_app.isManualActivation = 1;
-                g_app.manualActivationTime = GetTickCount();
-            }
+    for (int slot = 0; slot < CONTROLLER_MAX_SLOTS; slot++) {
+        if (g_controllers.slots[slot].connected != wasConnected[slot]) {
+            LogMessage("Controller input: slot %d %s", slot,
+                       g_controllers.slots[slot].connected ? "connected" : "disconnected");
         }
+    }
+}
+
+// Called every timer tick before the activation decision.
+void UpdateControllerInput() {
+    if (IsControllerPollNeeded()) {
+        PollControllers();
     } else {
-        int sentEscapeKeys = 0;
-        for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
-            int shellWindowCount = IsShellWindowOpen();
-            if (shellWindowCount > 0) {
-                LogMessage("Shell window(s) detected before screen saver activation (attempt %d), closing them", attempt + 1);
-                CloseShellWindows(1);
-                Sleep(SHELL_CLOSE_DELAY_MS);
-                sentEscapeKeys = 1;
-            } else {
-                break;
+        InvalidateControllerBaseline(&g_controllers);
+    }
+}
+
+void ResetControllerInput() {
+    memset(&g_controllers, 0, sizeof(g_controllers));
+    g_controllerHasActivity = 0;
+}
+#else
+DWORD GetControllerIdleTime() {
+    return MAXDWORD;
+}
+#endif
+
+#if OLED_FEATURE_CPU_ACTIVITY
+// ---------------------------------------------------------------------------
+// CPU activity detection
+//
+// Muted dashboards, slideshows and silent games neither own an audio
+// session nor always set ES_DISPLAY_REQUIRED. With cpuActivityEnabled, the
+// processes owning visible windows on a monitor are sampled with
+// GetProcessTimes once per second, but only in the seconds before that
+// monitor would be covered (and while CPU activity keeps it uncovered). A
+// process using at least cpuActivityThresholdPct of one core in
+// CPU_SUSTAINED_SAMPLES of the last CPU_HISTORY_SAMPLES samples keeps the
+// monitors its windows sit on uncovered.
+//
+// Sampling is incremental: windows are re-enumerated every
+// CPU_WINDOW_RESCAN_MS, and process handles and previous CPU times are kept
+// between samples, so a sample is one GetProcessTimes per tracked process.
+// With media detection, same-exe descendants (browser renderers and GPU
+// processes) are charged to the process owning the window, via the process
+// graph.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    DWORD pid;
+    HANDLE hProcess;
+    DWORD monitorMask;                  // Gated monitors showing the owner's windows
+    ULONGLONG lastCpu100ns;
+    DWORD history;                      // One bit per sample, newest in bit 0 (1 = busy)
+    int percent;                        // Last sample, % of one core
+    DWORD rescanSerial;
+    int fresh;                          // Tracked since the last sample: no interval yet
+} CpuProcess;
+
+typedef struct {
+    DWORD gatedMask;
+    DWORD windowPids[MAX_CPU_PROCESSES];
+    DWORD windowMasks[MAX_CPU_PROCESSES];
+    int windowPidCount;
+} CpuWindowScan;
+
+static CpuProcess g_cpuProcesses[MAX_CPU_PROCESSES];
+static int g_cpuProcessCount = 0;
+static DWORD g_cpuRescanSerial = 0;
+static DWORD g_cpuLastRescanTick = 0;
+static DWORD g_cpuLastSampleTick = 0;
+static LONGLONG g_cpuLastSampleWallUs = 0;
+static DWORD g_cpuMask = 0;
+static LONGLONG g_cpuLastUpdateUs = 0;
+static LONGLONG g_cpuTotalUpdateUs = 0;
+static int g_cpuUpdateCount = 0;
+static int g_cpuHandleOpens = 0;
+
+ULONGLONG GetProcessCpu100ns(HANDLE hProcess) {
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(hProcess, &created, &exited, &kernel, &user)) return 0;
+    return (((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+           (((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime);
+}
+
+void RemoveCpuProcess(int index) {
+    if (g_cpuProcesses[index].hProcess) CloseHandle(g_cpuProcesses[index].hProcess);
+    g_cpuProcesses[index] = g_cpuProcesses[--g_cpuProcessCount];
+}
+
+void ResetCpuActivity() {
+    while (g_cpuProcessCount > 0) {
+        RemoveCpuProcess(g_cpuProcessCount - 1);
+    }
+    g_cpuLastRescanTick = 0;
+    g_cpuLastSampleTick = 0;
+    if (g_cpuMask) {
+        LogMessage("CPU activity: mask=0x00000000");
+        g_cpuMask = 0;
+    }
+}
+
+// Start tracking pid (or add to its monitors if tracked already).
+void TrackCpuProcess(DWORD pid, DWORD monitorMask) {
+    for (int i = 0; i < g_cpuProcessCount; i++) {
+        if (g_cpuProcesses[i].pid == pid) {
+            if (g_cpuProcesses[i].rescanSerial != g_cpuRescanSerial) {
+                g_cpuProcesses[i].rescanSerial = g_cpuRescanSerial;
+                g_cpuProcesses[i].monitorMask = 0;
             }
+            g_cpuProcesses[i].monitorMask |= monitorMask;
+            return;
         }
+    }
+    if (g_cpuProcessCount >= MAX_CPU_PROCESSES) return;
+
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+    if (!hProcess) return;
+    g_cpuHandleOpens++;
+
+    CpuProcess* process = &g_cpuProcesses[g_cpuProcessCount++];
+    memset(process, 0, sizeof(*process));
+    process->pid = pid;
+    process->hProcess = hProcess;
+    process->monitorMask = monitorMask;
+    process->lastCpu100ns = GetProcessCpu100ns(hProcess);
+    process->rescanSerial = g_cpuRescanSerial;
+    process->fresh = 1;
+}
 
-        if (sentEscapeKeys) {
-            g_app.isManualActivation = 1;
-            g_app.manualActivationTime = GetTickCount();
+BOOL CALLBACK EnumCpuWindowCallback(HWND hWnd, LPARAM lParam) {
+    CpuWindowScan* scan = (CpuWindowScan*)lParam;
+
+    if (!IsWindowVisible(hWnd) || IsIconic(hWnd)) return TRUE;
+    if ((GetWindowLongPtr(hWnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) != 0) return TRUE;
+#if OLED_FEATURE_MEDIA_DETECTION
+    if (IsWindowCloakedCompat(hWnd)) return TRUE;
+#endif
+
+    RECT rect;
+    if (!GetWindowRect(hWnd, &rect) || RectArea(&rect) < MIN_MEDIA_WINDOW_AREA) return TRUE;
+
+    DWORD mask = 0;
+    for (int i = 0; i < g_monitorCount && i < 32; i++) {
+        if ((scan->gatedMask & (1u << i)) &&
+            RectIntersectionArea(&rect, &g_monitors[i].rect) >= MIN_MEDIA_WINDOW_AREA) {
+            mask |= 1u << i;
         }
     }
+    if (!mask) return TRUE;
 
-    if (g_monitorStates[monitorIndex].hScreenSaverWnd) {
-        // Reposition and resize in case the pixel shift compensation setting changed since the
-        // window was last created.
-        LONG_PTR exStyle = GetWindowLongPtrW(g_monitorStates[monitorIndex].hScreenSaverWnd, GWL_EXSTYLE);
-        if ((exStyle & WS_EX_NOACTIVATE) == 0) {
-            SetWindowLongPtrW(g_monitorStates[monitorIndex].hScreenSaverWnd, GWL_EXSTYLE, exStyle | WS_EX_NOACTIVATE);
-        }
-        int pad = g_app.config.pixelShiftCompensation;
-        SetWindowPos(g_monitorStates[monitorIndex].hScreenSaverWnd, HWND_TOPMOST,
-                     g_monitors[monitorIndex].rect.left   - pad,
-                     g_monitors[monitorIndex].rect.top    - pad,
-                     g_monitors[monitorIndex].rect.right  - g_monitors[monitorIndex].rect.left + pad * 2,
-                     g_monitors[monitorIndex].rect.bottom - g_monitors[monitorIndex].rect.top  + pad * 2,
-                     SWP_NOACTIVATE);
-        ShowWindow(g_monitorStates[monitorIndex].hScreenSaverWnd, SW_SHOWNOACTIVATE);
-        UpdateWindow(g_monitorStates[monitorIndex].hScreenSaverWnd);
-        g_monitorStates[monitorIndex].screenSaverActive = 1;
-        LogMessage("Screen saver window shown on monitor %d (reused)", monitorIndex);
-    } else {
-        // Expand the window beyond the monitor's reported bounds by the pixel shift compensation
-        // amount on all four sides. This ensures hardware pixel shift (used by some OLED panels
-        // to reduce burn-in) cannot expose the desktop behind the screen saver window.
-        int pad = g_app.config.pixelShiftCompensation;
-        HWND hWnd = CreateWindowExW(WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
-                                    L"OLEDAegisScreen", L"",
-                                   WS_POPUP,
-                                   g_monitors[monitorIndex].rect.left   - pad,
-                                   g_monitors[monitorIndex].rect.top    - pad,
-                                   g_monitors[monitorIndex].rect.right  - g_monitors[monitorIndex].rect.left + pad * 2,
-                                   g_monitors[monitorIndex].rect.bottom - g_monitors[monitorIndex].rect.top  + pad * 2,
-                                   NULL, NULL, GetModuleHandle(NULL), NULL);
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hWnd, &pid);
+    if (pid == 0 || pid == GetCurrentProcessId()) return TRUE;
 
-        if (hWnd) {
-            ShowWindow(hWnd, SW_SHOWNOACTIVATE);
-            UpdateWindow(hWnd);
-            g_monitorStates[monitorIndex].hScreenSaverWnd = hWnd;
-            g_monitorStates[monitorIndex].screenSaverActive = 1;
-            LogMessage("Screen saver window created on monitor %d", monitorIndex);
+    for (int i = 0; i < scan->windowPidCount; i++) {
+        if (scan->windowPids[i] == pid) {
+            scan->windowMasks[i] |= mask;
+            return TRUE;
         }
     }
-
-    if (!g_app.config.perMonitorInputDetection) {
-        HideCursorForScreenSaver("screen saver activation");
+    if (scan->windowPidCount < MAX_CPU_PROCESSES) {
+        scan->windowPids[scan->windowPidCount] = pid;
+        scan->windowMasks[scan->windowPidCount++] = mask;
     }
+    return TRUE;
 }
 
-void ShowScreenSaver(int isManual) {
-    if (g_app.screenSaverActive && !g_app.config.perMonitorInputDetection) return;
-
-    if (g_app.config.perMonitorInputDetection && !isManual) {
-        return;
-    }
-
-    if (isManual) {
-        g_app.isManualActivation = 1;
-        g_app.manualActivationTime = GetTickCount();
-        LogMessage("Showing screen saver (manual activation)");
+// Re-map windows to processes for the gated monitors.
+void RescanCpuProcesses(DWORD gatedMask) {
+    CpuWindowScan scan;
+    scan.gatedMask = gatedMask;
+    scan.windowPidCount = 0;
+    EnumWindows(EnumCpuWindowCallback, (LPARAM)&scan);
+
+    // The shell's desktop and taskbar windows span every monitor
+    DWORD shellPid = 0;
+    HWND hShell = GetShellWindow();
+    if (hShell) GetWindowThreadProcessId(hShell, &shellPid);
+
+    g_cpuRescanSerial++;
+    for (int i = 0; i < scan.windowPidCount; i++) {
+        if (scan.windowPids[i] != shellPid) {
+            TrackCpuProcess(scan.windowPids[i], scan.windowMasks[i]);
+        }
     }
 
-    if (!g_app.config.perMonitorInputDetection) {
-        int sentEscapeKeys = 0;
-        for (int attempt = 0; attempt < SHELL_CLOSE_MAX_ATTEMPTS; attempt++) {
-            int shellWindowCount = IsShellWindowOpen();
-            if (shellWindowCount > 0) {
-                LogMessage("Shell window(s) detected before screen saver activation (attempt %d), closing them", attempt + 1);
-                CloseShellWindows(1);
-                Sleep(SHELL_CLOSE_DELAY_MS);
-                sentEscapeKeys = 1;
-            } else {
-                break;
+#if OLED_FEATURE_MEDIA_DETECTION
+    // Charge same-exe descendants to the window owner
+    if (RefreshProcessGraph()) {
+        for (int n = 0; n < g_processGraphCount; n++) {
+            const ProcessNode* root = FindRootProcess(&g_processGraph[n]);
+            if (root == &g_processGraph[n] || root->pid == shellPid) continue;
+            for (int i = 0; i < scan.windowPidCount; i++) {
+                if (scan.windowPids[i] == root->pid) {
+                    TrackCpuProcess(g_processGraph[n].pid, scan.windowMasks[i]);
+                    break;
+                }
             }
         }
+    }
+#endif
 
-        if (sentEscapeKeys && !isManual) {
-            g_app.isManualActivation = 1;
-            g_app.manualActivationTime = GetTickCount();
-            LogMessage("Showing screen saver (automatic activation, with input cooldown due to shell window closure)");
-        } else if (!isManual) {
-            g_app.isManualActivation = 0;
-            g_app.manualActivationTime = 0;
-            LogMessage("Showing screen saver (automatic activation)");
+    // Drop processes that no longer show a window on a gated monitor
+    for (int i = g_cpuProcessCount - 1; i >= 0; i--) {
+        if (g_cpuProcesses[i].rescanSerial != g_cpuRescanSerial) {
+            RemoveCpuProcess(i);
         }
     }
+}
 
-    LogMessage("%d monitors detected", g_monitorCount);
-
-    int windowsCreated = 0;
-    time_t now = time(NULL);
+void UpdateCpuActivity() {
+    DWORD nowTick = GetTickCount();
+    int sampleMs = g_app.config.checkInterval > CPU_SAMPLE_INTERVAL_MS ?
+                   g_app.config.checkInterval : CPU_SAMPLE_INTERVAL_MS;
+    int leadSec = CPU_LEAD_SEC + (CPU_HISTORY_SAMPLES * sampleMs + 999) / 1000;
 
-    for (int i = 0; i < g_monitorCount; i++) {
-        if (g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
-            if (g_app.config.perMonitorInputDetection) {
-                g_monitorStates[i].lastInputTime = now;
-            }
-            ShowScreenSaverOnMonitor(i, isManual);
-            windowsCreated++;
+    DWORD gatedMask = 0;
+    for (int i = 0; i < g_monitorCount && i < 32; i++) {
+        if (g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive &&
+            GetMonitorIdleSeconds(i) >= GetEffectiveIdleTimeout(i) - leadSec) {
+            gatedMask |= 1u << i;
         }
     }
+    if (!gatedMask) {
+        // Nobody is close to a timeout: hold no handles, cost nothing
+        if (g_cpuProcessCount > 0 || g_cpuMask) ResetCpuActivity();
+        return;
+    }
+    if (g_cpuLastSampleTick != 0 && (DWORD)(nowTick - g_cpuLastSampleTick) < CPU_SAMPLE_INTERVAL_MS) {
+        return;
+    }
 
-    LogMessage("Activated screen saver on %d monitors", windowsCreated);
-
-    g_app.screenSaverActive = 1;
-}
+    LONGLONG startUs = GetTimestampUs();
+    if (g_cpuLastRescanTick == 0 || (DWORD)(nowTick - g_cpuLastRescanTick) >= CPU_WINDOW_RESCAN_MS) {
+        RescanCpuProcesses(gatedMask);
+        g_cpuLastRescanTick = nowTick;
+    }
 
-void HideScreenSaver() {
-    if (!g_app.screenSaverActive && !IsAnyMonitorActive()) return;
+    LONGLONG wallUs = startUs - g_cpuLastSampleWallUs;
+    int firstSample = g_cpuLastSampleTick == 0;
+    g_cpuLastSampleTick = nowTick;
+    g_cpuLastSampleWallUs = startUs;
 
-    LogMessage("Hiding screen saver");
+    DWORD busyMask = 0;
+    for (int i = g_cpuProcessCount - 1; i >= 0; i--) {
+        CpuProcess* process = &g_cpuProcesses[i];
+        if (WaitForSingleObject(process->hProcess, 0) == WAIT_OBJECT_0) {
+            RemoveCpuProcess(i);
+            continue;
+        }
+        ULONGLONG cpu = GetProcessCpu100ns(process->hProcess);
+        if (!firstSample && !process->fresh && wallUs > 0) {
+            // 100 ns units over microseconds, as a percentage
+            process->percent = (int)((cpu - process->lastCpu100ns) * 10 / (ULONGLONG)wallUs);
+            process->history = (process->history << 1) | (process->percent >= g_app.config.cpuActivityThresholdPct);
+        }
+        process->lastCpu100ns = cpu;
+        process->fresh = 0;
 
-    for (int i = 0; i < g_monitorCount; i++) {
-        if (g_monitorStates[i].screenSaverActive) {
-            HideScreenSaverOnMonitor(i);
+        int busy = 0;
+        for (int b = 0; b < CPU_HISTORY_SAMPLES; b++) {
+            busy += (process->history >> b) & 1;
+        }
+        if (busy >= CPU_SUSTAINED_SAMPLES) {
+            busyMask |= process->monitorMask;
         }
     }
+    busyMask &= gatedMask;
 
-    g_app.screenSaverActive = 0;
-    g_app.manualActivationTime = 0;
-    g_app.isManualActivation = 0;
+    if (busyMask != g_cpuMask) {
+        LogMessage("CPU activity: mask=0x%08X (%d processes tracked)", busyMask, g_cpuProcessCount);
+        g_cpuMask = busyMask;
+    }
 
-    EnsureCursorVisible("screen saver hidden");
+    g_cpuLastUpdateUs = GetTimestampUs() - startUs;
+    g_cpuTotalUpdateUs += g_cpuLastUpdateUs;
+    g_cpuUpdateCount++;
 }
 
-void EnsureScreenSaverTopmost() {
-    for (int i = 0; i < g_monitorCount; i++) {
-        if (g_monitorStates[i].screenSaverActive && g_monitorStates[i].hScreenSaverWnd) {
-            SetWindowPos(g_monitorStates[i].hScreenSaverWnd, HWND_TOPMOST,
-                        0, 0, 0, 0,
-                        SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
-        }
-    }
+DWORD GetCpuActivityMonitorMask() {
+    return g_app.config.cpuActivityEnabled ? g_cpuMask : 0;
+}
+#else
+DWORD GetCpuActivityMonitorMask() {
+    return 0;
 }
+#endif
 
+#if OLED_FEATURE_SETTINGS_UI
 void OpenConfigFileLocation() {
     char appDataPath[MAX_PATH];
     char configPath[MAX_PATH];
@@ -1801,6 +7455,32 @@ void OpenConfigFileLocation() {
     ShellExecuteA(NULL, "open", "explorer.exe", selectCmd, NULL, SW_SHOW);
 }
 
+// Free everything the settings dialog allocated. The tooltip control is
+// created without an owner, so it is not destroyed along with the dialog.
+void ReleaseSettingsDialogResources() {
+    if (g_hTooltipControl) {
+        DestroyWindow(g_hTooltipControl);
+        g_hTooltipControl = NULL;
+    }
+
+    if (g_hSettingsFont) {
+        DeleteObject(g_hSettingsFont);
+        g_hSettingsFont = NULL;
+    }
+
+    if (g_app.config.memoryTrimEnabled) {
+        TrimWorkingSet("settings dialog closed");
+    }
+}
+
+// The class can only be unregistered once its last window is gone, i.e.
+// after DestroyWindow (and WM_DESTROY) has returned.
+void CloseSettingsDialog(HWND hWnd) {
+    DestroyWindow(hWnd);
+    g_hSettingsDialog = NULL;
+    UnregisterClassA("OLED Aegis Settings Dialog", GetModuleHandle(NULL));
+}
+
 LRESULT CALLBACK SettingsDialogProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
         case WM_COMMAND:
@@ -1816,27 +7496,38 @@ LRESULT CALLBACK SettingsDialogProc(HWND hWnd, UINT message, WPARAM wParam, LPAR
                     break;
                 case IDC_CLOSE_BTN:
                     LogMessage("Settings: Dialog closed via 'Close' button");
-                    DestroyWindow(hWnd);
-                    g_hSettingsDialog = NULL;
+                    CloseSettingsDialog(hWnd);
                     break;
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+                case IDC_PERMONITOR_CHECK:
+                    UpdateTimeoutLabel(hWnd);
+                    break;
+#endif
             }
             return 0;
         }
         case WM_CLOSE:
             LogMessage("Settings: Dialog closed via WM_CLOSE");
-            DestroyWindow(hWnd);
-            g_hSettingsDialog = NULL;
+            CloseSettingsDialog(hWnd);
             return 0;
         case WM_DESTROY:
-            if (g_hSettingsFont) {
-                DeleteObject(g_hSettingsFont);
-                g_hSettingsFont = NULL;
-            }
+            ReleaseSettingsDialogResources();
             return 0;
     }
     return DefWindowProc(hWnd, message, wParam, lParam);
 }
 
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+// With the brightness-aware timeout in effect (it needs per-monitor input, so
+// follow the unapplied checkbox), the idle timeout only applies to monitors
+// not sampled yet: say so instead of letting it look ignored.
+void UpdateTimeoutLabel(HWND hDlg) {
+    int dynamic = g_app.config.dynamicTimeoutEnabled &&
+                  IsDlgButtonChecked(hDlg, IDC_PERMONITOR_CHECK) == BST_CHECKED;
+    SetDlgItemTextA(hDlg, IDC_TIMEOUT_LABEL, dynamic ? "Fallback Timeout (seconds):" : "Idle Timeout (seconds):");
+}
+#endif
+
 void AddTooltip(HWND hParent, HWND hControl, const char* text) {
     TOOLINFOA ti = {0};
     ti.cbSize = sizeof(TOOLINFOA);
@@ -1921,7 +7612,7 @@ void ShowSettingsDialog() {
 
         HWND hTimeoutLabel = CreateWindowA("STATIC", "Idle Timeout (seconds):",
                      WS_CHILD | WS_VISIBLE,
-                     margin, y, labelWidth, controlHeight, g_hSettingsDialog, NULL, hMod, NULL);
+                     margin, y, labelWidth, controlHeight, g_hSettingsDialog, (HMENU)IDC_TIMEOUT_LABEL, hMod, NULL);
         HWND hTimeoutEdit = CreateWindowExA(0, "EDIT", "",
                      WS_CHILD | WS_VISIBLE | WS_BORDER | ES_NUMBER,
                      margin + labelWidth, y, editWidth, controlHeight,
@@ -2001,6 +7692,20 @@ void ShowSettingsDialog() {
                          hMod, NULL);
             if (g_hSettingsFont) SendMessageA(hMonitorCheck, WM_SETFONT, (WPARAM)g_hSettingsFont, TRUE);
             y += rowHeight;
+
+#if OLED_FEATURE_WEAR_STATS
+            char wearSummary[160];
+            FormatWearSummary(i, 1, wearSummary, sizeof(wearSummary));
+            if (wearSummary[0] != '\0') {
+                // Two lines, so today's totals are never cut off
+                HWND hWearLabel = CreateWindowA("STATIC", wearSummary,
+                             WS_CHILD | WS_VISIBLE,
+                             margin + ScaleDPI(18), y - ScaleDPI(4), checkboxWidth - ScaleDPI(18), controlHeight * 2,
+                             g_hSettingsDialog, NULL, hMod, NULL);
+                if (g_hSettingsFont) SendMessageA(hWearLabel, WM_SETFONT, (WPARAM)g_hSettingsFont, TRUE);
+                y += rowHeight + controlHeight - ScaleDPI(4);
+            }
+#endif
         }
 
         y += margin;
@@ -2056,6 +7761,17 @@ void ShowSettingsDialog() {
         }
 
         // Add tooltips
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+        if (g_app.config.dynamicTimeoutEnabled) {
+            char timeoutTip[256];
+            sprintf_s(timeoutTip, sizeof(timeoutTip),
+                      "Idle timeout in seconds before the screen saver activates. "
+                      "With Per-Monitor Input Detection on, dynamicTimeoutEnabled scales each monitor's timeout "
+                      "between %d and %d seconds by its brightness; this one only applies until a monitor has been sampled.",
+                      g_app.config.dynamicTimeoutMinSec, g_app.config.dynamicTimeoutMaxSec);
+            AddTooltip(g_hSettingsDialog, hTimeoutEdit, timeoutTip);
+        } else
+#endif
         AddTooltip(g_hSettingsDialog, hTimeoutEdit,
                    "Idle timeout in seconds before the screen saver activates.");
         AddTooltip(g_hSettingsDialog, hIntervalEdit,
@@ -2090,6 +7806,9 @@ void ShowSettingsDialog() {
         CheckDlgButton(g_hSettingsDialog, IDC_PERMONITOR_CHECK, g_app.config.perMonitorInputDetection ? BST_CHECKED : BST_UNCHECKED);
         CheckDlgButton(g_hSettingsDialog, IDC_PERMONITOR_MEDIA_CHECK, g_app.config.perMonitorMediaDetection ? BST_CHECKED : BST_UNCHECKED);
         CheckDlgButton(g_hSettingsDialog, IDC_MUTED_MEDIA_CHECK, g_app.config.blockOnMutedMedia ? BST_CHECKED : BST_UNCHECKED);
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+        UpdateTimeoutLabel(g_hSettingsDialog);
+#endif
 
         sprintf_s(buffer, 32, "%d", g_app.config.pixelShiftCompensation);
         SetDlgItemTextA(g_hSettingsDialog, IDC_PIXELSHIFT_EDIT, buffer);
@@ -2120,82 +7839,785 @@ void ApplySettings(HWND hWnd) {
     int oldPerMonitorMedia = g_app.config.perMonitorMediaDetection;
     int oldBlockOnMutedMedia = g_app.config.blockOnMutedMedia;
 
-    g_app.config.mediaDetectionEnabled = IsDlgButtonChecked(hWnd, IDC_MEDIA_CHECK) == BST_CHECKED;
-    g_app.config.debugMode = IsDlgButtonChecked(hWnd, IDC_DEBUG_CHECK) == BST_CHECKED;
-    g_app.config.startupEnabled = IsDlgButtonChecked(hWnd, IDC_STARTUP_CHECK) == BST_CHECKED;
-    g_app.config.perMonitorInputDetection = IsDlgButtonChecked(hWnd, IDC_PERMONITOR_CHECK) == BST_CHECKED;
-    g_app.config.perMonitorMediaDetection = IsDlgButtonChecked(hWnd, IDC_PERMONITOR_MEDIA_CHECK) == BST_CHECKED;
-    g_app.config.blockOnMutedMedia = IsDlgButtonChecked(hWnd, IDC_MUTED_MEDIA_CHECK) == BST_CHECKED;
+    g_app.config.mediaDetectionEnabled = IsDlgButtonChecked(hWnd, IDC_MEDIA_CHECK) == BST_CHECKED;
+    g_app.config.debugMode = IsDlgButtonChecked(hWnd, IDC_DEBUG_CHECK) == BST_CHECKED;
+    g_app.config.startupEnabled = IsDlgButtonChecked(hWnd, IDC_STARTUP_CHECK) == BST_CHECKED;
+    g_app.config.perMonitorInputDetection = IsDlgButtonChecked(hWnd, IDC_PERMONITOR_CHECK) == BST_CHECKED;
+    g_app.config.perMonitorMediaDetection = IsDlgButtonChecked(hWnd, IDC_PERMONITOR_MEDIA_CHECK) == BST_CHECKED;
+    g_app.config.blockOnMutedMedia = IsDlgButtonChecked(hWnd, IDC_MUTED_MEDIA_CHECK) == BST_CHECKED;
+
+    GetDlgItemTextA(hWnd, IDC_PIXELSHIFT_EDIT, buffer, 32);
+    g_app.config.pixelShiftCompensation = atoi(buffer);
+    ClampConfigValues();
+
+    for (int i = 0; i < g_monitorCount; i++) {
+        int wasEnabled = g_app.config.monitorsEnabled[i];
+        g_app.config.monitorsEnabled[i] = IsDlgButtonChecked(hWnd, IDC_MONITOR_BASE + i) == BST_CHECKED;
+        g_monitorStates[i].enabled = g_app.config.monitorsEnabled[i];
+
+        if (!g_app.config.monitorsEnabled[i] && g_monitorStates[i].screenSaverActive) {
+            LogMessage("Disabling monitor %d which has active screen saver, hiding it", i);
+            HideScreenSaverOnMonitor(i);
+        }
+
+        if (!g_app.config.monitorsEnabled[i] && wasEnabled && g_monitorStates[i].hScreenSaverWnd) {
+            DestroyWindow(g_monitorStates[i].hScreenSaverWnd);
+            g_monitorStates[i].hScreenSaverWnd = NULL;
+            LogMessage("Destroyed screen saver window for disabled monitor %d", i);
+        }
+    }
+
+    if (!IsAnyMonitorActive()) {
+        g_app.screenSaverActive = 0;
+        EnsureCursorVisible("no active monitors after settings");
+    }
+
+    if (!oldPerMonitor && g_app.config.perMonitorInputDetection) {
+        time_t now = time(NULL);
+        for (int i = 0; i < g_monitorCount; i++) {
+            g_monitorStates[i].lastInputTime = now;
+        }
+        LogMessage("Per-monitor mode enabled: reset all monitor idle times");
+    }
+
+    SaveConfig();
+    UpdateStartupRegistry();
+
+    LogMessage("Settings applied: timeout %ds->%ds, interval %dms->%dms, media %d->%d, debug %d->%d, startup %d->%d, perMonitor %d->%d, perMonitorMedia %d->%d, mutedMedia %d->%d, pixelShift %dpx",
+             oldTimeout, g_app.config.idleTimeout,
+             oldInterval, g_app.config.checkInterval,
+             oldMedia, g_app.config.mediaDetectionEnabled,
+             oldDebug, g_app.config.debugMode,
+             oldStartup, g_app.config.startupEnabled,
+             oldPerMonitor, g_app.config.perMonitorInputDetection,
+             oldPerMonitorMedia, g_app.config.perMonitorMediaDetection,
+             oldBlockOnMutedMedia, g_app.config.blockOnMutedMedia,
+             g_app.config.pixelShiftCompensation);
+
+    if (oldInterval != g_app.config.checkInterval) {
+        KillTimer(g_app.hWnd, TIMER_IDLE_CHECK);
+        SetTimer(g_app.hWnd, TIMER_IDLE_CHECK, g_app.config.checkInterval, NULL);
+        LogMessage("Timer recreated with new interval: %dms", g_app.config.checkInterval);
+    }
+
+    sprintf_s(buffer, 32, "%d", g_app.config.checkInterval);
+    SetDlgItemTextA(hWnd, IDC_INTERVAL_EDIT, buffer);
+}
+#endif
+
+void UpdateTrayIcon(int active) {
+    active = active ? 1 : 0;
+    if (g_app.trayIconActive == active) {
+        return;
+    }
+
+    g_app.nid.hIcon = active ? g_hIconActive : g_hIconInactive;
+    lstrcpyA(g_app.nid.szTip, active ? "OLED Aegis - Active" : "OLED Aegis - Idle");
+    Shell_NotifyIconA(NIM_MODIFY, (PNOTIFYICONDATAA)&g_app.nid);
+    g_app.trayIconActive = active;
+}
+
+#if OLED_FEATURE_HOTKEYS
+// ---------------------------------------------------------------------------
+// Global hotkeys
+//
+// hotkeyAllMonitors, hotkeyCursorMonitor and hotkeyMonitor_<device path>
+// toggle the screen saver on all enabled monitors, the monitor under the
+// cursor, or one monitor. Unlike the tray and timer paths, they go straight to
+// PresentScreenSaverWindow: the user has just pressed a key, so there is no
+// shell flyout to dismiss and no reason to Sleep before going black.
+//
+// Latency is measured from the WM_HOTKEY post time to the window being shown
+// (and, in debugMode, to the next DWM composition via DwmFlush) and reported
+// in the log and by --stats.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int count;
+    LONGLONG lastUs;
+    LONGLONG maxUs;
+    LONGLONG totalUs;
+} HotkeyLatencyStats;
+
+static HotkeyLatencyStats g_hotkeyLatency;
+static int g_hotkeysRegistered = 0;
+
+// Parse "Ctrl+Alt+B", "Win+Shift+F9" or "Ctrl+0x91" into RegisterHotKey
+// modifiers and virtual key. Returns 1 on success.
+int ParseHotkeySpec(const char* spec, UINT* modifiers, UINT* vk) {
+    char buffer[64];
+    strncpy_s(buffer, sizeof(buffer), spec, _TRUNCATE);
+
+    *modifiers = MOD_NOREPEAT;
+    *vk = 0;
+
+    char* context = NULL;
+    for (char* token = strtok_s(buffer, "+", &context); token; token = strtok_s(NULL, "+", &context)) {
+        if (*vk != 0) {
+            return 0;  // Key must be the last token
+        }
+
+        if (_stricmp(token, "Ctrl") == 0 || _stricmp(token, "Control") == 0) {
+            *modifiers |= MOD_CONTROL;
+        } else if (_stricmp(token, "Alt") == 0) {
+            *modifiers |= MOD_ALT;
+        } else if (_stricmp(token, "Shift") == 0) {
+            *modifiers |= MOD_SHIFT;
+        } else if (_stricmp(token, "Win") == 0) {
+            *modifiers |= MOD_WIN;
+        } else if (token[1] == '\0' && ((token[0] >= 'A' && token[0] <= 'Z') ||
+                                        (token[0] >= 'a' && token[0] <= 'z') ||
+                                        (token[0] >= '0' && token[0] <= '9'))) {
+            *vk = (UINT)(token[0] >= 'a' ? token[0] - 'a' + 'A' : token[0]);
+        } else if ((token[0] == 'F' || token[0] == 'f') && token[1] >= '1' && token[1] <= '9') {
+            int n = atoi(token + 1);
+            if (n < 1 || n > 24) return 0;
+            *vk = VK_F1 + (UINT)(n - 1);
+        } else if (_stricmp(token, "Pause") == 0) {
+            *vk = VK_PAUSE;
+        } else if (_stricmp(token, "ScrollLock") == 0) {
+            *vk = VK_SCROLL;
+        } else if (token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+            *vk = (UINT)strtoul(token, NULL, 16);
+        } else {
+            return 0;
+        }
+    }
+
+    return *vk != 0 && *vk <= 0xFE;
+}
+
+void RegisterOneHotkey(int id, const char* spec, const char* description) {
+    if (spec[0] == '\0') return;
+
+    UINT modifiers, vk;
+    if (!ParseHotkeySpec(spec, &modifiers, &vk)) {
+        LogMessage("Hotkey: invalid binding '%s' for %s", spec, description);
+        return;
+    }
+    if (!RegisterHotKey(g_app.hWnd, id, modifiers, vk)) {
+        // Usually another application already owns this combination
+        LogMessage("Hotkey: RegisterHotKey failed for '%s' (%s), error %lu", spec, description, GetLastError());
+        return;
+    }
+    g_hotkeysRegistered++;
+    LogMessage("Hotkey: '%s' -> %s", spec, description);
+}
+
+void UnregisterHotkeys() {
+    UnregisterHotKey(g_app.hWnd, HOTKEY_ID_ALL_MONITORS);
+    UnregisterHotKey(g_app.hWnd, HOTKEY_ID_CURSOR_MONITOR);
+    for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
+        UnregisterHotKey(g_app.hWnd, HOTKEY_ID_MONITOR_BASE + i);
+    }
+    g_hotkeysRegistered = 0;
+}
+
+// (Re)register all configured hotkeys. Called after startup, config changes
+// and display changes, since per-monitor bindings follow monitor indices.
+void RegisterHotkeys() {
+    UnregisterHotkeys();
+
+    RegisterOneHotkey(HOTKEY_ID_ALL_MONITORS, g_app.config.hotkeyAllMonitors, "all monitors");
+    RegisterOneHotkey(HOTKEY_ID_CURSOR_MONITOR, g_app.config.hotkeyCursorMonitor, "cursor monitor");
+    for (int i = 0; i < g_monitorCount; i++) {
+        char description[32];
+        sprintf_s(description, sizeof(description), "monitor %d", i);
+        RegisterOneHotkey(HOTKEY_ID_MONITOR_BASE + i, g_app.config.hotkeyMonitor[i], description);
+    }
+}
+
+// Toggle the monitors in mask: uncover them if any is covered, otherwise
+// cover every enabled one. Returns 1 if monitors were covered.
+int HotkeyToggleMonitors(DWORD mask) {
+    int anyActive = 0;
+    for (int i = 0; i < g_monitorCount; i++) {
+        if ((mask & (1u << i)) && g_monitorStates[i].screenSaverActive) {
+            anyActive = 1;
+            break;
+        }
+    }
+
+    if (anyActive) {
+        for (int i = 0; i < g_monitorCount; i++) {
+            if ((mask & (1u << i)) && g_monitorStates[i].screenSaverActive) {
+                HideScreenSaverOnMonitor(i);
+            }
+        }
+        if (!IsAnyMonitorActive()) {
+            g_app.screenSaverActive = 0;
+            g_app.isManualActivation = 0;
+            g_app.manualActivationTime = 0;
+            EnsureCursorVisible("hotkey deactivate");
+        }
+    } else {
+        // The hotkey's own key-up is input; the manual cooldown absorbs it
+        g_app.isManualActivation = 1;
+        g_app.manualActivationTime = GetTickCount();
+        for (int i = 0; i < g_monitorCount; i++) {
+            if ((mask & (1u << i)) && g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
+                PresentScreenSaverWindow(i);
+            }
+        }
+        if (IsAnyMonitorActive()) {
+            g_app.screenSaverActive = 1;
+        }
+    }
+
+    UpdateTrayIcon(IsAnyMonitorActive() ? 1 : 0);
+    return !anyActive;
+}
+
+void HandleHotkey(int id) {
+    LONGLONG startUs = GetTimestampUs();
+    // GetMessageTime is the tick count at which WM_HOTKEY was posted
+    DWORD queueMs = GetTickCount() - (DWORD)GetMessageTime();
+
+    DWORD mask = 0;
+    if (id == HOTKEY_ID_ALL_MONITORS) {
+        mask = LEASE_ALL_MONITORS;
+    } else if (id == HOTKEY_ID_CURSOR_MONITOR) {
+        POINT pt;
+        GetCursorPos(&pt);
+        int idx = GetMonitorIndexFromPoint(pt);
+        if (idx >= 0 && idx < g_monitorCount) {
+            mask = 1u << idx;
+        }
+    } else if (id >= HOTKEY_ID_MONITOR_BASE && id < HOTKEY_ID_MONITOR_BASE + g_monitorCount) {
+        mask = 1u << (id - HOTKEY_ID_MONITOR_BASE);
+    }
+    if (mask == 0) return;
+
+    int activated = HotkeyToggleMonitors(mask);
+    LONGLONG shownUs = GetTimestampUs() - startUs;
+    if (!activated) {
+        LogMessage("Hotkey %d: deactivated in %lld us", id, shownUs);
+        return;
+    }
+
+    // Time to the next composed frame; only worth blocking for in debugMode
+    LONGLONG composedUs = 0;
+    if (g_app.config.debugMode && SUCCEEDED(DwmFlush())) {
+        composedUs = GetTimestampUs() - startUs;
+    }
+
+    LONGLONG latencyUs = (LONGLONG)queueMs * 1000 + (composedUs ? composedUs : shownUs);
+    g_hotkeyLatency.count++;
+    g_hotkeyLatency.lastUs = latencyUs;
+    g_hotkeyLatency.totalUs += latencyUs;
+    if (latencyUs > g_hotkeyLatency.maxUs) {
+        g_hotkeyLatency.maxUs = latencyUs;
+    }
+
+    LogMessage("Hotkey %d: black in %lld us (queue %lu ms, window %lld us, composed %lld us)",
+               id, latencyUs, (unsigned long)queueMs, shownUs, composedUs);
+}
+#endif
+
+#if OLED_FEATURE_CONTROL_CLI
+// ---------------------------------------------------------------------------
+// Command-line control
+//
+// "oled_aegis.exe --<command> [args]" does not start a second instance; it
+// forwards the command to the running instance's window with WM_COPYDATA and
+// exits with the result code. Text output (query/stats) comes back as a
+// WM_COPYDATA sent to the client's message-only window while the client is
+// still blocked in SendMessageTimeout, so the round trip is one synchronous
+// exchange with no polling.
+//
+//   --activate [monitors]     Cover the given monitors (default: all enabled)
+//   --deactivate [monitors]   Uncover the given monitors (default: all)
+//   --query                   Print screen saver and per-monitor state
+//   --reload                  Re-read oled_aegis.ini
+//   --stats                   Print startup trace, memory and lease counters
+//
+// Monitors are GDI names (DISPLAY2) or device paths, comma or space
+// separated. Activation/deactivation behave like a tray click: the idle timer
+// and manual-activation cooldown still apply afterwards.
+// ---------------------------------------------------------------------------
+
+// Append formatted text to a reply buffer, truncating silently when full
+void AppendControlReply(char* reply, size_t replySize, const char* format, ...) {
+    size_t len = strlen(reply);
+    if (len + 1 >= replySize) return;
+
+    va_list args;
+    va_start(args, format);
+    _vsnprintf_s(reply + len, replySize - len, _TRUNCATE, format, args);
+    va_end(args);
+}
+
+// Re-read the config file and apply everything that can change at runtime.
+void ReloadConfig() {
+    int oldInterval = g_app.config.checkInterval;
+    int oldPerMonitor = g_app.config.perMonitorInputDetection;
+
+    LoadConfig();
+
+    for (int i = 0; i < g_monitorCount; i++) {
+        g_monitorStates[i].enabled = g_app.config.monitorsEnabled[i];
+        if (!g_monitorStates[i].enabled && g_monitorStates[i].hScreenSaverWnd) {
+            HideScreenSaverOnMonitor(i);
+            DestroyWindow(g_monitorStates[i].hScreenSaverWnd);
+            g_monitorStates[i].hScreenSaverWnd = NULL;
+        }
+    }
+
+    if (!IsAnyMonitorActive()) {
+        g_app.screenSaverActive = 0;
+        EnsureCursorVisible("no active monitors after reload");
+    }
+    UpdateTrayIcon(IsAnyMonitorActive() ? 1 : 0);
+
+    if (!oldPerMonitor && g_app.config.perMonitorInputDetection) {
+        time_t now = time(NULL);
+        for (int i = 0; i < g_monitorCount; i++) {
+            g_monitorStates[i].lastInputTime = now;
+        }
+    }
+
+    if (oldInterval != g_app.config.checkInterval) {
+        KillTimer(g_app.hWnd, TIMER_IDLE_CHECK);
+        SetTimer(g_app.hWnd, TIMER_IDLE_CHECK, g_app.config.checkInterval, NULL);
+    }
+
+    UpdateStartupRegistry();
+
+#if OLED_FEATURE_LEASE_API
+    if (g_app.config.leaseApiEnabled) {
+        StartLeaseServer();
+    } else {
+        StopLeaseServer();
+    }
+#endif
+#if OLED_FEATURE_HOTKEYS
+    RegisterHotkeys();
+#endif
+#if OLED_FEATURE_BURNIN_MAP
+    if (!g_app.config.burnInDetectionEnabled) {
+        ReleaseBurnInResources();
+    } else if (!g_app.config.burnInOverlayEnabled) {
+        for (int i = 0; i < g_monitorCount; i++) {
+            RemoveBurnInOverlays(i);
+        }
+    }
+#endif
+#if OLED_FEATURE_MOTION_DETECTION
+    if (!g_app.config.motionDetectionEnabled) {
+        ReleaseMotionResources();
+    }
+#endif
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+    // Bounds may have changed: re-derive every timeout from the next sample
+    ReleaseAplResources();
+#endif
+#if OLED_FEATURE_CONTROLLER_INPUT
+    if (!g_app.config.controllerInputEnabled) {
+        ResetControllerInput();
+    }
+#endif
+#if OLED_FEATURE_CPU_ACTIVITY
+    if (!g_app.config.cpuActivityEnabled) {
+        ResetCpuActivity();
+    }
+#endif
+#if OLED_FEATURE_TAB_PROBE
+    // The worker keeps its own copy of browserTabAudioLabel; the next scan
+    // restarts it if it is still enabled
+    StopTabProbe();
+#endif
+#if OLED_FEATURE_MEDIA_SESSIONS
+    if (!g_app.config.mediaSessionDetection) {
+        StopSmtcWatcher();
+    }
+#endif
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+    if (!g_app.config.fullscreenDetectionEnabled) {
+        StopFullscreenTracking();
+    }
+#endif
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN
+    if (!g_app.config.parallelWindowScan) {
+        StopParallelWindowScan();
+    }
+#endif
+#if OLED_FEATURE_WEAR_STATS
+    if (g_app.config.wearAccountingEnabled && !g_wearLoaded) {
+        StartWearAccounting();
+    } else if (!g_app.config.wearAccountingEnabled && g_wearLoaded) {
+        StopWearAccounting();
+    }
+#endif
+
+    LogMessage("Config reloaded: timeout %ds, interval %dms, media %d, perMonitor %d",
+               g_app.config.idleTimeout, g_app.config.checkInterval,
+               g_app.config.mediaDetectionEnabled, g_app.config.perMonitorInputDetection);
+}
+
+int ControlSetMonitors(const char* args, int activate, char* reply, size_t replySize) {
+    DWORD mask = LEASE_ALL_MONITORS;
+    if (args[0] != '\0') {
+        mask = ParseMonitorList(args);
+        if (mask == 0) {
+            AppendControlReply(reply, replySize, "Unknown monitor: %s\n", args);
+            return CONTROL_RESULT_UNKNOWN_MONITOR;
+        }
+    }
+
+    int changed = 0;
+    if (activate) {
+        // Same cooldown as the hotkey, so the input that launched the
+        // command does not immediately undo it. Like the hotkey, skip the
+        // shell window probe: it sleeps, and the client is waiting
+        g_app.isManualActivation = 1;
+        g_app.manualActivationTime = GetTickCount();
+        for (int i = 0; i < g_monitorCount; i++) {
+            if ((mask & (1u << i)) && g_monitorStates[i].enabled && !g_monitorStates[i].screenSaverActive) {
+                PresentScreenSaverWindow(i);
+                if (g_monitorStates[i].screenSaverActive) changed++;
+            }
+        }
+        if (IsAnyMonitorActive()) {
+            g_app.screenSaverActive = 1;
+        }
+    } else {
+        for (int i = 0; i < g_monitorCount; i++) {
+            if ((mask & (1u << i)) && g_monitorStates[i].screenSaverActive) {
+                HideScreenSaverOnMonitor(i);
+                changed++;
+            }
+        }
+        if (!IsAnyMonitorActive()) {
+            g_app.screenSaverActive = 0;
+            g_app.isManualActivation = 0;
+            g_app.manualActivationTime = 0;
+            EnsureCursorVisible("control deactivate");
+        }
+    }
+
+    UpdateTrayIcon(IsAnyMonitorActive() ? 1 : 0);
+    AppendControlReply(reply, replySize, "%s %d monitor(s)\n", activate ? "Activated" : "Deactivated", changed);
+    return CONTROL_RESULT_OK;
+}
 
-    GetDlgItemTextA(hWnd, IDC_PIXELSHIFT_EDIT, buffer, 32);
-    g_app.config.pixelShiftCompensation = atoi(buffer);
-    ClampConfigValues();
+void ControlQuery(char* reply, size_t replySize) {
+    time_t now = time(NULL);
+    AppendControlReply(reply, replySize, "state=%s mode=%s idleMs=%lu timeout=%ds manual=%d\n",
+                       IsAnyMonitorActive() ? "active" : "idle",
+                       g_app.config.perMonitorInputDetection ? "perMonitor" : "global",
+                       (unsigned long)GetIdleTime(), g_app.config.idleTimeout,
+                       g_app.isManualActivation);
 
     for (int i = 0; i < g_monitorCount; i++) {
-        int wasEnabled = g_app.config.monitorsEnabled[i];
-        g_app.config.monitorsEnabled[i] = IsDlgButtonChecked(hWnd, IDC_MONITOR_BASE + i) == BST_CHECKED;
-        g_monitorStates[i].enabled = g_app.config.monitorsEnabled[i];
-
-        if (!g_app.config.monitorsEnabled[i] && g_monitorStates[i].screenSaverActive) {
-            LogMessage("Disabling monitor %d which has active screen saver, hiding it", i);
-            HideScreenSaverOnMonitor(i);
-        }
-
-        if (!g_app.config.monitorsEnabled[i] && wasEnabled && g_monitorStates[i].hScreenSaverWnd) {
-            DestroyWindow(g_monitorStates[i].hScreenSaverWnd);
-            g_monitorStates[i].hScreenSaverWnd = NULL;
-            LogMessage("Destroyed screen saver window for disabled monitor %d", i);
+        const char* gdiName = g_monitors[i].deviceName;
+        if (strncmp(gdiName, DEVICE_NAME_PREFIX, DEVICE_NAME_PREFIX_LEN) == 0) {
+            gdiName += DEVICE_NAME_PREFIX_LEN;
         }
+        AppendControlReply(reply, replySize, "monitor %d %s enabled=%d active=%d idleSec=%d primary=%d \"%s\"\n",
+                           i, gdiName, g_monitorStates[i].enabled, g_monitorStates[i].screenSaverActive,
+                           (int)(now - g_monitorStates[i].lastInputTime), g_monitors[i].isPrimary,
+                           g_monitors[i].friendlyName);
     }
+}
 
-    if (!IsAnyMonitorActive()) {
-        g_app.screenSaverActive = 0;
-        EnsureCursorVisible("no active monitors after settings");
+void ControlStats(char* reply, size_t replySize) {
+    LONGLONG nowUs = GetTimestampUs();
+    AppendControlReply(reply, replySize, "uptimeSec=%lld\n", (nowUs - g_startupBeginUs) / 1000000);
+
+    AppendControlReply(reply, replySize, "startupUs=%lld phases=%d\n",
+                       g_startupLastMarkUs - g_startupBeginUs, g_startupPhaseCount);
+    for (int i = 0; i < g_startupPhaseCount; i++) {
+        AppendControlReply(reply, replySize, "  %-24s %8lld us\n", g_startupPhases[i].name, g_startupPhases[i].elapsedUs);
     }
 
-    if (!oldPerMonitor && g_app.config.perMonitorInputDetection) {
-        time_t now = time(NULL);
+    MemoryFootprint footprint;
+    GetMemoryFootprint(&footprint);
+    AppendControlReply(reply, replySize, "workingSetKB=%lu privateKB=%lu peakWorkingSetKB=%lu gdi=%lu user=%lu trims=%d\n",
+                       (unsigned long)(footprint.workingSet / 1024),
+                       (unsigned long)(footprint.privateBytes / 1024),
+                       (unsigned long)(footprint.peakWorkingSet / 1024),
+                       (unsigned long)footprint.gdiHandles, (unsigned long)footprint.userHandles,
+                       g_workingSetTrimCount);
+    AppendControlReply(reply, replySize, "startupWorkingSetKB=%lu startupPrivateKB=%lu\n",
+                       (unsigned long)(g_startupFootprint.workingSet / 1024),
+                       (unsigned long)(g_startupFootprint.privateBytes / 1024));
+
+#if OLED_FEATURE_HOTKEYS
+    AppendControlReply(reply, replySize, "hotkeys=%d activations=%d lastUs=%lld avgUs=%lld maxUs=%lld\n",
+                       g_hotkeysRegistered, g_hotkeyLatency.count, g_hotkeyLatency.lastUs,
+                       g_hotkeyLatency.count ? g_hotkeyLatency.totalUs / g_hotkeyLatency.count : 0,
+                       g_hotkeyLatency.maxUs);
+#endif
+#if OLED_FEATURE_WEAR_STATS
+    for (int i = 0; i < g_monitorCount; i++) {
+        char summary[160];
+        FormatWearSummary(i, 0, summary, sizeof(summary));
+        if (summary[0] != '\0') {
+            AppendControlReply(reply, replySize, "wear monitor %d: %s\n", i, summary);
+        }
+    }
+#endif
+#if OLED_FEATURE_BURNIN_MAP
+    if (g_app.config.burnInDetectionEnabled) {
+        AppendControlReply(reply, replySize, "burnInSamples=%d lastUs=%lld intervalMs=%lu cpuPercent=%.3f\n",
+                           g_burnInSampleCount, g_burnInLastSampleUs, (unsigned long)g_burnInIntervalMs,
+                           GetBurnInCpuPercent());
         for (int i = 0; i < g_monitorCount; i++) {
-            g_monitorStates[i].lastInputTime = now;
+            AppendControlReply(reply, replySize, "burnIn monitor %d: hotCells=%d/%d overlays=%d\n",
+                               i, g_burnIn[i].hotCells, BURNIN_CELLS, g_burnIn[i].overlayCount);
         }
-        LogMessage("Per-monitor mode enabled: reset all monitor idle times");
     }
+#endif
+#if OLED_FEATURE_MOTION_DETECTION
+    if (g_app.config.motionDetectionEnabled) {
+        AppendControlReply(reply, replySize, "motionSamples=%d lastUs=%lld avgUs=%lld motionMask=0x%08X\n",
+                           g_motionSampleCount, g_motionLastSampleUs,
+                           g_motionSampleCount ? g_motionTotalSampleUs / g_motionSampleCount : 0, g_motionMask);
+        for (int i = 0; i < g_monitorCount; i++) {
+            if (!g_motion[i].sampled) continue;
+            AppendControlReply(reply, replySize, "motion monitor %d: changedPermille=%d moved=%d/%d source=%s\n",
+                               i, g_motion[i].changedPermille, CountMotionSamples(g_motion[i].history),
+                               MOTION_HISTORY_SAMPLES,
+                               EqualRect(&g_motion[i].source, &g_monitors[i].rect) ? "monitor" : "window");
+        }
+    }
+#endif
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+    if (IsDynamicTimeoutActive()) {
+        AppendControlReply(reply, replySize, "aplSamples=%d lastUs=%lld avgUs=%lld minSec=%d maxSec=%d\n",
+                           g_aplSampleCount, g_aplLastSampleUs,
+                           g_aplSampleCount ? g_aplTotalSampleUs / g_aplSampleCount : 0,
+                           g_app.config.dynamicTimeoutMinSec, g_app.config.dynamicTimeoutMaxSec);
+        for (int i = 0; i < g_monitorCount; i++) {
+            AppendControlReply(reply, replySize, "apl monitor %d: apl=%d timeoutSec=%d\n",
+                               i, g_aplInitialized ? g_apl[i].apl : -1, GetEffectiveIdleTimeout(i));
+        }
+    }
+#endif
+#if OLED_FEATURE_CPU_ACTIVITY
+    if (g_app.config.cpuActivityEnabled) {
+        AppendControlReply(reply, replySize, "cpuActivityUpdates=%d lastUs=%lld avgUs=%lld tracked=%d handleOpens=%d cpuMask=0x%08X\n",
+                           g_cpuUpdateCount, g_cpuLastUpdateUs,
+                           g_cpuUpdateCount ? g_cpuTotalUpdateUs / g_cpuUpdateCount : 0,
+                           g_cpuProcessCount, g_cpuHandleOpens, g_cpuMask);
+    }
+#endif
+#if OLED_FEATURE_CONTROLLER_INPUT
+    if (g_app.config.controllerInputEnabled) {
+        int connected = 0;
+        for (int i = 0; i < CONTROLLER_MAX_SLOTS; i++) {
+            connected += g_controllers.slots[i].connected;
+        }
+        AppendControlReply(reply, replySize, "controllers xinput=%d polls=%d activity=%d connected=%d idleMs=%lu\n",
+                           g_xinputState > 0, g_controllerPollCount, g_controllerActivityCount,
+                           connected, (unsigned long)GetControllerIdleTime());
+    }
+#endif
+#if OLED_FEATURE_MEDIA_DETECTION
+    int cachedSessions = g_captureEndpoint.sessionCount;
+    int notifyingEndpoints = g_captureEndpoint.notifyReceived ? 1 : 0;
+    for (int i = 0; i < MAX_AUDIO_ENDPOINTS; i++) {
+        cachedSessions += g_renderEndpoints[i].sessionCount;
+        notifyingEndpoints += g_renderEndpoints[i].inUse && g_renderEndpoints[i].notifyReceived;
+    }
+    AppendControlReply(reply, replySize, "audioScans=%d lastUs=%lld avgUs=%lld comObjectsLast=%d comObjectsTotal=%ld renderEndpoints=%d cachedSessions=%d notifyingEndpoints=%d\n",
+                       g_audioScanCount, g_audioScanLastUs,
+                       g_audioScanCount ? g_audioScanTotalUs / g_audioScanCount : 0,
+                       g_audioComObjectsLast, (long)g_audioComObjectsTotal,
+                       GetRenderEndpointCount(), cachedSessions, notifyingEndpoints);
+    AppendControlReply(reply, replySize, "windowScans full=%d avgUs=%lld lastWindows=%d targeted=%d avgUs=%lld lastWindows=%d threadSnapshots=%d\n",
+                       g_windowScanCount[WINDOW_SCAN_FULL],
+                       g_windowScanCount[WINDOW_SCAN_FULL] ?
+                           g_windowScanTotalUs[WINDOW_SCAN_FULL] / g_windowScanCount[WINDOW_SCAN_FULL] : 0,
+                       g_windowScanLastWindows[WINDOW_SCAN_FULL],
+                       g_windowScanCount[WINDOW_SCAN_TARGETED],
+                       g_windowScanCount[WINDOW_SCAN_TARGETED] ?
+                           g_windowScanTotalUs[WINDOW_SCAN_TARGETED] / g_windowScanCount[WINDOW_SCAN_TARGETED] : 0,
+                       g_windowScanLastWindows[WINDOW_SCAN_TARGETED], g_threadSnapshotCount);
+    AppendControlReply(reply, replySize, "slowWindows=%d skippedWindows=%d budgetStops=%d\n",
+                       g_slowWindowCount, g_skippedWindowCount, g_windowBudgetStops);
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+    if (g_app.config.windowScanSliceUs) {
+        AppendControlReply(reply, replySize, "slicedWindowScans=%d avgUs=%lld lastWindows=%d lastSlices=%d maxSliceUs=%lld stale=%d\n",
+                           g_windowScanCount[WINDOW_SCAN_SLICED],
+                           g_windowScanCount[WINDOW_SCAN_SLICED] ?
+                               g_windowScanTotalUs[WINDOW_SCAN_SLICED] / g_windowScanCount[WINDOW_SCAN_SLICED] : 0,
+                           g_windowScanLastWindows[WINDOW_SCAN_SLICED], g_windowSlicesLast,
+                           g_windowSliceMaxUs, g_staleWindowScans);
+    }
+#endif
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN
+    if (g_app.config.parallelWindowScan) {
+        AppendControlReply(reply, replySize, "parallelWindowScans=%d avgUs=%lld lastUs=%lld lastWindows=%d workers=%d timeouts=%d\n",
+                           g_windowScanCount[WINDOW_SCAN_PARALLEL],
+                           g_windowScanCount[WINDOW_SCAN_PARALLEL] ?
+                               g_windowScanTotalUs[WINDOW_SCAN_PARALLEL] / g_windowScanCount[WINDOW_SCAN_PARALLEL] : 0,
+                           g_windowScanLastUs[WINDOW_SCAN_PARALLEL], g_windowScanLastWindows[WINDOW_SCAN_PARALLEL],
+                           g_parallelScanWorkers, g_parallelScanTimeouts);
+    }
+#endif
+#endif
+#if OLED_FEATURE_TAB_PROBE
+    if (g_app.config.browserTabProbeEnabled) {
+        AppendControlReply(reply, replySize, "tabProbes=%ld hits=%ld lastMs=%ld maxMs=%ld worker=%d\n",
+                           (long)g_tabProbeCount, (long)g_tabProbeHits, (long)g_tabProbeLastMs,
+                           (long)g_tabProbeMaxMs, g_hTabProbeThread != NULL);
+    }
+#endif
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+    if (g_app.config.fullscreenDetectionEnabled) {
+        AppendControlReply(reply, replySize, "fullscreenMask=0x%08X recomputes=%d\n",
+                           g_fullscreenMask, g_fullscreenRecomputes);
+    }
+#endif
+#if OLED_FEATURE_MEDIA_SESSIONS
+    if (g_app.config.mediaSessionDetection) {
+        AppendControlReply(reply, replySize, "mediaSessions=%d refreshes=%ld eventDriven=%ld worker=%d\n",
+                           g_smtcScan.sessionCount, (long)g_smtcRefreshCount, (long)g_smtcEventDriven,
+                           g_hSmtcThread != NULL);
+    }
+#endif
+#if OLED_FEATURE_LEASE_API
+    AppendControlReply(reply, replySize, "leases=%d leaseMask=0x%08X server=%d\n",
+                       g_leaseCount, g_leaseMonitorMask, g_hLeaseServerThread != NULL);
+#endif
+}
 
-    SaveConfig();
-    UpdateStartupRegistry();
+// Execute one control command on the UI thread. Returns a CONTROL_RESULT_*
+// code; human-readable output is appended to reply.
+int HandleControlCommand(const char* command, char* reply, size_t replySize) {
+    char verb[32] = {0};
+    const char* args = command;
+    int verbLen = 0;
+    while (*args && *args != ' ' && verbLen < (int)sizeof(verb) - 1) {
+        verb[verbLen++] = *args++;
+    }
+    while (*args == ' ') args++;
+
+    if (_stricmp(verb, "activate") == 0) {
+        return ControlSetMonitors(args, 1, reply, replySize);
+    } else if (_stricmp(verb, "deactivate") == 0) {
+        return ControlSetMonitors(args, 0, reply, replySize);
+    } else if (_stricmp(verb, "query") == 0) {
+        ControlQuery(reply, replySize);
+        return CONTROL_RESULT_OK;
+    } else if (_stricmp(verb, "reload") == 0) {
+        ReloadConfig();
+        AppendControlReply(reply, replySize, "Config reloaded\n");
+        return CONTROL_RESULT_OK;
+    } else if (_stricmp(verb, "stats") == 0) {
+        ControlStats(reply, replySize);
+        return CONTROL_RESULT_OK;
+    }
 
-    LogMessage("Settings applied: timeout %ds->%ds, interval %dms->%dms, media %d->%d, debug %d->%d, startup %d->%d, perMonitor %d->%d, perMonitorMedia %d->%d, mutedMedia %d->%d, pixelShift %dpx",
-             oldTimeout, g_app.config.idleTimeout,
-             oldInterval, g_app.config.checkInterval,
-             oldMedia, g_app.config.mediaDetectionEnabled,
-             oldDebug, g_app.config.debugMode,
-             oldStartup, g_app.config.startupEnabled,
-             oldPerMonitor, g_app.config.perMonitorInputDetection,
-             oldPerMonitorMedia, g_app.config.perMonitorMediaDetection,
-             oldBlockOnMutedMedia, g_app.config.blockOnMutedMedia,
-             g_app.config.pixelShiftCompensation);
+    AppendControlReply(reply, replySize,
+                       "Usage: oled_aegis.exe --activate|--deactivate [DISPLAYn ...] | --query | --reload | --stats\n");
+    return CONTROL_RESULT_USAGE;
+}
 
-    if (oldInterval != g_app.config.checkInterval) {
-        KillTimer(g_app.hWnd, TIMER_IDLE_CHECK);
-        SetTimer(g_app.hWnd, TIMER_IDLE_CHECK, g_app.config.checkInterval, NULL);
-        LogMessage("Timer recreated with new interval: %dms", g_app.config.checkInterval);
+// WM_COPYDATA from a control client. The reply text is sent back to the
+// client window passed in wParam before returning the result code.
+LRESULT HandleControlCopyData(HWND hClient, const COPYDATASTRUCT* cds) {
+    if (!cds || cds->dwData != CONTROL_COPYDATA_COMMAND ||
+        cds->cbData == 0 || cds->cbData >= CONTROL_MAX_COMMAND_LEN) {
+        return CONTROL_RESULT_USAGE;
     }
 
-    sprintf_s(buffer, 32, "%d", g_app.config.checkInterval);
-    SetDlgItemTextA(hWnd, IDC_INTERVAL_EDIT, buffer);
+    char command[CONTROL_MAX_COMMAND_LEN];
+    memcpy(command, cds->lpData, cds->cbData);
+    command[cds->cbData] = '\0';
+
+    LONGLONG startUs = GetTimestampUs();
+    char reply[CONTROL_REPLY_BUFFER_SIZE] = {0};
+    int result = HandleControlCommand(command, reply, sizeof(reply));
+    LogMessage("Control: '%s' -> %d (%lld us)", command, result, GetTimestampUs() - startUs);
+
+    if (hClient && IsWindow(hClient) && reply[0] != '\0') {
+        COPYDATASTRUCT replyData;
+        replyData.dwData = CONTROL_COPYDATA_REPLY;
+        replyData.cbData = (DWORD)strlen(reply);
+        replyData.lpData = reply;
+        DWORD_PTR ignored = 0;
+        SendMessageTimeoutW(hClient, WM_COPYDATA, (WPARAM)g_app.hWnd, (LPARAM)&replyData,
+                            SMTO_ABORTIFHUNG, CONTROL_TIMEOUT_MS, &ignored);
+    }
+
+    return result;
 }
 
-void UpdateTrayIcon(int active) {
-    active = active ? 1 : 0;
-    if (g_app.trayIconActive == active) {
-        return;
+static char g_controlReply[CONTROL_REPLY_BUFFER_SIZE];
+
+LRESULT CALLBACK ControlClientWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_COPYDATA) {
+        const COPYDATASTRUCT* cds = (const COPYDATASTRUCT*)lParam;
+        if (cds && cds->dwData == CONTROL_COPYDATA_REPLY && cds->cbData < sizeof(g_controlReply)) {
+            memcpy(g_controlReply, cds->lpData, cds->cbData);
+            g_controlReply[cds->cbData] = '\0';
+            return TRUE;
+        }
+        return FALSE;
     }
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
 
-    g_app.nid.hIcon = active ? g_hIconActive : g_hIconInactive;
-    lstrcpyA(g_app.nid.szTip, active ? "OLED Aegis - Active" : "OLED Aegis - Idle");
-    Shell_NotifyIconA(NIM_MODIFY, (PNOTIFYICONDATAA)&g_app.nid);
-    g_app.trayIconActive = active;
+// Write client output to stdout if it is redirected, otherwise to the
+// console of the parent process (this is a GUI-subsystem executable).
+void WriteControlOutput(const char* text) {
+    if (text[0] == '\0') return;
+
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    int ownsHandle = 0;
+    if (hOut == NULL || hOut == INVALID_HANDLE_VALUE) {
+        if (!AttachConsole(ATTACH_PARENT_PROCESS)) return;
+        hOut = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (hOut == INVALID_HANDLE_VALUE) return;
+        ownsHandle = 1;
+    }
+
+    DWORD written = 0;
+    WriteFile(hOut, text, (DWORD)strlen(text), &written, NULL);
+    if (ownsHandle) {
+        CloseHandle(hOut);
+    }
+}
+
+// Client side of "oled_aegis.exe --<command>". Returns the process exit code.
+int RunControlClient(const char* command) {
+    HWND hTarget = FindWindowW(L"OLEDAegisWindow", NULL);
+    if (!hTarget) {
+        WriteControlOutput("OLED Aegis is not running\n");
+        return CONTROL_RESULT_NOT_RUNNING;
+    }
+
+    WNDCLASSW wc = {0};
+    wc.lpfnWndProc = ControlClientWindowProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = L"OLEDAegisControlClient";
+    RegisterClassW(&wc);
+    HWND hReply = CreateWindowExW(0, wc.lpszClassName, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+
+    COPYDATASTRUCT cds;
+    cds.dwData = CONTROL_COPYDATA_COMMAND;
+    cds.cbData = (DWORD)strlen(command);
+    cds.lpData = (PVOID)command;
+
+    // Without SMTO_BLOCK, the reply WM_COPYDATA sent to hReply is dispatched
+    // while this call waits
+    DWORD_PTR result = CONTROL_RESULT_TIMEOUT;
+    if (!SendMessageTimeoutW(hTarget, WM_COPYDATA, (WPARAM)hReply, (LPARAM)&cds,
+                             SMTO_ABORTIFHUNG, CONTROL_TIMEOUT_MS, &result)) {
+        WriteControlOutput("OLED Aegis did not respond\n");
+        result = CONTROL_RESULT_TIMEOUT;
+    } else {
+        WriteControlOutput(g_controlReply);
+    }
+
+    if (hReply) {
+        DestroyWindow(hReply);
+    }
+    return (int)result;
 }
+#endif
 
 // Handle WM_CREATE: initialize application state, tray icon, config, monitors,
 // and the idle-check timer. Returns 0 on success, -1 to abort window creation
@@ -2217,6 +8639,7 @@ int HandleCreation(HWND hWnd) {
         return -1;
     }
     // Keep mutex handle open for app lifetime to maintain single-instance lock
+    StartupTraceMark("single-instance mutex");
 
     LoadTrayIcons();
 
@@ -2228,6 +8651,7 @@ int HandleCreation(HWND hWnd) {
     g_app.nid.hIcon = g_hIconInactive;
     lstrcpyA(g_app.nid.szTip, "OLED Aegis - Idle");
     Shell_NotifyIconA(NIM_ADD, &g_app.nid);
+    StartupTraceMark("tray icon");
 
     g_app.config.idleTimeout = DEFAULT_IDLE_TIMEOUT;
     g_app.config.checkInterval = 1000;
@@ -2237,11 +8661,33 @@ int HandleCreation(HWND hWnd) {
     g_app.config.perMonitorInputDetection = 0;
             g_app.config.perMonitorMediaDetection = 1;
             g_app.config.blockOnMutedMedia = 0;
+    g_app.config.memoryTrimEnabled = 0;
+    g_app.config.memorySoakLog = 0;
+    g_app.config.leaseApiEnabled = 0;
+    g_app.config.wearAccountingEnabled = 0;
+    g_app.config.burnInDetectionEnabled = 0;
+    g_app.config.burnInOverlayEnabled = 0;
+    g_app.config.burnInStaticSec = DEFAULT_BURNIN_STATIC_SEC;
+    g_app.config.burnInOverlayAlpha = 255;
+    g_app.config.motionDetectionEnabled = 0;
+    g_app.config.dynamicTimeoutEnabled = 0;
+    g_app.config.dynamicTimeoutMinSec = DEFAULT_DYNAMIC_TIMEOUT_MIN_SEC;
+    g_app.config.dynamicTimeoutMaxSec = DEFAULT_DYNAMIC_TIMEOUT_MAX_SEC;
+    g_app.config.controllerInputEnabled = 0;
+    g_app.config.cpuActivityEnabled = 0;
+    g_app.config.cpuActivityThresholdPct = DEFAULT_CPU_ACTIVITY_THRESHOLD_PCT;
+    g_app.config.browserTabProbeEnabled = 0;
+    g_app.config.mediaSessionDetection = 0;
+    g_app.config.fullscreenDetectionEnabled = 0;
+    g_app.config.parallelWindowScan = 0;
+    g_app.config.windowScanSliceUs = 0;
+    g_app.config.browserTabAudioLabel[0] = '\0';
             for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
         g_app.config.monitorsEnabled[i] = 1;
     }
 
     EnumerateMonitors();
+    StartupTraceMark("monitor enumeration");
 
     for (int i = 0; i < g_monitorCount; i++) {
         g_monitorStates[i].lastInputTime = time(NULL);
@@ -2249,18 +8695,14 @@ int HandleCreation(HWND hWnd) {
         g_monitorStates[i].enabled = g_app.config.monitorsEnabled[i];
     }
 
-    if (!ConfigFileExists()) {
-        SaveConfig();
-    }
-
-    LoadConfig();
+    // A missing config file is written with defaults during deferred init
+    g_app.configMissingAtStartup = !LoadConfig();
+    StartupTraceMark("config load");
 
     for (int i = 0; i < g_monitorCount; i++) {
         g_monitorStates[i].enabled = g_app.config.monitorsEnabled[i];
     }
 
-    UpdateStartupRegistry();
-
     LogMessage("Application started. Timeout: %ds, Media: %d, Debug: %d",
              g_app.config.idleTimeout, g_app.config.mediaDetectionEnabled, g_app.config.debugMode);
 
@@ -2274,219 +8716,320 @@ int HandleCreation(HWND hWnd) {
     RegisterClassW(&wc);
 
     SetTimer(hWnd, TIMER_IDLE_CHECK, g_app.config.checkInterval, NULL);
+    StartupTraceMark("window class and timer");
+
+    // Everything not needed for the first idle check runs after the message
+    // loop is pumping, so the tray icon and timer are up as early as possible.
+    PostMessage(hWnd, WM_DEFERRED_INIT, 0, 0);
 
     return 0;
 }
 
-void HandleTimeout(WPARAM wParam) {
-    if (wParam != TIMER_IDLE_CHECK) {
-        return;
+// Handle WM_DEFERRED_INIT: first-run config write, startup registry sync and
+// opening the debug log. Posted from HandleCreation.
+void HandleDeferredInit() {
+    if (g_app.configMissingAtStartup) {
+        SaveConfig();
+        g_app.configMissingAtStartup = 0;
+        StartupTraceMark("deferred config write");
     }
 
-    // Skip all processing if no monitors have screen saver enabled
-    if (!IsAnyMonitorEnabled()) {
-        return;
+    UpdateStartupRegistry();
+    StartupTraceMark("deferred startup registry");
+
+#if OLED_FEATURE_LEASE_API
+    if (g_app.config.leaseApiEnabled) {
+        StartLeaseServer();
+        StartupTraceMark("deferred lease server");
     }
+#endif
 
-    // Per-monitor input detection mode:
-    //   Each monitor has its own idle timer, updated by tracking cursor position
-    //   and focused-window location. This lets the screen saver activate on
-    //   unused monitors while the user continues working on others. Media is
-    //   checked per-monitor (if perMonitorMediaDetection is on) or globally.
-    //   Each monitor's screen saver is activated/deactivated independently.
-    if (g_app.config.perMonitorInputDetection) {
-        DWORD idleTime = GetIdleTime();
-        time_t now = time(NULL);
+#if OLED_FEATURE_HOTKEYS
+    RegisterHotkeys();
+    StartupTraceMark("deferred hotkeys");
+#endif
 
-        int usePerMonitorMedia = (g_app.config.perMonitorMediaDetection && g_app.config.mediaDetectionEnabled);
-        int mediaOnMonitor[MAX_MONITOR_COUNT] = {0};
-        int mediaPlaying = 0;
-        if (usePerMonitorMedia) {
-            UpdateMediaMonitorStates(mediaOnMonitor);
-        } else {
-            mediaPlaying = IsMediaPlaying();
-        }
+#if OLED_FEATURE_WEAR_STATS
+    if (g_app.config.wearAccountingEnabled) {
+        StartWearAccounting();
+        StartupTraceMark("deferred wear history");
+    }
+#endif
+
+    // Footprint right after startup, for comparing build configurations
+    GetMemoryFootprint(&g_startupFootprint);
+
+    EndDeferredLogging();
+    LogStartupTrace();
+    LogMessage("Startup footprint: workingSet=%lu KB, private=%lu KB, gdi=%lu, user=%lu",
+               (unsigned long)(g_startupFootprint.workingSet / 1024),
+               (unsigned long)(g_startupFootprint.privateBytes / 1024),
+               (unsigned long)g_startupFootprint.gdiHandles,
+               (unsigned long)g_startupFootprint.userHandles);
+}
 
-        int inManualCooldown = 0;
-        if (g_app.isManualActivation) {
-            DWORD timeSinceActivation = GetTickCount() - g_app.manualActivationTime;
-            if (timeSinceActivation < MANUAL_ACTIVATION_COOLDOWN_MS) {
-                inManualCooldown = 1;
-            } else {
-                g_app.isManualActivation = 0;
-                g_app.manualActivationTime = 0;
-            }
+// Per-monitor input detection mode:
+//   Each monitor has its own idle timer, updated by tracking cursor position
+//   and focused-window location. This lets the screen saver activate on
+//   unused monitors while the user continues working on others. Media is
+//   checked per-monitor (if perMonitorMediaDetection is on) or globally.
+//   Each monitor's screen saver is activated/deactivated independently.
+#if OLED_FEATURE_PER_MONITOR_INPUT
+void HandleTimeoutPerMonitor() {
+    DWORD idleTime = GetIdleTime();
+    time_t now = time(NULL);
+
+    int usePerMonitorMedia = (g_app.config.perMonitorMediaDetection && g_app.config.mediaDetectionEnabled);
+    int mediaOnMonitor[MAX_MONITOR_COUNT] = {0};
+    int mediaPlaying = 0;
+    if (usePerMonitorMedia) {
+        UpdateMediaMonitorStates(mediaOnMonitor);
+    } else {
+        mediaPlaying = IsMediaPlaying();
+    }
+    DWORD inhibitMask = GetIdleLeaseMonitorMask() | GetMotionMonitorMask() | GetCpuActivityMonitorMask();
+
+    int inManualCooldown = 0;
+    if (g_app.isManualActivation) {
+        DWORD timeSinceActivation = GetTickCount() - g_app.manualActivationTime;
+        if (timeSinceActivation < MANUAL_ACTIVATION_COOLDOWN_MS) {
+            inManualCooldown = 1;
+        } else {
+            g_app.isManualActivation = 0;
+            g_app.manualActivationTime = 0;
         }
+    }
 
-        if (idleTime < IDLE_ACTIVITY_THRESHOLD_MS && !inManualCooldown) {
-            POINT pt;
-            GetCursorPos(&pt);
-            int cursorMonitorIndex = GetMonitorIndexFromPoint(pt);
+    if (idleTime < IDLE_ACTIVITY_THRESHOLD_MS && !inManualCooldown) {
+        POINT pt;
+        GetCursorPos(&pt);
+        int cursorMonitorIndex = GetMonitorIndexFromPoint(pt);
 
-            if (cursorMonitorIndex >= 0 && cursorMonitorIndex < g_monitorCount) {
-                g_monitorStates[cursorMonitorIndex].lastInputTime = now;
-            }
+        if (cursorMonitorIndex >= 0 && cursorMonitorIndex < g_monitorCount) {
+            g_monitorStates[cursorMonitorIndex].lastInputTime = now;
+        }
 
-            HWND hFg = GetForegroundWindow();
-            if (hFg) {
-                int isOledWindow = 0;
-                for (int i = 0; i < g_monitorCount; i++) {
-                    if (g_monitorStates[i].hScreenSaverWnd == hFg) {
-                        isOledWindow = 1;
-                        break;
-                    }
+        HWND hFg = GetForegroundWindow();
+        if (hFg) {
+            int isOledWindow = 0;
+            for (int i = 0; i < g_monitorCount; i++) {
+                if (g_monitorStates[i].hScreenSaverWnd == hFg) {
+                    isOledWindow = 1;
+                    break;
                 }
+            }
 
-                if (!isOledWindow) {
-                    RECT rect;
-                    GetWindowRect(hFg, &rect);
-                    int fgMonitorIndex = GetMonitorIndexFromRect(rect);
-                    if (fgMonitorIndex >= 0 && fgMonitorIndex < g_monitorCount && fgMonitorIndex != cursorMonitorIndex) {
-                        g_monitorStates[fgMonitorIndex].lastInputTime = now;
-                    }
+            if (!isOledWindow) {
+                RECT rect;
+                GetWindowRect(hFg, &rect);
+                int fgMonitorIndex = GetMonitorIndexFromRect(rect);
+                if (fgMonitorIndex >= 0 && fgMonitorIndex < g_monitorCount && fgMonitorIndex != cursorMonitorIndex) {
+                    g_monitorStates[fgMonitorIndex].lastInputTime = now;
                 }
             }
         }
+    }
 
-        for (int i = 0; i < g_monitorCount; i++) {
-            if (!g_monitorStates[i].enabled) continue;
-
-            int idleSeconds = (int)(now - g_monitorStates[i].lastInputTime);
-            int monitorHasMedia = usePerMonitorMedia ? mediaOnMonitor[i] : mediaPlaying;
+    for (int i = 0; i < g_monitorCount; i++) {
+        if (!g_monitorStates[i].enabled) continue;
 
-            if (!monitorHasMedia && idleSeconds >= g_app.config.idleTimeout) {
-                if (!g_monitorStates[i].screenSaverActive) {
-                    LogMessage("Timer: Activating screen saver on monitor %d (idle: %ds)", i, idleSeconds);
-                    ShowScreenSaverOnMonitor(i, 0);
-                }
-            } else if (g_monitorStates[i].screenSaverActive && !inManualCooldown) {
-                if (monitorHasMedia) {
-                    LogMessage("Timer: Deactivating screen saver on monitor %d (media detected)", i);
-                    HideScreenSaverOnMonitor(i);
-                } else if (idleSeconds < IDLE_DEACTIVATE_THRESHOLD_SEC) {
-                    LogMessage("Timer: Deactivating screen saver on monitor %d (input detected)", i);
-                    HideScreenSaverOnMonitor(i);
-                }
-            }
+        int idleSeconds = (int)(now - g_monitorStates[i].lastInputTime);
+        int monitorHasMedia = usePerMonitorMedia ? mediaOnMonitor[i] : mediaPlaying;
+        if (inhibitMask & (1u << i)) {
+            monitorHasMedia = 1;
         }
 
-        if (!IsAnyMonitorActive()) {
-            g_app.screenSaverActive = 0;
+        switch (DecideMonitorAction(g_monitorStates[i].screenSaverActive, idleSeconds,
+                                    GetEffectiveIdleTimeout(i), monitorHasMedia, inManualCooldown)) {
+            case MONITOR_ACTION_ACTIVATE:
+                LogMessage("Timer: Activating screen saver on monitor %d (idle: %ds)", i, idleSeconds);
+                ShowScreenSaverOnMonitor(i, 0);
+                break;
+            case MONITOR_ACTION_DEACTIVATE_MEDIA:
+                LogMessage("Timer: Deactivating screen saver on monitor %d (media detected)", i);
+                HideScreenSaverOnMonitor(i);
+                break;
+            case MONITOR_ACTION_DEACTIVATE_INPUT:
+                LogMessage("Timer: Deactivating screen saver on monitor %d (input detected)", i);
+                HideScreenSaverOnMonitor(i);
+                break;
+            case MONITOR_ACTION_NONE:
+                break;
         }
+    }
 
-        POINT cursorPt;
-        GetCursorPos(&cursorPt);
-        int cursorMonitorIndex = GetMonitorIndexFromPoint(cursorPt);
-        int cursorOnActiveMonitor = (cursorMonitorIndex >= 0 && cursorMonitorIndex < g_monitorCount && g_monitorStates[cursorMonitorIndex].screenSaverActive);
+    if (!IsAnyMonitorActive()) {
+        g_app.screenSaverActive = 0;
+    }
 
-        if (cursorOnActiveMonitor) {
-            HideCursorForScreenSaver("cursor on active monitor");
-        } else {
-            if (g_app.cursorHidden) {
-                EnsureCursorVisible("cursor left active monitor");
-            }
-        }
+    POINT cursorPt;
+    GetCursorPos(&cursorPt);
+    int cursorMonitorIndex = GetMonitorIndexFromPoint(cursorPt);
+    int cursorOnActiveMonitor = (cursorMonitorIndex >= 0 && cursorMonitorIndex < g_monitorCount && g_monitorStates[cursorMonitorIndex].screenSaverActive);
 
-        UpdateTrayIcon(IsAnyMonitorActive() ? 1 : 0);
+    if (cursorOnActiveMonitor) {
+        HideCursorForScreenSaver("cursor on active monitor");
     } else {
-        // Global input detection mode:
-        //   A single idle timer (GetIdleTime) covers all monitors. When per-
-        //   monitor media detection is on, each monitor is still activated/
-        //   deactivated independently based on whether media is playing on it,
-        //   but idle time is global. Without per-monitor media, the original
-        //   all-on/all-off behavior is used.
-        DWORD idleTime = GetIdleTime();
-
-        if (g_app.config.perMonitorMediaDetection && g_app.config.mediaDetectionEnabled) {
-            // Per-monitor media with global input:
-            //   When idle beyond the timeout, activate the screen saver on
-            //   monitors without media and deactivate it on monitors where media
-            //   is detected. When the user is active, deactivate everything
-            //   (preserving the manual-activation cooldown logic).
-            int mediaOnMonitor[MAX_MONITOR_COUNT] = {0};
+        if (g_app.cursorHidden) {
+            EnsureCursorVisible("cursor left active monitor");
+        }
+    }
+
+    UpdateTrayIcon(IsAnyMonitorActive() ? 1 : 0);
+}
+#endif
+
+// Carries out DecideGlobalAction for all monitors at once
+static void ApplyGlobalAction(DWORD idleTime, DWORD timeoutMs, int mediaPlaying) {
+    DWORD timeSinceActivation = g_app.isManualActivation ? GetTickCount() - g_app.manualActivationTime : 0;
+
+    switch (DecideGlobalAction(g_app.screenSaverActive, idleTime, timeoutMs, mediaPlaying,
+                               g_app.isManualActivation, timeSinceActivation)) {
+        case GLOBAL_ACTION_ACTIVATE:
+            LogMessage("Timer: Activating screen saver (idle: %lums)", idleTime);
+            ShowScreenSaver(0);
+            UpdateTrayIcon(1);
+            break;
+        case GLOBAL_ACTION_DEACTIVATE:
+            LogMessage("Timer: Deactivating screen saver (idle: %lums, media: %d)", idleTime, mediaPlaying);
+            HideScreenSaver();
+            UpdateTrayIcon(0);
+            break;
+        case GLOBAL_ACTION_DEACTIVATE_AFTER_COOLDOWN:
+            LogMessage("Timer: Deactivating screen saver (new input detected after cooldown)");
+            HideScreenSaver();
+            UpdateTrayIcon(0);
+            break;
+        case GLOBAL_ACTION_HOLD_COOLDOWN:
+            LogMessage("Timer: Skipping deactivation (manual cooldown: %lums/%dms)",
+                     timeSinceActivation, MANUAL_ACTIVATION_COOLDOWN_MS);
+            break;
+        case GLOBAL_ACTION_NONE:
+            break;
+    }
+}
+
+// Global input detection mode:
+//   A single idle timer (GetIdleTime) covers all monitors. When per-
+//   monitor media detection is on, each monitor is still activated/
+//   deactivated independently based on whether media is playing on it,
+//   but idle time is global. Without per-monitor media, the original
+//   all-on/all-off behavior is used. Idle-inhibit leases and detected
+//   motion also take the per-monitor path, since they can cover a subset of
+//   monitors.
+void HandleTimeoutGlobal() {
+    DWORD idleTime = GetIdleTime();
+    int usePerMonitorMedia = (g_app.config.perMonitorMediaDetection && g_app.config.mediaDetectionEnabled);
+    DWORD inhibitMask = GetIdleLeaseMonitorMask() | GetMotionMonitorMask() | GetCpuActivityMonitorMask();
+
+    if (usePerMonitorMedia || inhibitMask != 0) {
+        // Per-monitor media with global input:
+        //   When idle beyond the timeout, activate the screen saver on
+        //   monitors without media and deactivate it on monitors where media
+        //   is detected. When the user is active, deactivate everything
+        //   (preserving the manual-activation cooldown logic).
+        int mediaOnMonitor[MAX_MONITOR_COUNT] = {0};
+        if (usePerMonitorMedia) {
             UpdateMediaMonitorStates(mediaOnMonitor);
+        } else if (IsMediaPlaying()) {
+            for (int i = 0; i < g_monitorCount; i++) {
+                mediaOnMonitor[i] = 1;
+            }
+        }
+        ApplyInhibitMask(mediaOnMonitor, inhibitMask);
 
-            if (idleTime > (DWORD)(g_app.config.idleTimeout * 1000)) {
-                for (int i = 0; i < g_monitorCount; i++) {
-                    if (!g_monitorStates[i].enabled) continue;
+        DWORD timeoutMs = (DWORD)(g_app.config.idleTimeout * 1000);
+        if (idleTime > timeoutMs) {
+            for (int i = 0; i < g_monitorCount; i++) {
+                if (!g_monitorStates[i].enabled) continue;
 
-                    if (mediaOnMonitor[i]) {
-                        if (g_monitorStates[i].screenSaverActive) {
-                            LogMessage("Timer: Deactivating screen saver on monitor %d (media detected)", i);
-                            HideScreenSaverOnMonitor(i);
-                        }
-                    } else if (!g_monitorStates[i].screenSaverActive) {
+                switch (DecideIdleMonitorAction(g_monitorStates[i].screenSaverActive, mediaOnMonitor[i])) {
+                    case MONITOR_ACTION_ACTIVATE:
                         LogMessage("Timer: Activating screen saver on monitor %d (idle: %lums)", i, idleTime);
                         ShowScreenSaverOnMonitor(i, 0);
-                    }
+                        break;
+                    case MONITOR_ACTION_DEACTIVATE_MEDIA:
+                        LogMessage("Timer: Deactivating screen saver on monitor %d (media detected)", i);
+                        HideScreenSaverOnMonitor(i);
+                        break;
+                    case MONITOR_ACTION_DEACTIVATE_INPUT:
+                    case MONITOR_ACTION_NONE:
+                        break;
                 }
+            }
 
-                g_app.screenSaverActive = IsAnyMonitorActive() ? 1 : 0;
-
-                if (!g_app.screenSaverActive && g_app.cursorHidden) {
-                    EnsureCursorVisible("no active monitors");
-                }
+            g_app.screenSaverActive = IsAnyMonitorActive() ? 1 : 0;
 
-                UpdateTrayIcon(g_app.screenSaverActive);
-            } else {
-                // User is active: deactivate everything (preserve manual cooldown logic)
-                if (g_app.screenSaverActive) {
-                    if (g_app.isManualActivation) {
-                        DWORD timeSinceActivation = GetTickCount() - g_app.manualActivationTime;
-                        if (timeSinceActivation < MANUAL_ACTIVATION_COOLDOWN_MS) {
-                            LogMessage("Timer: Skipping deactivation (manual cooldown: %lums/%dms)",
-                                     timeSinceActivation, MANUAL_ACTIVATION_COOLDOWN_MS);
-                        } else {
-                            if (idleTime < IDLE_DEACTIVATE_THRESHOLD_MS) {
-                                LogMessage("Timer: Deactivating screen saver (new input detected after cooldown)");
-                                HideScreenSaver();
-                                UpdateTrayIcon(0);
-                            }
-                        }
-                    } else {
-                        LogMessage("Timer: Deactivating screen saver (idle: %lums)", idleTime);
-                        HideScreenSaver();
-                        UpdateTrayIcon(0);
-                    }
-                }
+            if (!g_app.screenSaverActive && g_app.cursorHidden) {
+                EnsureCursorVisible("no active monitors");
             }
+
+            UpdateTrayIcon(g_app.screenSaverActive);
         } else {
-            // Original global behavior:
-            //   When idle beyond the timeout and no media is playing, activate
-            //   the screen saver on all enabled monitors at once. When the user
-            //   is active or media starts playing, deactivate everything.
-            //   Manual-activation cooldown logic is preserved.
-            int mediaPlaying = IsMediaPlaying();
-
-            if (!mediaPlaying && idleTime > (DWORD)(g_app.config.idleTimeout * 1000)) {
-                if (!g_app.screenSaverActive) {
-                    LogMessage("Timer: Activating screen saver (idle: %lums)", idleTime);
-                    ShowScreenSaver(0);
-                    UpdateTrayIcon(1);
-                }
-            } else {
-                if (g_app.screenSaverActive) {
-                    if (g_app.isManualActivation) {
-                        DWORD timeSinceActivation = GetTickCount() - g_app.manualActivationTime;
-                        if (timeSinceActivation < MANUAL_ACTIVATION_COOLDOWN_MS) {
-                            LogMessage("Timer: Skipping deactivation (manual cooldown: %lums/%dms)",
-                                     timeSinceActivation, MANUAL_ACTIVATION_COOLDOWN_MS);
-                        } else {
-                            if (idleTime < IDLE_DEACTIVATE_THRESHOLD_MS) {
-                                LogMessage("Timer: Deactivating screen saver (new input detected after cooldown)");
-                                HideScreenSaver();
-                                UpdateTrayIcon(0);
-                            }
-                        }
-                    } else {
-                        LogMessage("Timer: Deactivating screen saver (idle: %lums, media: %d)", idleTime, mediaPlaying);
-                        HideScreenSaver();
-                        UpdateTrayIcon(0);
-                    }
-                }
-            }
+            // User is active: deactivate everything (preserve manual cooldown logic)
+            ApplyGlobalAction(idleTime, timeoutMs, 0);
         }
+    } else {
+        // Original global behavior:
+        //   When idle beyond the timeout and no media is playing, activate
+        //   the screen saver on all enabled monitors at once. When the user
+        //   is active or media starts playing, deactivate everything.
+        //   Manual-activation cooldown logic is preserved.
+        ApplyGlobalAction(idleTime, (DWORD)(g_app.config.idleTimeout * 1000), IsMediaPlaying());
+    }
+}
+
+void HandleTimeout(WPARAM wParam) {
+#if OLED_FEATURE_SLICED_WINDOW_SCAN
+    if (wParam == TIMER_MEDIA_SCAN_SLICE) {
+        ContinueMediaScan();
+        return;
+    }
+#endif
+    if (wParam != TIMER_IDLE_CHECK) {
+        return;
+    }
+
+#if OLED_FEATURE_WEAR_STATS
+    // Before the enabled-monitor check: uncovered time counts either way
+    UpdateWearAccounting();
+#endif
+
+    // Skip all processing if no monitors have screen saver enabled
+    if (!IsAnyMonitorEnabled()) {
+        return;
+    }
+
+#if OLED_FEATURE_CONTROLLER_INPUT
+    if (g_app.config.controllerInputEnabled) {
+        UpdateControllerInput();
+    }
+#endif
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+    if (IsDynamicTimeoutActive()) {
+        UpdateDynamicTimeouts();
     }
+#endif
+#if OLED_FEATURE_MOTION_DETECTION
+    if (g_app.config.motionDetectionEnabled) {
+        UpdateMotionDetection();
+    }
+#endif
+#if OLED_FEATURE_CPU_ACTIVITY
+    if (g_app.config.cpuActivityEnabled) {
+        UpdateCpuActivity();
+    }
+#endif
+
+#if OLED_FEATURE_PER_MONITOR_INPUT
+    if (g_app.config.perMonitorInputDetection) {
+        HandleTimeoutPerMonitor();
+    } else {
+        HandleTimeoutGlobal();
+    }
+#else
+    HandleTimeoutGlobal();
+#endif
 
     // Ensure screen saver windows stay on top (handles notifications like MS
     // Teams, Steam friends, etc.), but throttle to avoid a SetWindowPos call
@@ -2501,6 +9044,14 @@ void HandleTimeout(WPARAM wParam) {
     } else {
         lastTopmostRefresh = 0;
     }
+
+#if OLED_FEATURE_BURNIN_MAP
+    if (g_app.config.burnInDetectionEnabled) {
+        UpdateBurnInHeatmap();
+    }
+#endif
+
+    UpdateMemoryManagement();
 }
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
@@ -2517,19 +9068,64 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         case WM_CREATE:
             return HandleCreation(hWnd);
 
+        case WM_DEFERRED_INIT:
+            HandleDeferredInit();
+            break;
+
         case WM_TIMER:
             HandleTimeout(wParam);
             break;
 
+#if OLED_FEATURE_HOTKEYS
+        case WM_HOTKEY:
+            HandleHotkey((int)wParam);
+            break;
+#endif
+
+#if OLED_FEATURE_CONTROL_CLI
+        case WM_COPYDATA:
+            return HandleControlCopyData((HWND)wParam, (const COPYDATASTRUCT*)lParam);
+#endif
+
+#if OLED_FEATURE_LEASE_API
+        case WM_LEASE_REQUEST: {
+            LeaseRequest* req = (LeaseRequest*)lParam;
+            HandleLeaseRequest(req);
+            SetEvent(req->hDone);
+            ReleaseLeaseRequest(req);
+            return 0;
+        }
+
+        case WM_LEASE_OWNER_EXITED: {
+            IdleLease* lease = FindIdleLease((DWORD)wParam);
+            if (lease) {
+                ReleaseIdleLease(lease, "owner exited");
+            }
+            break;
+        }
+#endif
+
         case WM_POWERBROADCAST:
             if (wParam == PBT_APMRESUMESUSPEND || wParam == PBT_APMRESUMEAUTOMATIC) {
                 LogMessage("System resumed from sleep - resetting media detection cache");
                 ResetMediaDetectionCache();
             }
+#if OLED_FEATURE_WEAR_STATS
+            HandleWearPowerEvent(wParam, lParam);
+#endif
             break;
 
         case WM_DISPLAYCHANGE:
             LogMessage("Display configuration changed - re-enumerating monitors");
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+            InvalidateFullscreenState();
+#endif
+            // A scan in progress maps windows to the old monitors: drop it
+            // and the cached result (the next scan clears scanInProgress)
+#if OLED_FEATURE_MEDIA_DETECTION
+            AbortWindowSlices();
+#endif
+            g_mediaCacheInvalidated = 1;
 
             // Destroy all screen saver windows first
             for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
@@ -2563,11 +9159,31 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             // If settings dialog is open, close and reopen to refresh monitor list
             if (g_hSettingsDialog) {
                 LogMessage("Refreshing settings dialog for new monitor configuration");
-                DestroyWindow(g_hSettingsDialog);
-                g_hSettingsDialog = NULL;
+#if OLED_FEATURE_SETTINGS_UI
+                CloseSettingsDialog(g_hSettingsDialog);
                 ShowSettingsDialog();
+#endif
             }
 
+#if OLED_FEATURE_HOTKEYS
+            RegisterHotkeys();
+#endif
+#if OLED_FEATURE_WEAR_STATS
+            RefreshWearMapping();
+#endif
+#if OLED_FEATURE_BURNIN_MAP
+            ReleaseBurnInResources();
+#endif
+#if OLED_FEATURE_MOTION_DETECTION
+            ReleaseMotionResources();
+#endif
+#if OLED_FEATURE_CPU_ACTIVITY
+            ResetCpuActivity();
+#endif
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+            ReleaseAplResources();
+#endif
+
             LogMessage("Monitor configuration updated: %d -> %d monitors", oldMonitorCount, g_monitorCount);
             break;
 
@@ -2581,8 +9197,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                 EnsureCursorVisible("tray menu opened");
 
                 HMENU hMenu = CreatePopupMenu();
+#if OLED_FEATURE_SETTINGS_UI
                 AppendMenuA(hMenu, MF_STRING, IDM_SETTINGS, "Settings...");
                 AppendMenuA(hMenu, MF_SEPARATOR, 0, NULL);
+#endif
                 AppendMenuA(hMenu, MF_STRING, IDM_EXIT, "Exit");
 
                 TrackPopupMenu(hMenu, TPM_RIGHTBUTTON, pt.x, pt.y, 0, hWnd, NULL);
@@ -2610,10 +9228,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
         case WM_COMMAND:
             switch (LOWORD(wParam)) {
+#if OLED_FEATURE_SETTINGS_UI
                 case IDM_SETTINGS:
                     LogMessage("User: Selected 'Settings' from tray menu");
                     ShowSettingsDialog();
                     break;
+#endif
                 case IDM_EXIT:
                     LogMessage("User: Selected 'Exit' from tray menu - shutting down");
                     HideScreenSaver();
@@ -2628,6 +9248,28 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
             EnsureCursorVisible("shutdown");
 
+#if OLED_FEATURE_LEASE_API
+            StopLeaseServer();
+#endif
+#if OLED_FEATURE_HOTKEYS
+            UnregisterHotkeys();
+#endif
+#if OLED_FEATURE_WEAR_STATS
+            StopWearAccounting();
+#endif
+#if OLED_FEATURE_BURNIN_MAP
+            ReleaseBurnInResources();
+#endif
+#if OLED_FEATURE_MOTION_DETECTION
+            ReleaseMotionResources();
+#endif
+#if OLED_FEATURE_CPU_ACTIVITY
+            ResetCpuActivity();
+#endif
+#if OLED_FEATURE_DYNAMIC_TIMEOUT
+            ReleaseAplResources();
+#endif
+
             for (int i = 0; i < MAX_MONITOR_COUNT; i++) {
                 if (g_monitorStates[i].hScreenSaverWnd) {
                     DestroyWindow(g_monitorStates[i].hScreenSaverWnd);
@@ -2638,10 +9280,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
             Shell_NotifyIconA(NIM_DELETE, &g_app.nid);
 
+#if OLED_FEATURE_SETTINGS_UI
             if (g_hSettingsDialog) {
-                DestroyWindow(g_hSettingsDialog);
-                g_hSettingsDialog = NULL;
+                CloseSettingsDialog(g_hSettingsDialog);
             }
+#endif
 
             if (g_logFile) {
                 fclose(g_logFile);
@@ -2672,10 +9315,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
-    SetProcessDPIAware();
+#if OLED_FEATURE_CONTROL_CLI
+    if (lpCmdLine && lpCmdLine[0] == '-' && lpCmdLine[1] == '-') {
+        return RunControlClient(lpCmdLine + 2);
+    }
+#endif
 
-    HRESULT hrCom = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-    // hrCom may be S_OK or S_FALSE (already initialized); either is fine to proceed.
+    StartupTraceBegin();
+    SetProcessDPIAware();
 
     g_uTaskbarRestart = RegisterWindowMessageW(L"TaskbarCreated");
 
@@ -2694,9 +9341,35 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         DispatchMessage(&msg);
     }
 
-    if (SUCCEEDED(hrCom)) {
+    // Exit from the tray menu quits without WM_DESTROY
+#if OLED_FEATURE_LEASE_API
+    StopLeaseServer();
+#endif
+#if OLED_FEATURE_WEAR_STATS
+    StopWearAccounting();
+#endif
+#if OLED_FEATURE_TAB_PROBE
+    StopTabProbe();
+#endif
+#if OLED_FEATURE_MEDIA_SESSIONS
+    StopSmtcWatcher();
+#endif
+#if OLED_FEATURE_FULLSCREEN_DETECTION
+    StopFullscreenTracking();
+#endif
+#if OLED_FEATURE_PARALLEL_WINDOW_SCAN
+    StopParallelWindowScan();
+#endif
+#if OLED_FEATURE_MEDIA_DETECTION
+    ReleaseAudioCache();
+
+    // COM is only ever initialized by media detection (ole32 isn't linked
+    // into the minimal build)
+    if (g_comInitialized) {
         CoUninitialize();
+        g_comInitialized = 0;
     }
+#endif
 
     return (int)msg.wParam;
 }
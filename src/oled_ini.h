@@ -0,0 +1,56 @@
+// OLED Aegis - config file line parsing
+//
+// Splitting oled_aegis.ini lines into keys and values, kept free of Win32
+// types so tests/test_config.c can check it with any C compiler. LoadConfig
+// in oled_aegis.c decides what each key means.
+
+#ifndef OLED_INI_H
+#define OLED_INI_H
+
+#include <string.h>
+
+static int IsIniSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static char* TrimIniText(char* text) {
+    while (IsIniSpace(*text)) text++;
+    size_t len = strlen(text);
+    while (len > 0 && IsIniSpace(text[len - 1])) {
+        text[--len] = '\0';
+    }
+    return text;
+}
+
+// Keys whose value is free text: the rest of the line after '=', spaces
+// and ';' included (a localized browser label may contain either).
+static int IsIniStringKey(const char* key) {
+    return strcmp(key, "browserTabAudioLabel") == 0;
+}
+
+// Split line in place into a trimmed key and value. A ';' starts a comment,
+// except inside the value of a string key. Returns 0 for blank and comment
+// lines, for lines without '=' or without a key, and for an empty value
+// (which leaves a numeric setting at its default); a string key may be
+// empty.
+static int SplitIniLine(char* line, char** key, char** value) {
+    char* start = TrimIniText(line);
+    if (*start == ';') return 0;
+
+    char* equals = strchr(start, '=');
+    if (!equals) return 0;
+    *equals = '\0';
+
+    *key = TrimIniText(start);
+    if (**key == '\0' || strchr(*key, ';')) return 0;
+
+    char* rest = equals + 1;
+    if (!IsIniStringKey(*key)) {
+        char* comment = strchr(rest, ';');
+        if (comment) *comment = '\0';
+    }
+    *value = TrimIniText(rest);
+    return **value != '\0' || IsIniStringKey(*key);
+}
+
+#endif
@@ -0,0 +1,88 @@
+// OLED Aegis - motion detection kernels
+//
+// Luma conversion and frame differencing for the on-screen motion detection
+// in oled_aegis.c, kept free of Win32 types so tests/test_motion.c can check
+// the SSE2 path against the scalar one and tests/bench_motion.c can time
+// both on synthetic frames, with any C compiler.
+//
+// The SSE2 path handles whole vectors and leaves the tail to the scalar
+// code, so the two give identical results for every length.
+
+#ifndef OLED_MOTION_H
+#define OLED_MOTION_H
+
+#ifndef MOTION_USE_SSE2
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MOTION_USE_SSE2 1
+#else
+#define MOTION_USE_SSE2 0
+#endif
+#endif
+
+#if MOTION_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// BT.601 luma of BGRA pixels [start, count) (same weights as the burn-in heatmap).
+static void MotionLumaScalar(const unsigned char* bgra, int start, int count, unsigned char* luma) {
+    for (int i = start; i < count; i++) {
+        const unsigned char* p = bgra + (size_t)i * 4;
+        luma[i] = (unsigned char)((p[0] * 29u + p[1] * 150u + p[2] * 77u) >> 8);
+    }
+}
+
+// Number of positions in [start, count) where |a[i] - b[i]| > threshold.
+static int CountChangedPixelsScalar(const unsigned char* a, const unsigned char* b, int start, int count,
+                                    unsigned char threshold) {
+    int changed = 0;
+    for (int i = start; i < count; i++) {
+        int diff = (int)a[i] - (int)b[i];
+        if (diff > threshold || diff < -threshold) changed++;
+    }
+    return changed;
+}
+
+static void MotionLumaFromBgra(const unsigned char* bgra, int count, unsigned char* luma) {
+    int i = 0;
+#if MOTION_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);  // B, G, R, A (x256)
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(bgra + (size_t)i * 4));
+        // madd leaves two partial sums per pixel: B*29+G*150 and R*77
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+        lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+        hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+        __m128i sums = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi),
+                                                       _MM_SHUFFLE(2, 0, 2, 0)));
+        sums = _mm_srli_epi32(sums, 8);
+        sums = _mm_packs_epi32(sums, sums);
+        sums = _mm_packus_epi16(sums, sums);
+        *(int*)(luma + i) = _mm_cvtsi128_si32(sums);
+    }
+#endif
+    MotionLumaScalar(bgra, i, count, luma);
+}
+
+static int CountChangedPixels(const unsigned char* a, const unsigned char* b, int count, unsigned char threshold) {
+    int changed = 0;
+    int i = 0;
+#if MOTION_USE_SSE2
+    const __m128i thr = _mm_set1_epi8((char)threshold);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i total = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i still = _mm_cmpeq_epi8(_mm_subs_epu8(diff, thr), zero);  // 0xFF where |diff| <= thr
+        total = _mm_add_epi64(total, _mm_sad_epu8(_mm_andnot_si128(still, one), zero));
+    }
+    changed = _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#endif
+    return changed + CountChangedPixelsScalar(a, b, i, count, threshold);
+}
+
+#endif
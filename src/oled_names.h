@@ -0,0 +1,95 @@
+// OLED Aegis - process name interning
+//
+// Process names seen in audio sessions are interned into small integer IDs
+// (open-addressed table keyed by the lower-cased exe name, truncated to
+// PROCESS_NAME_KEY_LEN - 1 chars, hashed with FNV-1a) so a media scan's
+// active sets are bitmaps and a window's process is checked with one hash
+// probe instead of a case-insensitive compare loop. Kept free of Win32 types
+// so tests/test_names.c can check it and tests/bench_names.c can time it
+// against that loop, with any C compiler.
+
+#ifndef OLED_NAMES_H
+#define OLED_NAMES_H
+
+#include <string.h>
+
+#define MAX_INTERNED_PROCESS_NAMES      128     // Process name intern table (power of two)
+#define PROCESS_NAME_KEY_LEN            64      // Interned names are truncated to this (with NUL)
+#define PROCESS_ID_WORDS                (MAX_INTERNED_PROCESS_NAMES / 32)
+
+typedef struct {
+    char name[PROCESS_NAME_KEY_LEN];    // Lower-cased; empty = free slot
+    int isBrowser;                      // Set by the caller on insertion
+} InternedProcessName;
+
+typedef struct {
+    InternedProcessName entries[MAX_INTERNED_PROCESS_NAMES];
+    int count;
+    unsigned int generation;            // Bumped when the table is cleared (invalidates cached IDs)
+    int compares;                       // strcmp calls since the caller last reset it
+    int overflowed;                     // An insert failed since the last clear
+} ProcessNameTable;
+
+// Lower-case and truncate name into key; returns its FNV-1a hash.
+static unsigned int MakeProcessNameKey(const char* name, char key[PROCESS_NAME_KEY_LEN]) {
+    unsigned int hash = 2166136261u;
+    int i = 0;
+    for (; name[i] && i < PROCESS_NAME_KEY_LEN - 1; i++) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        key[i] = c;
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+    key[i] = '\0';
+    return hash;
+}
+
+// Slot holding key, or the free slot where it would go (-1 if full).
+static int ProbeProcessName(ProcessNameTable* table, const char* key, unsigned int hash) {
+    for (int n = 0; n < MAX_INTERNED_PROCESS_NAMES; n++) {
+        int slot = (int)((hash + (unsigned int)n) & (MAX_INTERNED_PROCESS_NAMES - 1));
+        if (table->entries[slot].name[0] == '\0') return slot;
+        table->compares++;
+        if (strcmp(table->entries[slot].name, key) == 0) return slot;
+    }
+    return -1;
+}
+
+// ID of name, or -1 if it was never inserted.
+static int FindProcessName(ProcessNameTable* table, const char* name) {
+    char key[PROCESS_NAME_KEY_LEN];
+    int slot = ProbeProcessName(table, key, MakeProcessNameKey(name, key));
+    return (slot >= 0 && table->entries[slot].name[0] != '\0') ? slot : -1;
+}
+
+// ID of name, inserting it if needed (*inserted is set then). Returns -1
+// and sets overflowed when the table is full.
+static int InsertProcessName(ProcessNameTable* table, const char* name, int* inserted) {
+    char key[PROCESS_NAME_KEY_LEN];
+    int slot = ProbeProcessName(table, key, MakeProcessNameKey(name, key));
+    *inserted = 0;
+    if (slot < 0) {
+        table->overflowed = 1;
+        return -1;
+    }
+    if (table->entries[slot].name[0] == '\0') {
+        memcpy(table->entries[slot].name, key, sizeof(key));
+        table->entries[slot].isBrowser = 0;
+        table->count++;
+        *inserted = 1;
+    }
+    return slot;
+}
+
+// IDs stay valid across scans; call at the start of a scan, which clears the
+// table once it is half full or after an insert failed because it was full.
+static void ClearProcessNamesIfFull(ProcessNameTable* table) {
+    if (table->overflowed || table->count * 2 >= MAX_INTERNED_PROCESS_NAMES) {
+        memset(table->entries, 0, sizeof(table->entries));
+        table->count = 0;
+        table->generation++;
+        table->overflowed = 0;
+    }
+}
+
+#endif
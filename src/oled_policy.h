@@ -0,0 +1,160 @@
+// OLED Aegis - activation policy
+//
+// The decisions made on every idle timer tick, and what counts as input,
+// kept free of Win32 types and global state: all inputs are plain values
+// gathered by the platform code in oled_aegis.c, and devices are reached
+// through function pointers. This lets tests/test_policy.c exercise the
+// policy with any C compiler, without a desktop or hardware.
+
+#ifndef OLED_POLICY_H
+#define OLED_POLICY_H
+
+#define MANUAL_ACTIVATION_COOLDOWN_MS 2500
+#define IDLE_DEACTIVATE_THRESHOLD_MS    2000    // Time threshold to deactivate screen saver after input
+#define IDLE_DEACTIVATE_THRESHOLD_SEC   2       // Time threshold in seconds (for per-monitor mode)
+
+typedef enum {
+    MONITOR_ACTION_NONE,
+    MONITOR_ACTION_ACTIVATE,
+    MONITOR_ACTION_DEACTIVATE_MEDIA,
+    MONITOR_ACTION_DEACTIVATE_INPUT
+} MonitorAction;
+
+typedef enum {
+    GLOBAL_ACTION_NONE,
+    GLOBAL_ACTION_ACTIVATE,
+    GLOBAL_ACTION_DEACTIVATE,
+    GLOBAL_ACTION_DEACTIVATE_AFTER_COOLDOWN,
+    GLOBAL_ACTION_HOLD_COOLDOWN
+} GlobalAction;
+
+// Per-monitor input mode: one monitor with its own idle clock.
+static MonitorAction DecideMonitorAction(int screenSaverActive, int idleSeconds, int idleTimeout,
+                                         int hasMedia, int inManualCooldown) {
+    if (!hasMedia && idleSeconds >= idleTimeout) {
+        return screenSaverActive ? MONITOR_ACTION_NONE : MONITOR_ACTION_ACTIVATE;
+    }
+
+    if (!screenSaverActive || inManualCooldown) {
+        return MONITOR_ACTION_NONE;
+    }
+
+    if (hasMedia) {
+        return MONITOR_ACTION_DEACTIVATE_MEDIA;
+    }
+
+    if (idleSeconds < IDLE_DEACTIVATE_THRESHOLD_SEC) {
+        return MONITOR_ACTION_DEACTIVATE_INPUT;
+    }
+
+    return MONITOR_ACTION_NONE;
+}
+
+// Global input mode with per-monitor media: one monitor once the global idle
+// time is past the timeout. Input never deactivates here; that goes through
+// DecideGlobalAction for all monitors at once.
+static MonitorAction DecideIdleMonitorAction(int screenSaverActive, int hasMedia) {
+    if (hasMedia) {
+        return screenSaverActive ? MONITOR_ACTION_DEACTIVATE_MEDIA : MONITOR_ACTION_NONE;
+    }
+    return screenSaverActive ? MONITOR_ACTION_NONE : MONITOR_ACTION_ACTIVATE;
+}
+
+// Global input mode: all monitors at once, driven by the global idle time.
+// A manual activation holds off deactivation for the cooldown, and after it
+// only fresh input (not a stale idle time) deactivates.
+static GlobalAction DecideGlobalAction(int screenSaverActive, unsigned long idleMs, unsigned long idleTimeoutMs,
+                                       int mediaPlaying, int isManualActivation, unsigned long msSinceManual) {
+    if (!mediaPlaying && idleMs > idleTimeoutMs) {
+        return screenSaverActive ? GLOBAL_ACTION_NONE : GLOBAL_ACTION_ACTIVATE;
+    }
+
+    if (!screenSaverActive) {
+        return GLOBAL_ACTION_NONE;
+    }
+
+    if (!isManualActivation) {
+        return GLOBAL_ACTION_DEACTIVATE;
+    }
+
+    if (msSinceManual < MANUAL_ACTIVATION_COOLDOWN_MS) {
+        return GLOBAL_ACTION_HOLD_COOLDOWN;
+    }
+
+    if (idleMs < IDLE_DEACTIVATE_THRESHOLD_MS) {
+        return GLOBAL_ACTION_DEACTIVATE_AFTER_COOLDOWN;
+    }
+
+    return GLOBAL_ACTION_NONE;
+}
+
+// ---------------------------------------------------------------------------
+// Game controller activity
+//
+// A slot's packet number changes whenever its controller's state does. Only a
+// change between two consecutive polls counts as activity: when polling
+// resumes after a gap (polls are skipped while no deadline is near, or the
+// timer was delayed), every slot is re-read as the new baseline first, so
+// stick drift, a controller plugged in meanwhile or one used minutes ago
+// doesn't count as fresh input.
+// ---------------------------------------------------------------------------
+
+#define CONTROLLER_MAX_SLOTS            4       // XUSER_MAX_COUNT
+#define CONTROLLER_RESCAN_MS            5000    // Re-probe empty slots at most this often (slow on XInput)
+
+// Reads a slot's packet number. Returns 0 if nothing is connected to slot.
+// XInputGetState in the app, scripted in the tests.
+typedef int (*ControllerReadPacketFn)(unsigned int slot, unsigned int* packetNumber);
+
+typedef struct {
+    int connected;
+    unsigned int packetNumber;
+    unsigned int lastProbeTick;         // When an empty slot was last probed
+} ControllerSlot;
+
+typedef struct {
+    ControllerSlot slots[CONTROLLER_MAX_SLOTS];
+    int baselineValid;                  // The previous tick polled: changes count
+    unsigned int lastPollTick;
+} ControllerTracker;
+
+// The next poll only re-reads the baseline. Call on every tick that skips polling.
+static void InvalidateControllerBaseline(ControllerTracker* tracker) {
+    tracker->baselineValid = 0;
+}
+
+// Poll all slots. Returns 1 on activity: a changed packet number, or a
+// controller connected since the previous poll. A poll more than maxGapMs
+// after the previous one is treated as a resumption and only re-baselines.
+static int PollControllerTracker(ControllerTracker* tracker, ControllerReadPacketFn readPacket,
+                                 unsigned int nowTick, unsigned int maxGapMs) {
+    int rebaseline = !tracker->baselineValid || (unsigned int)(nowTick - tracker->lastPollTick) > maxGapMs;
+    int activity = 0;
+
+    for (unsigned int slot = 0; slot < CONTROLLER_MAX_SLOTS; slot++) {
+        ControllerSlot* slotState = &tracker->slots[slot];
+        if (!rebaseline && !slotState->connected && slotState->lastProbeTick != 0 &&
+            (unsigned int)(nowTick - slotState->lastProbeTick) < CONTROLLER_RESCAN_MS) {
+            continue;
+        }
+
+        unsigned int packetNumber;
+        if (!readPacket(slot, &packetNumber)) {
+            slotState->connected = 0;
+            slotState->lastProbeTick = nowTick ? nowTick : 1;
+            continue;
+        }
+
+        if (!rebaseline && (!slotState->connected || packetNumber != slotState->packetNumber)) {
+            activity = 1;
+        }
+        slotState->connected = 1;
+        slotState->packetNumber = packetNumber;
+    }
+
+    tracker->baselineValid = 1;
+    tracker->lastPollTick = nowTick;
+    return activity;
+}
+
+#endif
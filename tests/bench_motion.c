@@ -0,0 +1,87 @@
+// Times the motion detection kernels in src/oled_motion.h on synthetic
+// 128x72 frames (MOTION_FRAME_WIDTH x MOTION_FRAME_HEIGHT in oled_aegis.c):
+// the SSE2 path against the scalar reference, per call. Exits non-zero if
+// the two disagree. Plain C:
+//   cc -O2 -I src tests/bench_motion.c -o build/bench_motion
+
+#include <stdio.h>
+#include <time.h>
+#include "oled_motion.h"
+
+#define FRAME_WIDTH     128
+#define FRAME_HEIGHT    72
+#define FRAME_PIXELS    (FRAME_WIDTH * FRAME_HEIGHT)
+#define PIXEL_THRESHOLD 12                      // MOTION_PIXEL_THRESHOLD
+#define BENCH_ITERATIONS 20000
+
+static unsigned char g_bgra[2][FRAME_PIXELS * 4];
+static unsigned char g_luma[2][FRAME_PIXELS];
+
+// A horizontal gradient with a bright box that moves between the two
+// frames, like a small video in a window.
+static void DrawFrame(unsigned char* bgra, int boxX) {
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            unsigned char* p = bgra + ((size_t)y * FRAME_WIDTH + x) * 4;
+            int inBox = x >= boxX && x < boxX + 32 && y >= 20 && y < 52;
+            p[0] = (unsigned char)(inBox ? 240 : x * 2);
+            p[1] = (unsigned char)(inBox ? 220 : y * 3);
+            p[2] = (unsigned char)(inBox ? 200 : (x + y) & 0xFF);
+            p[3] = 255;
+        }
+    }
+}
+
+static double ElapsedUs(clock_t start) {
+    return (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / BENCH_ITERATIONS;
+}
+
+int main(void) {
+    DrawFrame(g_bgra[0], 16);
+    DrawFrame(g_bgra[1], 24);
+
+    unsigned int checksum = 0;
+
+    clock_t start = clock();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        MotionLumaFromBgra(g_bgra[n & 1], FRAME_PIXELS, g_luma[n & 1]);
+        checksum += g_luma[n & 1][n % FRAME_PIXELS];
+    }
+    double lumaUs = ElapsedUs(start);
+
+    start = clock();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        MotionLumaScalar(g_bgra[n & 1], 0, FRAME_PIXELS, g_luma[n & 1]);
+        checksum += g_luma[n & 1][n % FRAME_PIXELS];
+    }
+    double lumaScalarUs = ElapsedUs(start);
+
+    int changed = 0;
+    start = clock();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        changed = CountChangedPixels(g_luma[n & 1], g_luma[(n + 1) & 1], FRAME_PIXELS, PIXEL_THRESHOLD);
+        checksum += (unsigned int)changed;
+    }
+    double diffUs = ElapsedUs(start);
+
+    int changedScalar = 0;
+    start = clock();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        changedScalar = CountChangedPixelsScalar(g_luma[n & 1], g_luma[(n + 1) & 1], 0, FRAME_PIXELS,
+                                                 PIXEL_THRESHOLD);
+        checksum += (unsigned int)changedScalar;
+    }
+    double diffScalarUs = ElapsedUs(start);
+
+    printf("Motion kernels, %dx%d frame, %d iterations (%s path, checksum %u)\n",
+           FRAME_WIDTH, FRAME_HEIGHT, BENCH_ITERATIONS, MOTION_USE_SSE2 ? "SSE2" : "scalar", checksum);
+    printf("  luma:       %7.2f us, scalar %7.2f us\n", lumaUs, lumaScalarUs);
+    printf("  diff/count: %7.2f us, scalar %7.2f us (%d of %d pixels changed)\n",
+           diffUs, diffScalarUs, changed, FRAME_PIXELS);
+
+    if (changed != changedScalar) {
+        printf("FAIL: changed pixels %d, scalar %d\n", changed, changedScalar);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Replays the per-scan process name work of a media scan with the interned
+// table in src/oled_names.h, against the name lists it replaced: active
+// session names kept as strings, deduplicated with a case-insensitive
+// compare, and every window's process compared against each of them.
+// Workload: 6 render sessions (2 of them browsers), 1 capture session and
+// 60 top-level windows. Exits non-zero if the two disagree. Plain C:
+//   cc -O2 -I src tests/bench_names.c -o build/bench_names
+
+#include <stdio.h>
+#include <time.h>
+#include "oled_names.h"
+
+#define BENCH_SCANS         200000
+#define MAX_LIST_NAMES      64                  // MAX_ACTIVE_AUDIO_PIDS
+#define MAX_LIST_NAME_LEN   260                 // MAX_PATH
+
+static const char* const g_renderSessions[] = {
+    "chrome.exe", "firefox.exe", "Spotify.exe", "Discord.exe", "vlc.exe", "ms-teams.exe",
+};
+static const char* const g_captureSessions[] = { "ms-teams.exe" };
+
+static const char* const g_windowProcesses[] = {
+    "explorer.exe", "Code.exe", "chrome.exe", "firefox.exe", "slack.exe", "OUTLOOK.EXE",
+    "WindowsTerminal.exe", "Spotify.exe", "ms-teams.exe", "TextInputHost.exe", "ApplicationFrameHost.exe",
+    "SystemSettings.exe", "Discord.exe", "steamwebhelper.exe", "vlc.exe", "devenv.exe", "notepad.exe",
+    "Taskmgr.exe", "obs64.exe", "mspaint.exe",
+};
+#define WINDOW_COUNT 60
+
+static const char* const g_browsers[] = {
+    "chrome.exe", "msedge.exe", "firefox.exe", "brave.exe", "opera.exe",
+    "opera_gx.exe", "vivaldi.exe", "arc.exe", "thorium.exe", "zen.exe",
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+static long g_listCompares = 0;
+
+// _stricmp, counted
+static int CompareNoCase(const char* a, const char* b) {
+    g_listCompares++;
+    for (;; a++, b++) {
+        char ca = (*a >= 'A' && *a <= 'Z') ? (char)(*a - 'A' + 'a') : *a;
+        char cb = (*b >= 'A' && *b <= 'Z') ? (char)(*b - 'A' + 'a') : *b;
+        if (ca != cb) return ca - cb;
+        if (ca == '\0') return 0;
+    }
+}
+
+static int IsBrowserName(const char* name) {
+    for (int i = 0; i < (int)COUNT_OF(g_browsers); i++) {
+        if (CompareNoCase(name, g_browsers[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// ---- Name lists ----------------------------------------------------------
+
+typedef struct {
+    char audio[MAX_LIST_NAMES][MAX_LIST_NAME_LEN];
+    int audioCount;
+    char capture[8][MAX_LIST_NAME_LEN];
+    int captureCount;
+} NameLists;
+
+static void AddListName(char names[][MAX_LIST_NAME_LEN], int* count, int max, const char* name) {
+    for (int i = 0; i < *count; i++) {
+        if (CompareNoCase(names[i], name) == 0) return;
+    }
+    if (*count < max) {
+        snprintf(names[*count], MAX_LIST_NAME_LEN, "%s", name);
+        (*count)++;
+    }
+}
+
+static int ListContains(char names[][MAX_LIST_NAME_LEN], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (CompareNoCase(names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static NameLists g_lists;
+
+// Returns the number of audible windows, plus 1000 if all audio is browsers.
+static int ScanWithLists(void) {
+    memset(&g_lists, 0, sizeof(g_lists));
+    for (int i = 0; i < (int)COUNT_OF(g_renderSessions); i++) {
+        AddListName(g_lists.audio, &g_lists.audioCount, MAX_LIST_NAMES, g_renderSessions[i]);
+    }
+    for (int i = 0; i < (int)COUNT_OF(g_captureSessions); i++) {
+        AddListName(g_lists.capture, &g_lists.captureCount, 8, g_captureSessions[i]);
+    }
+
+    int audible = 0;
+    for (int w = 0; w < WINDOW_COUNT; w++) {
+        const char* name = g_windowProcesses[w % COUNT_OF(g_windowProcesses)];
+        int capture = ListContains(g_lists.capture, g_lists.captureCount, name);
+        int audio = ListContains(g_lists.audio, g_lists.audioCount, name);
+        audible += capture || audio;
+    }
+
+    int allBrowsers = 1;
+    for (int i = 0; i < g_lists.audioCount; i++) {
+        if (!IsBrowserName(g_lists.audio[i])) {
+            allBrowsers = 0;
+            break;
+        }
+    }
+    return audible + allBrowsers * 1000;
+}
+
+// ---- Interned table --------------------------------------------------------
+
+typedef struct {
+    unsigned int audioIds[PROCESS_ID_WORDS];
+    unsigned int captureIds[PROCESS_ID_WORDS];
+    int audioCount;
+    int captureCount;
+} IdSets;
+
+typedef struct {
+    const char* name;
+    int nameId;
+    unsigned int generation;
+} Session;                              // CachedAudioSession's name cache
+
+static ProcessNameTable g_table;
+static Session g_render[COUNT_OF(g_renderSessions)];
+static Session g_capture[COUNT_OF(g_captureSessions)];
+static IdSets g_ids;
+
+static int SessionNameId(Session* session) {
+    if (session->nameId < 0 || session->generation != g_table.generation) {
+        int inserted;
+        session->nameId = InsertProcessName(&g_table, session->name, &inserted);
+        if (inserted) g_table.entries[session->nameId].isBrowser = IsBrowserName(session->name);
+        session->generation = g_table.generation;
+    }
+    return session->nameId;
+}
+
+static int TestId(const unsigned int* bitmap, int id) {
+    return id >= 0 && (bitmap[id >> 5] & (1u << (id & 31))) != 0;
+}
+
+static void AddId(unsigned int* bitmap, int* count, int id) {
+    if (id >= 0 && !TestId(bitmap, id)) {
+        bitmap[id >> 5] |= 1u << (id & 31);
+        (*count)++;
+    }
+}
+
+static int ScanWithTable(void) {
+    memset(&g_ids, 0, sizeof(g_ids));
+    ClearProcessNamesIfFull(&g_table);
+    for (int i = 0; i < (int)COUNT_OF(g_render); i++) {
+        AddId(g_ids.audioIds, &g_ids.audioCount, SessionNameId(&g_render[i]));
+    }
+    for (int i = 0; i < (int)COUNT_OF(g_capture); i++) {
+        AddId(g_ids.captureIds, &g_ids.captureCount, SessionNameId(&g_capture[i]));
+    }
+
+    int audible = 0;
+    for (int w = 0; w < WINDOW_COUNT; w++) {
+        int id = FindProcessName(&g_table, g_windowProcesses[w % COUNT_OF(g_windowProcesses)]);
+        if (id < 0) continue;
+        audible += TestId(g_ids.captureIds, id) || TestId(g_ids.audioIds, id);
+    }
+
+    int allBrowsers = 1;
+    for (int id = 0; id < MAX_INTERNED_PROCESS_NAMES; id++) {
+        if (TestId(g_ids.audioIds, id) && !g_table.entries[id].isBrowser) {
+            allBrowsers = 0;
+            break;
+        }
+    }
+    return audible + allBrowsers * 1000;
+}
+
+static double ElapsedUs(clock_t start) {
+    return (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / BENCH_SCANS;
+}
+
+int main(void) {
+    for (int i = 0; i < (int)COUNT_OF(g_render); i++) {
+        g_render[i].name = g_renderSessions[i];
+        g_render[i].nameId = -1;
+    }
+    for (int i = 0; i < (int)COUNT_OF(g_capture); i++) {
+        g_capture[i].name = g_captureSessions[i];
+        g_capture[i].nameId = -1;
+    }
+
+    int listResult = ScanWithLists();
+    long listComparesPerScan = g_listCompares;
+    g_listCompares = 0;
+    int tableResult = ScanWithTable();
+    long firstScanListCompares = g_listCompares;   // Browser checks on insertion
+    g_listCompares = 0;
+    g_table.compares = 0;
+    ScanWithTable();
+    long tableComparesPerScan = g_table.compares + g_listCompares;
+
+    long checksum = 0;
+    clock_t start = clock();
+    for (int n = 0; n < BENCH_SCANS; n++) {
+        checksum += ScanWithLists();
+    }
+    double listUs = ElapsedUs(start);
+
+    start = clock();
+    for (int n = 0; n < BENCH_SCANS; n++) {
+        checksum += ScanWithTable();
+    }
+    double tableUs = ElapsedUs(start);
+
+    printf("Process name work per scan: %d render sessions, %d capture, %d windows (checksum %ld)\n",
+           (int)COUNT_OF(g_renderSessions), (int)COUNT_OF(g_captureSessions), WINDOW_COUNT, checksum);
+    printf("  state zeroed:  %6d bytes, interned %6d bytes\n", (int)sizeof(NameLists), (int)sizeof(IdSets));
+    printf("  name compares: %6ld, interned %6ld (%ld more on the first scan)\n",
+           listComparesPerScan, tableComparesPerScan, firstScanListCompares);
+    printf("  time:          %6.2f us, interned %6.2f us\n", listUs, tableUs);
+
+    if (listResult != tableResult) {
+        printf("FAIL: name lists give %d, interned table %d\n", listResult, tableResult);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,385 @@
+// Times the media window scan strategies of oled_aegis.c on a real desktop,
+// for several window counts. Needs a desktop session, so it is not part of
+// `build.bat test`:
+//   build.bat bench [window count ...]              (default: 100 500 2000)
+//
+// The benchmark adds that many owned popup windows (visible, off-screen, not
+// on the taskbar) to the desktop, plus a few "media" windows on a second
+// thread standing in for a player. Each window visited gets the calls of
+// InterrogateWindowState. Strategies:
+//   full      EnumWindows over every top-level window (the default scan)
+//   targeted  EnumThreadWindows over the media threads only, as done when at
+//             most PID_TARGETED_MAX_PROCESSES processes play (one thread
+//             here; a real player has a few UI threads)
+//   snapshot  the Toolhelp thread snapshot that finds those threads, taken
+//             only when the set of media processes changes or every 10 s
+//   seq/pool  the parallelWindowScan path: EnumWindows collects the handles,
+//             then the windows are interrogated by the calling thread alone
+//             (seq) or claimed one at a time by it and the thread pool workers
+//             (pool, CPUs - 1 workers up to 7, at least 32 windows each)
+
+#include <windows.h>
+#include <dwmapi.h>
+#include <tlhelp32.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#pragma comment(lib, "user32.lib")
+#pragma comment(lib, "dwmapi.lib")
+
+#define BENCH_ROUNDS        20
+#define MEDIA_WINDOWS       3
+#define MAX_BENCH_WINDOWS   9000        // Below the default 10000 USER handles per process
+#define MAX_COLLECTED_WINDOWS 16384     // Room for the desktop's own windows too
+#define MAX_SCAN_WORKERS    7           // MAX_PARALLEL_SCAN_WORKERS
+#define MIN_WINDOWS_PER_WORKER 32       // PARALLEL_SCAN_MIN_WINDOWS
+
+static HWND g_owner = NULL;
+static HWND g_fillers[MAX_BENCH_WINDOWS];
+static int g_fillerCount = 0;
+static DWORD g_mediaThreadId = 0;
+static HANDLE g_mediaReady = NULL;
+static HANDLE g_mediaStop = NULL;
+static LARGE_INTEGER g_frequency;
+
+typedef struct {
+    DWORD mediaThreadId;
+    int windowsVisited;
+    int usable;
+    int mediaFound;
+} ScanCounts;
+
+// ParallelWindowScan, reduced to what the benchmark counts
+typedef struct {
+    HWND windows[MAX_COLLECTED_WINDOWS];
+    int windowCount;
+    DWORD mediaThreadId;
+    volatile LONG next;                 // Next unclaimed window
+    volatile LONG remaining;            // Windows not yet interrogated
+    volatile LONG usable;
+    volatile LONG mediaFound;
+} CollectedScan;
+
+static CollectedScan g_collected;
+static PTP_WORK g_scanWork = NULL;
+static HANDLE g_scanDone = NULL;
+static int g_scanWorkers = 0;
+
+static double NowUs(void) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000000.0 / (double)g_frequency.QuadPart;
+}
+
+// Keep the benchmark's own windows responsive, so IsHungAppWindow stays false
+static void PumpMessages(void) {
+    MSG msg;
+    while (PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE)) {
+        DispatchMessageA(&msg);
+    }
+}
+
+static HWND CreateOwnerWindow(void) {
+    return CreateWindowExA(0, "OLEDAegisBenchWindow", "bench owner", WS_POPUP, 0, 0, 0, 0,
+                           NULL, NULL, GetModuleHandle(NULL), NULL);
+}
+
+static HWND CreateBenchWindow(HWND owner, int index) {
+    // Owned popups never get a taskbar button; far off-screen so nothing shows
+    HWND hWnd = CreateWindowExA(WS_EX_NOACTIVATE, "OLEDAegisBenchWindow", "bench", WS_POPUP,
+                                -32000 + (index % 64) * 16, -32000, 320, 180,
+                                owner, NULL, GetModuleHandle(NULL), NULL);
+    if (hWnd) ShowWindow(hWnd, SW_SHOWNOACTIVATE);
+    return hWnd;
+}
+
+static DWORD WINAPI MediaThreadProc(LPVOID param) {
+    (void)param;
+    // Its own owner: an owner on another thread would join the two input queues
+    HWND owner = CreateOwnerWindow();
+    HWND windows[MEDIA_WINDOWS];
+    for (int i = 0; i < MEDIA_WINDOWS; i++) {
+        windows[i] = CreateBenchWindow(owner, i);
+    }
+    SetEvent(g_mediaReady);
+
+    while (MsgWaitForMultipleObjects(1, &g_mediaStop, FALSE, INFINITE, QS_ALLINPUT) != WAIT_OBJECT_0) {
+        PumpMessages();
+    }
+    for (int i = 0; i < MEDIA_WINDOWS; i++) {
+        if (windows[i]) DestroyWindow(windows[i]);
+    }
+    if (owner) DestroyWindow(owner);
+    return 0;
+}
+
+// The calls InterrogateWindowState makes. Returns 1 if the window could show media.
+static int InterrogateWindow(HWND hWnd, RECT* rect, DWORD* threadId) {
+    DWORD cloaked = 0;
+    if (!IsWindowVisible(hWnd) || IsIconic(hWnd) ||
+        (SUCCEEDED(DwmGetWindowAttribute(hWnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked)) {
+        return 0;
+    }
+    if (IsHungAppWindow(hWnd)) return 0;
+    if ((GetWindowLongPtrA(hWnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) != 0) return 0;
+
+    if (FAILED(DwmGetWindowAttribute(hWnd, DWMWA_EXTENDED_FRAME_BOUNDS, rect, sizeof(*rect))) &&
+        !GetWindowRect(hWnd, rect)) {
+        return 0;
+    }
+    if (rect->right <= rect->left || rect->bottom <= rect->top) return 0;
+
+    DWORD pid = 0;
+    *threadId = GetWindowThreadProcessId(hWnd, &pid);
+    return 1;
+}
+
+static BOOL CALLBACK ScanWindowCallback(HWND hWnd, LPARAM lParam) {
+    ScanCounts* counts = (ScanCounts*)lParam;
+    RECT rect;
+    DWORD threadId = 0;
+    counts->windowsVisited++;
+    if (InterrogateWindow(hWnd, &rect, &threadId)) {
+        counts->usable++;
+        if (threadId == counts->mediaThreadId) counts->mediaFound++;
+    }
+    return TRUE;
+}
+
+static void ScanFull(ScanCounts* counts) {
+    EnumWindows(ScanWindowCallback, (LPARAM)counts);
+}
+
+static void ScanTargeted(ScanCounts* counts) {
+    EnumThreadWindows(counts->mediaThreadId, ScanWindowCallback, (LPARAM)counts);
+}
+
+static BOOL CALLBACK CollectWindowCallback(HWND hWnd, LPARAM lParam) {
+    CollectedScan* scan = (CollectedScan*)lParam;
+    if (scan->windowCount >= MAX_COLLECTED_WINDOWS) return FALSE;
+    scan->windows[scan->windowCount++] = hWnd;
+    return TRUE;
+}
+
+static void CollectWindows(CollectedScan* scan, DWORD mediaThreadId) {
+    // A worker queued by the previous round may start late: keep it from
+    // claiming slots while they are being refilled, as ScanWindowsInParallel does
+    InterlockedExchange(&scan->next, MAX_COLLECTED_WINDOWS);
+    scan->windowCount = 0;
+    scan->mediaThreadId = mediaThreadId;
+    scan->usable = 0;
+    scan->mediaFound = 0;
+    EnumWindows(CollectWindowCallback, (LPARAM)scan);
+}
+
+static void ReportCollected(const CollectedScan* scan, ScanCounts* counts) {
+    counts->windowsVisited = scan->windowCount;
+    counts->usable = scan->usable;
+    counts->mediaFound = scan->mediaFound;
+}
+
+static void InterrogateCollected(CollectedScan* scan, int i) {
+    RECT rect;
+    DWORD threadId = 0;
+    if (InterrogateWindow(scan->windows[i], &rect, &threadId)) {
+        InterlockedIncrement(&scan->usable);
+        if (threadId == scan->mediaThreadId) InterlockedIncrement(&scan->mediaFound);
+    }
+}
+
+// InterrogateClaimedWindows
+static void InterrogateClaimed(CollectedScan* scan) {
+    for (;;) {
+        LONG i = InterlockedIncrement(&scan->next) - 1;
+        if (i >= scan->windowCount) break;
+        InterrogateCollected(scan, i);
+        if (InterlockedDecrement(&scan->remaining) == 0) {
+            SetEvent(g_scanDone);
+        }
+    }
+}
+
+static VOID CALLBACK ScanWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) {
+    (void)instance;
+    (void)context;
+    (void)work;
+    InterrogateClaimed(&g_collected);
+}
+
+static void ScanCollectedSequential(ScanCounts* counts) {
+    CollectedScan* scan = &g_collected;
+    CollectWindows(scan, counts->mediaThreadId);
+    for (int i = 0; i < scan->windowCount; i++) {
+        InterrogateCollected(scan, i);
+    }
+    ReportCollected(scan, counts);
+}
+
+static void ScanCollectedInPool(ScanCounts* counts) {
+    CollectedScan* scan = &g_collected;
+    CollectWindows(scan, counts->mediaThreadId);
+    scan->remaining = scan->windowCount;
+    ResetEvent(g_scanDone);
+    InterlockedExchange(&scan->next, 0);
+
+    int workers = g_scanWorkers;
+    if (workers > scan->windowCount / MIN_WINDOWS_PER_WORKER) {
+        workers = scan->windowCount / MIN_WINDOWS_PER_WORKER;
+    }
+    for (int i = 0; i < workers; i++) {
+        SubmitThreadpoolWork(g_scanWork);
+    }
+    InterrogateClaimed(scan);
+    if (scan->windowCount > 0) WaitForSingleObject(g_scanDone, INFINITE);
+    ReportCollected(scan, counts);
+}
+
+// The thread snapshot the targeted scan needs once per change of the media
+// process set. Returns the number of threads of this process.
+static int SnapshotTargetThreads(void) {
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) return -1;
+
+    DWORD pid = GetCurrentProcessId();
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    int threadCount = 0;
+    for (BOOL ok = Thread32First(hSnapshot, &entry); ok; ok = Thread32Next(hSnapshot, &entry)) {
+        if (entry.th32OwnerProcessID == pid) threadCount++;
+    }
+    CloseHandle(hSnapshot);
+    return threadCount;
+}
+
+// Average of BENCH_ROUNDS runs, in microseconds
+static double TimeScan(void (*scan)(ScanCounts*), ScanCounts* lastCounts) {
+    double totalUs = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        PumpMessages();
+        ScanCounts counts = {0};
+        counts.mediaThreadId = g_mediaThreadId;
+        double startUs = NowUs();
+        scan(&counts);
+        totalUs += NowUs() - startUs;
+        *lastCounts = counts;
+    }
+    return totalUs / BENCH_ROUNDS;
+}
+
+static double TimeSnapshot(int* threadCount) {
+    double totalUs = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double startUs = NowUs();
+        *threadCount = SnapshotTargetThreads();
+        totalUs += NowUs() - startUs;
+    }
+    return totalUs / BENCH_ROUNDS;
+}
+
+static int GrowFillers(int count) {
+    while (g_fillerCount < count) {
+        HWND hWnd = CreateBenchWindow(g_owner, g_fillerCount);
+        if (!hWnd) {
+            printf("CreateWindowEx failed at %d windows (error %lu)\n", g_fillerCount, GetLastError());
+            return 0;
+        }
+        g_fillers[g_fillerCount++] = hWnd;
+        if ((g_fillerCount & 255) == 0) PumpMessages();
+    }
+    return 1;
+}
+
+static int CompareInts(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int main(int argc, char** argv) {
+    int counts[16] = { 100, 500, 2000 };
+    int countCount = 3;
+    if (argc > 1) {
+        countCount = 0;
+        for (int i = 1; i < argc && countCount < 16; i++) {
+            int count = atoi(argv[i]);
+            if (count > 0 && count <= MAX_BENCH_WINDOWS) counts[countCount++] = count;
+        }
+    }
+    qsort(counts, countCount, sizeof(counts[0]), CompareInts);
+
+    QueryPerformanceFrequency(&g_frequency);
+
+    WNDCLASSA wc = {0};
+    wc.lpfnWndProc = DefWindowProcA;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = "OLEDAegisBenchWindow";
+    if (!RegisterClassA(&wc)) {
+        printf("RegisterClass failed (error %lu)\n", GetLastError());
+        return 1;
+    }
+    g_owner = CreateOwnerWindow();
+
+    g_mediaReady = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_mediaStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+    HANDLE mediaThread = CreateThread(NULL, 0, MediaThreadProc, NULL, 0, &g_mediaThreadId);
+    if (!g_owner || !mediaThread || WaitForSingleObject(g_mediaReady, 5000) != WAIT_OBJECT_0) {
+        printf("Could not set up the benchmark windows\n");
+        return 1;
+    }
+
+    // The calling thread is one of the workers, as the timer thread is
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    g_scanWorkers = (int)info.dwNumberOfProcessors - 1;
+    if (g_scanWorkers > MAX_SCAN_WORKERS) g_scanWorkers = MAX_SCAN_WORKERS;
+    if (g_scanWorkers < 0) g_scanWorkers = 0;
+    g_scanDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_scanWork = CreateThreadpoolWork(ScanWorkCallback, NULL, NULL);
+    if (!g_scanDone || !g_scanWork) {
+        printf("Could not set up the thread pool scan\n");
+        return 1;
+    }
+
+    printf("Media window scan, %d rounds each (us per scan), %d pool workers\n", BENCH_ROUNDS, g_scanWorkers);
+    printf("%8s %8s | %10s %10s %10s | %10s %10s %8s | %8s\n",
+           "added", "visited", "full", "targeted", "snapshot", "seq", "pool", "speedup", "threads");
+
+    int result = 0;
+    for (int i = 0; i < countCount && result == 0; i++) {
+        if (!GrowFillers(counts[i])) {
+            result = 1;
+            break;
+        }
+
+        ScanCounts full;
+        ScanCounts targeted;
+        ScanCounts sequential;
+        ScanCounts pooled;
+        int threadCount = 0;
+        double fullUs = TimeScan(ScanFull, &full);
+        double targetedUs = TimeScan(ScanTargeted, &targeted);
+        double snapshotUs = TimeSnapshot(&threadCount);
+        double sequentialUs = TimeScan(ScanCollectedSequential, &sequential);
+        double pooledUs = TimeScan(ScanCollectedInPool, &pooled);
+        printf("%8d %8d | %10.1f %10.1f %10.1f | %10.1f %10.1f %7.2fx | %8d\n",
+               counts[i], full.windowsVisited, fullUs, targetedUs, snapshotUs,
+               sequentialUs, pooledUs, sequentialUs / pooledUs, threadCount);
+
+        // Every strategy must find the same media windows
+        if (full.mediaFound != MEDIA_WINDOWS || targeted.mediaFound != MEDIA_WINDOWS ||
+            sequential.mediaFound != MEDIA_WINDOWS || pooled.mediaFound != MEDIA_WINDOWS) {
+            printf("FAIL: media windows found: full %d, targeted %d, seq %d, pool %d, expected %d\n",
+                   full.mediaFound, targeted.mediaFound, sequential.mediaFound, pooled.mediaFound,
+                   MEDIA_WINDOWS);
+            result = 1;
+        }
+    }
+
+    WaitForThreadpoolWorkCallbacks(g_scanWork, TRUE);
+    CloseThreadpoolWork(g_scanWork);
+    SetEvent(g_mediaStop);
+    WaitForSingleObject(mediaThread, 5000);
+    for (int i = 0; i < g_fillerCount; i++) {
+        DestroyWindow(g_fillers[i]);
+    }
+    DestroyWindow(g_owner);
+    return result;
+}
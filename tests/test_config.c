@@ -0,0 +1,70 @@
+// Tests for the config line parsing in src/oled_ini.h, including the
+// browserTabAudioLabel example from the README. Plain C, like
+// tests/test_policy.c:
+//   cc -I src tests/test_config.c -o build/test_config
+
+#include <stdio.h>
+#include <string.h>
+#include "oled_ini.h"
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+    const char* line;
+    int expectedOk;
+    const char* expectedKey;
+    const char* expectedValue;
+} IniLineCase;
+
+static const IniLineCase g_lineCases[] = {
+    { "idleTimeout=300\n",                          1, "idleTimeout", "300" },
+    { "idleTimeout=300\r\n",                        1, "idleTimeout", "300" },
+    { "  idleTimeout = 300  ; five minutes\n",      1, "idleTimeout", "300" },
+    { "hotkeyAllMonitors=Ctrl+Alt+B\n",             1, "hotkeyAllMonitors", "Ctrl+Alt+B" },
+    { "monitorEnabled_\\\\?\\DISPLAY#DEL40F5#5&1a2b3c&0&UID4352#{e6f07b5f-ee97-4a90-b076-33f57bf4eaa7}=1\n",
+      1, "monitorEnabled_\\\\?\\DISPLAY#DEL40F5#5&1a2b3c&0&UID4352#{e6f07b5f-ee97-4a90-b076-33f57bf4eaa7}", "1" },
+    // The README example: a multi-word label is kept whole
+    { "browserTabAudioLabel=Reproduciendo audio\n", 1, "browserTabAudioLabel", "Reproduciendo audio" },
+    { "browserTabAudioLabel=Lecture audio ; en cours\r\n", 1, "browserTabAudioLabel", "Lecture audio ; en cours" },
+    { "browserTabAudioLabel=\n",                    1, "browserTabAudioLabel", "" },
+    // Lines that set nothing
+    { "\n",                                         0, NULL, NULL },
+    { "; idleTimeout=300\n",                        0, NULL, NULL },
+    { "idleTimeout\n",                              0, NULL, NULL },
+    { "=300\n",                                     0, NULL, NULL },
+    { "idleTimeout=\n",                             0, NULL, NULL },
+    { "idleTimeout=; none\n",                       0, NULL, NULL },
+};
+
+static int g_failures = 0;
+
+static void TestLineCases(void) {
+    for (int i = 0; i < (int)COUNT_OF(g_lineCases); i++) {
+        const IniLineCase* c = &g_lineCases[i];
+        char line[512];
+        snprintf(line, sizeof(line), "%s", c->line);
+
+        char* key = NULL;
+        char* value = NULL;
+        int ok = SplitIniLine(line, &key, &value);
+        if (ok != c->expectedOk) {
+            printf("FAIL line[%d]: got %d, expected %d\n", i, ok, c->expectedOk);
+            g_failures++;
+        } else if (ok && (strcmp(key, c->expectedKey) != 0 || strcmp(value, c->expectedValue) != 0)) {
+            printf("FAIL line[%d]: got '%s'='%s', expected '%s'='%s'\n",
+                   i, key, value, c->expectedKey, c->expectedValue);
+            g_failures++;
+        }
+    }
+}
+
+int main(void) {
+    TestLineCases();
+
+    if (g_failures) {
+        printf("%d config test(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All config tests passed\n");
+    return 0;
+}
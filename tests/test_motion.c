@@ -0,0 +1,97 @@
+// Checks the motion detection kernels in src/oled_motion.h: the SSE2 path
+// must match the scalar reference for every length (vector bodies and
+// tails) and every threshold. Plain C, like tests/test_policy.c:
+//   cc -O2 -I src tests/test_motion.c -o build/test_motion
+
+#include <stdio.h>
+#include "oled_motion.h"
+
+#define MAX_TEST_PIXELS (128 * 72 + 19)        // A motion frame plus an odd tail
+
+static unsigned char g_bgra[MAX_TEST_PIXELS * 4];
+static unsigned char g_frameA[MAX_TEST_PIXELS];
+static unsigned char g_frameB[MAX_TEST_PIXELS];
+static unsigned char g_luma[MAX_TEST_PIXELS];
+static unsigned char g_lumaReference[MAX_TEST_PIXELS];
+
+static int g_failures = 0;
+
+// xorshift32, so every compiler sees the same pixels
+static unsigned int g_random = 2463534242u;
+
+static unsigned char NextRandomByte(void) {
+    g_random ^= g_random << 13;
+    g_random ^= g_random >> 17;
+    g_random ^= g_random << 5;
+    return (unsigned char)(g_random >> 24);
+}
+
+static void FillFrames(void) {
+    for (int i = 0; i < MAX_TEST_PIXELS * 4; i++) {
+        g_bgra[i] = NextRandomByte();
+    }
+    // Extremes first, so saturation in the vector path is exercised
+    g_bgra[0] = g_bgra[1] = g_bgra[2] = g_bgra[3] = 255;
+    g_bgra[4] = g_bgra[5] = g_bgra[6] = g_bgra[7] = 0;
+
+    for (int i = 0; i < MAX_TEST_PIXELS; i++) {
+        g_frameA[i] = NextRandomByte();
+        // Mostly small changes, a few large ones in either direction
+        int delta = (int)(NextRandomByte() % 41) - 20;
+        if (i % 7 == 0) delta *= 6;
+        int b = (int)g_frameA[i] + delta;
+        g_frameB[i] = (unsigned char)(b < 0 ? 0 : b > 255 ? 255 : b);
+    }
+    g_frameA[0] = 0;
+    g_frameB[0] = 255;
+    g_frameA[1] = 255;
+    g_frameB[1] = 0;
+}
+
+static void TestLuma(int count) {
+    for (int i = 0; i < MAX_TEST_PIXELS; i++) {
+        g_luma[i] = 0xA5;
+        g_lumaReference[i] = 0xA5;
+    }
+    MotionLumaFromBgra(g_bgra, count, g_luma);
+    MotionLumaScalar(g_bgra, 0, count, g_lumaReference);
+
+    for (int i = 0; i < MAX_TEST_PIXELS; i++) {
+        if (g_luma[i] != g_lumaReference[i]) {
+            printf("FAIL luma[count %d]: pixel %d is %d, expected %d\n", count, i, g_luma[i], g_lumaReference[i]);
+            g_failures++;
+            return;
+        }
+    }
+}
+
+static void TestChangedPixels(int count, int threshold) {
+    int got = CountChangedPixels(g_frameA, g_frameB, count, (unsigned char)threshold);
+    int expected = CountChangedPixelsScalar(g_frameA, g_frameB, 0, count, (unsigned char)threshold);
+    if (got != expected) {
+        printf("FAIL changed[count %d, threshold %d]: got %d, expected %d\n", count, threshold, got, expected);
+        g_failures++;
+    }
+}
+
+int main(void) {
+    FillFrames();
+
+    for (int count = 0; count <= 67; count++) {
+        TestLuma(count);
+        for (int threshold = 0; threshold < 256; threshold++) {
+            TestChangedPixels(count, threshold);
+        }
+    }
+    TestLuma(MAX_TEST_PIXELS);
+    for (int threshold = 0; threshold < 256; threshold++) {
+        TestChangedPixels(MAX_TEST_PIXELS, threshold);
+    }
+
+    if (g_failures) {
+        printf("%d motion kernel test(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All motion kernel tests passed (%s path)\n", MOTION_USE_SSE2 ? "SSE2" : "scalar");
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Tests for the process name interning in src/oled_names.h. Plain C, like
+// tests/test_policy.c:
+//   cc -I src tests/test_names.c -o build/test_names
+
+#include <stdio.h>
+#include "oled_names.h"
+
+static int g_failures = 0;
+
+static void Check(int ok, const char* what, int got, int expected) {
+    if (!ok) {
+        printf("FAIL %s: got %d, expected %d\n", what, got, expected);
+        g_failures++;
+    }
+}
+
+static ProcessNameTable g_table;
+
+static void TestLookup(void) {
+    int inserted;
+    int chrome = InsertProcessName(&g_table, "chrome.exe", &inserted);
+    Check(chrome >= 0 && inserted, "insert chrome.exe", inserted, 1);
+    int id = InsertProcessName(&g_table, "Chrome.EXE", &inserted);
+    Check(id == chrome && !inserted, "insert Chrome.EXE", id, chrome);
+    id = FindProcessName(&g_table, "CHROME.exe");
+    Check(id == chrome, "find CHROME.exe", id, chrome);
+    id = FindProcessName(&g_table, "firefox.exe");
+    Check(id == -1, "find firefox.exe", id, -1);
+    Check(g_table.count == 1, "count", g_table.count, 1);
+
+    // Names are truncated to PROCESS_NAME_KEY_LEN - 1 characters
+    char longA[100];
+    char longB[100];
+    for (int i = 0; i < 99; i++) {
+        longA[i] = 'a';
+        longB[i] = 'A';
+    }
+    longA[99] = '\0';
+    longB[99] = '\0';
+    longB[80] = 'x';
+    int longId = InsertProcessName(&g_table, longA, &inserted);
+    id = FindProcessName(&g_table, longB);
+    Check(longId >= 0 && id == longId, "truncated name", id, longId);
+}
+
+static void TestClear(void) {
+    ClearProcessNamesIfFull(&g_table);
+    Check(g_table.count == 2 && g_table.generation == 0, "clear below half full", g_table.count, 2);
+
+    char name[32];
+    int inserted;
+    for (int i = g_table.count; i < MAX_INTERNED_PROCESS_NAMES / 2; i++) {
+        snprintf(name, sizeof(name), "app%d.exe", i);
+        InsertProcessName(&g_table, name, &inserted);
+    }
+    ClearProcessNamesIfFull(&g_table);
+    Check(g_table.count == 0, "clear at half full", g_table.count, 0);
+    Check(g_table.generation == 1, "generation after clear", (int)g_table.generation, 1);
+    int id = FindProcessName(&g_table, "chrome.exe");
+    Check(id == -1, "find after clear", id, -1);
+}
+
+static void TestOverflow(void) {
+    char name[32];
+    int inserted;
+    int failed = 0;
+    for (int i = 0; i < MAX_INTERNED_PROCESS_NAMES; i++) {
+        snprintf(name, sizeof(name), "app%d.exe", i);
+        if (InsertProcessName(&g_table, name, &inserted) < 0) failed++;
+    }
+    Check(failed == 0 && !g_table.overflowed, "fill table", failed, 0);
+    int id = InsertProcessName(&g_table, "one-too-many.exe", &inserted);
+    Check(id == -1, "insert into full table", id, -1);
+    Check(g_table.overflowed == 1, "overflowed", g_table.overflowed, 1);
+    id = FindProcessName(&g_table, "app7.exe");
+    Check(id >= 0, "find in full table", id, 0);
+
+    ClearProcessNamesIfFull(&g_table);
+    Check(g_table.count == 0 && !g_table.overflowed, "clear after overflow", g_table.count, 0);
+    id = InsertProcessName(&g_table, "one-too-many.exe", &inserted);
+    Check(id >= 0 && inserted, "insert after clear", id, 0);
+}
+
+int main(void) {
+    TestLookup();
+    TestClear();
+    TestOverflow();
+
+    if (g_failures) {
+        printf("%d name table test(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All name table tests passed\n");
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Table-driven tests for the activation policy in src/oled_policy.h.
+// Plain C with no Win32 dependency, so they build with cl.exe or any other
+// C compiler:
+//   cl.exe /nologo /I src tests\test_policy.c /Fe:build\test_policy.exe
+//   cc -I src tests/test_policy.c -o build/test_policy
+
+#include <stdio.h>
+#include "oled_policy.h"
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+static int g_failures = 0;
+
+static void Check(int ok, const char *table, int row, int got, int expected) {
+    if (!ok) {
+        printf("FAIL %s[%d]: got %d, expected %d\n", table, row, got, expected);
+        g_failures++;
+    }
+}
+
+typedef struct {
+    int screenSaverActive;
+    int idleSeconds;
+    int idleTimeout;
+    int hasMedia;
+    int inManualCooldown;
+    MonitorAction expected;
+} MonitorCase;
+
+static const MonitorCase g_monitorCases[] = {
+    // Idle past the timeout, nothing playing
+    { 0, 300, 300, 0, 0, MONITOR_ACTION_ACTIVATE },
+    { 0, 301, 300, 0, 0, MONITOR_ACTION_ACTIVATE },
+    { 1, 301, 300, 0, 0, MONITOR_ACTION_NONE },
+    { 0, 299, 300, 0, 0, MONITOR_ACTION_NONE },
+    // Media keeps the monitor uncovered, whatever the idle time
+    { 0, 999, 300, 1, 0, MONITOR_ACTION_NONE },
+    { 1, 999, 300, 1, 0, MONITOR_ACTION_DEACTIVATE_MEDIA },
+    { 1,   0, 300, 1, 0, MONITOR_ACTION_DEACTIVATE_MEDIA },
+    // Fresh input on a covered monitor
+    { 1,   0, 300, 0, 0, MONITOR_ACTION_DEACTIVATE_INPUT },
+    { 1, IDLE_DEACTIVATE_THRESHOLD_SEC - 1, 300, 0, 0, MONITOR_ACTION_DEACTIVATE_INPUT },
+    { 1, IDLE_DEACTIVATE_THRESHOLD_SEC,     300, 0, 0, MONITOR_ACTION_NONE },
+    // Manual cooldown holds off every deactivation, but not activation
+    { 1,   0, 300, 0, 1, MONITOR_ACTION_NONE },
+    { 1,   0, 300, 1, 1, MONITOR_ACTION_NONE },
+    { 0, 301, 300, 0, 1, MONITOR_ACTION_ACTIVATE },
+};
+
+typedef struct {
+    int screenSaverActive;
+    int hasMedia;
+    MonitorAction expected;
+} IdleMonitorCase;
+
+static const IdleMonitorCase g_idleMonitorCases[] = {
+    { 0, 0, MONITOR_ACTION_ACTIVATE },
+    { 1, 0, MONITOR_ACTION_NONE },
+    { 0, 1, MONITOR_ACTION_NONE },
+    { 1, 1, MONITOR_ACTION_DEACTIVATE_MEDIA },
+};
+
+typedef struct {
+    int screenSaverActive;
+    unsigned long idleMs;
+    unsigned long idleTimeoutMs;
+    int mediaPlaying;
+    int isManualActivation;
+    unsigned long msSinceManual;
+    GlobalAction expected;
+} GlobalCase;
+
+static const GlobalCase g_globalCases[] = {
+    // Activation needs idle strictly past the timeout and no media
+    { 0, 300001, 300000, 0, 0, 0, GLOBAL_ACTION_ACTIVATE },
+    { 0, 300000, 300000, 0, 0, 0, GLOBAL_ACTION_NONE },
+    { 1, 300001, 300000, 0, 0, 0, GLOBAL_ACTION_NONE },
+    { 0, 300001, 300000, 1, 0, 0, GLOBAL_ACTION_NONE },
+    // Input or media deactivates an automatic activation right away
+    { 1,    100, 300000, 0, 0, 0, GLOBAL_ACTION_DEACTIVATE },
+    { 1, 300001, 300000, 1, 0, 0, GLOBAL_ACTION_DEACTIVATE },
+    { 0,    100, 300000, 0, 0, 0, GLOBAL_ACTION_NONE },
+    // Manual activation: cooldown first, then only fresh input deactivates
+    { 1,    100, 300000, 0, 1, 0,                                 GLOBAL_ACTION_HOLD_COOLDOWN },
+    { 1,    100, 300000, 1, 1, MANUAL_ACTIVATION_COOLDOWN_MS - 1, GLOBAL_ACTION_HOLD_COOLDOWN },
+    { 1,    100, 300000, 0, 1, MANUAL_ACTIVATION_COOLDOWN_MS,     GLOBAL_ACTION_DEACTIVATE_AFTER_COOLDOWN },
+    { 1, IDLE_DEACTIVATE_THRESHOLD_MS - 1, 300000, 0, 1, 5000, GLOBAL_ACTION_DEACTIVATE_AFTER_COOLDOWN },
+    { 1, IDLE_DEACTIVATE_THRESHOLD_MS,     300000, 0, 1, 5000, GLOBAL_ACTION_NONE },
+    { 1, 300001, 300000, 0, 1, 5000, GLOBAL_ACTION_NONE },
+};
+
+// A short scripted session on two monitors in per-monitor input mode: the
+// user works on monitor 0, leaves monitor 1 alone, then starts a video on
+// monitor 1 and finally returns to it.
+typedef struct {
+    int idleSeconds[2];
+    int hasMedia[2];
+    int expectedActive[2];
+} ScenarioStep;
+
+static const ScenarioStep g_scenario[] = {
+    { {   0,   0 }, { 0, 0 }, { 0, 0 } },
+    { {   0, 299 }, { 0, 0 }, { 0, 0 } },
+    { {   0, 300 }, { 0, 0 }, { 0, 1 } },
+    { {  60, 400 }, { 0, 0 }, { 0, 1 } },
+    { { 300, 600 }, { 0, 0 }, { 1, 1 } },
+    { { 310, 610 }, { 0, 1 }, { 1, 0 } },
+    { { 320, 620 }, { 0, 1 }, { 1, 0 } },
+    { {   0, 630 }, { 0, 0 }, { 0, 1 } },
+    { {   1,   0 }, { 0, 0 }, { 0, 0 } },
+};
+
+// A scripted controller standing in for XInputGetState. Each step either
+// skips polling (no deadline near) or polls at its tick, with the slots in
+// the given state.
+typedef struct {
+    unsigned int tick;
+    int polled;
+    int connected[2];                   // Slots 0 and 1; slots 2 and 3 stay empty
+    unsigned int packet[2];
+    int expectedActivity;
+} ControllerStep;
+
+#define CONTROLLER_TEST_MAX_GAP_MS 5000
+
+static const ControllerStep g_controllerSteps[] = {
+    { 1000,  1, { 1, 0 }, { 5, 0 }, 0 },  // First poll only takes the baseline
+    { 2000,  1, { 1, 0 }, { 5, 0 }, 0 },
+    { 3000,  1, { 1, 0 }, { 6, 0 }, 1 },  // Button pressed between polls
+    { 4000,  0, { 1, 0 }, { 9, 0 }, 0 },  // Used while polling was paused...
+    { 5000,  1, { 1, 0 }, { 9, 0 }, 0 },  // ...which is not fresh input
+    { 6000,  1, { 1, 1 }, { 9, 1 }, 0 },  // Slot 1 plugged in, empty slot not re-probed yet
+    { 10000, 1, { 1, 1 }, { 9, 1 }, 1 },  // Re-probed: connected between polls
+    { 11000, 1, { 1, 1 }, { 9, 1 }, 0 },
+    { 30000, 1, { 1, 1 }, { 12, 4 }, 0 }, // Timer delayed past the gap: re-baseline
+    { 31000, 1, { 0, 1 }, { 0, 4 }, 0 },  // Unplugging is not input
+    { 32000, 1, { 0, 1 }, { 0, 4 }, 0 },
+};
+
+static const ControllerStep* g_controllerNow = NULL;
+static int g_emptySlotReads = 0;
+
+static int ScriptedReadPacket(unsigned int slot, unsigned int* packetNumber) {
+    if (slot >= 2) {
+        g_emptySlotReads++;
+        return 0;
+    }
+    if (!g_controllerNow->connected[slot]) return 0;
+    *packetNumber = g_controllerNow->packet[slot];
+    return 1;
+}
+
+static void TestControllerTracker(void) {
+    ControllerTracker tracker = {0};
+
+    for (int i = 0; i < (int)COUNT_OF(g_controllerSteps); i++) {
+        g_controllerNow = &g_controllerSteps[i];
+        int activity = 0;
+        if (g_controllerNow->polled) {
+            activity = PollControllerTracker(&tracker, ScriptedReadPacket, g_controllerNow->tick,
+                                             CONTROLLER_TEST_MAX_GAP_MS);
+        } else {
+            InvalidateControllerBaseline(&tracker);
+        }
+        Check(activity == g_controllerNow->expectedActivity, "controller", i,
+              activity, g_controllerNow->expectedActivity);
+    }
+
+    // Slots 2 and 3 are probed on each re-baseline (1000, 5000, 30000) and
+    // once CONTROLLER_RESCAN_MS has passed (10000): 4 times each
+    Check(g_emptySlotReads == 8, "controller/emptySlotReads", 0, g_emptySlotReads, 8);
+}
+
+static void TestMonitorCases(void) {
+    for (int i = 0; i < (int)COUNT_OF(g_monitorCases); i++) {
+        const MonitorCase *c = &g_monitorCases[i];
+        MonitorAction got = DecideMonitorAction(c->screenSaverActive, c->idleSeconds, c->idleTimeout,
+                                                c->hasMedia, c->inManualCooldown);
+        Check(got == c->expected, "monitor", i, got, c->expected);
+    }
+}
+
+static void TestIdleMonitorCases(void) {
+    for (int i = 0; i < (int)COUNT_OF(g_idleMonitorCases); i++) {
+        const IdleMonitorCase *c = &g_idleMonitorCases[i];
+        MonitorAction got = DecideIdleMonitorAction(c->screenSaverActive, c->hasMedia);
+        Check(got == c->expected, "idleMonitor", i, got, c->expected);
+    }
+}
+
+static void TestGlobalCases(void) {
+    for (int i = 0; i < (int)COUNT_OF(g_globalCases); i++) {
+        const GlobalCase *c = &g_globalCases[i];
+        GlobalAction got = DecideGlobalAction(c->screenSaverActive, c->idleMs, c->idleTimeoutMs,
+                                              c->mediaPlaying, c->isManualActivation, c->msSinceManual);
+        Check(got == c->expected, "global", i, got, c->expected);
+    }
+}
+
+static void TestScenario(void) {
+    int active[2] = { 0, 0 };
+
+    for (int step = 0; step < (int)COUNT_OF(g_scenario); step++) {
+        const ScenarioStep *s = &g_scenario[step];
+        for (int m = 0; m < 2; m++) {
+            switch (DecideMonitorAction(active[m], s->idleSeconds[m], 300, s->hasMedia[m], 0)) {
+                case MONITOR_ACTION_ACTIVATE:
+                    active[m] = 1;
+                    break;
+                case MONITOR_ACTION_DEACTIVATE_MEDIA:
+                case MONITOR_ACTION_DEACTIVATE_INPUT:
+                    active[m] = 0;
+                    break;
+                case MONITOR_ACTION_NONE:
+                    break;
+            }
+            Check(active[m] == s->expectedActive[m], m ? "scenario/monitor1" : "scenario/monitor0",
+                  step, active[m], s->expectedActive[m]);
+        }
+    }
+}
+
+int main(void) {
+    TestMonitorCases();
+    TestIdleMonitorCases();
+    TestGlobalCases();
+    TestScenario();
+    TestControllerTracker();
+
+    if (g_failures) {
+        printf("%d policy test(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All policy tests passed\n");
+    return 0;
+}